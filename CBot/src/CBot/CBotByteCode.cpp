@@ -0,0 +1,1636 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#include "CBot/CBotByteCode.h"
+
+#include "CBot/CBotStack.h"
+
+#include "CBot/CBotInstr/CBotInstr.h"
+#include "CBot/CBotInstr/CBotExprLitBool.h"
+#include "CBot/CBotInstr/CBotExprLitNum.h"
+#include "CBot/CBotInstr/CBotInstrCall.h"
+
+#include "CBot/CBotVar/CBotVar.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+namespace CBot
+{
+
+////////////////////////////////////////////////////////////////////////////////
+CBotByteCode::CBotByteCode()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::unique_ptr<CBotByteCode> CBotByteCode::Generate(CBotInstr* expr)
+{
+    std::unique_ptr<CBotByteCode> code(new CBotByteCode());
+
+    if (!expr->GenerateByteCode(*code) || code->m_operands.size() != 1) return nullptr;
+    if (code->m_depth > MAX_DEPTH) return nullptr;
+
+    code->m_resultType = code->m_operands.back().type;
+    code->m_operands.clear();
+
+    // the subexpressions are evaluated by this code from now on
+    for (std::unique_ptr<CBotByteCode>* subsumed : code->m_subsumed) subsumed->reset();
+    code->m_subsumed.clear();
+
+    return code;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotInstr* CBotByteCode::Fold(CBotInstr* expr)
+{
+    CBotByteCode code;
+
+    if (!expr->GenerateByteCode(code) || code.m_operands.size() != 1) return expr;
+    if (code.m_depth > MAX_DEPTH) return expr;
+    if (code.m_code.size() < 2) return expr;        // nothing computed
+    if (code.m_operands.back().named) return expr;  // +WheeledGrabber keeps its name
+    for (const Operation& operation : code.m_code)
+    {
+        if (operation.code == OpCode::VARIABLE) return expr;    // not a constant
+    }
+
+    Value       value;
+    CBotToken*  errToken = nullptr;
+    int         ticks = 0;
+    if (code.Run(nullptr, value, errToken, ticks) != CBotNoErr) return expr;
+
+    CBotInstr* inst = nullptr;
+    switch (code.m_operands.back().type)
+    {
+    case CBotTypBoolean: inst = new CBotExprLitBool(value.b); break;
+    case CBotTypInt:     inst = new CBotExprLitNum<int>(value.i); break;
+    case CBotTypLong:    inst = new CBotExprLitNum<long>(value.l); break;
+    case CBotTypFloat:   inst = new CBotExprLitNum<float>(value.f); break;
+    case CBotTypDouble:  inst = new CBotExprLitNum<double>(value.d); break;
+    default: return expr;
+    }
+    inst->SetToken(expr->GetToken());
+
+    delete expr;
+    return inst;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::IsConstant(CBotInstr* expr, bool& value)
+{
+    CBotByteCode code;
+
+    if (!expr->GenerateByteCode(code)) return false;
+    if (code.m_code.size() != 1 || code.m_code[0].code != OpCode::CONSTANT) return false;
+    if (code.m_code[0].type != CBotTypBoolean) return false;
+
+    value = code.m_constants[0].b;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::IsSupported(CBotType type)
+{
+    return type == CBotTypInt   || type == CBotTypLong   ||
+           type == CBotTypFloat || type == CBotTypDouble ||
+           type == CBotTypBoolean;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::Add(OpCode code, CBotType type, int op, long arg, CBotToken* token)
+{
+    Operation operation;
+    operation.code   = code;
+    operation.type   = type;
+    operation.source = type;
+    operation.mode   = NONE;
+    operation.op     = op;
+    operation.arg    = arg;
+    operation.scope  = m_scope;
+    operation.token  = token;
+    operation.instr  = nullptr;
+    operation.ticks  = 0;
+    m_code.push_back(operation);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::Push(CBotType type, bool named)
+{
+    m_operands.push_back(Operand{type, named, false});
+    m_depth = std::max(m_depth, static_cast<int>(m_operands.size()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::PushHeld()
+{
+    m_operands.push_back(Operand{CBotTypVoid, false, true});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::AddConversion(int depth, CBotType type)
+{
+    Operand& source = m_operands[m_operands.size() - 1 - depth];
+    if (source.type == type) return;
+
+    Add(OpCode::CONVERT, type, 0, depth);
+    m_code.back().source = source.type;
+    source.type = type;
+    source.named = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddConstant(int value)
+{
+    Value v;
+    v.i = value;
+    Add(OpCode::CONSTANT, CBotTypInt, 0, m_constants.size());
+    m_constants.push_back(v);
+    Push(CBotTypInt);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddConstant(long value)
+{
+    Value v;
+    v.l = value;
+    Add(OpCode::CONSTANT, CBotTypLong, 0, m_constants.size());
+    m_constants.push_back(v);
+    Push(CBotTypLong);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddConstant(float value)
+{
+    Value v;
+    v.f = value;
+    Add(OpCode::CONSTANT, CBotTypFloat, 0, m_constants.size());
+    m_constants.push_back(v);
+    Push(CBotTypFloat);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddConstant(double value)
+{
+    Value v;
+    v.d = value;
+    Add(OpCode::CONSTANT, CBotTypDouble, 0, m_constants.size());
+    m_constants.push_back(v);
+    Push(CBotTypDouble);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddConstant(bool value)
+{
+    Value v;
+    v.b = value;
+    Add(OpCode::CONSTANT, CBotTypBoolean, 0, m_constants.size());
+    m_constants.push_back(v);
+    Push(CBotTypBoolean);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddVariable(long ident, int slot, CBotType type, CBotToken* token)
+{
+    if (!IsSupported(type)) return false;
+
+    Add(OpCode::VARIABLE, type, slot, ident, token);
+    m_code.back().ticks = 1;                    // see CBotExprVar::Execute()
+    Push(type, type == CBotTypInt);             // it may have been assigned a predefined number
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddUnaryOperation(int op)
+{
+    if (m_operands.empty() || !IsSupported(m_operands.back().type)) return false;
+    CBotType type = m_operands.back().type;
+
+    switch (op)
+    {
+    case ID_ADD:
+    case ID_SUB:
+        if (type == CBotTypBoolean) return false;
+        break;
+    case ID_NOT:
+        if (type != CBotTypInt && type != CBotTypLong) return false;
+        break;
+    case ID_LOG_NOT:
+    case ID_TXT_NOT:
+        if (type != CBotTypBoolean) return false;
+        break;
+    default:
+        return false;
+    }
+
+    Add(OpCode::UNARY, type, op);
+    m_code.back().ticks = 1;                    // see CBotExprUnaire::Execute()
+    if (op != ID_ADD) m_operands.back().named = false;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int CBotByteCode::AddShortCircuit(int op)
+{
+    OpCode jump;
+    switch (op)
+    {
+    case ID_LOG_AND:
+    case ID_TXT_AND:
+        jump = OpCode::JUMP_IF_FALSE;
+        break;
+    case ID_LOG_OR:
+    case ID_TXT_OR:
+        jump = OpCode::JUMP_IF_TRUE;
+        break;
+    default:
+        return -1;
+    }
+    if (m_operands.empty() || m_operands.back().type != CBotTypBoolean) return -1;
+
+    Add(jump, CBotTypBoolean);
+    m_operands.pop_back();                 // when not skipped, the result is the second operand
+    return m_code.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddOperation(int op, CBotToken* token, int shortCircuit)
+{
+    if (shortCircuit >= 0)
+    {
+        // (a && b) is b when it is evaluated, same for ||
+        if (m_operands.empty() || m_operands.back().type != CBotTypBoolean) return false;
+        m_code[shortCircuit].arg = m_code.size();
+        // the ticks of CBotTwoOpExpr::Execute() are charged only when b is evaluated, see Evaluate()
+        m_code[shortCircuit].ticks = 2;
+        m_operands.back().named = false;
+        return true;
+    }
+
+    if (m_operands.size() < 2) return false;
+    CBotType type1 = m_operands[m_operands.size() - 2].type;
+    CBotType type2 = m_operands[m_operands.size() - 1].type;
+    if (!IsSupported(type1) || !IsSupported(type2)) return false;
+
+    bool isBool = (type1 == CBotTypBoolean);
+    if (isBool != (type2 == CBotTypBoolean)) return false;
+
+    // same rules as CBotTwoOpExpr::Execute()
+    CBotType type = std::max(type1, type2);
+    CBotType typeRes = type;
+
+    switch (op)
+    {
+    case ID_EQ:
+    case ID_NE:
+        typeRes = CBotTypBoolean;
+        break;
+    case ID_HI:
+    case ID_LO:
+    case ID_HS:
+    case ID_LS:
+        if (isBool) return false;
+        typeRes = CBotTypBoolean;
+        break;
+    case ID_AND:
+    case ID_OR:
+    case ID_XOR:
+        if (type == CBotTypFloat || type == CBotTypDouble) return false;
+        break;
+    case ID_SL:
+    case ID_ASR:
+    case ID_SR:
+        if (type != CBotTypInt && type != CBotTypLong) return false;
+        break;
+    case ID_DIV:
+        if (type == CBotTypFloat && (type1 == CBotTypLong || type2 == CBotTypLong)) type = typeRes = CBotTypDouble;
+        [[fallthrough]];
+    case ID_ADD:
+    case ID_SUB:
+    case ID_MUL:
+    case ID_MODULO:
+    case ID_POWER:
+        if (isBool) return false;
+        break;
+    default:
+        return false;
+    }
+
+    // arithmetic is made in the type of the result, comparisons in the greatest of both types
+    AddConversion(1, type);
+    AddConversion(0, (op == ID_SL || op == ID_ASR || op == ID_SR) ? CBotTypInt : type);
+
+    Add(OpCode::BINARY, type, op, 0, token);
+    m_code.back().ticks = 2;                    // see CBotTwoOpExpr::Execute()
+    m_operands.pop_back();
+    m_operands.back() = Operand{typeRes, false, false};
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::AddSubsumed(std::unique_ptr<CBotByteCode>* code)
+{
+    // a statement of a function body may still be executed by the tree walker (see AddInstruction())
+    if (m_function) return;
+    m_subsumed.push_back(code);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::SetNamed()
+{
+    if (!m_operands.empty() && m_operands.back().type == CBotTypInt) m_operands.back().named = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T CBotByteCode::Get(const Value& value)
+{
+    if constexpr (std::is_same_v<T, bool>)   return value.b;
+    if constexpr (std::is_same_v<T, int>)    return value.i;
+    if constexpr (std::is_same_v<T, long>)   return value.l;
+    if constexpr (std::is_same_v<T, float>)  return value.f;
+    if constexpr (std::is_same_v<T, double>) return value.d;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void CBotByteCode::Set(Value& value, T val)
+{
+    if constexpr (std::is_same_v<T, bool>)   value.b = val;
+    if constexpr (std::is_same_v<T, int>)    value.i = val;
+    if constexpr (std::is_same_v<T, long>)   value.l = val;
+    if constexpr (std::is_same_v<T, float>)  value.f = val;
+    if constexpr (std::is_same_v<T, double>) value.d = val;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::Convert(Value& value, CBotType source, CBotType type)
+{
+    // same conversions as the CBotVar::GetVal...() of the source type
+    double d = 0;
+    long   l = 0;
+    bool   isFloat = false;
+
+    switch (source)
+    {
+    case CBotTypBoolean: l = value.b; break;
+    case CBotTypInt:     l = value.i; break;
+    case CBotTypLong:    l = value.l; break;
+    case CBotTypFloat:   d = value.f; isFloat = true; break;
+    case CBotTypDouble:  d = value.d; isFloat = true; break;
+    default: assert(false);
+    }
+
+    switch (type)
+    {
+    case CBotTypInt:
+        value.i = isFloat ? static_cast<int>(d) : static_cast<int>(l);
+        break;
+    case CBotTypLong:
+        value.l = isFloat ? static_cast<long>(d) : l;
+        break;
+    case CBotTypFloat:
+        value.f = isFloat ? static_cast<float>(d) : static_cast<float>(l);
+        break;
+    case CBotTypDouble:
+        value.d = isFloat ? d : static_cast<double>(l);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::Read(CBotVar* var, CBotType type, Value& value)
+{
+    switch (type)
+    {
+    case CBotTypBoolean: value.b = var->GetValInt() != 0; break;
+    case CBotTypInt:     value.i = var->GetValInt(); break;
+    case CBotTypLong:    value.l = var->GetValLong(); break;
+    case CBotTypFloat:   value.f = var->GetValFloat(); break;
+    case CBotTypDouble:  value.d = var->GetValDouble(); break;
+    default: assert(false);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::Write(CBotVar* var, CBotType type, const Value& value)
+{
+    switch (type)
+    {
+    case CBotTypBoolean: var->SetValInt(value.b); break;
+    case CBotTypInt:     var->SetValInt(value.i); break;
+    case CBotTypLong:    var->SetValLong(value.l); break;
+    case CBotTypFloat:   var->SetValFloat(value.f); break;
+    case CBotTypDouble:  var->SetValDouble(value.d); break;
+    default: assert(false);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::Unary(int op, CBotType type, Value& value)
+{
+    switch (op)
+    {
+    case ID_ADD:
+        break;
+    case ID_SUB:
+        switch (type)
+        {
+        case CBotTypInt:    value.i = WrappingNeg(value.i); break;
+        case CBotTypLong:   value.l = WrappingNeg(value.l); break;
+        case CBotTypFloat:  value.f = -value.f; break;
+        case CBotTypDouble: value.d = -value.d; break;
+        default: assert(false);
+        }
+        break;
+    case ID_NOT:
+        if (type == CBotTypInt) value.i = ~value.i;
+        else                    value.l = ~value.l;
+        break;
+    case ID_LOG_NOT:
+    case ID_TXT_NOT:
+        value.b = !value.b;
+        break;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+CBotError CBotByteCode::Compute(int op, Value& left, const Value& right, bool nanIsError)
+{
+    // see CBotVarValue.h for the reference implementation of each operator
+    T l = Get<T>(left);
+
+    if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    {
+        int shift = right.i;
+        switch (op)
+        {
+        case ID_SL:
+            Set<T>(left, static_cast<T>(static_cast<std::make_unsigned_t<T>>(l) << shift));
+            return CBotNoErr;
+        case ID_ASR:
+            Set<T>(left, l >> shift);
+            return CBotNoErr;
+        case ID_SR:
+            Set<T>(left, static_cast<std::make_unsigned_t<T>>(l) >> shift);
+            return CBotNoErr;
+        }
+    }
+
+    T r = Get<T>(right);
+
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        if (nanIsError && (std::isnan(l) || std::isnan(r)))
+        {
+            if (op == ID_EQ) { left.b = std::isnan(l) == std::isnan(r); return CBotNoErr; }
+            if (op == ID_NE) { left.b = std::isnan(l) != std::isnan(r); return CBotNoErr; }
+            return CBotErrNan;
+        }
+    }
+
+    switch (op)
+    {
+    case ID_EQ:
+        left.b = l == r;
+        return CBotNoErr;
+    case ID_NE:
+        left.b = l != r;
+        return CBotNoErr;
+    }
+
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        switch (op)
+        {
+        case ID_AND: left.b = l && r; break;
+        case ID_OR:  left.b = l || r; break;
+        case ID_XOR: left.b = l != r; break;
+        default: assert(false);
+        }
+    }
+    else
+    {
+        switch (op)
+        {
+        case ID_ADD:
+            Set<T>(left, WrappingAdd(l, r));
+            break;
+        case ID_SUB:
+            Set<T>(left, WrappingSub(l, r));
+            break;
+        case ID_MUL:
+            Set<T>(left, WrappingMul(l, r));
+            break;
+        case ID_POWER:
+            Set<T>(left, pow(l, r));
+            break;
+        case ID_DIV:
+            if (r == static_cast<T>(0)) return CBotErrZeroDiv;
+            Set<T>(left, WrappingDiv(l, r));
+            break;
+        case ID_MODULO:
+            if (r == static_cast<T>(0)) return CBotErrZeroDiv;
+            if constexpr (std::is_integral_v<T>) Set<T>(left, WrappingMod(l, r));
+            else                                 Set<T>(left, fmod(l, r));
+            break;
+        case ID_LO:
+            left.b = l < r;
+            break;
+        case ID_HI:
+            left.b = l > r;
+            break;
+        case ID_LS:
+            left.b = l <= r;
+            break;
+        case ID_HS:
+            left.b = l >= r;
+            break;
+        default:
+            if constexpr (std::is_integral_v<T>)
+            {
+                switch (op)
+                {
+                case ID_AND: Set<T>(left, l & r); break;
+                case ID_OR:  Set<T>(left, l | r); break;
+                case ID_XOR: Set<T>(left, l ^ r); break;
+                default: assert(false);
+                }
+            }
+            else assert(false);
+        }
+    }
+    return CBotNoErr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::Execute(CBotStack* pile)
+{
+    Value       value;
+    CBotToken*  errToken = nullptr;
+    int         ticks = 0;
+    CBotError   err = Run(pile, value, errToken, ticks);
+
+    CBotVar* result = CBotVar::Create("", m_resultType);
+    if (err == CBotNoErr) Write(result, m_resultType, value);
+    pile->SetVar(result);
+    if (err != CBotNoErr) pile->SetError(err, errToken);
+
+    pile->ChargeTimer(ticks);
+    return pile->IsOk();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline CBotError CBotByteCode::Evaluate(const Operation& operation, Value* stack, int& top, std::size_t& pc, int& ticks,
+                                        CBotStack* pile, CBotToken*& errToken)
+{
+    CBotError err = CBotNoErr;
+
+    switch (operation.code)
+    {
+    case OpCode::CONSTANT:
+        stack[top++] = m_constants[operation.arg];
+        break;
+
+    case OpCode::VARIABLE:
+    {
+        CBotVar* var = pile->FindVar(operation.arg, operation.op, false);
+        assert(var != nullptr);
+        if (operation.token != nullptr && var->IsUndefined())
+        {
+            errToken = operation.token;
+            return CBotErrNotInit;
+        }
+        Read(var, operation.type, stack[top++]);
+        break;
+    }
+
+    case OpCode::CONVERT:
+        Convert(stack[top - 1 - operation.arg], operation.source, operation.type);
+        break;
+
+    case OpCode::UNARY:
+        Unary(operation.op, operation.type, stack[top - 1]);
+        break;
+
+    case OpCode::BINARY:
+    {
+        bool nanIsError = (operation.mode == NONE);
+        switch (operation.type)
+        {
+        case CBotTypBoolean: err = Compute<bool>(operation.op, stack[top - 2], stack[top - 1], nanIsError); break;
+        case CBotTypInt:     err = Compute<int>(operation.op, stack[top - 2], stack[top - 1], nanIsError); break;
+        case CBotTypLong:    err = Compute<long>(operation.op, stack[top - 2], stack[top - 1], nanIsError); break;
+        case CBotTypFloat:   err = Compute<float>(operation.op, stack[top - 2], stack[top - 1], nanIsError); break;
+        case CBotTypDouble:  err = Compute<double>(operation.op, stack[top - 2], stack[top - 1], nanIsError); break;
+        default: assert(false);
+        }
+        top--;
+        errToken = operation.token;
+        break;
+    }
+
+    case OpCode::JUMP_IF_FALSE:
+        if (!stack[top - 1].b)
+        {
+            pc = operation.arg;
+            ticks -= operation.ticks;       // the operator costs nothing when b is skipped
+        }
+        else top--;
+        break;
+
+    case OpCode::JUMP_IF_TRUE:
+        if (stack[top - 1].b)
+        {
+            pc = operation.arg;
+            ticks -= operation.ticks;
+        }
+        else top--;
+        break;
+
+    default:
+        assert(false);          // only in function bodies, see ExecuteFunction()
+    }
+
+    return err;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotError CBotByteCode::Run(CBotStack* pile, Value& result, CBotToken*& errToken, int& ticks)
+{
+    Value       stack[MAX_DEPTH];
+    int         top = 0;                            // number of values on the stack
+    CBotError   err = CBotNoErr;
+
+    std::size_t pc = 0;
+    while (pc < m_code.size())
+    {
+        const Operation& operation = m_code[pc++];
+        ticks += operation.ticks;
+
+        err = Evaluate(operation, stack, top, pc, ticks, pile, errToken);
+        if (err != CBotNoErr) break;
+    }
+
+    if (err == CBotNoErr)
+    {
+        assert(top == 1);
+        result = stack[0];
+    }
+    return err;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::unique_ptr<CBotByteCode> CBotByteCode::GenerateFunction(CBotInstr* block)
+{
+    if (block == nullptr) return nullptr;
+
+    std::unique_ptr<CBotByteCode> code(new CBotByteCode());
+    code->m_function = true;
+    code->m_block = block;
+
+    if (!block->GenerateByteCode(*code)) return nullptr;
+    if (code->m_depth > MAX_DEPTH) return nullptr;
+
+    // nothing is gained if every statement is executed by the tree walker
+    bool lowered = false;
+    for (const Operation& operation : code->m_code)
+    {
+        if (operation.code != OpCode::CHECK && operation.code != OpCode::EXEC &&
+            operation.code != OpCode::ENTER && operation.code != OpCode::LEAVE) lowered = true;
+    }
+    if (!lowered) return nullptr;
+
+    // the parents are before their children
+    for (Scope& scope : code->m_scopes)
+    {
+        if (scope.parent < 0) continue;
+        scope.depth = code->m_scopes[scope.parent].depth + (scope.level ? 1 : 0);
+        if (scope.depth >= MAX_LEVELS) return nullptr;
+    }
+
+    code->m_operands.clear();
+    return code;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotByteCode::Mark CBotByteCode::GetMark()
+{
+    return Mark{m_code.size(), m_operands.size(), m_scopes.size(), m_loops.size(), m_jumps.size(), m_argTypes.size()};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::Rollback(const Mark& mark)
+{
+    m_code.resize(mark.code);
+    m_operands.resize(mark.operands);
+    m_scopes.resize(mark.scopes);
+    m_loops.resize(mark.loops);
+    m_jumps.resize(mark.jumps);
+    m_argTypes.resize(mark.argTypes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddStatement(CBotInstr* instr, Check check)
+{
+    std::size_t at = m_code.size();
+    Add(OpCode::CHECK, CBotTypVoid, check);
+    m_code[at].mode = 1;
+    m_code[at].instr = instr;
+
+    if (AddInstruction(instr)) return true;
+
+    m_code[at].mode = 0;                    // the tree walker pauses by itself
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddInstruction(CBotInstr* instr)
+{
+    Mark mark = GetMark();
+    if (instr->GenerateByteCode(*this))
+    {
+        // the value of an expression used as a statement is dropped
+        int count = 0;
+        while (m_operands.size() > mark.operands)
+        {
+            if (m_operands.back().held)
+            {
+                Add(OpCode::POP, CBotTypVoid);
+                m_code.back().mode = HELD;
+            }
+            else count++;
+            m_operands.pop_back();
+        }
+        if (count > 0) Add(OpCode::POP, CBotTypVoid, 0, count);
+        return true;
+    }
+
+    Rollback(mark);
+    assert(m_operands.empty());
+    Add(OpCode::EXEC, CBotTypVoid);
+    m_code.back().instr = instr;
+    m_code.back().mode = m_declare;         // its variables are restored with the ones of the block
+    m_scopes[m_scope].level = true;
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::AddBody(CBotInstr* body)
+{
+    if (body == nullptr) return;
+
+    // a variable declared by the single statement of an if or a loop belongs to the enclosing block
+    bool declare = m_declare;
+    m_declare = false;
+    AddStatement(body);
+    m_declare = declare;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::AddCondition(CBotInstr* expr, CBotType type)
+{
+    Mark mark = GetMark();
+    if (expr->GenerateByteCode(*this) && m_operands.size() == mark.operands + 1 &&
+        m_operands.back().type == type) return;
+    Rollback(mark);
+
+    assert(m_operands.empty());
+    Add(OpCode::EVAL, type);
+    m_code.back().mode = STACK;
+    m_code.back().instr = expr;
+    Push(type);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddValue(CBotInstr* value)
+{
+    Mark mark = GetMark();
+    if (value->GenerateByteCode(*this) && m_operands.size() == mark.operands + 1)
+    {
+        if (!m_operands.back().named) return true;
+        if (m_code.back().code == OpCode::CALL)
+        {
+            // the result is copied with its name
+            m_code.back().mode = HELD;
+            m_operands.back() = Operand{CBotTypVoid, false, true};
+            return true;
+        }
+    }
+    Rollback(mark);
+
+    if (!m_operands.empty()) return false;          // the tree walker can't run in the middle of an expression
+    Add(OpCode::EVAL, CBotTypVoid);
+    m_code.back().mode = HELD;
+    m_code.back().instr = value;
+    PushHeld();
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int CBotByteCode::OpenScope(CBotInstr* block)
+{
+    int index = m_scopes.size();
+    if (m_scope >= 0)
+    {
+        Add(OpCode::ENTER, CBotTypVoid, 0, index);
+        m_code.back().instr = block;
+    }
+
+    // the body of the function is on the stack level of the code
+    m_scopes.push_back(Scope{m_scope, m_code.size(), m_scope < 0, 0, block});
+    m_scope = index;
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::CloseScope(int scope)
+{
+    int parent = m_scopes[scope].parent;
+    if (parent >= 0) Add(OpCode::LEAVE, CBotTypVoid, 0, parent);
+    m_scope = parent;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int CBotByteCode::OpenLoop(const std::string& label)
+{
+    int index = m_loops.size();
+    m_loops.push_back(Loop{m_code.size(), 0, 0, 0, m_scope, label});
+    m_openLoops.push_back(index);
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::CloseLoop(int index, std::size_t continuePc)
+{
+    Loop& loop = m_loops[index];
+    loop.end = loop.breakPc = m_code.size();
+    loop.continuePc = continuePc;
+
+    for (auto it = m_jumps.begin(); it != m_jumps.end(); )
+    {
+        if (it->loop != index)
+        {
+            ++it;
+            continue;
+        }
+        m_code[it->pc].arg = it->isContinue ? loop.continuePc : loop.breakPc;
+        it = m_jumps.erase(it);
+    }
+    m_openLoops.pop_back();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::AddCheck(CBotInstr* instr, int lim)
+{
+    // same as a SetState(..., lim) of the tree walker whose result is checked
+    Add(OpCode::CHECK, CBotTypVoid, INTERRUPT, lim);
+    m_code.back().instr = instr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::AddBackEdge(CBotInstr* loop, std::size_t target)
+{
+    AddCheck(loop, 0);
+    Add(OpCode::JUMP, CBotTypVoid, 0, target);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddBlock(CBotInstr* block, CBotInstr* first)
+{
+    if (!m_function) return false;
+
+    // a block doesn't pause by itself in step by step mode
+    if (!m_code.empty() && m_code.back().code == OpCode::CHECK && m_code.back().instr == block) m_code.back().mode = 0;
+
+    int scope = OpenScope(block);
+    bool declare = m_declare;
+    m_declare = true;
+    for (CBotInstr* p = first; p != nullptr; p = p->GetNext()) AddStatement(p, p == first ? STEP : TICK);
+    m_declare = declare;
+    CloseScope(scope);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddList(CBotInstr* list, CBotInstr* first)
+{
+    if (!m_function) return false;
+
+    for (CBotInstr* p = first; p != nullptr; p = p->GetNext())
+    {
+        if (p != first) AddCheck(list, -10);
+        AddInstruction(p);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddDeclaration(CBotInstr* instr, CBotToken* name, CBotType type, long ident, CBotInstr* value)
+{
+    if (!m_function || !m_declare || !IsSupported(type)) return false;
+
+    int mode = NONE;
+    if (value != nullptr)
+    {
+        if (!AddValue(value)) return false;
+        if (m_operands.back().held) mode = HELD;
+        else
+        {
+            if ((m_operands.back().type == CBotTypBoolean) != (type == CBotTypBoolean)) return false;
+            AddConversion(0, type);
+            mode = STACK;
+        }
+        m_operands.pop_back();
+    }
+
+    Add(OpCode::DECLARE, type, 0, ident, name);
+    m_code.back().mode = mode;
+    m_scopes[m_scope].level = true;
+    AddCheck(instr, -10);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddAssignment(long ident, int slot, CBotType type, int op, CBotInstr* value, CBotToken* token)
+{
+    if (!m_function || !IsSupported(type) || value == nullptr) return false;
+
+    if (op == ID_ASS)
+    {
+        if (!AddValue(value)) return false;
+        Operand& operand = m_operands.back();
+        if (!operand.held)
+        {
+            if ((operand.type == CBotTypBoolean) != (type == CBotTypBoolean)) return false;
+            AddConversion(0, type);
+        }
+        Add(OpCode::STORE, type, slot, ident, token);
+        m_code.back().mode = operand.held ? HELD : STACK;
+        m_code.back().ticks = 3;                        // see CBotExpression::Execute()
+        // a copy of the variable is the result, it has the name of the value copied from a variable
+        operand = Operand{type, operand.held && type == CBotTypInt, false};
+        return true;
+    }
+
+    // same rules as CBotExpression::Execute(), the operation is made in the type of the variable
+    int binary;
+    switch (op)
+    {
+    case ID_ASSADD:     binary = ID_ADD; break;
+    case ID_ASSSUB:     binary = ID_SUB; break;
+    case ID_ASSMUL:     binary = ID_MUL; break;
+    case ID_ASSDIV:     binary = ID_DIV; break;
+    case ID_ASSMODULO:  binary = ID_MODULO; break;
+    case ID_ASSAND:     binary = ID_AND; break;
+    case ID_ASSOR:      binary = ID_OR; break;
+    case ID_ASSXOR:     binary = ID_XOR; break;
+    case ID_ASSSL:      binary = ID_SL; break;
+    case ID_ASSSR:      binary = ID_SR; break;
+    case ID_ASSASR:     binary = ID_ASR; break;
+    default: return false;
+    }
+
+    bool isBool = (type == CBotTypBoolean);
+    bool isFloat = (type == CBotTypFloat || type == CBotTypDouble);
+    bool isShift = (binary == ID_SL || binary == ID_SR || binary == ID_ASR);
+    bool isLogic = (binary == ID_AND || binary == ID_OR || binary == ID_XOR);
+    if (isBool && !isLogic) return false;
+    if (isFloat && (isLogic || isShift)) return false;
+
+    Add(OpCode::VARIABLE, type, slot, ident);           // no ::CBotErrNotInit here
+    Push(type);
+    if (!value->GenerateByteCode(*this)) return false;
+
+    CBotType right = m_operands.back().type;
+    if (!IsSupported(right) || (right == CBotTypBoolean) != isBool) return false;
+    AddConversion(0, isShift ? CBotTypInt : type);
+
+    Add(OpCode::BINARY, type, binary, 0, token);
+    m_code.back().mode = STACK;                         // CBotVar operators don't check for NaN
+    m_operands.pop_back();
+    m_operands.back() = Operand{type, false, false};
+
+    Add(OpCode::STORE, type, slot, ident, token);
+    m_code.back().mode = STACK;
+    m_code.back().ticks = 3;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddIncrement(long ident, int slot, CBotType type, int op, bool post, CBotToken* token)
+{
+    if (!m_function || !IsSupported(type) || type == CBotTypBoolean) return false;
+
+    Add(post ? OpCode::POST_INCREMENT : OpCode::INCREMENT, type, slot, ident, token);
+    m_code.back().mode = op;
+    m_code.back().ticks = post ? 1 : 2;                 // see CBotPostIncExpr::Execute() and CBotPreIncExpr::Execute()
+    // the copy made before the change keeps the name, CBotVar::Inc() removes it
+    Push(type, post && type == CBotTypInt);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddCall(CBotInstr* call, int count, CBotType type, bool external)
+{
+    // the parameters must be the whole operand stack, nothing is left on it if the call is interrupted
+    if (!m_function || m_operands.size() != static_cast<std::size_t>(count)) return false;
+
+    int first = m_argTypes.size();
+    for (const Operand& operand : m_operands)
+    {
+        if (operand.held || operand.named) return false;
+        m_argTypes.push_back(operand.type);
+    }
+    m_operands.clear();
+
+    Add(OpCode::CALL, type, first, count);
+    m_code.back().instr = call;
+
+    // the result of a function of the program has the type of its return statement
+    if (type == CBotTypVoid)
+    {
+        m_code.back().mode = NONE;
+    }
+    else if (external && IsSupported(type))
+    {
+        m_code.back().mode = STACK;
+        Push(type, type == CBotTypInt);
+    }
+    else
+    {
+        m_code.back().mode = HELD;
+        PushHeld();
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddIf(CBotInstr* instr, CBotInstr* condition, CBotInstr* block, CBotInstr* blockElse)
+{
+    if (!m_function) return false;
+
+    AddCondition(condition, CBotTypBoolean);
+    std::size_t branch = m_code.size();
+    Add(OpCode::BRANCH, CBotTypBoolean);
+    m_operands.pop_back();
+
+    // CBotIf::Execute() checks the timer whatever the condition, once it is no longer on the operand stack
+    AddCheck(instr, -10);
+    AddBody(block);
+    std::size_t jump = m_code.size();
+    Add(OpCode::JUMP, CBotTypVoid);
+    m_code[branch].arg = m_code.size();
+    AddCheck(instr, -10);
+    AddBody(blockElse);
+    m_code[jump].arg = m_code.size();
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddWhile(CBotInstr* loop, CBotInstr* condition, CBotInstr* block, const std::string& label)
+{
+    if (!m_function) return false;
+
+    int index = OpenLoop(label);
+    std::size_t test = m_code.size();
+    AddCondition(condition, CBotTypBoolean);
+    std::size_t exit = m_code.size();
+    Add(OpCode::BRANCH, CBotTypBoolean);
+    m_operands.pop_back();
+
+    AddCheck(loop, -10);
+    AddBody(block);
+    AddBackEdge(loop, test);
+
+    m_code[exit].arg = m_code.size();
+    CloseLoop(index, test);                 // a continue doesn't charge the end of the loop
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddDo(CBotInstr* loop, CBotInstr* block, CBotInstr* condition, const std::string& label)
+{
+    if (!m_function) return false;
+
+    int index = OpenLoop(label);
+    std::size_t start = m_code.size();
+    AddBody(block);
+    AddCheck(loop, -10);
+
+    std::size_t next = m_code.size();
+    AddCondition(condition, CBotTypBoolean);
+    std::size_t exit = m_code.size();
+    Add(OpCode::BRANCH, CBotTypBoolean);
+    m_operands.pop_back();
+    AddBackEdge(loop, start);
+
+    m_code[exit].arg = m_code.size();
+    CloseLoop(index, next);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddFor(CBotInstr* loop, CBotInstr* init, CBotInstr* test, CBotInstr* incr, CBotInstr* block,
+                          const std::string& label)
+{
+    if (!m_function) return false;
+
+    // the variables of the initialization belong to the loop, like in CBotFor::Execute()
+    int scope = OpenScope(loop);
+    bool declare = m_declare;
+    m_declare = true;
+    if (init != nullptr) AddInstruction(init);
+    m_declare = false;
+    AddCheck(loop, -10);
+
+    int index = OpenLoop(label);
+    std::size_t start = m_code.size();
+    std::size_t exit = 0;
+    if (test != nullptr)
+    {
+        AddCondition(test, CBotTypBoolean);
+        exit = m_code.size();
+        Add(OpCode::BRANCH, CBotTypBoolean);
+        m_operands.pop_back();
+    }
+
+    AddCheck(loop, -10);
+    AddBody(block);
+    AddCheck(loop, -10);
+    std::size_t next = m_code.size();
+    if (incr != nullptr) AddInstruction(incr);
+    AddBackEdge(loop, start);
+
+    if (test != nullptr) m_code[exit].arg = m_code.size();
+    CloseLoop(index, next);
+
+    m_declare = declare;
+    CloseScope(scope);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddBreak(bool isContinue, const std::string& label)
+{
+    if (!m_function) return false;
+
+    for (auto it = m_openLoops.rbegin(); it != m_openLoops.rend(); ++it)
+    {
+        const Loop& loop = m_loops[*it];
+        if (!label.empty() && loop.label != label) continue;
+
+        if (m_scope != loop.scope) Add(OpCode::LEAVE, CBotTypVoid, 0, loop.scope);
+        Add(OpCode::JUMP, CBotTypVoid);
+        m_code.back().scope = loop.scope;
+        m_jumps.push_back(Jump{m_code.size() - 1, *it, isContinue});
+        return true;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddReturn(CBotInstr* value)
+{
+    if (!m_function) return false;
+
+    int mode = NONE;
+    CBotType type = CBotTypVoid;
+    if (value != nullptr)
+    {
+        if (!AddValue(value)) return false;
+        // like CBotReturn, the value keeps the type of the expression
+        mode = m_operands.back().held ? HELD : STACK;
+        type = m_operands.back().type;
+        m_operands.pop_back();
+    }
+
+    Add(OpCode::RETURN, type);
+    m_code.back().mode = mode;
+    m_code.back().ticks = 1;                // see CBotReturn::Execute()
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::AddThrow(CBotInstr* value, CBotToken* token)
+{
+    if (!m_function) return false;
+
+    AddCondition(value, CBotTypInt);
+    Add(OpCode::THROW, CBotTypInt, 0, 0, token);
+    m_code.back().ticks = 1;
+    m_operands.pop_back();
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int CBotByteCode::RestoreLevels(CBotStack* pj, std::size_t pc, CBotStack** levels)
+{
+    // blocks with a stack level, from the innermost one
+    int chain[MAX_LEVELS];
+    int count = 0;
+    for (int scope = m_code[pc].scope; scope > 0; scope = m_scopes[scope].parent)
+    {
+        if (m_scopes[scope].level) chain[count++] = scope;
+    }
+
+    levels[0] = pj->RestoreStack(m_block);
+    if (levels[0] == nullptr) return -1;
+
+    int depth = 0;
+    while (count > 0)
+    {
+        levels[depth + 1] = levels[depth]->RestoreStack(m_scopes[chain[--count]].block);
+        if (levels[++depth] == nullptr) return -1;
+    }
+    return depth;
+}
+
+//! Charges the executed operations and saves the position of an operation which may be interrupted
+static bool SavePosition(CBotStack* vm, int& ticks, std::size_t pc)
+{
+    if (vm->GetState() != static_cast<int>(pc))
+    {
+        ticks--;                            // the tree walker doesn't charge the tick of SetState() here
+        if (!vm->SetState(pc) && !vm->IsOk()) return false;
+    }
+    vm->ChargeTimer(ticks);
+    ticks = 0;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotByteCode::ExecuteFunction(CBotStack* pj)
+{
+    // the state of the level is the position in the code
+    CBotStack*  vm = pj->AddStack(m_block, CBotStack::BlockVisibilityType::BLOCK);
+    if (vm->StackOver()) return pj->Return(vm);
+
+    CBotStack*  levels[MAX_LEVELS];
+    std::size_t pc = vm->GetState();
+    int         depth = 0;
+    levels[0] = vm;
+    if (pc > 0) depth = RestoreLevels(pj, pc, levels);      // resumed
+    assert(depth >= 0);
+    CBotStack*  pile = levels[depth];
+
+    Value       stack[MAX_DEPTH];
+    int         top = 0;                            // empty each time the code is interrupted
+    int         ticks = 0;
+    CBotError   err = CBotNoErr;
+    CBotToken*  errToken = nullptr;
+
+    while (pc < m_code.size())
+    {
+        const Operation& operation = m_code[pc++];
+        ticks += operation.ticks;
+
+        switch (operation.code)
+        {
+        case OpCode::CHECK:
+            if (operation.mode != 0 && vm->GetTimer() <= 0)     // step by step
+            {
+                CBotStack* step = pile->AddStack(operation.instr);
+                if (step->IfStep())
+                {
+                    SavePosition(vm, ticks, pc - 1);
+                    return false;
+                }
+                pile->ReturnInPlace();
+            }
+            if (operation.op == STEP) break;
+            vm->ChargeTimer(ticks);
+            ticks = 0;
+            if (!vm->SetState(pc, operation.arg))
+            {
+                if (!vm->IsOk()) return false;
+                if (operation.op == TICK) break;
+                // the statement or the loop is shown as the running instruction
+                (depth > 0 ? levels[depth - 1] : pj)->RestoreStack(operation.instr);
+                return false;
+            }
+            break;
+
+        case OpCode::JUMP:
+            pc = operation.arg;
+            break;
+
+        case OpCode::BRANCH:
+            if (!stack[--top].b) pc = operation.arg;
+            break;
+
+        case OpCode::POP:
+            top -= operation.arg;
+            if (operation.mode == HELD) pile->SetVar(nullptr);
+            break;
+
+        case OpCode::STORE:
+        {
+            CBotVar* var = pile->FindVar(operation.arg, operation.op, false);
+            assert(var != nullptr);
+            if (operation.mode == STACK)
+            {
+                Write(var, operation.type, stack[top - 1]);
+                break;
+            }
+            if (pile->GetVar() != nullptr) var->SetVal(pile->GetVar());
+            pile->SetVar(nullptr);
+            Read(var, operation.type, stack[top++]);
+            break;
+        }
+
+        case OpCode::DECLARE:
+        {
+            CBotVar* var = CBotVar::Create(operation.token->GetString(), CBotTypResult(operation.type));
+            var->SetUniqNum(operation.arg);
+            pile->AddVar(var);
+            if (operation.mode == STACK)
+            {
+                Write(var, operation.type, stack[--top]);
+            }
+            else if (operation.mode == HELD)
+            {
+                if (pile->GetVar() != nullptr) var->SetVal(pile->GetVar());
+                pile->SetVar(nullptr);
+            }
+            break;
+        }
+
+        case OpCode::INCREMENT:
+        case OpCode::POST_INCREMENT:
+        {
+            CBotVar* var = pile->FindVar(operation.arg, operation.op, false);
+            assert(var != nullptr);
+            bool post = (operation.code == OpCode::POST_INCREMENT);
+            if (!var->IsDefined())
+            {
+                // like CBotPostIncExpr, the variable is changed anyway
+                err = CBotErrNotInit;
+                errToken = operation.token;
+                if (!post) break;
+            }
+            if (post) Read(var, operation.type, stack[top++]);
+            if (operation.mode == ID_INC) var->Inc();
+            else                          var->Dec();
+            if (!post) Read(var, operation.type, stack[top++]);
+            break;
+        }
+
+        case OpCode::ENTER:
+            if (m_scopes[operation.arg].level)
+            {
+                levels[depth + 1] = pile->AddStack(operation.instr, CBotStack::BlockVisibilityType::BLOCK);
+                pile = levels[++depth];
+                if (pile->StackOver()) return false;
+            }
+            break;
+
+        case OpCode::LEAVE:
+            if (m_scopes[operation.arg].depth != depth)
+            {
+                depth = m_scopes[operation.arg].depth;
+                pile = levels[depth];
+                pile->ReturnInPlace();
+            }
+            break;
+
+        case OpCode::EVAL:
+        {
+            if (!SavePosition(vm, ticks, pc - 1)) return false;
+            CBotStack* p = pile;
+            if (!operation.instr->Execute(p)) return false;     // interrupted or error
+
+            if (operation.mode == HELD) break;                  // for STORE, DECLARE or RETURN
+            CBotVar* result = pile->GetVar();
+            if (result != nullptr) Read(result, operation.type, stack[top]);
+            else stack[top].l = 0;
+            top++;
+            pile->SetVar(nullptr);
+            break;
+        }
+
+        case OpCode::EXEC:
+        {
+            std::size_t at = pc - 1;
+            if (!SavePosition(vm, ticks, at)) return false;
+            CBotStack* p = pile;
+            if (operation.instr->Execute(p))
+            {
+                pile->SetVar(nullptr);
+                break;
+            }
+
+            // a break or a continue for a loop of the code, from the innermost one
+            CBotError error = vm->GetError();
+            if (error != CBotError(-1) && error != CBotError(-2)) return false;
+
+            auto loop = m_loops.rbegin();
+            for ( ; loop != m_loops.rend(); ++loop)
+            {
+                if (at < loop->start || at >= loop->end) continue;
+
+                CBotStack* level = levels[m_scopes[loop->scope].depth];
+                if (level->IfContinue(level->GetState(), loop->label))
+                {
+                    pc = loop->continuePc;
+                }
+                else if (level->BreakReturn(level, loop->label))
+                {
+                    level->ReturnInPlace();
+                    pc = loop->breakPc;
+                }
+                else continue;
+
+                depth = m_scopes[loop->scope].depth;
+                pile = level;
+                break;
+            }
+            if (loop == m_loops.rend()) return false;
+            break;
+        }
+
+        case OpCode::CALL:
+        {
+            if (!SavePosition(vm, ticks, pc - 1)) return false;
+            CBotStack* call = pile->AddStack(operation.instr);
+            if (call->StackOver()) return false;
+
+            if (call->GetState() == 0 && operation.arg > 0)
+            {
+                // the parameters are kept on the stack level in case the call is interrupted
+                CBotVar* params = nullptr;
+                for (int i = 0; i < operation.arg; i++)
+                {
+                    CBotType type = m_argTypes[operation.op + i];
+                    CBotVar* var = CBotVar::Create("", CBotTypResult(type));
+                    Write(var, type, stack[top - operation.arg + i]);
+                    if (params == nullptr) params = var;
+                    else params->AddNext(var);
+                }
+                top -= operation.arg;
+                call->SetVar(params);
+                // one tick per parameter, like CBotInstrCall::Execute()
+                vm->ChargeTimer(operation.arg - 1);
+                if (!call->SetState(1) && !call->IsOk()) return false;
+            }
+
+            CBotVar* ppVars[MAX_DEPTH + 1];
+            int count = 0;
+            for (CBotVar* var = call->GetVar(); var != nullptr; var = var->GetNext()) ppVars[count++] = var;
+            ppVars[count] = nullptr;
+
+            CBotStack* pile2 = call->AddStack();
+            if (pile2->IfStep()) return false;
+            if (!static_cast<CBotInstrCall*>(operation.instr)->Call(pile2, ppVars)) return false;
+
+            if (operation.mode == HELD)
+            {
+                pile->Return(pile2);                // for STORE, DECLARE or RETURN
+                break;
+            }
+            if (operation.mode == STACK)
+            {
+                CBotVar* result = pile2->GetVar();
+                if (result != nullptr) Read(result, operation.type, stack[top]);
+                else stack[top].l = 0;
+                top++;
+            }
+            pile->ReturnInPlace();
+            break;
+        }
+
+        case OpCode::RETURN:
+            vm->ChargeTimer(ticks);
+            if (operation.mode == STACK)
+            {
+                CBotVar* result = CBotVar::Create("", CBotTypResult(operation.type));
+                Write(result, operation.type, stack[--top]);
+                vm->SetVar(result);
+            }
+            else if (operation.mode == HELD) vm->Return(pile);
+            else vm->SetVar(nullptr);
+            vm->SetBreak(3, std::string());
+            return false;
+
+        case OpCode::THROW:
+        {
+            int value = stack[--top].i;
+            if (value == 0) break;                  // no error, as in CBotThrow
+            err = value < 0 ? CBotErrBadThrow : static_cast<CBotError>(value);
+            errToken = operation.token;
+            break;
+        }
+
+        default:
+            err = Evaluate(operation, stack, top, pc, ticks, pile, errToken);
+        }
+
+        if (err != CBotNoErr)
+        {
+            vm->ChargeTimer(ticks);
+            pile->SetError(err, errToken);
+            return false;
+        }
+    }
+
+    vm->ChargeTimer(ticks);
+    return pj->Return(vm);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotByteCode::RestoreFunction(CBotStack* pj)
+{
+    CBotStack*  vm = pj->RestoreStack(m_block);
+    if (vm == nullptr) return;
+
+    std::size_t pc = vm->GetState();
+    if (pc >= m_code.size()) return;
+
+    CBotStack*  levels[MAX_LEVELS];
+    int         depth = RestoreLevels(pj, pc, levels);
+    if (depth < 0) return;
+
+    // the variables of the blocks entered get their identifiers back, see CBotLeftExprVar::RestoreState()
+    for (int scope = m_code[pc].scope; scope >= 0; scope = m_scopes[scope].parent)
+    {
+        CBotStack* level = levels[m_scopes[scope].depth];
+        for (std::size_t i = m_scopes[scope].enter; i < pc; i++)
+        {
+            const Operation& operation = m_code[i];
+            if (operation.scope != scope) continue;
+
+            if (operation.code == OpCode::DECLARE)
+            {
+                CBotVar* var = level->FindVar(operation.token->GetString());
+                if (var != nullptr) var->SetUniqNum(operation.arg);
+            }
+            else if (operation.code == OpCode::EXEC && operation.mode != 0)
+            {
+                CBotStack* p = level;
+                operation.instr->RestoreState(p, false);
+            }
+        }
+    }
+
+    // then the operation which was interrupted
+    CBotStack* pile = levels[depth];
+    const Operation& operation = m_code[pc];
+    switch (operation.code)
+    {
+    case OpCode::CHECK:
+        pile->RestoreStack(operation.instr);
+        break;
+
+    case OpCode::EVAL:
+    case OpCode::EXEC:
+        operation.instr->RestoreState(pile, true);
+        break;
+
+    case OpCode::CALL:
+    {
+        CBotStack* call = pile->RestoreStack(operation.instr);
+        if (call == nullptr) return;
+
+        CBotVar* ppVars[MAX_DEPTH + 1];
+        int count = 0;
+        for (CBotVar* var = call->GetVar(); var != nullptr; var = var->GetNext()) ppVars[count++] = var;
+        ppVars[count] = nullptr;
+
+        CBotStack* pile2 = call->RestoreStack();
+        if (pile2 == nullptr) return;
+        static_cast<CBotInstrCall*>(operation.instr)->RestoreCall(pile2, ppVars);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+} // namespace CBot
@@ -0,0 +1,480 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#pragma once
+
+#include "CBot/CBotEnums.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CBot
+{
+
+class CBotInstr;
+class CBotStack;
+class CBotToken;
+class CBotVar;
+
+/**
+ * \brief Compiled form of an expression or of a function body, run by a small VM working on an operand stack of unboxed values
+ *
+ * When a program is compiled with CBotEngine::BYTECODE, the expressions made of number
+ * and boolean literals, local variables and operators are lowered to a flat list of
+ * operations (see CBotInstr::GenerateByteCode()). Evaluating them needs neither
+ * a CBotStack level per node nor a temporary CBotVar per operation, while results,
+ * errors and error positions stay the same as with the tree walker.
+ *
+ * Such an expression can't be suspended (nothing in it may wait), so it is always
+ * evaluated in one go: it is shown as a single step in step by step mode and the
+ * instruction timer is charged afterwards with the ticks the tree walker would have
+ * charged for the same nodes (see CBotStack::SetState()).
+ *
+ * The body of a function is lowered as a whole by GenerateFunction(): blocks, declarations
+ * and assignments of local variables, if, while, do, for, break, continue, return, throw
+ * and calls become operations as well. Such code runs on a single stack level whose
+ * state is the position in the code, plus one level per block declaring variables, so it
+ * can be suspended and resumed at the same points as the tree walker: on the timer where
+ * an instruction of the tree walker checks it (after a condition, a declaration, at the
+ * end of a loop, ...), in step by step mode before each statement and inside the functions
+ * it calls. Each operation charges the ticks of the nodes it replaces, so a program gets
+ * the same amount of work per CBotProgram::Run() with both engines.
+ * Saving the state with CBotProgram::SaveState() only writes these levels, their variables
+ * and the position, RestoreFunction() gives the variables their identifiers back.
+ *
+ * A statement that can't be lowered (switch, try, strings, objects, arrays, ...) is kept
+ * and executed by the tree walker from inside the code, on the level of its block.
+ * Errors raised by the code, and breaks or continues coming from such statements,
+ * go through the CBotStack like the ones of the tree walker.
+ */
+class CBotByteCode
+{
+public:
+    /**
+     * \brief Lowers the given expression
+     * \param expr Root of the expression
+     * \return Compiled expression, or nullptr if some part of it can't be lowered
+     */
+    static std::unique_ptr<CBotByteCode> Generate(CBotInstr* expr);
+
+    /**
+     * \brief Evaluates the expression
+     *
+     * The result (or the error) is left on the given stack level, like CBotInstr::Execute() does
+     *
+     * \param pile Stack level of the instruction owning this code
+     * \return false on error
+     */
+    bool Execute(CBotStack* pile);
+
+    /**
+     * \brief Lowers the body of a function
+     * \param block Body of the function, see CBotListInstr
+     * \return Compiled body, or nullptr if nothing in it can be lowered
+     */
+    static std::unique_ptr<CBotByteCode> GenerateFunction(CBotInstr* block);
+
+    /**
+     * \brief Runs the body of a function, or resumes it, in place of CBotInstr::Execute() of the block
+     * \param pj Stack level of the function
+     * \return false if interrupted, on error or on return (see CBotStack::GetRetVar())
+     */
+    bool ExecuteFunction(CBotStack* pj);
+
+    /**
+     * \brief Restores the state of the body of a function, in place of CBotInstr::RestoreState() of the block
+     * \param pj Stack level of the function
+     */
+    void RestoreFunction(CBotStack* pj);
+
+    //! \name Compile time evaluation, used when the program is optimized (see CBotProgram::SetOptimize())
+    //@{
+
+    /**
+     * \brief Replaces an expression made of literals by a literal of its value
+     *
+     * The expression is kept when its evaluation fails, so the error is raised at runtime as before
+     *
+     * \param expr Expression, deleted if it is replaced
+     * \return The new literal, or expr itself
+     */
+    static CBotInstr* Fold(CBotInstr* expr);
+
+    /**
+     * \brief Tells if an expression is a boolean literal
+     * \param expr Expression
+     * \param[out] value Value of the literal
+     * \return true if the expression is a boolean literal
+     */
+    static bool IsConstant(CBotInstr* expr, bool& value);
+
+    //@}
+
+    //! \name Code generation, used by CBotInstr::GenerateByteCode()
+    //@{
+
+    /**
+     * \brief Pushes a constant value
+     */
+    bool AddConstant(int value);
+    bool AddConstant(long value);
+    bool AddConstant(float value);
+    bool AddConstant(double value);
+    bool AddConstant(bool value);
+
+    /**
+     * \brief Pushes the value of a local variable
+     * \param ident Unique number of the variable, see CBotVar::GetUniqNum()
+     * \param slot Slot of the variable, see CBotStack::FindVar(long, int, bool)
+     * \param type Type of the variable
+     * \param token Token reported with ::CBotErrNotInit
+     * \return false if the type is not supported
+     */
+    bool AddVariable(long ident, int slot, CBotType type, CBotToken* token);
+
+    /**
+     * \brief Applies an unary operator (ID_ADD, ID_SUB, ID_NOT, ID_LOG_NOT, ID_TXT_NOT) to the top value
+     */
+    bool AddUnaryOperation(int op);
+
+    /**
+     * \brief Called between both operands of a binary operator, to skip the second one when possible
+     * \param op Operator
+     * \return Position of the jump to patch in AddOperation(), or -1 if there's no shortcut for this operator
+     */
+    int AddShortCircuit(int op);
+
+    /**
+     * \brief Applies a binary operator to the two top values
+     * \param op Operator
+     * \param token Token reported with errors (division by zero, ...)
+     * \param shortCircuit Value returned by AddShortCircuit()
+     * \return false if the operand types are not supported
+     */
+    bool AddOperation(int op, CBotToken* token, int shortCircuit);
+
+    /**
+     * \brief Registers the compiled code of a subexpression that is now part of this one
+     *
+     * It is released once the generation succeeds, as it won't be executed anymore
+     */
+    void AddSubsumed(std::unique_ptr<CBotByteCode>* code);
+
+    /**
+     * \brief Tells that the top value is a number predefined with CBotToken::DefineNum(), which keeps its name when copied
+     */
+    void SetNamed();
+
+    //@}
+
+    //! \name Code generation of statements, only when lowering a function body
+    //@{
+
+    /**
+     * \brief Lowers a block of statements
+     * \param block Block, see CBotListInstr
+     * \param first First statement of the block
+     */
+    bool AddBlock(CBotInstr* block, CBotInstr* first);
+
+    /**
+     * \brief Lowers the expressions of a list, each one is a statement of its own (see CBotListExpression)
+     * \param list List of expressions
+     * \param first First expression of the list
+     */
+    bool AddList(CBotInstr* list, CBotInstr* first);
+
+    /**
+     * \brief Declares a local variable
+     * \param instr Instruction of the declaration
+     * \param name Token of the name of the variable
+     * \param type Type of the variable
+     * \param ident Unique number of the variable
+     * \param value Initial value, or nullptr
+     * \return false if the type is not supported or if the variable can't be declared here
+     */
+    bool AddDeclaration(CBotInstr* instr, CBotToken* name, CBotType type, long ident, CBotInstr* value);
+
+    /**
+     * \brief Assigns a local variable, the new value of the variable is pushed
+     * \param ident Unique number of the variable
+     * \param slot Slot of the variable
+     * \param type Type of the variable
+     * \param op Assignment operator (ID_ASS, ID_ASSADD, ...)
+     * \param value Assigned value
+     * \param token Token reported with errors
+     */
+    bool AddAssignment(long ident, int slot, CBotType type, int op, CBotInstr* value, CBotToken* token);
+
+    /**
+     * \brief Increments or decrements a local variable, see CBotPreIncExpr and CBotPostIncExpr
+     * \param ident Unique number of the variable
+     * \param slot Slot of the variable
+     * \param type Type of the variable
+     * \param op ID_INC or ID_DEC
+     * \param post true to push the value before the change
+     * \param token Token reported with ::CBotErrNotInit
+     */
+    bool AddIncrement(long ident, int slot, CBotType type, int op, bool post, CBotToken* token);
+
+    /**
+     * \brief Calls a function, once its parameters have been pushed
+     * \param call Instruction of the call, it does the call itself (see CBotInstrCall::Call())
+     * \param count Number of parameters
+     * \param type Type of the result
+     * \param external true for a function of the application, whose result has exactly the type of the call
+     */
+    bool AddCall(CBotInstr* call, int count, CBotType type, bool external);
+
+    bool AddIf(CBotInstr* instr, CBotInstr* condition, CBotInstr* block, CBotInstr* blockElse);
+    bool AddWhile(CBotInstr* loop, CBotInstr* condition, CBotInstr* block, const std::string& label);
+    bool AddDo(CBotInstr* loop, CBotInstr* block, CBotInstr* condition, const std::string& label);
+    bool AddFor(CBotInstr* loop, CBotInstr* init, CBotInstr* test, CBotInstr* incr, CBotInstr* block, const std::string& label);
+
+    /**
+     * \brief Leaves a loop being lowered
+     * \param isContinue true for continue, false for break
+     * \param label Label of the loop, empty for the innermost one
+     */
+    bool AddBreak(bool isContinue, const std::string& label);
+
+    /**
+     * \brief Returns from the function
+     * \param value Returned value, or nullptr
+     */
+    bool AddReturn(CBotInstr* value);
+
+    /**
+     * \brief Raises the error given by an int value
+     * \param value Value of the error
+     * \param token Token reported with the error
+     */
+    bool AddThrow(CBotInstr* value, CBotToken* token);
+
+    //@}
+
+private:
+    CBotByteCode();
+
+    enum class OpCode : unsigned char
+    {
+        CONSTANT,       //!< pushes m_constants[arg]
+        VARIABLE,       //!< pushes the value of variable number arg, in slot op, checks it is defined if there's a token
+        CONVERT,        //!< converts the value at depth arg from source to type
+        UNARY,          //!< applies op to the top value
+        BINARY,         //!< applies op to the two top values, a NaN operand is not an error if mode is set
+        JUMP_IF_FALSE,  //!< jumps to arg if the top value is false, pops it otherwise
+        JUMP_IF_TRUE,   //!< jumps to arg if the top value is true, pops it otherwise
+
+        // only in function bodies
+        CHECK,          //!< pauses before statement instr in step by step mode if mode is set, then charges the timer as told by op (see Check)
+        JUMP,           //!< jumps to arg
+        BRANCH,         //!< pops the top value, jumps to arg if it is false
+        POP,            //!< pops arg values, releases the variable held on the stack level if mode is HELD
+        STORE,          //!< assigns variable number arg, in slot op, from the top value (left as the result) or the held variable
+        DECLARE,        //!< creates variable number arg named token, initialized from the top value or the held variable
+        INCREMENT,      //!< applies mode (ID_INC or ID_DEC) to variable number arg, in slot op, then pushes its value
+        POST_INCREMENT, //!< pushes the value of variable number arg, in slot op, then applies mode to it
+        ENTER,          //!< enters block arg, adds its stack level if it has one
+        LEAVE,          //!< leaves the blocks up to block arg, releasing their stack levels
+        EVAL,           //!< executes expression instr with the tree walker, the result is pushed or held
+        EXEC,           //!< executes statement instr with the tree walker, catches the breaks and continues for the loops of the code,
+                        //!< its declarations are restored with the ones of the block if mode is set
+        CALL,           //!< calls instr with the arg top values as parameters, the result is dropped, pushed or held
+        RETURN,         //!< returns the top value, the held variable or nothing
+        THROW,          //!< raises the error given by the top value
+    };
+
+    //! Where the value of an operation comes from, or where its result goes
+    enum Mode : int
+    {
+        NONE,           //!< no value
+        STACK,          //!< on the operand stack
+        HELD,           //!< variable held by the current stack level (EVAL and CALL leave it there)
+    };
+
+    //! What a CHECK does with the timer
+    enum Check : int
+    {
+        STEP,           //!< nothing, it only pauses in step by step mode
+        TICK,           //!< charges one tick, like CBotListInstr between two statements
+        INTERRUPT,      //!< charges one tick and is interrupted if the timer is below arg, like the SetState() of an instruction
+    };
+
+    union Value
+    {
+        bool    b;
+        int     i;
+        long    l;
+        float   f;
+        double  d;
+    };
+
+    struct Operation
+    {
+        OpCode      code;
+        CBotType    type;       //!< type the operation works with
+        CBotType    source;     //!< type converted from (CONVERT)
+        int         mode;
+        int         op;         //!< operator token (UNARY, BINARY), slot (variables), or index in m_argTypes (CALL)
+        long        arg;
+        int         scope;      //!< block the operation is in, index in m_scopes
+        CBotToken*  token;      //!< token for errors
+        CBotInstr*  instr;      //!< instruction executed by the tree walker, or shown in step by step mode
+        int         ticks;      //!< ticks charged when it is executed, the same as the tree walker for the nodes it replaces
+    };
+
+    //! Value on the operand stack while generating the code
+    struct Operand
+    {
+        CBotType    type;
+        bool        named;      //!< int which may have the name of a predefined number, a copy of the variable is needed to keep it
+        bool        held;       //!< not on the stack, it is the variable held by the stack level
+    };
+
+    //! Block of a function body
+    struct Scope
+    {
+        int         parent;     //!< enclosing block, -1 for the body itself
+        std::size_t enter;      //!< position of the first operation
+        bool        level;      //!< needs its own stack level (it declares variables or executes statements)
+        int         depth;      //!< number of stack levels above the one of the body
+        CBotInstr*  block;      //!< instruction of the stack level
+    };
+
+    //! Loop of a function body
+    struct Loop
+    {
+        std::size_t start;      //!< operations of the loop
+        std::size_t end;
+        std::size_t breakPc;
+        std::size_t continuePc;
+        int         scope;      //!< block the loop is in
+        std::string label;
+    };
+
+    //! Break or continue to patch once the position is known
+    struct Jump
+    {
+        std::size_t pc;
+        int         loop;
+        bool        isContinue;
+    };
+
+    //! Sizes of the generated code, to undo the generation of an instruction that can't be lowered
+    struct Mark
+    {
+        std::size_t code;
+        std::size_t operands;
+        std::size_t scopes;
+        std::size_t loops;
+        std::size_t jumps;
+        std::size_t argTypes;
+    };
+
+    /**
+     * \brief Runs the code
+     * \param pile Stack level to read the variables from, may be nullptr if there are none
+     * \param[out] result Value of the expression
+     * \param[out] errToken Token of the error
+     * \param[out] ticks Ticks charged by the executed operations
+     * \return CBotNoErr or the error
+     */
+    CBotError Run(CBotStack* pile, Value& result, CBotToken*& errToken, int& ticks);
+
+    /**
+     * \brief Runs an operation working only on the operand stack and variables, see Run()
+     */
+    CBotError Evaluate(const Operation& operation, Value* stack, int& top, std::size_t& pc, int& ticks,
+                       CBotStack* pile, CBotToken*& errToken);
+
+    /**
+     * \brief Finds the stack levels of the blocks entered at the given position
+     * \param pj Stack level of the function
+     * \param pc Position in the code
+     * \param[out] levels Stack levels, the one of the body first
+     * \return Index of the last level, or -1 if some are missing
+     */
+    int RestoreLevels(CBotStack* pj, std::size_t pc, CBotStack** levels);
+
+    void Add(OpCode code, CBotType type, int op = 0, long arg = 0, CBotToken* token = nullptr);
+    void AddConversion(int depth, CBotType type);
+    void Push(CBotType type, bool named = false);
+    void PushHeld();
+
+    Mark GetMark();
+    void Rollback(const Mark& mark);
+    bool AddStatement(CBotInstr* instr, Check check = STEP);
+    bool AddInstruction(CBotInstr* instr);
+    void AddBody(CBotInstr* body);
+    void AddCondition(CBotInstr* condition, CBotType type);
+    bool AddValue(CBotInstr* value);
+    int  OpenScope(CBotInstr* block);
+    void CloseScope(int scope);
+    int  OpenLoop(const std::string& label);
+    void CloseLoop(int loop, std::size_t continuePc);
+    void AddCheck(CBotInstr* instr, int lim);
+    void AddBackEdge(CBotInstr* loop, std::size_t target);
+
+    static bool IsSupported(CBotType type);
+
+    template <typename T> static T Get(const Value& value);
+    template <typename T> static void Set(Value& value, T val);
+    static void Convert(Value& value, CBotType source, CBotType type);
+    static void Read(CBotVar* var, CBotType type, Value& value);
+    static void Write(CBotVar* var, CBotType type, const Value& value);
+    static void Unary(int op, CBotType type, Value& value);
+    template <typename T> static CBotError Compute(int op, Value& left, const Value& right, bool nanIsError);
+
+private:
+    //! Maximum depth of the operand stack
+    static const int MAX_DEPTH = 32;
+    //! Maximum number of nested blocks with a stack level in a function body
+    static const int MAX_LEVELS = 32;
+
+    std::vector<Operation> m_code;
+    std::vector<Value> m_constants;
+    //! Operand stack while generating the code
+    std::vector<Operand> m_operands;
+    int m_depth = 0;
+    CBotType m_resultType = CBotTypVoid;
+    std::vector<std::unique_ptr<CBotByteCode>*> m_subsumed;
+
+    //! Lowering a function body, see GenerateFunction()
+    bool m_function = false;
+    //! Body of the function
+    CBotInstr* m_block = nullptr;
+    std::vector<Scope> m_scopes;
+    std::vector<Loop> m_loops;
+    //! Types of the parameters of the calls
+    std::vector<CBotType> m_argTypes;
+
+    //! \name State of the generation of a function body
+    //@{
+    int m_scope = -1;
+    //! Variables can be declared in the current block (not in the single statement of an if or a loop)
+    bool m_declare = false;
+    //! Loops being generated, innermost last
+    std::vector<int> m_openLoops;
+    std::vector<Jump> m_jumps;
+    //@}
+};
+
+} // namespace CBot
@@ -21,8 +21,10 @@
 #include "CBot/CBotCStack.h"
 
 #include "CBot/CBotClass.h"
+#include "CBot/CBotContextState.h"
 #include "CBot/CBotToken.h"
 #include "CBot/CBotExternalCall.h"
+#include "CBot/CBotProgram.h"
 
 #include "CBot/CBotVar/CBotVar.h"
 
@@ -258,6 +260,12 @@ CBotProgram* CBotCStack::GetProgram()
     return m_data->prog;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotCStack::IsOptimized()
+{
+    return m_data->prog != nullptr && m_data->prog->GetOptimize();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void CBotCStack::SetRetType(CBotTypResult& type)
 {
@@ -302,9 +310,20 @@ void CBotCStack::AddVar(CBotVar* pVar)
 
     if (p == nullptr || pVar == nullptr) return;
 
+    // the next free slot in the current function, the slots of closed blocks are reused
+    int slot = 0;
+    for (CBotCStack* pp = p; pp != nullptr; pp = pp->m_prev) slot += pp->m_listVar.size();
+    pVar->m_slot = slot;
+
     p->m_listVar.emplace_back(pVar);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+int CBotCStack::GetVarSlot(CBotVar* var)
+{
+    return var->m_slot;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void CBotCStack::CreateVarThis(CBotClass* pClass)
 {
@@ -406,7 +425,7 @@ bool CBotCStack::CheckCall(CBotToken* &pToken, CBotDefParam* pParam, const std::
         }
     }
 
-    for (CBotFunction* pp : CBotFunction::m_publicFunctions)
+    for (CBotFunction* pp : GetCurrentState().functions.publicFunctions)
     {
         if ( name == pp->GetName() )
         {
@@ -103,6 +103,14 @@ public:
      */
     void AddVar(CBotVar* p);
 
+    /*!
+     * \brief GetVarSlot Gives the slot of a local variable in its function,
+     * used at run time instead of searching the variable on the stack.
+     * \param var Variable returned by FindVar()
+     * \return Slot of the variable, see CBotStack::FindVar(long, int, bool)
+     */
+    int GetVarSlot(CBotVar* var);
+
     /*!
      * \brief Create 'this' as a local variable.
      * \param pClass The current class referred to by 'this'
@@ -251,6 +259,12 @@ public:
      */
     CBotProgram* GetProgram();
 
+    /*!
+     * \brief Tells if the program being compiled is optimized, see CBotProgram::SetOptimize()
+     * \return
+     */
+    bool IsOptimized();
+
     /*!
      * \brief CompileCall
      * \param p
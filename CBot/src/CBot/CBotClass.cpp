@@ -31,6 +31,7 @@
 
 #include "CBot/CBotVar/CBotVar.h"
 
+#include "CBot/CBotContextState.h"
 #include "CBot/CBotExternalCall.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
@@ -43,8 +44,6 @@ namespace CBot
 {
 
 ////////////////////////////////////////////////////////////////////////////////
-std::set<CBotClass*> CBotClass::m_publicClasses{};
-
 ////////////////////////////////////////////////////////////////////////////////
 CBotClass::CBotClass(const std::string& name,
                      CBotClass* parent,
@@ -59,13 +58,17 @@ CBotClass::CBotClass(const std::string& name,
     m_bIntrinsic= bIntrinsic;
     m_nbVar     = m_parent == nullptr ? 0 : m_parent->m_nbVar;
 
-    m_publicClasses.insert(this);
+    CBotContext* context = CBotContext::GetCurrent();
+    GetContextState(context).classes.publicClasses.insert(this);
+    GetContextState(context).classes.revision++;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 CBotClass::~CBotClass()
 {
-    m_publicClasses.erase(this);
+    CBotContext* context = CBotContext::GetCurrent();
+    GetContextState(context).classes.publicClasses.erase(this);
+    GetContextState(context).classes.revision++;
 
     delete  m_pVar;
     delete  m_externalMethods;
@@ -82,24 +85,34 @@ CBotClass* CBotClass::Create(const std::string& name,
 ////////////////////////////////////////////////////////////////////////////////
 void CBotClass::ClearPublic()
 {
-    while ( !m_publicClasses.empty() )
+    std::set<CBotClass*>& publicClasses = GetCurrentState().classes.publicClasses;
+    while ( !publicClasses.empty() )
     {
-        auto it = m_publicClasses.begin();
+        auto it = publicClasses.begin();
         delete *it; // calling destructor removes the class from the list
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+long CBotClass::GetRevision()
+{
+    return GetCurrentState().classes.revision;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void CBotClass::Purge()
 {
     delete      m_pVar;
     m_pVar      = nullptr;
+    m_fieldSlots.clear();
     m_externalMethods->Clear();
     for (CBotFunction* f : m_pMethod) delete f;
     m_pMethod.clear();
+    m_methodsByIdent.clear();
     m_IsDef     = false;
 
     m_nbVar     = m_parent == nullptr ? 0 : m_parent->m_nbVar;
+    GetCurrentState().classes.revision++;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -138,7 +151,7 @@ void CBotClass::Unlock()
 ////////////////////////////////////////////////////////////////////////////////
 void CBotClass::FreeLock(CBotProgram* prog)
 {
-    for (CBotClass* pClass : m_publicClasses)
+    for (CBotClass* pClass : GetCurrentState().classes.publicClasses)
     {
         if (pClass->m_lockProg.size() > 0 && prog == pClass->m_lockProg[0])
         {
@@ -183,10 +196,12 @@ bool CBotClass::AddItem(std::string name,
 bool CBotClass::AddItem(CBotVar* pVar)
 {
     pVar->SetUniqNum(++m_nbVar);
+    m_fieldSlots.emplace(pVar->GetName(), m_nbVar - 1);
 
     if ( m_pVar == nullptr ) m_pVar = pVar;
     else m_pVar->AddNext(pVar);
 
+    GetCurrentState().classes.revision++;
     return true;
 }
 
@@ -248,6 +263,23 @@ CBotVar* CBotClass::GetItemRef(int nIdent)
     return nullptr;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+int CBotClass::GetFieldCount()
+{
+    return m_nbVar;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int CBotClass::GetFieldSlot(const std::string& name)
+{
+    for (CBotClass* pClass = this; pClass != nullptr; pClass = pClass->m_parent)
+    {
+        auto it = pClass->m_fieldSlots.find(name);
+        if (it != pClass->m_fieldSlots.end()) return it->second;
+    }
+    return -1;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotClass::CheckVar(const std::string &name)
 {
@@ -276,7 +308,7 @@ CBotClass* CBotClass::Find(CBotToken* &pToken)
 ////////////////////////////////////////////////////////////////////////////////
 CBotClass* CBotClass::Find(const std::string& name)
 {
-    for (CBotClass* p : m_publicClasses)
+    for (CBotClass* p : GetCurrentState().classes.publicClasses)
     {
         if ( p->GetName() == name ) return p;
     }
@@ -289,6 +321,7 @@ bool CBotClass::AddFunction(const std::string& name,
                             bool rExec(CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exception, void* user),
                             CBotTypResult rCompile(CBotVar* pThis, CBotVar*& pVar))
 {
+    GetCurrentState().classes.revision++;
     return m_externalMethods->AddFunction(name, std::unique_ptr<CBotExternalCall>(new CBotExternalCallClass(rExec, rCompile)));
 }
 
@@ -299,6 +332,25 @@ bool CBotClass::SetUpdateFunc(void rUpdate(CBotVar* thisVar, void* user))
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotClass::SetFieldUpdateFunc(void rUpdate(CBotVar* thisVar, CBotVar* field, int slot, void* user))
+{
+    m_rUpdateField = rUpdate;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotClass::IsUpdatedByField()
+{
+    return m_rUpdateField != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotClass::InvalidateFields()
+{
+    GetCurrentState().classes.fieldsGeneration++;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CBotTypResult CBotClass::CompileMethode(CBotToken* name,
                                         CBotVar* pThis,
@@ -322,13 +374,18 @@ CBotTypResult CBotClass::CompileMethode(CBotToken* name,
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotClass::ExecuteMethode(long& nIdent,
+bool CBotClass::ExecuteMethode(long nIdent,
                                CBotVar* pThis,
                                CBotVar** ppParams,
                                CBotTypResult pResultType,
                                CBotStack*& pStack,
                                CBotToken* pToken)
 {
+    long ident = nIdent;
+    CBotClass* pClass = FindVirtual(ident, pStack);
+    if (pClass != nullptr)
+        return CBotFunction::DoCall(ident, pToken->GetString(), pThis, ppParams, pStack, pToken, pClass);
+
     int ret = m_externalMethods->DoCall(pToken, pThis, ppParams, pStack, pResultType);
     if (ret >= 0) return ret;
 
@@ -343,7 +400,7 @@ bool CBotClass::ExecuteMethode(long& nIdent,
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void CBotClass::RestoreMethode(long& nIdent,
+void CBotClass::RestoreMethode(long nIdent,
                                CBotToken* name,
                                CBotVar* pThis,
                                CBotVar** ppParams,
@@ -352,7 +409,12 @@ void CBotClass::RestoreMethode(long& nIdent,
     if (m_externalMethods->RestoreCall(name, pThis, ppParams, pStack))
         return;
 
-    CBotClass* pClass = this;
+    long ident = nIdent;
+    CBotClass* pClass = FindVirtual(ident, pStack);
+    if (pClass != nullptr && CBotFunction::RestoreCall(ident, name->GetString(), pThis, ppParams, pStack, pClass))
+        return;
+
+    pClass = this;
     while (pClass != nullptr)
     {
         bool ok = CBotFunction::RestoreCall(nIdent, name->GetString(), pThis, ppParams, pStack, pClass);
@@ -363,70 +425,70 @@ void CBotClass::RestoreMethode(long& nIdent,
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotClass::SaveStaticState(std::ostream &ostr)
+bool CBotClass::SaveStaticState(CBotStateWriter &writer)
 {
-    if (!WriteLong(ostr, CBOTVERSION*2)) return false;
+    if (!WriteLong(writer, CBOTVERSION*2)) return false;
 
     // saves the state of static variables in classes
-    for (CBotClass* p : m_publicClasses)
+    for (CBotClass* p : GetCurrentState().classes.publicClasses)
     {
-        if (!WriteWord(ostr, 1)) return false;
+        if (!WriteWord(writer, 1)) return false;
         // save the name of the class
-        if (!WriteString(ostr, p->GetName())) return false;
+        if (!WriteString(writer, p->GetName())) return false;
 
         CBotVar*    pv = p->GetVar();
         while( pv != nullptr )
         {
             if ( pv->IsStatic() )
             {
-                if (!WriteWord(ostr, 1)) return false;
-                if (!WriteString(ostr, pv->GetName())) return false;
+                if (!WriteWord(writer, 1)) return false;
+                if (!WriteString(writer, pv->GetName())) return false;
 
-                if (!pv->Save0State(ostr)) return false;             // common header
-                if (!pv->Save1State(ostr)) return false;                // saves as the child class
-                if (!WriteWord(ostr, 0)) return false;
+                if (!pv->Save0State(writer)) return false;             // common header
+                if (!pv->Save1State(writer)) return false;                // saves as the child class
+                if (!WriteWord(writer, 0)) return false;
             }
             pv = pv->GetNext();
         }
 
-        if (!WriteWord(ostr, 0)) return false;
+        if (!WriteWord(writer, 0)) return false;
     }
 
-    if (!WriteWord(ostr, 0)) return false;
+    if (!WriteWord(writer, 0)) return false;
     return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotClass::RestoreStaticState(std::istream &istr)
+bool CBotClass::RestoreStaticState(CBotStateReader &reader)
 {
     std::string      ClassName, VarName;
     CBotClass*      pClass;
     unsigned short  w;
 
     long version;
-    if (!ReadLong(istr, version)) return false;
+    if (!ReadLong(reader, version)) return false;
     if (version != CBOTVERSION*2) return false;
 
     while (true)
     {
-        if (!ReadWord(istr, w)) return false;
+        if (!ReadWord(reader, w)) return false;
         if ( w == 0 ) return true;
 
-        if (!ReadString(istr, ClassName)) return false;
+        if (!ReadString(reader, ClassName)) return false;
         pClass = Find(ClassName);
 
         while (true)
         {
-            if (!ReadWord(istr, w)) return false;
+            if (!ReadWord(reader, w)) return false;
             if ( w == 0 ) break;
 
             CBotVar*    pVar = nullptr;
             CBotVar*    pv = nullptr;
 
-            if (!ReadString(istr, VarName)) return false;
+            if (!ReadString(reader, VarName)) return false;
             if ( pClass != nullptr ) pVar = pClass->GetItem(VarName);
 
-            if (!CBotVar::RestoreState(istr, pv)) return false; // the temp variable
+            if (!CBotVar::RestoreState(reader, pv)) return false; // the temp variable
 
             if ( pVar != nullptr ) pVar->Copy(pv);
             delete pv;
@@ -435,6 +497,20 @@ bool CBotClass::RestoreStaticState(std::istream &istr)
     return true;
 }
 
+bool CBotClass::SaveStaticState(std::ostream &ostr)
+{
+    std::string state;
+    CBotStateWriter writer(state);
+    if (!SaveStaticState(writer)) return false;
+    return !!ostr.write(state.data(), state.size());
+}
+
+bool CBotClass::RestoreStaticState(std::istream &istr)
+{
+    CBotStateReader reader(istr);
+    return RestoreStaticState(reader);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotClass::CheckCall(CBotProgram* program, CBotDefParam* pParam, CBotToken*& pToken)
 {
@@ -547,6 +623,82 @@ const std::list<CBotFunction*>& CBotClass::GetFunctions() const
     return m_pMethod;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+CBotFunction* CBotClass::FindMethod(long nIdent)
+{
+    auto it = m_methodsByIdent.find(nIdent);
+    return it != m_methodsByIdent.end() ? it->second : nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotClass::HasDestructor()
+{
+    std::string name = "~" + m_name;
+    if (m_externalMethods->CheckCall(name)) return true;
+    return std::any_of(m_pMethod.begin(), m_pMethod.end(), [&name](CBotFunction* f) { return f->GetName() == name; });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotClass* CBotClass::FindVirtual(long& nIdent, CBotStack* pStack)
+{
+    if (nIdent == 0) return nullptr;
+
+    // methods defined out of their class may depend on the program making the call
+    CBotContext* context = CBotContext::GetCurrent();
+    CBotProgram* program = pStack->GetProgram();
+    if (GetContextState(context).functions.publicMethods > 0) return nullptr;
+    if (program != nullptr && program->m_hasMethods) return nullptr;
+
+    bool isolated = pStack->IsIsolated();
+    if (m_vtableRevision != GetContextState(context).classes.revision)
+    {
+        if (isolated) return nullptr;
+        m_vtable.clear();
+        m_vtableRevision = GetContextState(context).classes.revision;
+    }
+
+    auto it = m_vtable.find(nIdent);
+    if (it == m_vtable.end())
+    {
+        if (isolated) return nullptr;
+        it = m_vtable.emplace(nIdent, ResolveVirtual(nIdent)).first;
+    }
+
+    if (it->second.owner != nullptr) nIdent = it->second.ident;
+    return it->second.owner;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotClass::VirtualMethod CBotClass::ResolveVirtual(long nIdent)
+{
+    CBotFunction* method = nullptr;
+    CBotClass* owner = this;
+    while (owner != nullptr && (method = owner->FindMethod(nIdent)) == nullptr) owner = owner->m_parent;
+    if (method == nullptr) return VirtualMethod{0, nullptr};
+
+    // same search as ExecuteMethode(), from the class of the instance up to the one of the method
+    for (CBotClass* pClass = this; pClass != nullptr; pClass = pClass->m_parent)
+    {
+        if (pClass->m_externalMethods->CheckCall(method->GetName())) return VirtualMethod{0, nullptr};
+        if (pClass == owner) return VirtualMethod{nIdent, owner};
+
+        CBotFunction* found = nullptr;
+        int count = 0;
+        for (CBotFunction* f : pClass->m_pMethod)
+        {
+            if (f->GetName() != method->GetName()) continue;
+            found = f;
+            count++;
+        }
+        if (count == 0) continue;
+
+        // an override, unless the choice between overloads depends on the arguments
+        if (count == 1 && found->CheckParam(method->m_param)) return VirtualMethod{found->m_nFuncIdent, pClass};
+        return VirtualMethod{0, nullptr};
+    }
+    return VirtualMethod{0, nullptr};
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotClass::CompileDefItem(CBotToken* &p, CBotCStack* pStack, bool bSecond)
 {
@@ -599,6 +751,7 @@ bool CBotClass::CompileDefItem(CBotToken* &p, CBotCStack* pStack, bool bSecond)
                     if ( f == nullptr ) return false;
 
                     m_pMethod.push_back(f);
+                    m_methodsByIdent.emplace(f->m_nFuncIdent, f);
                 }
                 else
                 {
@@ -803,6 +956,7 @@ CBotClass* CBotClass::Compile(CBotToken* &p, CBotCStack* pStack)
         }
 
         pOld->m_IsDef = true;           // complete definition
+        GetCurrentState().classes.revision++;
         if (pStack->IsOk()) return pOld;
     }
     pStack->SetError(CBotErrNoTerminator, p);
@@ -811,7 +965,12 @@ CBotClass* CBotClass::Compile(CBotToken* &p, CBotCStack* pStack)
 
 void CBotClass::Update(CBotVar* var, void* user)
 {
-    m_rUpdate(var, user);
+    if (m_rUpdate != nullptr) m_rUpdate(var, user);
+}
+
+void CBotClass::UpdateField(CBotVar* var, CBotVar* field, int slot, void* user)
+{
+    m_rUpdateField(var, field, slot, user);
 }
 
 } // namespace CBot
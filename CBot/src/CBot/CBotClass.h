@@ -25,8 +25,8 @@
 
 #include <string>
 #include <deque>
-#include <set>
 #include <list>
+#include <unordered_map>
 
 namespace CBot
 {
@@ -39,6 +39,8 @@ class CBotDefParam;
 class CBotToken;
 class CBotCStack;
 class CBotExternalCallList;
+class CBotStateWriter;
+class CBotStateReader;
 
 /**
  * \brief A CBot class definition
@@ -149,7 +151,32 @@ public:
      * \return
      */
     bool SetUpdateFunc(void rUpdate(CBotVar* thisVar, void* user));
-    //
+
+    /*!
+     * \brief Defines a routine updating one field of the instances, called when a program reads it
+     *
+     * Replaces the routine of SetUpdateFunc(): reading a field of an instance doesn't update the
+     * others, and each field is updated at most once until InvalidateFields(). The conversion of
+     * an instance to a string still updates all its fields.
+     *
+     * \param rUpdate Routine updating \a field of \a thisVar, \a slot is the position of the field
+     * in the class, in the order of AddItem() after the fields of the parent classes
+     * \return
+     */
+    bool SetFieldUpdateFunc(void rUpdate(CBotVar* thisVar, CBotVar* field, int slot, void* user));
+
+    /*!
+     * \brief Tells if the instances are updated one field at a time, see SetFieldUpdateFunc()
+     */
+    bool IsUpdatedByField();
+
+    /*!
+     * \brief Marks all the fields updated by SetFieldUpdateFunc() as out of date
+     *
+     * Called at the start of each CBotProgram::Run() and after each call to an external function
+     * which isn't isolated, the only times the objects of the host can change under a program.
+     */
+    static void InvalidateFields();
 
     /*!
      * \brief AddItem Adds an element to the class.
@@ -221,6 +248,27 @@ public:
      */
     CBotVar* GetItemRef(int nIdent);
 
+    //! \name Field layout
+    //@{
+
+    /*!
+     * \brief Number of slots in the layout of the instances, inherited fields included
+     *
+     * The field with unique number n (see AddItem()) is in slot n - 1, the fields of
+     * the parent classes come first. Instances keep their fields in an array
+     * following this layout, see CBotVarClass::GetItemRef().
+     */
+    int GetFieldCount();
+
+    /*!
+     * \brief Slot of a field in the layout of the instances
+     * \param name Name of the field, a field of this class hides the ones of the parents
+     * \return Slot of the field, or -1 if there is no such field
+     */
+    int GetFieldSlot(const std::string& name);
+
+    //@}
+
     /*!
      * \brief Check whether a variable is already defined in a class
      * \param name Name of the variable
@@ -246,7 +294,7 @@ public:
 
     /*!
      * \brief ExecuteMethode Executes a method.
-     * \param nIdent
+     * \param nIdent Unique identifier of the method, if not found the method is searched by name
      * \param name
      * \param pThis
      * \param ppParams
@@ -255,18 +303,18 @@ public:
      * \param pToken
      * \return
      */
-    bool ExecuteMethode(long &nIdent, CBotVar* pThis, CBotVar** ppParams, CBotTypResult pResultType,
+    bool ExecuteMethode(long nIdent, CBotVar* pThis, CBotVar** ppParams, CBotTypResult pResultType,
                         CBotStack*&pStack, CBotToken* pToken);
 
     /*!
      * \brief RestoreMethode Restored the execution stack.
-     * \param nIdent
+     * \param nIdent Unique identifier of the method, if not found the method is searched by name
      * \param name
      * \param pThis
      * \param ppParams
      * \param pStack
      */
-    void RestoreMethode(long &nIdent,
+    void RestoreMethode(long nIdent,
                         CBotToken* name,
                         CBotVar* pThis,
                         CBotVar** ppParams,
@@ -309,6 +357,18 @@ public:
      */
     const std::list<CBotFunction*>& GetFunctions() const;
 
+    /*!
+     * \brief Finds a user-defined method of this class by its unique identifier
+     * \param nIdent Unique identifier of the method
+     * \return The method, or nullptr if it is not defined in this class
+     */
+    CBotFunction* FindMethod(long nIdent);
+
+    /*!
+     * \brief Tells if the instances of this class have a destructor, user-defined or external, run when they are released
+     */
+    bool HasDestructor();
+
     /*!
      * \brief CompileDefItem
      * \param p
@@ -336,6 +396,15 @@ public:
      */
     static void ClearPublic();
 
+    /*!
+     * \brief Revision of the class definitions
+     *
+     * Changes every time a class is created, destroyed, purged, gets a new field
+     * or finishes compiling
+     * \return
+     */
+    static long GetRevision();
+
     /*!
      * \brief Save all static variables from each public class
      * \param ostr Output stream
@@ -343,6 +412,13 @@ public:
      */
     static bool SaveStaticState(std::ostream &ostr);
 
+    /*!
+     * \brief Save all static variables from each public class in memory
+     * \param writer Where the state is written
+     * \return true on success
+     */
+    static bool SaveStaticState(CBotStateWriter &writer);
+
     /*!
      * \brief Restore all static variables in each public class
      * \param istr Input stream
@@ -350,6 +426,13 @@ public:
      */
     static bool RestoreStaticState(std::istream &istr);
 
+    /*!
+     * \brief Restore all static variables in each public class from memory
+     * \param reader Where the state is read from
+     * \return true on success
+     */
+    static bool RestoreStaticState(CBotStateReader &reader);
+
     /**
      * \brief Request a lock on this class (for "synchronized" keyword)
      * \param prog Program that requests the lock
@@ -380,9 +463,43 @@ public:
 
     void Update(CBotVar* var, void* user);
 
+    /*!
+     * \brief Calls the routine of SetFieldUpdateFunc() for a field of an instance
+     */
+    void UpdateField(CBotVar* var, CBotVar* field, int slot, void* user);
+
 private:
-    //! List of all public classes
-    static std::set<CBotClass*> m_publicClasses;
+    /*!
+     * \brief Finds the method a call runs on an instance of this class, through the table of virtual methods
+     *
+     * A call compiled for a method of a parent class runs the override of the class of the instance,
+     * found here directly instead of searching each class of the chain by name and parameters. Calls
+     * whose target depends on more than the instance class (overloaded overrides, external methods
+     * of the same name, methods defined out of their class) aren't in the table.
+     *
+     * In isolated mode (see CBotProgram::RunIsolated()) the table is only read, as other programs
+     * may use it at the same time.
+     *
+     * \param[in,out] nIdent Unique identifier of the method the call was compiled for, replaced by the one of the override
+     * \param pStack Stack of the program making the call
+     * \return Class defining the method to run, or nullptr if the call must be searched the usual way
+     */
+    CBotClass* FindVirtual(long& nIdent, CBotStack* pStack);
+
+    //! Entry of the table of virtual methods
+    struct VirtualMethod
+    {
+        //! Method to run
+        long ident;
+        //! Class defining it, nullptr if the call must be searched the usual way
+        CBotClass* owner;
+    };
+
+    /*!
+     * \brief Computes an entry of the table of virtual methods, see FindVirtual()
+     */
+    VirtualMethod ResolveVirtual(long nIdent);
+
 
 
     //! true if this class is fully compiled, false if only precompiled
@@ -397,11 +514,20 @@ private:
     bool m_bIntrinsic;
     //! Linked list of all class fields
     CBotVar* m_pVar;
+    //! Slots of the fields of this class by name, see GetFieldSlot()
+    std::unordered_map<std::string, int> m_fieldSlots;
     //! Linked list of all class external calls
     CBotExternalCallList* m_externalMethods;
     //! List of all class methods
     std::list<CBotFunction*> m_pMethod{};
+    //! Class methods by their unique identifier
+    std::unordered_map<long, CBotFunction*> m_methodsByIdent{};
+    //! Table of virtual methods, by unique identifier of the method a call was compiled for
+    std::unordered_map<long, VirtualMethod> m_vtable{};
+    //! Revision of the classes the table was computed with, see GetRevision()
+    long m_vtableRevision = -1;
     void (*m_rUpdate)(CBotVar* thisVar, void* user);
+    void (*m_rUpdateField)(CBotVar* thisVar, CBotVar* field, int slot, void* user) = nullptr;
 
     CBotToken* m_pOpenblk;
 
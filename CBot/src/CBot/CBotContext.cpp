@@ -0,0 +1,102 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#include "CBot/CBotContextState.h"
+
+#include "CBot/CBotClass.h"
+#include "CBot/CBotExternalCall.h"
+
+#include "CBot/stdlib/stdlib.h"
+
+namespace CBot
+{
+
+//! Current context of each thread, nullptr for the default one
+static thread_local CBotContext* currentContext = nullptr;
+
+//! Last serial number given to a context
+static std::atomic<long> contextSerial{0};
+
+////////////////////////////////////////////////////////////////////////////////
+CBotContext::CBotContext() : m_state(new CBotContextState())
+{
+    m_state->serial = ++contextSerial;
+    m_state->files.reset(new CBotFileState());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotContext::~CBotContext()
+{
+    {
+        Scope scope(this);
+        if (m_state->definitions.externalCalls != nullptr) CBotProgram::Free();
+        CBotClass::ClearPublic();
+        m_state->files.reset();
+    }
+
+    if (currentContext == this) currentContext = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotContext* CBotContext::GetCurrent()
+{
+    if (currentContext != nullptr) return currentContext;
+
+    // never destroyed, as objects of the default context may be destroyed late at exit
+    static CBotContext* defaultContext = new CBotContext();
+    return defaultContext;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotContext::SetCurrent(CBotContext* context)
+{
+    currentContext = context;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotContext::Scope::Scope(CBotContext* context) : m_previous(currentContext)
+{
+    currentContext = context;
+}
+
+CBotContext::Scope::~Scope()
+{
+    currentContext = m_previous;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotContext::Statistics CBotContext::GetStatistics()
+{
+    Statistics statistics;
+    statistics.classes = m_state->classes.publicClasses.size();
+    statistics.publicFunctions = m_state->functions.publicFunctions.size();
+    statistics.sharedCodes = m_state->functions.sharedCodes.size();
+    {
+        std::lock_guard<std::mutex> lock(m_state->instances.mutex);
+        statistics.instances = m_state->instances.byIdent.size();
+    }
+    statistics.collectedInstances = m_state->instances.collected;
+    {
+        std::lock_guard<std::mutex> lock(m_state->variables.namesMutex);
+        statistics.variableNames = m_state->variables.names.size();
+    }
+    return statistics;
+}
+
+} // namespace CBot
@@ -0,0 +1,133 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace CBot
+{
+
+struct CBotContextState;
+
+/**
+ * \brief State of a CBot engine: registered functions, constants and classes, objects, open files...
+ *
+ * Each context is a world of its own, programs only see what was defined in their context. Several
+ * independent engines can so live in one process and run on separate threads, as long as a context
+ * is used by a single thread at a time.
+ *
+ * The static functions of the engine (CBotProgram::Init(), CBotProgram::AddFunction(), CBotClass::Create(),
+ * CBotVar::Create()...) work on the current context of the calling thread. Unless SetCurrent() is called,
+ * it is a default context shared by the whole process, so programs using a single engine don't have to
+ * care about contexts at all.
+ *
+ * A CBotProgram belongs to the context current when it was created, and makes it current again while
+ * it compiles, runs, saves or restores its state and is destroyed. Everything else created in a context
+ * (variables, classes) must be used and destroyed while it is current, and before the context itself.
+ *
+ * The only exception is CBotProgram::RunIsolated(), which may run several programs of a context at once.
+ *
+ * \code
+ * CBotContext context;
+ * CBotContext::SetCurrent(&context);
+ *
+ * CBotProgram::Init();
+ * CBotProgram::AddFunction("message", rMessage, cMessage);
+ * auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+ * // compile and run the program, possibly in another thread
+ * program.reset();
+ * CBotProgram::Free();
+ *
+ * CBotContext::SetCurrent(nullptr);
+ * \endcode
+ */
+class CBotContext
+{
+public:
+    /**
+     * \brief Constructor, the context is empty until CBotProgram::Init() is called in it
+     */
+    CBotContext();
+
+    /**
+     * \brief Destructor, frees what CBotProgram::Free() didn't
+     */
+    ~CBotContext();
+
+    CBotContext(const CBotContext&) = delete;
+    CBotContext& operator=(const CBotContext&) = delete;
+
+    /**
+     * \brief Returns the current context of the calling thread
+     */
+    static CBotContext* GetCurrent();
+
+    /**
+     * \brief Changes the current context of the calling thread
+     * \param context New current context, nullptr for the default one
+     */
+    static void SetCurrent(CBotContext* context);
+
+    /**
+     * \brief Makes a context current until the end of the scope
+     */
+    class Scope
+    {
+    public:
+        Scope(CBotContext* context);
+        ~Scope();
+
+    private:
+        CBotContext* m_previous;
+    };
+
+    /**
+     * \brief Counters of what the context holds
+     */
+    struct Statistics
+    {
+        //! Classes, intrinsic or compiled
+        std::size_t classes = 0;
+        //! Public functions of the programs
+        std::size_t publicFunctions = 0;
+        //! Compiled code shared by the programs with the same source, see CBotProgram::Compile()
+        std::size_t sharedCodes = 0;
+        //! Class instances alive with an identifier
+        std::size_t instances = 0;
+        //! Instances freed by CBotProgram::CollectCycles()
+        long collectedInstances = 0;
+        //! Names of the variables, each one stored once
+        std::size_t variableNames = 0;
+    };
+
+    /**
+     * \brief Returns the counters of what the context holds
+     */
+    Statistics GetStatistics();
+
+private:
+    //! What the context holds, only seen inside the engine, see GetContextState()
+    std::unique_ptr<CBotContextState> m_state;
+
+    friend CBotContextState& GetContextState(CBotContext* context);
+};
+
+} // namespace CBot
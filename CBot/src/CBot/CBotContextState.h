@@ -0,0 +1,221 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#pragma once
+
+#include "CBot/CBotContext.h"
+#include "CBot/CBotProgram.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace CBot
+{
+
+class CBotClass;
+class CBotExternalCallList;
+class CBotFunction;
+class CBotVarClass;
+struct CBotFileState;
+
+/**
+ * \brief Examination of a group of candidates by CBotProgram::CollectCycles(), which its deadline may interrupt
+ *
+ * The instances reached are marked: if the counter of one of them changes before the examination is over
+ * (see CBotVarClass::IncrementUse()), the examination is abandoned and its roots become candidates again.
+ */
+struct CBotCycleCollection
+{
+    //! An instance reached, see outside
+    struct Reached
+    {
+        //! Its counter, minus the references from the other instances reached
+        int outside;
+        //! It was one of the candidates the examination started from
+        bool root;
+    };
+
+    //! Instances reached, the references they hold being removed from the counters
+    std::unordered_map<CBotVarClass*, Reached> outside;
+    //! Instances reached, in order, and the number of them whose references were removed
+    std::vector<CBotVarClass*> reached;
+    std::size_t counted = 0;
+    //! Instances kept alive by the references from outside, and those whose references remain to follow
+    std::unordered_set<CBotVarClass*> alive;
+    std::vector<CBotVarClass*> pending;
+    //! The references were all removed, the instances alive are being marked
+    bool marking = false;
+    //! An examination is in progress
+    bool active = false;
+    //! A counter of an instance reached changed, the examination is abandoned
+    std::atomic<bool> invalid{false};
+    //! The last examination was abandoned, the next one runs to its end so that the collection progresses
+    bool uninterrupted = false;
+
+    //! Forgets the examination, once it is over
+    void Reset()
+    {
+        outside.clear();
+        reached.clear();
+        counted = 0;
+        alive.clear();
+        pending.clear();
+        marking = false;
+        active = false;
+    }
+};
+
+/**
+ * \brief What a CBotContext holds, grouped by part of the engine
+ *
+ * This header is internal to the engine, the host only sees CBotContext. Each part is only
+ * used by the classes it names.
+ */
+struct CBotContextState
+{
+    //! Hash of the names, which can also look them up from a std::string_view
+    struct NameHash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    //! What the host defines for the programs, see CBotContextState::definitions
+    struct Definitions
+    {
+        //! Functions added with CBotProgram::AddFunction()
+        std::unique_ptr<CBotExternalCallList> externalCalls;
+        //! See CBotExternalCallList::GetRevision()
+        long externalCallsRevision = 0;
+        //! Constants added with CBotToken::DefineNum()
+        std::unordered_map<std::string, long, NameHash, std::equal_to<>> defineNum;
+        //! See CBotToken::GetDefineNumRevision()
+        long defineNumRevision = 0;
+    };
+
+    //! Classes of the context, see CBotContextState::classes
+    struct Classes
+    {
+        //! All the classes, intrinsic or compiled
+        std::set<CBotClass*> publicClasses;
+        //! See CBotClass::GetRevision()
+        long revision = 0;
+        //! Changes every time the objects of the host may have changed, see CBotClass::InvalidateFields()
+        long fieldsGeneration = 1;
+        //! Changes every time a program runs with an access to the static fields, see CBotProgram::IsStateChanged()
+        long sharedStateRevision = 0;
+    };
+
+    //! Public functions and compiled code of the programs, see CBotContextState::functions
+    struct Functions
+    {
+        //! Public functions of all the programs
+        std::set<CBotFunction*> publicFunctions;
+        //! Changes every time the list of public functions changes
+        long revision = 0;
+        //! Public functions by their unique number
+        std::unordered_map<long, CBotFunction*> byIdent;
+        //! Number of public functions that are methods defined out of their class
+        int publicMethods = 0;
+        //! Compiled code of the programs, by hash of their source (see CBotProgram::Compile())
+        std::unordered_multimap<std::size_t, std::weak_ptr<CBotProgram::SharedCode>> sharedCodes;
+    };
+
+    //! Class instances alive, see CBotContextState::instances
+    struct Instances
+    {
+        //! All class instances by their number, for CBotVarClass::Find()
+        std::unordered_multimap<long, CBotVarClass*> byIdent;
+        std::mutex mutex;
+        //! Number of instances with a destructor to call when they are released (see CBotVarClass::ConstructorSet())
+        std::atomic<long> destructible{0};
+        //! Instances which lost a reference since they were last examined by CBotProgram::CollectCycles(), guarded by mutex,
+        //! merged from the buffers of the threads (see CBotVarClass::MergeCycleCandidates())
+        std::unordered_set<CBotVarClass*> cycleCandidates;
+        //! Number of instances freed by CBotProgram::CollectCycles()
+        long collected = 0;
+        //! Examination of CBotProgram::CollectCycles() in progress
+        CBotCycleCollection cycleCollection;
+        //! Limits of the destructors, see CBotProgram::SetDestructorLimits()
+        long destructorTickLimit = 0;
+        std::chrono::steady_clock::time_point destructorDeadline = std::chrono::steady_clock::time_point::max();
+        //! Timer ticks used by the destructors
+        std::atomic<long> destructorTicks{0};
+        //! Destructors stopped by the limits
+        std::atomic<long> stoppedDestructors{0};
+    };
+
+    //! Shared data of the variables, see CBotContextState::variables
+    struct Variables
+    {
+        //! Last unique number given (see CBotVar::NextUniqNum())
+        std::atomic<long> identcpt{0};
+        //! Names of the variables, each one is stored once, so the variables must not outlive the context
+        std::unordered_set<std::string> names;
+        //! Only taken for the names not yet in the cache of the thread, see CBotVar::InternName()
+        std::mutex namesMutex;
+    };
+
+    //! State of the compilation in progress, see CBotContextState::compilation
+    struct Compilation
+    {
+        //! Counter of nested loops, to determine the break and continue valid
+        int loopLvl = 0;
+        //! Labels of the nested loops
+        std::vector<std::string> labelLvl;
+    };
+
+    Definitions definitions;
+    Classes classes;
+    Functions functions;
+    Instances instances;
+    Variables variables;
+    Compilation compilation;
+    //! Files opened by the programs, see GetFileState()
+    std::unique_ptr<CBotFileState> files;
+    //! Unique number of the context, which tells the caches of the threads which context they belong to
+    long serial = 0;
+};
+
+/**
+ * \brief Returns what a context holds
+ */
+inline CBotContextState& GetContextState(CBotContext* context)
+{
+    return *context->m_state;
+}
+
+/**
+ * \brief Returns what the current context of the calling thread holds
+ */
+inline CBotContextState& GetCurrentState()
+{
+    return GetContextState(CBotContext::GetCurrent());
+}
+
+} // namespace CBot
@@ -28,6 +28,7 @@
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <set>
 
 namespace CBot
 {
@@ -24,6 +24,8 @@
 
 #define    MAXARRAYSIZE    9999
 
+#define    LENGTH_PER_TICK 100              /// \def characters of a string processed per timer tick, see CBotStack::ChargeLength()
+
 //! Define the current CBot version
 #define    CBOTVERSION    104
 
@@ -56,6 +56,15 @@ enum CBotType
     CBotTypMAX = 20
 };
 
+/**
+ * \brief Execution engines of CBotProgram, see CBotProgram::SetEngine()
+ */
+enum class CBotEngine
+{
+    TREE,       //!< every instruction is executed by walking the compiled instruction tree
+    BYTECODE,   //!< function bodies and expressions are lowered to bytecode where possible, the rest runs in the tree walker, see CBotByteCode
+};
+
 /**
  * \brief Different modes for CBotProgram::GetPosition
  */
@@ -274,6 +283,7 @@ enum CBotError : int
     CBotErrNotOpen       = 6013, //!< channel not open
     CBotErrRead          = 6014, //!< error while reading
     CBotErrWrite         = 6015, //!< writing error
+    CBotErrMemory        = 6016, //!< memory limit exceeded, see CBotProgram::SetMemoryLimit()
 
     CBotErrMAX, //!< Max errors
 };
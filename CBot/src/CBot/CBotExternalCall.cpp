@@ -19,6 +19,8 @@
 
 #include "CBot/CBotExternalCall.h"
 
+#include "CBot/CBotClass.h"
+#include "CBot/CBotContextState.h"
 #include "CBot/CBotToken.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
@@ -32,14 +34,28 @@ namespace CBot
 void CBotExternalCallList::Clear()
 {
     m_list.clear();
+    GetCurrentState().definitions.externalCallsRevision++;
 }
 
 bool CBotExternalCallList::AddFunction(const std::string& name, std::unique_ptr<CBotExternalCall> call)
 {
     m_list[name] = std::move(call);
+    GetCurrentState().definitions.externalCallsRevision++;
     return true;
 }
 
+CBotExternalCall* CBotExternalCallList::Find(const std::string& name)
+{
+    auto it = m_list.find(name);
+    if (it == m_list.end()) return nullptr;
+    return it->second.get();
+}
+
+long CBotExternalCallList::GetRevision()
+{
+    return GetCurrentState().definitions.externalCallsRevision;
+}
+
 CBotTypResult CBotExternalCallList::CompileCall(CBotToken*& p, CBotVar* thisVar, CBotVar** ppVar, CBotCStack* pStack)
 {
     if (m_list.count(p->GetString()) == 0)
@@ -77,12 +93,18 @@ int CBotExternalCallList::DoCall(CBotToken* token, CBotVar* thisVar, CBotVar** p
     if (token == nullptr)
         return -1;
 
-    if (m_list.count(token->GetString()) == 0)
+    CBotExternalCall* pt = Find(token->GetString());
+    if (pt == nullptr)
         return -1;
 
-    CBotExternalCall* pt = m_list[token->GetString()].get();
+    return DoCall(pt, token, thisVar, ppVar, pStack, rettype);
+}
 
+bool CBotExternalCallList::DoCall(CBotExternalCall* pt, CBotToken* token, CBotVar* thisVar, CBotVar** ppVar,
+                                  CBotStack* pStack, const CBotTypResult& rettype)
+{
     if (thisVar == nullptr && pStack->IsCallFinished()) return true;  // only for non-method external call
+    if (!pt->IsIsolated() && pStack->StopIsolated()) return false;    // may act on the host
 
     // if this is a method call we need to use AddStack()
     CBotStack* pile = (thisVar != nullptr) ? pStack->AddStack() : pStack->AddStackExternalCall(pt);
@@ -97,26 +119,33 @@ int CBotExternalCallList::DoCall(CBotToken* token, CBotVar* thisVar, CBotVar** p
         // creates a variable to the result
         CBotVar* pResult = rettype.Eq(CBotTypVoid) ? nullptr : CBotVar::Create("", rettype);
         pile2->SetVar(pResult);
+        pile->ChargeTimer(pt->GetCost());
         pile->IncState(); // increment state to mark this step done
     }
 
     pile->SetError(CBotNoErr, token); // save token for the position in case of error
-    return pt->Run(thisVar, pStack);
+    bool ok = pt->Run(thisVar, pStack);
+    if (!pt->IsIsolated()) CBotClass::InvalidateFields();   // the call may have changed the objects of the host
+    return ok;
 }
 
 bool CBotExternalCallList::RestoreCall(CBotToken* token, CBotVar* thisVar, CBotVar** ppVar, CBotStack* pStack)
 {
-    if (m_list.count(token->GetString()) == 0)
+    CBotExternalCall* pt = Find(token->GetString());
+    if (pt == nullptr)
         return false;
 
-    CBotExternalCall* pt = m_list[token->GetString()].get();
+    RestoreCall(pt, thisVar, pStack);
+    return true;
+}
 
+void CBotExternalCallList::RestoreCall(CBotExternalCall* pt, CBotVar* thisVar, CBotStack* pStack)
+{
     // if this is a method call we need to use RestoreStack()
     CBotStack* pile = (thisVar != nullptr) ? pStack->RestoreStack() : pStack->RestoreStackEOX(pt);
-    if (pile == nullptr) return true;
+    if (pile == nullptr) return;
 
     pile->RestoreStack();
-    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -129,6 +158,26 @@ CBotExternalCall::~CBotExternalCall()
 {
 }
 
+void CBotExternalCall::SetIsolated(bool isolated)
+{
+    m_isolated = isolated;
+}
+
+bool CBotExternalCall::IsIsolated() const
+{
+    return m_isolated;
+}
+
+void CBotExternalCall::SetCost(int cost)
+{
+    m_cost = cost;
+}
+
+int CBotExternalCall::GetCost() const
+{
+    return m_cost;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 CBotExternalCallDefault::CBotExternalCallDefault(RuntimeFunc rExec, CompileFunc rCompile)
@@ -73,6 +73,37 @@ public:
      * \return false to request program interruption, true otherwise
      */
     virtual bool Run(CBotVar* thisVar, CBotStack* pStack) = 0;
+
+    /**
+     * \brief Marks the function as working only on its arguments and result
+     *
+     * Such a function can be called by programs running at once, see CBotProgram::RunIsolated()
+     */
+    void SetIsolated(bool isolated);
+
+    /**
+     * \brief Tells if the function was marked with SetIsolated()
+     */
+    bool IsIsolated() const;
+
+    /**
+     * \brief Sets the number of timer ticks charged to the program for each call, in addition to the usual ones
+     *
+     * Used for functions that do much more work than a CBot instruction
+     *
+     * \param cost Number of ticks, 0 by default
+     * \see CBotStack::ChargeTimer()
+     */
+    void SetCost(int cost);
+
+    /**
+     * \brief Returns the cost given to SetCost()
+     */
+    int GetCost() const;
+
+private:
+    bool m_isolated = false;
+    int m_cost = 0;
 };
 
 /**
@@ -172,6 +203,24 @@ public:
      */
     bool CheckCall(const std::string& name);
 
+    /**
+     * \brief Find a function, to bind a call site to it
+     *
+     * The returned pointer stays valid as long as GetRevision() doesn't change
+     *
+     * \param name Function name
+     * \return The function, or nullptr if it doesn't exist
+     */
+    CBotExternalCall* Find(const std::string& name);
+
+    /**
+     * \brief Revision of the registered functions
+     *
+     * Changes every time a function is added or the list is cleared, in any list
+     * of the current context, so bindings made with Find() must be made again
+     */
+    static long GetRevision();
+
     /**
      * \brief Find and call runtime function
      *
@@ -186,6 +235,19 @@ public:
      */
     int DoCall(CBotToken* token, CBotVar* thisVar, CBotVar** ppVars, CBotStack* pStack, const CBotTypResult& rettype);
 
+    /**
+     * \brief Call a runtime function found with Find()
+     *
+     * \param pt Function to call
+     * \param token Token reported with errors
+     * \param thisVar "this" variable for class calls, nullptr for normal calls
+     * \param ppVars List of arguments
+     * \param pStack Runtime stack
+     * \param rettype Return type of the function, as returned by CompileCall()
+     * \return false if function requested interruption, true on success
+     */
+    bool DoCall(CBotExternalCall* pt, CBotToken* token, CBotVar* thisVar, CBotVar** ppVars, CBotStack* pStack, const CBotTypResult& rettype);
+
     /**
      * \brief Restore execution status after loading saved state
      *
@@ -197,6 +259,15 @@ public:
      */
     bool RestoreCall(CBotToken* token, CBotVar* thisVar, CBotVar** ppVar, CBotStack* pStack);
 
+    /**
+     * \brief Restore execution status of a call to a function found with Find()
+     *
+     * \param pt Called function
+     * \param thisVar "this" variable for class calls, nullptr for normal calls
+     * \param pStack Runtime stack
+     */
+    void RestoreCall(CBotExternalCall* pt, CBotVar* thisVar, CBotStack* pStack);
+
     /**
      * \brief Set user pointer to pass to compile functions
      *
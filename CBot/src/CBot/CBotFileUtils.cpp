@@ -22,43 +22,125 @@
 #include "CBot/CBotClass.h"
 #include "CBot/CBotEnums.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace CBot
 {
 
-template<typename T>
-static bool WriteBinary(std::ostream &ostr, T value, unsigned padTo = 0)
+// The numbers are written and read a byte at a time straight in the buffer of the stream:
+// std::ostream::write() and std::istream::read() would check the state of the stream each time.
+// The encoding below is shared with CBotStateWriter and CBotStateReader, which work on memory.
+
+static bool IsGood(std::ostream &ostr)
+{
+    return !!ostr;
+}
+
+static bool IsGood(std::istream &istr)
+{
+    return !!istr;
+}
+
+static bool IsGood(CBotStateWriter &)
+{
+    return true;
+}
+
+static bool IsGood(CBotStateReader &reader)
+{
+    return !reader.Failed();
+}
+
+static bool PutByte(std::ostream &ostr, unsigned char chr)
+{
+    if (ostr.rdbuf()->sputc(static_cast<char>(chr)) != std::char_traits<char>::eof()) return true;
+    ostr.setstate(std::ios::badbit);
+    return false;
+}
+
+static bool GetByte(std::istream &istr, unsigned char &chr)
+{
+    auto c = istr.rdbuf()->sbumpc();
+    if (c != std::char_traits<char>::eof())
+    {
+        chr = static_cast<unsigned char>(c);
+        return true;
+    }
+    istr.setstate(std::ios::eofbit | std::ios::failbit);
+    return false;
+}
+
+static bool PutByte(CBotStateWriter &writer, unsigned char chr)
 {
+    writer.Put(chr);
+    return true;
+}
+
+static bool GetByte(CBotStateReader &reader, unsigned char &chr)
+{
+    return reader.Get(chr);
+}
+
+static bool PutBytes(std::ostream &ostr, const char* data, std::size_t size)
+{
+    return !!ostr.write(data, size);
+}
+
+static bool GetBytes(std::istream &istr, char* data, std::size_t size)
+{
+    return !!istr.read(data, size);
+}
+
+static bool PutBytes(CBotStateWriter &writer, const char* data, std::size_t size)
+{
+    writer.Put(data, size);
+    return true;
+}
+
+static bool GetBytes(CBotStateReader &reader, char* data, std::size_t size)
+{
+    return reader.Get(data, size);
+}
+
+template<typename T, typename Output>
+static bool WriteBinary(Output &ostr, T value, unsigned padTo = 0)
+{
+    if (!IsGood(ostr)) return false;
+
     unsigned char chr;
     unsigned count = 1;
     while (value > 127) // unsigned LEB128
     {
         ++count;
         chr = (value & 0x7F) | 0x80;
-        if (!ostr.write(reinterpret_cast<char*>(&chr), 1)) return false;
+        if (!PutByte(ostr, chr)) return false;
         value >>= 7;
     }
     chr = value & 0x7F;
     if (count < padTo) chr |= 0x80;
-    if (!ostr.write(reinterpret_cast<char*>(&chr), 1)) return false;
+    if (!PutByte(ostr, chr)) return false;
 
     if (count < padTo)
     {
         while (++count < padTo)
-            if (!(ostr << '\x80')) return false;
-        if (!(ostr << '\x00')) return false;
+            if (!PutByte(ostr, 0x80)) return false;
+        if (!PutByte(ostr, 0x00)) return false;
     }
     return true;
 }
 
-template<typename T>
-static bool ReadBinary(std::istream &istr, T &value)
+template<typename T, typename Input>
+static bool ReadBinary(Input &istr, T &value)
 {
     value = 0;
+    if (!IsGood(istr)) return false;
+
     unsigned char chr;
     unsigned shift = 0;
     while (true)        // unsigned LEB128
     {
-        if (!istr.read(reinterpret_cast<char*>(&chr), 1)) return false;
+        if (!GetByte(istr, chr)) return false;
         if (shift < sizeof(T) * 8)
             value |= static_cast<T>(chr & 0x7F) << shift;
         shift += 7;
@@ -67,9 +149,11 @@ static bool ReadBinary(std::istream &istr, T &value)
     return true;
 }
 
-template<typename T>
-static bool WriteSignedBinary(std::ostream &ostr, T value, unsigned padTo = 0)
+template<typename T, typename Output>
+static bool WriteSignedBinary(Output &ostr, T value, unsigned padTo = 0)
 {
+    if (!IsGood(ostr)) return false;
+
     signed char sign = value >> (8 * sizeof(T) - 1);
     unsigned count = 0;
     while (true)        // signed LEB128
@@ -80,32 +164,34 @@ static bool WriteSignedBinary(std::ostream &ostr, T value, unsigned padTo = 0)
         if (!(value != sign || ((chr ^ sign) & 0x40) != 0))
         {
             if (count < padTo) chr |= 0x80;
-            if (!ostr.write(reinterpret_cast<char*>(&chr), 1)) return false;
+            if (!PutByte(ostr, chr)) return false;
             break;
         }
         chr |= 0x80;
-        if (!ostr.put(chr)) return false;
+        if (!PutByte(ostr, chr)) return false;
     }
 
     if (count < padTo)
     {
-        char chr = (sign < 0) ? 0x7F : 0x00;
+        unsigned char chr = (sign < 0) ? 0x7F : 0x00;
         while (++count < padTo)
-            if (!ostr.put(chr | 0x80)) return false;
-        if (!ostr.put(chr)) return false;
+            if (!PutByte(ostr, chr | 0x80)) return false;
+        if (!PutByte(ostr, chr)) return false;
     }
     return true;
 }
 
-template<typename T>
-static bool ReadSignedBinary(std::istream &istr, T &value)
+template<typename T, typename Input>
+static bool ReadSignedBinary(Input &istr, T &value)
 {
     value = 0;
+    if (!IsGood(istr)) return false;
+
     unsigned char chr;
     unsigned shift = 0;
     while (true)        // signed LEB128
     {
-        if (!istr.read(reinterpret_cast<char*>(&chr), 1)) return false;
+        if (!GetByte(istr, chr)) return false;
         if (shift < sizeof(T) * 8 - 1)
             value |= (static_cast<T>(chr & 0x7F) << shift);
         shift += 7;
@@ -181,7 +267,8 @@ bool ReadLong(std::istream &istr, long &l)
     return ReadSignedBinary<long>(istr, l);
 }
 
-bool WriteFloat(std::ostream &ostr, float f)
+template<typename Output>
+static bool WriteFloatTo(Output &ostr, float f)
 {
     union TypeConverter
     {
@@ -197,7 +284,8 @@ bool WriteFloat(std::ostream &ostr, float f)
     return WriteBinary<uint32_t>(ostr, u.iValue);
 }
 
-bool ReadFloat(std::istream &istr, float &f)
+template<typename Input>
+static bool ReadFloatFrom(Input &istr, float &f)
 {
     union TypeConverter
     {
@@ -214,7 +302,8 @@ bool ReadFloat(std::istream &istr, float &f)
     return true;
 }
 
-bool WriteDouble(std::ostream &ostr, double d)
+template<typename Output>
+static bool WriteDoubleTo(Output &ostr, double d)
 {
     union TypeConverter
     {
@@ -230,7 +319,8 @@ bool WriteDouble(std::ostream &ostr, double d)
     return WriteBinary<uint64_t>(ostr, u.iValue);
 }
 
-bool ReadDouble(std::istream &istr, double &d)
+template<typename Input>
+static bool ReadDoubleFrom(Input &istr, double &d)
 {
     union TypeConverter
     {
@@ -247,15 +337,17 @@ bool ReadDouble(std::istream &istr, double &d)
     return true;
 }
 
-bool WriteString(std::ostream &ostr, const std::string &s)
+template<typename Output>
+static bool WriteStringTo(Output &ostr, const std::string &s)
 {
     if (!WriteBinary<size_t>(ostr, s.size())) return false;
-    if (!ostr.write(&(s[0]), s.size())) return false;
+    if (!PutBytes(ostr, s.data(), s.size())) return false;
 
     return true;
 }
 
-bool ReadString(std::istream &istr, std::string &s)
+template<typename Input>
+static bool ReadStringFrom(Input &istr, std::string &s)
 {
     size_t length = 0;
     if (!ReadBinary<size_t>(istr, length)) return false;
@@ -263,43 +355,45 @@ bool ReadString(std::istream &istr, std::string &s)
     s.resize(length);
     if (length != 0)
     {
-        if (!istr.read(&(s[0]), length)) return false;
+        if (!GetBytes(istr, &(s[0]), length)) return false;
     }
     return true;
 }
 
-bool WriteType(std::ostream &ostr, const CBotTypResult &type)
+template<typename Output>
+static bool WriteTypeTo(Output &ostr, const CBotTypResult &type)
 {
     int typ = type.GetType();
     if ( typ == CBotTypIntrinsic ) typ = CBotTypClass;
-    if ( !WriteWord(ostr, typ) ) return false;
+    if ( !WriteBinary<unsigned short>(ostr, typ) ) return false;
     if ( typ == CBotTypClass )
     {
         CBotClass* p = type.GetClass();
-        if (!WriteString(ostr, p->GetName())) return false;
+        if (!WriteStringTo(ostr, p->GetName())) return false;
     }
     if ( type.Eq( CBotTypArrayBody ) ||
          type.Eq( CBotTypArrayPointer ) )
     {
-        if (!WriteWord(ostr, type.GetLimite())) return false;
-        if (!WriteType(ostr, type.GetTypElem())) return false;
+        if (!WriteBinary<unsigned short>(ostr, type.GetLimite())) return false;
+        if (!WriteTypeTo(ostr, type.GetTypElem())) return false;
     }
 
     if ( type.Eq(CBotTypPointer) )
     {
         if (type.GetClass() != nullptr)
         {
-            if (!WriteString(ostr, type.GetClass()->GetName())) return false;
+            if (!WriteStringTo(ostr, type.GetClass()->GetName())) return false;
         }
-        else if (!WriteString(ostr, "")) return false;
+        else if (!WriteStringTo(ostr, "")) return false;
     }
     return true;
 }
 
-bool ReadType(std::istream &istr, CBotTypResult &type)
+template<typename Input>
+static bool ReadTypeFrom(Input &istr, CBotTypResult &type)
 {
     unsigned short  w, ww;
-    if (!ReadWord(istr, w)) return false;
+    if (!ReadBinary<unsigned short>(istr, w)) return false;
     type.SetType(w);
 
     if ( type.Eq( CBotTypIntrinsic ) )
@@ -310,7 +404,7 @@ bool ReadType(std::istream &istr, CBotTypResult &type)
     if ( type.Eq( CBotTypClass ) )
     {
         std::string  s;
-        if (!ReadString(istr, s)) return false;
+        if (!ReadStringFrom(istr, s)) return false;
         type = CBotTypResult( w, s );
     }
 
@@ -318,8 +412,8 @@ bool ReadType(std::istream &istr, CBotTypResult &type)
          type.Eq( CBotTypArrayBody ) )
     {
         CBotTypResult   r;
-        if (!ReadWord(istr, ww)) return false;
-        if (!ReadType(istr, r)) return false;
+        if (!ReadBinary<unsigned short>(istr, ww)) return false;
+        if (!ReadTypeFrom(istr, r)) return false;
         type = CBotTypResult( w, r );
         type.SetLimite(static_cast<short>(ww));
     }
@@ -327,12 +421,171 @@ bool ReadType(std::istream &istr, CBotTypResult &type)
     if ( type.Eq(CBotTypPointer) )
     {
         std::string className;
-        if (!ReadString(istr, className)) return false;
+        if (!ReadStringFrom(istr, className)) return false;
         type = CBotTypResult(w, className);
     }
     return true;
 }
 
+bool WriteFloat(std::ostream &ostr, float f)
+{
+    return WriteFloatTo(ostr, f);
+}
+
+bool ReadFloat(std::istream &istr, float &f)
+{
+    return ReadFloatFrom(istr, f);
+}
+
+bool WriteDouble(std::ostream &ostr, double d)
+{
+    return WriteDoubleTo(ostr, d);
+}
+
+bool ReadDouble(std::istream &istr, double &d)
+{
+    return ReadDoubleFrom(istr, d);
+}
+
+bool WriteString(std::ostream &ostr, const std::string &s)
+{
+    return WriteStringTo(ostr, s);
+}
+
+bool ReadString(std::istream &istr, std::string &s)
+{
+    return ReadStringFrom(istr, s);
+}
+
+bool WriteType(std::ostream &ostr, const CBotTypResult &type)
+{
+    return WriteTypeTo(ostr, type);
+}
+
+bool ReadType(std::istream &istr, CBotTypResult &type)
+{
+    return ReadTypeFrom(istr, type);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool WriteWord(CBotStateWriter &writer, unsigned short w)
+{
+    return WriteBinary<unsigned short>(writer, w);
+}
+
+bool ReadWord(CBotStateReader &reader, unsigned short &w)
+{
+    return ReadBinary<unsigned short>(reader, w);
+}
+
+bool WriteByte(CBotStateWriter &writer, char c)
+{
+    return PutByte(writer, static_cast<unsigned char>(c));
+}
+
+bool ReadByte(CBotStateReader &reader, char& c)
+{
+    unsigned char chr;
+    if (!reader.Get(chr)) return false;
+    c = static_cast<char>(chr);
+    return true;
+}
+
+bool WriteShort(CBotStateWriter &writer, short s)
+{
+    return WriteSignedBinary<short>(writer, s);
+}
+
+bool ReadShort(CBotStateReader &reader, short &s)
+{
+    return ReadSignedBinary<short>(reader, s);
+}
+
+bool WriteUInt32(CBotStateWriter &writer, uint32_t i)
+{
+    return WriteBinary<uint32_t>(writer, i);
+}
+
+bool ReadUInt32(CBotStateReader &reader, uint32_t &i)
+{
+    return ReadBinary<uint32_t>(reader, i);
+}
+
+bool WriteInt(CBotStateWriter &writer, int i)
+{
+    return WriteSignedBinary<int>(writer, i);
+}
+
+bool ReadInt(CBotStateReader &reader, int &i)
+{
+    return ReadSignedBinary<int>(reader, i);
+}
+
+bool WriteLong(CBotStateWriter &writer, long l, unsigned padTo)
+{
+    return WriteSignedBinary<long>(writer, l, padTo);
+}
+
+bool ReadLong(CBotStateReader &reader, long &l)
+{
+    return ReadSignedBinary<long>(reader, l);
+}
+
+bool WriteFloat(CBotStateWriter &writer, float f)
+{
+    return WriteFloatTo(writer, f);
+}
+
+bool ReadFloat(CBotStateReader &reader, float &f)
+{
+    return ReadFloatFrom(reader, f);
+}
+
+bool WriteDouble(CBotStateWriter &writer, double d)
+{
+    return WriteDoubleTo(writer, d);
+}
+
+bool ReadDouble(CBotStateReader &reader, double &d)
+{
+    return ReadDoubleFrom(reader, d);
+}
+
+bool WriteString(CBotStateWriter &writer, const std::string &s)
+{
+    return WriteStringTo(writer, s);
+}
+
+bool ReadString(CBotStateReader &reader, std::string &s)
+{
+    return ReadStringFrom(reader, s);
+}
+
+bool WriteType(CBotStateWriter &writer, const CBotTypResult &type)
+{
+    return WriteTypeTo(writer, type);
+}
+
+bool ReadType(CBotStateReader &reader, CBotTypResult &type)
+{
+    return ReadTypeFrom(reader, type);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Copies \a size bytes from \a istr to \a ostr, by blocks
+static bool CopyStream(std::istream& istr, std::ostream &ostr, std::streamsize size)
+{
+    char buffer[4096];
+    while (size > 0)
+    {
+        std::streamsize count = std::min<std::streamsize>(size, sizeof(buffer));
+        if (!istr.read(buffer, count)) return false;
+        if (!ostr.write(buffer, count)) return false;
+        size -= count;
+    }
+    return true;
+}
+
 bool WriteStream(std::ostream &ostr, std::istream& istr)
 {
     if (!istr.seekg(0, istr.end)) return false;
@@ -342,13 +595,7 @@ bool WriteStream(std::ostream &ostr, std::istream& istr)
     if (!WriteLong(ostr, size)) return false;
 
     if (!istr.seekg(0, istr.beg)) return false;
-    while (size > 0)
-    {
-        size -= 1;
-        if (!ostr.put(istr.get())) return false;
-    }
-
-    return true;
+    return CopyStream(istr, ostr, size);
 }
 
 bool ReadStream(std::istream& istr, std::ostream &ostr)
@@ -357,11 +604,51 @@ bool ReadStream(std::istream& istr, std::ostream &ostr)
     if (!ReadLong(istr, length)) return false;
     if (length == 0) return true;
 
-    while (length-- > 0)
+    return CopyStream(istr, ostr, length);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotStateReader::CBotStateReader(const char* data, std::size_t size)
+    : m_pos(data), m_end(data + size)
+{
+}
+
+CBotStateReader::CBotStateReader(std::istream& istr)
+    : m_stream(&istr)
+{
+    m_failed = !istr;
+}
+
+bool CBotStateReader::Get(char* data, std::size_t size)
+{
+    if (m_stream != nullptr)
+    {
+        if (!m_failed && m_stream->read(data, size)) return true;
+        Fail();
+        return false;
+    }
+
+    if (static_cast<std::size_t>(m_end - m_pos) < size)
     {
-        if (!ostr.put(istr.get())) return false;
+        Fail();
+        return false;
     }
+    std::memcpy(data, m_pos, size);
+    m_pos += size;
     return true;
 }
 
+bool CBotStateReader::GetFromStream(unsigned char& c)
+{
+    if (m_stream != nullptr && !m_failed && GetByte(*m_stream, c)) return true;
+    Fail();
+    return false;
+}
+
+void CBotStateReader::Fail()
+{
+    m_failed = true;
+    if (m_stream != nullptr) m_stream->setstate(std::ios::failbit);
+}
+
 } // namespace CBot
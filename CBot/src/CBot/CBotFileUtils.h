@@ -28,14 +28,15 @@ namespace CBot
 
 class CBotVar;
 class CBotTypResult;
+class CBotStateWriter;
 
 /*!
  * \brief Save a linked list if variables
- * \param ostr Output stream
+ * \param writer Where the state is written
  * \param pVar First variable in the list
  * \return true on success
  */
-bool SaveVars(std::ostream &ostr, CBotVar* pVar);
+bool SaveVars(CBotStateWriter &writer, CBotVar* pVar);
 
 /*!
  * \brief WriteWord
@@ -214,4 +215,113 @@ bool WriteStream(std::ostream &ostr, std::istream& istr);
  */
 bool ReadStream(std::istream& istr, std::ostream &ostr);
 
+/*!
+ * \brief Writes an execution state straight in memory
+ *
+ * Used by CBotProgram::SaveState() and the functions it calls: the bytes are appended to
+ * a std::string without going through a std::ostream.
+ */
+class CBotStateWriter
+{
+public:
+    /*!
+     * \brief Constructor
+     * \param data String to append to, it must outlive the writer
+     */
+    explicit CBotStateWriter(std::string& data) : m_data(data) {}
+
+    //! Appends a byte
+    void Put(unsigned char c)
+    {
+        m_data.push_back(static_cast<char>(c));
+    }
+
+    //! Appends \a size bytes
+    void Put(const char* data, std::size_t size)
+    {
+        m_data.append(data, size);
+    }
+
+private:
+    std::string& m_data;
+};
+
+/*!
+ * \brief Reads an execution state straight from memory
+ *
+ * The state saved in files can also be read from a std::istream, a byte at a time so that
+ * the reader never takes what follows the state in the stream.
+ */
+class CBotStateReader
+{
+public:
+    /*!
+     * \brief Reads from memory
+     * \param data Data to read, it must outlive the reader
+     * \param size Size of the data
+     */
+    CBotStateReader(const char* data, std::size_t size);
+    /*!
+     * \brief Reads from a stream, its state is set when the reader fails
+     * \param istr Input stream, it must outlive the reader
+     */
+    explicit CBotStateReader(std::istream& istr);
+
+    //! Reads a byte, false at the end of the data
+    bool Get(unsigned char& c)
+    {
+        if (m_pos != m_end)
+        {
+            c = static_cast<unsigned char>(*m_pos++);
+            return true;
+        }
+        return GetFromStream(c);
+    }
+
+    //! Reads \a size bytes, false if there are not as many left
+    bool Get(char* data, std::size_t size);
+
+    //! Tells if a read failed
+    bool Failed() const
+    {
+        return m_failed;
+    }
+
+private:
+    bool GetFromStream(unsigned char& c);
+    void Fail();
+
+    const char* m_pos = nullptr;
+    const char* m_end = nullptr;
+    std::istream* m_stream = nullptr;
+    bool m_failed = false;
+};
+
+/*!
+ * \name Execution state in memory
+ * The same as the functions above with the same encoding, for CBotStateWriter and CBotStateReader
+ */
+//@{
+bool WriteWord(CBotStateWriter &writer, unsigned short w);
+bool ReadWord(CBotStateReader &reader, unsigned short &w);
+bool WriteByte(CBotStateWriter &writer, char c);
+bool ReadByte(CBotStateReader &reader, char& c);
+bool WriteShort(CBotStateWriter &writer, short s);
+bool ReadShort(CBotStateReader &reader, short &s);
+bool WriteUInt32(CBotStateWriter &writer, uint32_t i);
+bool ReadUInt32(CBotStateReader &reader, uint32_t &i);
+bool WriteInt(CBotStateWriter &writer, int i);
+bool ReadInt(CBotStateReader &reader, int &i);
+bool WriteLong(CBotStateWriter &writer, long l, unsigned padTo = 0);
+bool ReadLong(CBotStateReader &reader, long &l);
+bool WriteFloat(CBotStateWriter &writer, float f);
+bool ReadFloat(CBotStateReader &reader, float &f);
+bool WriteDouble(CBotStateWriter &writer, double d);
+bool ReadDouble(CBotStateReader &reader, double &d);
+bool WriteString(CBotStateWriter &writer, const std::string &s);
+bool ReadString(CBotStateReader &reader, std::string &s);
+bool WriteType(CBotStateWriter &writer, const CBotTypResult &type);
+bool ReadType(CBotStateReader &reader, CBotTypResult &type);
+//@}
+
 } // namespace CBot
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#include "CBot/CBotInstanceNumbers.h"
+
+#include "CBot/CBotVar/CBotVar.h"
+#include "CBot/CBotVar/CBotVarClass.h"
+
+namespace CBot
+{
+
+//! Numbers of the program running isolated in each thread, the instances are created too deep
+//! (CBotVar::Create()) to be given them, as the current context of the thread
+static thread_local CBotInstanceNumbers* currentNumbers = nullptr;
+
+////////////////////////////////////////////////////////////////////////////////
+long CBotInstanceNumbers::Take(CBotVarClass* instance)
+{
+    m_instances.insert(instance);
+    return -(++m_count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotInstanceNumbers::Add(CBotVarClass* instance)
+{
+    m_instances.insert(instance);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotInstanceNumbers::Remove(CBotVarClass* instance)
+{
+    m_instances.erase(instance);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotInstanceNumbers::Number()
+{
+    if (m_count == 0) return;
+
+    // the n-th temporary number stands for the n-th number a serial run would have taken
+    long first = CBotVar::NextUniqNums(m_count);
+    std::unordered_set<CBotVarClass*> instances;
+    instances.swap(m_instances);
+    m_count = 0;
+    for (CBotVarClass* instance : instances)
+        instance->SetIdent(first - 1 - instance->m_ItemIdent);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotInstanceNumbers* CBotInstanceNumbers::GetCurrent()
+{
+    return currentNumbers;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotInstanceNumbers::Scope::Scope(CBotInstanceNumbers* numbers) : m_previous(currentNumbers)
+{
+    currentNumbers = numbers;
+}
+
+CBotInstanceNumbers::Scope::~Scope()
+{
+    currentNumbers = m_previous;
+}
+
+} // namespace CBot
@@ -0,0 +1,93 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#pragma once
+
+#include <unordered_set>
+
+namespace CBot
+{
+
+class CBotVarClass;
+
+/**
+ * \brief Numbers of the class instances created by a program running in CBotProgram::RunIsolated()
+ *
+ * Programs running at once would take the numbers of their instances from the context in any order,
+ * and so save other states than when they run one after the other. While a Scope is alive, the
+ * instances created in the calling thread get temporary numbers (-1, -2...) instead, and Number()
+ * gives them the ones they would have got in a serial run.
+ */
+class CBotInstanceNumbers
+{
+public:
+    CBotInstanceNumbers() = default;
+    CBotInstanceNumbers(const CBotInstanceNumbers&) = delete;
+    CBotInstanceNumbers& operator=(const CBotInstanceNumbers&) = delete;
+
+    /**
+     * \brief Gives a temporary number to a new instance
+     * \return The number, negative
+     */
+    long Take(CBotVarClass* instance);
+
+    /**
+     * \brief Notes an instance which got a temporary number from another one, see CBotVarClass::Copy()
+     */
+    void Add(CBotVarClass* instance);
+
+    /**
+     * \brief Forgets an instance destroyed or numbered again
+     */
+    void Remove(CBotVarClass* instance);
+
+    /**
+     * \brief Gives the instances alive their final numbers, taken from the current context
+     *
+     * The numbers taken include those of the instances already destroyed, so the programs
+     * numbered in the order they would run one after the other get the numbers of a serial run.
+     */
+    void Number();
+
+    /**
+     * \brief Returns the numbers of the calling thread, nullptr out of RunIsolated()
+     */
+    static CBotInstanceNumbers* GetCurrent();
+
+    /**
+     * \brief Makes temporary numbers current until the end of the scope
+     */
+    class Scope
+    {
+    public:
+        Scope(CBotInstanceNumbers* numbers);
+        ~Scope();
+
+    private:
+        CBotInstanceNumbers* m_previous;
+    };
+
+private:
+    //! Instances alive with a temporary number
+    std::unordered_set<CBotVarClass*> m_instances;
+    //! Temporary numbers given since the last Number()
+    long m_count = 0;
+};
+
+} // namespace CBot
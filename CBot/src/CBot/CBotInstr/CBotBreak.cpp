@@ -19,6 +19,7 @@
 
 #include "CBot/CBotInstr/CBotBreak.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -92,6 +93,12 @@ void CBotBreak :: RestoreState(CBotStack* &pj, bool bMain)
     if ( bMain ) pj->RestoreStack(this);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotBreak::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddBreak(m_token.GetType() == ID_CONTINUE, m_label);
+}
+
 std::string CBotBreak::GetDebugData()
 {
     return !m_label.empty() ? "m_label = "+m_label : "";
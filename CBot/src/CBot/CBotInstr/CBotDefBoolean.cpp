@@ -23,6 +23,7 @@
 #include "CBot/CBotInstr/CBotTwoOpExpr.h"
 #include "CBot/CBotInstr/CBotDefArray.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -174,6 +175,14 @@ void CBotDefBoolean::RestoreState(CBotStack* &pj, bool bMain)
          m_next2b->RestoreState(pile, bMain);                // other(s) definition(s)
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotDefBoolean::GenerateByteCode(CBotByteCode& code)
+{
+    CBotLeftExprVar* var = static_cast<CBotLeftExprVar*>(m_var);
+    if (!code.AddDeclaration(this, var->GetToken(), static_cast<CBotType>(var->m_typevar.GetType()), var->m_nIdent, m_expr)) return false;
+    return m_next2b == nullptr || m_next2b->GenerateByteCode(code);        // other(s) definition(s)
+}
+
 std::map<std::string, CBotInstr*> CBotDefBoolean::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
@@ -57,6 +57,9 @@ public:
      */
     void RestoreState(CBotStack* &pj, bool bMain) override;
 
+
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotDefBoolean"; }
     virtual std::map<std::string, CBotInstr*> GetDebugLinks() override;
@@ -330,6 +330,8 @@ bool CBotDefClass::Execute(CBotStack* &pj)
 
         else if ( m_hasParams )
         {
+            if (pile->StopIsolated()) return false;     // the fields and the constructor may run any code
+
             // evaluates the constructor of an instance
 
             if ( !bIntrincic && pile->GetState() == 1)
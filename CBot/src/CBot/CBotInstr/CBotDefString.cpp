@@ -141,7 +141,9 @@ bool CBotDefString::Execute(CBotStack* &pj)
 
     if ( pile->GetState()==0)
     {
-        if (m_expr && !m_expr->Execute(pile)) return false;
+        // the value is kept if the conversion below was interrupted
+        if (m_expr && pile->GetVar() == nullptr && !m_expr->Execute(pile)) return false;
+        if (pile->StopIsolated(pile->GetVar())) return false;   // the conversion to string reads the object
         m_var->Execute(pile);
 
         if (!pile->SetState(1)) return false;
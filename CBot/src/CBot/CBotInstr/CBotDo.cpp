@@ -21,6 +21,7 @@
 #include "CBot/CBotInstr/CBotBlock.h"
 #include "CBot/CBotInstr/CBotCondition.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -154,6 +155,12 @@ void CBotDo :: RestoreState(CBotStack* &pj, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotDo::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddDo(this, m_block, m_condition, m_label);
+}
+
 std::string CBotDo::GetDebugData()
 {
     return !m_label.empty() ? "m_label = "+m_label : "";
@@ -19,6 +19,7 @@
 
 #include "CBot/CBotInstr/CBotExprLitBool.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -28,7 +29,7 @@ namespace CBot
 {
 
 ////////////////////////////////////////////////////////////////////////////////
-CBotExprLitBool::CBotExprLitBool()
+CBotExprLitBool::CBotExprLitBool(bool value) : m_value(value)
 {
 }
 
@@ -46,7 +47,7 @@ CBotInstr* CBotExprLitBool::Compile(CBotToken* &p, CBotCStack* pStack)
     if ( p->GetType() == ID_TRUE ||
          p->GetType() == ID_FALSE )
     {
-        inst = new CBotExprLitBool();
+        inst = new CBotExprLitBool(p->GetType() == ID_TRUE);
         inst->SetToken(p);  // stores the operation false or true
         p = p->GetNext();
 
@@ -64,10 +65,9 @@ bool CBotExprLitBool::Execute(CBotStack* &pj)
 
     if (pile->IfStep()) return false;
 
-    CBotVar*    var = CBotVar::Create("", CBotTypBoolean);
+    CBotVar*    var = pile->CreateVar(CBotTypBoolean);
 
-    if (GetTokenType() == ID_TRUE)      var->SetValInt(1);
-    else                              var->SetValInt(0);
+    var->SetValInt(m_value ? 1 : 0);
 
     pile->SetVar(var);  // put on the stack
     return pj->Return(pile);    // forwards below
@@ -79,4 +79,10 @@ void CBotExprLitBool::RestoreState(CBotStack* &pj, bool bMain)
     if (bMain) pj->RestoreStack(this);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotExprLitBool::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddConstant(m_value);
+}
+
 } // namespace CBot
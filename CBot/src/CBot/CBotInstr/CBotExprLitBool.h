@@ -30,7 +30,11 @@ namespace CBot
 class CBotExprLitBool : public CBotInstr
 {
 public:
-    CBotExprLitBool();
+    /*!
+     * \brief Constructor
+     * \param value Value of the literal
+     */
+    CBotExprLitBool(bool value);
     ~CBotExprLitBool();
 
     /*!
@@ -55,8 +59,14 @@ public:
      */
     void RestoreState(CBotStack* &pj, bool bMain) override;
 
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotExprLitBool"; }
+
+private:
+    //! Value
+    bool m_value;
 };
 
 } // namespace CBot
@@ -20,6 +20,7 @@
 #include "CBot/CBotInstr/CBotExprLitNum.h"
 #include "CBot/CBotStack.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotCStack.h"
 #include "CBot/CBotVar/CBotVar.h"
 
@@ -159,7 +160,7 @@ bool CBotExprLitNum<T>::Execute(CBotStack* &pj)
 
     if (pile->IfStep()) return false;
 
-    CBotVar*    var = CBotVar::Create("", m_numtype);
+    CBotVar*    var = pile->CreateVar(m_numtype);
 
     if (m_token.GetType() == TokenTypDef)
     {
@@ -180,6 +181,14 @@ void CBotExprLitNum<T>::RestoreState(CBotStack* &pj, bool bMain)
     if (bMain) pj->RestoreStack(this);
 }
 
+template <typename T>
+bool CBotExprLitNum<T>::GenerateByteCode(CBotByteCode& code)
+{
+    if (!code.AddConstant(m_value)) return false;
+    if (m_token.GetType() == TokenTypDef) code.SetNamed();     // the variable gets the name too
+    return true;
+}
+
 template <typename T>
 std::string CBotExprLitNum<T>::GetDebugData()
 {
@@ -196,4 +205,9 @@ std::string CBotExprLitNum<T>::GetDebugData()
     return ss.str();
 }
 
+template class CBotExprLitNum<int>;
+template class CBotExprLitNum<long>;
+template class CBotExprLitNum<float>;
+template class CBotExprLitNum<double>;
+
 } // namespace CBot
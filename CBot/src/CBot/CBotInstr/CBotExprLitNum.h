@@ -57,6 +57,8 @@ public:
      */
     void RestoreState(CBotStack* &pj, bool bMain) override;
 
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotExprLitNum"; }
     virtual std::string GetDebugData() override;
@@ -69,4 +71,14 @@ private:
 
 };
 
+template <> CBotExprLitNum<int>::CBotExprLitNum(int val);
+template <> CBotExprLitNum<long>::CBotExprLitNum(long val);
+template <> CBotExprLitNum<float>::CBotExprLitNum(float val);
+template <> CBotExprLitNum<double>::CBotExprLitNum(double val);
+
+extern template class CBotExprLitNum<int>;
+extern template class CBotExprLitNum<long>;
+extern template class CBotExprLitNum<float>;
+extern template class CBotExprLitNum<double>;
+
 } // namespace CBot
@@ -155,7 +155,8 @@ bool CBotExprRetVar::Execute(CBotStack* &pj)
     if (pile1->GetState() == 0)
     {
         pVar = pj->GetVar();
-        pVar->Update(pj->GetUserPtr());
+        if (pile1->StopIsolated(pVar)) return false;    // object of the host
+        if (!pVar->IsUpdatedByField()) pVar->Update(pj->GetUserPtr());
         if (pVar->GetType(CBotVar::GetTypeMode::CLASS_AS_POINTER) == CBotTypNullPointer)
         {
             pile1->SetError(CBotErrNull, &m_token);
@@ -20,6 +20,7 @@
 #include "CBot/CBotInstr/CBotExprUnaire.h"
 #include "CBot/CBotInstr/CBotParExpr.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -58,16 +59,15 @@ CBotInstr* CBotExprUnaire::Compile(CBotToken* &p, CBotCStack* pStack, bool bLite
 
     if (inst->m_expr != nullptr)
     {
-        if (op == ID_ADD && pStk->GetType() < CBotTypBoolean)        // only with the number
-            return pStack->Return(inst, pStk);
-        if (op == ID_SUB && pStk->GetType() < CBotTypBoolean)        // only with the numer
-            return pStack->Return(inst, pStk);
-        if (op == ID_NOT && pStk->GetType() < CBotTypFloat)        // only with an integer
-            return pStack->Return(inst, pStk);
-        if (op == ID_LOG_NOT && pStk->GetTypResult().Eq(CBotTypBoolean))// only with boolean
-            return pStack->Return(inst, pStk);
-        if (op == ID_TXT_NOT && pStk->GetTypResult().Eq(CBotTypBoolean))// only with boolean
+        if ((op == ID_ADD && pStk->GetType() < CBotTypBoolean) ||         // only with the number
+            (op == ID_SUB && pStk->GetType() < CBotTypBoolean) ||         // only with the numer
+            (op == ID_NOT && pStk->GetType() < CBotTypFloat) ||           // only with an integer
+            (op == ID_LOG_NOT && pStk->GetTypResult().Eq(CBotTypBoolean)) ||// only with boolean
+            (op == ID_TXT_NOT && pStk->GetTypResult().Eq(CBotTypBoolean))) // only with boolean
+        {
+            if (pStk->IsOptimized()) return pStack->Return(CBotByteCode::Fold(inst), pStk);
             return pStack->Return(inst, pStk);
+        }
 
         pStk->SetError(CBotErrBadType1, &inst->m_token);
     }
@@ -123,6 +123,13 @@ void CBotExprUnaire::RestoreState(CBotStack* &pj, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotExprUnaire::GenerateByteCode(CBotByteCode& code)
+{
+    if (!m_expr->GenerateByteCode(code)) return false;
+    return code.AddUnaryOperation(GetTokenType());
+}
+
 std::map<std::string, CBotInstr*> CBotExprUnaire::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
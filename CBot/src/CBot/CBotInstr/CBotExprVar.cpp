@@ -24,6 +24,7 @@
 #include "CBot/CBotInstr/CBotIndexExpr.h"
 #include "CBot/CBotInstr/CBotFieldExpr.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -36,6 +37,8 @@ namespace CBot
 CBotExprVar::CBotExprVar()
 {
     m_nIdent = 0;
+    m_nSlot = -1;
+    m_varType = CBotTypVoid;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -64,6 +67,7 @@ CBotInstr* CBotExprVar::Compile(CBotToken*& p, CBotCStack* pStack, bool bCheckRe
         {
             int        ident = var->GetUniqNum();
             (static_cast<CBotExprVar*>(inst))->m_nIdent = ident;     // identifies variable by its number
+            if (ident >= 9000) (static_cast<CBotExprVar*>(inst))->m_nSlot = pStk->GetVarSlot(var);
 
             if (ident > 0 && ident < 9000)
             {
@@ -167,6 +171,7 @@ CBotInstr* CBotExprVar::Compile(CBotToken*& p, CBotCStack* pStack, bool bCheckRe
             }
 
             pStk->SetCopyVar(var);  // place the copy of the variable on the stack (for type)
+            (static_cast<CBotExprVar*>(inst))->m_varType = var->GetType();
             if (pStk->IsOk()) return pStack->Return(inst, pStk);
         }
         pStk->SetError(CBotErrUndefVar, p);
@@ -286,13 +291,16 @@ bool CBotExprVar::ExecuteVar(CBotVar* &pVar, CBotStack* &pj, CBotToken* prevToke
 
     if (bStep && m_nIdent>0 && pj->IfStep()) return false;
 
-    pVar = pj->FindVar(m_nIdent, true);     // tries with the variable update if necessary
+    pVar = pj->FindVar(m_nIdent, m_nSlot, false);
     if (pVar == nullptr)
     {
         assert(false);
         //pj->SetError(static_cast<CBotError>(1), &m_token); // TODO: yeah, don't care that this exception doesn't exist ~krzys_h
         return false;
     }
+    if (pj->StopIsolated(pVar)) return false;       // object of the host
+    if (m_next3 == nullptr || !pVar->IsUpdatedByField())
+        pVar->Update(pj->GetUserPtr());             // the variable update if necessary
     if ( m_next3 != nullptr &&
          !m_next3->ExecuteVar(pVar, pj, &m_token, bStep, false) )
             return false;   // field of an instance, table, methode
@@ -310,6 +318,14 @@ void CBotExprVar::RestoreStateVar(CBotStack* &pj, bool bMain)
          m_next3->RestoreStateVar(pj, bMain);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotExprVar::GenerateByteCode(CBotByteCode& code)
+{
+    // only plain local variables, no fields, array elements or method calls
+    if (m_next3 != nullptr || m_nIdent <= 0) return false;
+    return code.AddVariable(m_nIdent, m_nSlot, m_varType, &m_token);
+}
+
 std::string CBotExprVar::GetDebugData()
 {
     std::stringstream ss;
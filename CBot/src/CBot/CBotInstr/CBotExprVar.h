@@ -89,12 +89,18 @@ public:
      */
     void RestoreStateVar(CBotStack* &pj, bool bMain) override;
 
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotExprVar"; }
     virtual std::string GetDebugData() override;
 
 private:
     long m_nIdent;
+    //! Slot of a local variable, see CBotStack::FindVar(long, int, bool)
+    int m_nSlot;
+    //! Type of the variable at compile time
+    CBotType m_varType;
     friend class CBotPostIncExpr;
     friend class CBotPreIncExpr;
 
@@ -23,10 +23,12 @@
 
 #include "CBot/CBotInstr/CBotTwoOpExpr.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
 #include "CBot/CBotVar/CBotVar.h"
+#include "CBot/CBotVar/CBotVarString.h"
 
 #include <cassert>
 
@@ -185,13 +187,15 @@ bool CBotExpression::Execute(CBotStack* &pj)
 
     if ( pile2->GetState()==0)
     {
-        if (m_rightop && !m_rightop->Execute(pile2)) return false;    // initial value // interrupted?
+        // the value is kept if the conversion below was interrupted
+        if (m_rightop && pile2->GetVar() == nullptr && !m_rightop->Execute(pile2)) return false;    // initial value // interrupted?
         if (m_rightop)
         {
             CBotVar* var = pile1->GetVar();
             CBotVar* value = pile2->GetVar();
             if (var->GetType() == CBotTypString && value->GetType() != CBotTypString)
             {
+                if (pile2->StopIsolated(value)) return false;   // the conversion reads the object
                 CBotVar* newVal = CBotVar::Create("", var->GetTypResult());
                 value->Update(pj->GetUserPtr());
                 newVal->SetValString(value->GetValString());
@@ -203,10 +207,13 @@ bool CBotExpression::Execute(CBotStack* &pj)
 
     if (pile1->GetState() == 1)
     {
+        CBotVar* target = pVar;         // the variable itself
         if (m_token.GetType() != ID_ASS)
         {
             pVar = pile1->GetVar();     // recovers if interrupted
-            result = CBotVar::Create("", pVar->GetTypResult(CBotVar::GetTypeMode::CLASS_AS_INTRINSIC));
+            CBotTypResult type = pVar->GetTypResult(CBotVar::GetTypeMode::CLASS_AS_INTRINSIC);
+            result = type.GetType() <= CBotTypBoolean ? pile2->CreateVar(static_cast<CBotType>(type.GetType()))
+                                                      : CBotVar::Create("", type);
         }
 
         switch (m_token.GetType())
@@ -214,7 +221,18 @@ bool CBotExpression::Execute(CBotStack* &pj)
         case ID_ASS:
             break;
         case ID_ASSADD:
-            result->Add(pile1->GetVar(), pile2->GetVar());
+            if (result->GetType() == CBotTypString)
+            {
+                // a string built by a loop (s += ...) grows in place instead of being copied
+                CBotVarString* copy = static_cast<CBotVarString*>(pile1->GetVar());
+                if (target->GetType() == CBotTypString &&
+                    static_cast<CBotVarString*>(target)->AppendInPlace(copy, pile2->GetVar()))
+                    static_cast<CBotVarString*>(result)->SetValString(copy);
+                else
+                    result->Add(copy, pile2->GetVar());
+                pile2->ChargeLength(static_cast<CBotVarString*>(result)->GetString().length());
+            }
+            else result->Add(pile1->GetVar(), pile2->GetVar());
             pile2->SetVar(result);
             break;
         case ID_ASSSUB:
@@ -308,6 +326,13 @@ void CBotExpression::RestoreState(CBotStack* &pj, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotExpression::GenerateByteCode(CBotByteCode& code)
+{
+    if (m_rightop == nullptr) return false;
+    return m_leftop->GenerateAssignment(code, m_token.GetType(), m_rightop, &m_token);
+}
+
 std::map<std::string, CBotInstr*> CBotExpression::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
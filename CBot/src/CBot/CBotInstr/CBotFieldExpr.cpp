@@ -83,6 +83,7 @@ bool CBotFieldExpr::ExecuteVar(CBotVar* &pVar, CBotStack* &pile, CBotToken* prev
         pile->SetError(CBotErrNull, prevToken);
         return pj->Return(pile);
     }
+    if (pile->StopIsolated(pVar)) return false;     // object of the host
     if (pItem->GetUserPtr() == OBJECTDELETED)
     {
         pile->SetError(CBotErrDeletedPtr, prevToken);
@@ -100,13 +101,17 @@ bool CBotFieldExpr::ExecuteVar(CBotVar* &pVar, CBotStack* &pile, CBotToken* prev
 
     if (pVar->IsStatic())
     {
+        if (pile->StopIsolated()) return false;     // shared by all the instances
+        pile->SetSharedAccess();
         // for a static variable, takes it in the class itself
         CBotClass* pClass = pItem->GetClass();
         pVar = pClass->GetItem(m_token.GetString());
     }
 
     // request the update of the element, if applicable
-    pVar->Update(pile->GetUserPtr());
+    if (pile->StopIsolated(pVar)) return false;
+    if (!pVar->IsStatic()) pItem->UpdateField(pVar, pile->GetUserPtr());
+    if (m_next3 == nullptr || !pVar->IsUpdatedByField()) pVar->Update(pile->GetUserPtr());
 
     if ( m_next3 != nullptr &&
          !m_next3->ExecuteVar(pVar, pile, &m_token, bStep, bExtend) ) return false;
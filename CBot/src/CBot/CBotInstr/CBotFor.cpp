@@ -22,6 +22,7 @@
 #include "CBot/CBotInstr/CBotBlock.h"
 #include "CBot/CBotInstr/CBotBoolExpr.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -210,6 +211,12 @@ void CBotFor :: RestoreState(CBotStack* &pj, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotFor::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddFor(this, m_init, m_test, m_incr, m_block, m_label);
+}
+
 std::string CBotFor::GetDebugData()
 {
     return !m_label.empty() ? "m_label = "+m_label : "";
@@ -27,9 +27,12 @@
 #include "CBot/CBotInstr/CBotEmpty.h"
 #include "CBot/CBotInstr/CBotListArray.h"
 
+#include "CBot/CBotByteCode.h"
+#include "CBot/CBotContextState.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 #include "CBot/CBotClass.h"
+#include "CBot/CBotProgram.h"
 #include "CBot/CBotDefParam.h"
 #include "CBot/CBotUtils.h"
 
@@ -46,6 +49,7 @@ CBotFunction::CBotFunction()
 {
     m_param = nullptr;            // empty parameter list
     m_block = nullptr;            // the instruction block
+    m_byteCode = nullptr;
     m_bPublic    = false;           // function not public
     m_bExtern    = false;           // function not extern
     m_pProg      = nullptr;
@@ -55,21 +59,57 @@ CBotFunction::CBotFunction()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-std::set<CBotFunction*> CBotFunction::m_publicFunctions{};
 
 ////////////////////////////////////////////////////////////////////////////////
 CBotFunction::~CBotFunction()
 {
-    delete m_param;                // empty parameter list
-    delete m_block;                // the instruction block
+    if (!m_shared)
+    {
+        delete m_param;            // empty parameter list
+        delete m_block;            // the instruction block
+        delete m_byteCode;
+    }
 
     // remove public list if there is
-    if (m_bPublic)
+    CBotContext* context = CBotContext::GetCurrent();
+    if (m_bPublic && GetContextState(context).functions.publicFunctions.erase(this) > 0)
     {
-        m_publicFunctions.erase(this);
+        auto it = GetContextState(context).functions.byIdent.find(m_nFuncIdent);
+        if (it != GetContextState(context).functions.byIdent.end() && it->second == this)
+            GetContextState(context).functions.byIdent.erase(it);
+        if (!m_MasterClass.empty()) GetContextState(context).functions.publicMethods--;
+        GetContextState(context).functions.revision++;
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+CBotFunction* CBotFunction::Share(CBotProgram* program)
+{
+    CBotFunction* func = new CBotFunction();
+    func->m_token       = m_token;
+    func->m_nFuncIdent  = m_nFuncIdent;
+    func->m_bSynchro    = m_bSynchro;
+    func->m_param       = m_param;
+    func->m_block       = m_block;
+    func->m_byteCode    = m_byteCode;
+    func->m_shared      = true;
+    func->m_retToken    = m_retToken;
+    func->m_retTyp      = m_retTyp;
+    func->m_bPublic     = m_bPublic;
+    func->m_bProtect    = m_bProtect;
+    func->m_bPrivate    = m_bPrivate;
+    func->m_bExtern     = m_bExtern;
+    func->m_MasterClass = m_MasterClass;
+    func->m_classToken  = m_classToken;
+    func->m_pProg       = program;
+    func->m_extern      = m_extern;
+    func->m_openpar     = m_openpar;
+    func->m_closepar    = m_closepar;
+    func->m_openblk     = m_openblk;
+    func->m_closeblk    = m_closeblk;
+    return func;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotFunction::IsPublic()
 {
@@ -240,6 +280,9 @@ CBotFunction* CBotFunction::Compile(CBotToken* &p, CBotCStack* pStack, CBotFunct
                         pStk->ResetError(CBotErrNoReturn, errPos, errPos);
                         goto bad;
                     }
+                    CBotProgram* prog = pStk->GetProgram();
+                    if (prog != nullptr && prog->GetEngine() == CBotEngine::BYTECODE)
+                        func->m_byteCode = CBotByteCode::GenerateFunction(func->m_block).release();
                     return pStack->ReturnFunc(func, pStk);
                 }
             }
@@ -445,7 +488,7 @@ bool CBotFunction::Execute(CBotVar** ppVars, CBotStack* &pj, CBotVar* pInstance)
         pile->IncState();
     }
 
-    if (!pile->GetRetVar(m_block->Execute(pile)))
+    if (!pile->GetRetVar(ExecuteBlock(pile)))
     {
         if ( pile->GetError() < 0 )
             pile->SetError( CBotNoErr );
@@ -456,6 +499,20 @@ bool CBotFunction::Execute(CBotVar** ppVars, CBotStack* &pj, CBotVar* pInstance)
     return pj->Return(pile);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotFunction::ExecuteBlock(CBotStack* pile)
+{
+    if (m_byteCode != nullptr) return m_byteCode->ExecuteFunction(pile);
+    return m_block->Execute(pile);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotFunction::RestoreBlock(CBotStack* pile)
+{
+    if (m_byteCode != nullptr) m_byteCode->RestoreFunction(pile);
+    else m_block->RestoreState(pile, true);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void CBotFunction::RestoreState(CBotVar** ppVars, CBotStack* &pj, CBotVar* pInstance)
 {
@@ -498,14 +555,14 @@ void CBotFunction::RestoreState(CBotVar** ppVars, CBotStack* &pj, CBotVar* pInst
         pThis->SetUniqNum(-2);
     }
 
-    m_block->RestoreState(pile2, true);
+    RestoreBlock(pile2);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 CBotTypResult CBotFunction::CompileCall(const std::string &name, CBotVar** ppVars, long &nIdent, CBotProgram* program)
 {
     CBotTypResult type;
-    if (!FindLocalOrPublic(program->GetFunctions(), nIdent, name, ppVars, type, program))
+    if (!FindLocalOrPublic(program, nIdent, name, ppVars, type, program))
     {
         // Reset the identifier to "not found" value
         nIdent = 0;
@@ -514,35 +571,28 @@ CBotTypResult CBotFunction::CompileCall(const std::string &name, CBotVar** ppVar
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-CBotFunction* CBotFunction::FindLocalOrPublic(const std::list<CBotFunction*>& localFunctionList, long &nIdent, const std::string &name,
+CBotFunction* CBotFunction::FindLocalOrPublic(CBotProgram* program, long &nIdent, const std::string &name,
                                               CBotVar** ppVars, CBotTypResult &TypeOrError, CBotProgram* baseProg)
 {
     TypeOrError.SetType(CBotErrUndefCall);      // no routine of the name
 
     if ( nIdent )
     {
-        for (CBotFunction* pt : localFunctionList)
-        {
-            if (pt->m_nFuncIdent == nIdent)
-            {
-                TypeOrError = pt->m_retTyp;
-                return pt;
-            }
-        }
+        CBotFunction* pt = program->FindFunction(nIdent);
 
         // search the list of public functions
-        for (CBotFunction* pt : m_publicFunctions)
+        if (pt == nullptr) pt = FindPublic(nIdent);
+
+        if (pt != nullptr)
         {
-            if (pt->m_nFuncIdent == nIdent)
-            {
-                TypeOrError = pt->m_retTyp;
-                return pt;
-            }
+            TypeOrError = pt->m_retTyp;
+            return pt;
         }
     }
 
     if ( name.empty() ) return nullptr;
 
+    const std::list<CBotFunction*>& localFunctionList = program->GetFunctions();
     std::map<CBotFunction*, int> funcMap;
 
     CBotFunction::SearchList(localFunctionList, name, ppVars, TypeOrError, funcMap);
@@ -641,7 +691,7 @@ void CBotFunction::SearchPublic(const std::string& name, CBotVar** ppVars, CBotT
                                 std::map<CBotFunction*, int>& funcMap, CBotClass* pClass)
 {
     {
-        for (CBotFunction* pt : m_publicFunctions)
+        for (CBotFunction* pt : GetCurrentState().functions.publicFunctions)
         {
             if ( pt->m_token.GetString() == name )
             {
@@ -745,14 +795,14 @@ CBotFunction* CBotFunction::BestFunction(std::map<CBotFunction*, int>& funcMap,
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-int CBotFunction::DoCall(CBotProgram* program, const std::list<CBotFunction*>& localFunctionList, long &nIdent, const std::string &name,
+int CBotFunction::DoCall(CBotProgram* program, long &nIdent, const std::string &name,
                          CBotVar** ppVars, CBotStack* pStack, CBotToken* pToken)
 {
     CBotTypResult   type;
     CBotFunction*   pt = nullptr;
     CBotProgram*    baseProg = pStack->GetProgram(true);
 
-    pt = FindLocalOrPublic(localFunctionList, nIdent, name, ppVars, type, baseProg);
+    pt = FindLocalOrPublic(program, nIdent, name, ppVars, type, baseProg);
 
     if ( pt != nullptr )
     {
@@ -819,7 +869,7 @@ int CBotFunction::DoCall(CBotProgram* program, const std::list<CBotFunction*>& l
         // finally execution of the found function
 
         if ( !pStk3->GetRetVar(                     // puts the result on the stack
-            pt->m_block->Execute(pStk3) ))          // GetRetVar said if it is interrupted
+            pt->ExecuteBlock(pStk3) ))          // GetRetVar said if it is interrupted
         {
             if ( !pStk3->IsOk() && pt->m_pProg != program )
             {
@@ -834,7 +884,7 @@ int CBotFunction::DoCall(CBotProgram* program, const std::list<CBotFunction*>& l
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void CBotFunction::RestoreCall(const std::list<CBotFunction*>& localFunctionList,
+void CBotFunction::RestoreCall(CBotProgram* program,
                                long &nIdent, const std::string &name, CBotVar** ppVars, CBotStack* pStack)
 {
     CBotTypResult   type;
@@ -843,7 +893,7 @@ void CBotFunction::RestoreCall(const std::list<CBotFunction*>& localFunctionList
     CBotStack*      pStk3;
     CBotProgram*    baseProg = pStack->GetProgram(true);
 
-    pt = FindLocalOrPublic(localFunctionList, nIdent, name, ppVars, type, baseProg);
+    pt = FindLocalOrPublic(program, nIdent, name, ppVars, type, baseProg);
 
     if ( pt != nullptr )
     {
@@ -896,7 +946,7 @@ void CBotFunction::RestoreCall(const std::list<CBotFunction*>& localFunctionList
         // initializes the variables as parameters
         if (pt->m_param != nullptr)
             pt->m_param->RestoreState(pStk3, false); // restore parameter IDs
-        pt->m_block->RestoreState(pStk3, true);
+        pt->RestoreBlock(pStk3);
     }
 }
 
@@ -942,53 +992,27 @@ CBotFunction* CBotFunction::FindMethod(long& nIdent, const std::string& name,
 {
     TypeOrError.SetType(CBotErrUndefCall);      // no routine of the name
 
-    auto methods = pClass->GetFunctions();
+    const std::list<CBotFunction*>& methods = pClass->GetFunctions();
 
     if ( nIdent )
     {
         // search methods in the class
-        for (CBotFunction* pt : methods)
+        CBotFunction* pt = pClass->FindMethod(nIdent);
+        if ( pt != nullptr )
         {
-            if ( pt->m_nFuncIdent == nIdent )
-            {
-                TypeOrError = pt->m_retTyp;
-                return pt;
-            }
+            TypeOrError = pt->m_retTyp;
+            return pt;
         }
 
-        bool skipPublic = false;
-        if (program != nullptr)
-        {
-            // search the current program
-            for (CBotFunction* pt : program->GetFunctions())
-            {
-                if ( pt->m_nFuncIdent == nIdent )
-                {
-                    // check if the method is inherited
-                    if ( pt->GetClassName() != pClass->GetName() )
-                    {
-                        skipPublic = true;
-                        break; // break in case there is an override
-                    }
-                    TypeOrError = pt->m_retTyp;
-                    return pt;
-                }
-            }
-        }
+        // search the current program, then the list of public functions
+        if (program != nullptr) pt = program->FindFunction(nIdent);
+        if (pt == nullptr) pt = FindPublic(nIdent);
 
-        // search the list of public functions
-        if (!skipPublic)
+        // check if the method is inherited, in case there is an override
+        if ( pt != nullptr && pt->GetClassName() == pClass->GetName() )
         {
-            for (CBotFunction* pt : m_publicFunctions)
-            {
-                if (pt->m_nFuncIdent == nIdent)
-                {
-                    // check if the method is inherited, break in case there is an override
-                    if ( pt->GetClassName() != pClass->GetName() ) break;
-                    TypeOrError = pt->m_retTyp;
-                    return pt;
-                }
-            }
+            TypeOrError = pt->m_retTyp;
+            return pt;
         }
     }
 
@@ -1070,6 +1094,9 @@ int CBotFunction::DoCall(long &nIdent, const std::string &name, CBotVar* pThis,
             pStk->IncState();
         }
 
+        // the lock is shared by the programs
+        if ( pt->m_bSynchro && pStk->StopIsolated() ) return false;
+
         if ( pStk->GetState() == 1 )
         {
             if ( pt->m_bSynchro )
@@ -1082,7 +1109,7 @@ int CBotFunction::DoCall(long &nIdent, const std::string &name, CBotVar* pThis,
         // finally calls the found function
 
         if ( !pStk3->GetRetVar(                         // puts the result on the stack
-            pt->m_block->Execute(pStk3) ))          // GetRetVar said if it is interrupted
+            pt->ExecuteBlock(pStk3) ))          // GetRetVar said if it is interrupted
         {
             if ( !pStk3->IsOk() )
             {
@@ -1159,7 +1186,7 @@ bool CBotFunction::RestoreCall(long &nIdent, const std::string &name, CBotVar* p
 
         // finally calls the found function
 
-        pt->m_block->RestoreState(pStk3, true);                 // interrupt !
+        pt->RestoreBlock(pStk3);                 // interrupt !
         return true;
     }
     return false;
@@ -1214,7 +1241,19 @@ const std::string& CBotFunction::GetClassName() const
 ////////////////////////////////////////////////////////////////////////////////
 void CBotFunction::AddPublic(CBotFunction* func)
 {
-    m_publicFunctions.insert(func);
+    CBotContext* context = CBotContext::GetCurrent();
+    if (!GetContextState(context).functions.publicFunctions.insert(func).second) return;
+    GetContextState(context).functions.byIdent.emplace(func->m_nFuncIdent, func);
+    if (!func->m_MasterClass.empty()) GetContextState(context).functions.publicMethods++;
+    GetContextState(context).functions.revision++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotFunction* CBotFunction::FindPublic(long nIdent)
+{
+    auto& publicFunctions = GetCurrentState().functions.byIdent;
+    auto it = publicFunctions.find(nIdent);
+    return it != publicFunctions.end() ? it->second : nullptr;
 }
 
 bool CBotFunction::HasReturn()
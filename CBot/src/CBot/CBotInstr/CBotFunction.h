@@ -21,8 +21,6 @@
 
 #include "CBot/CBotInstr/CBotInstr.h"
 
-#include <set>
-
 namespace CBot
 {
 
@@ -118,10 +116,11 @@ public:
     /*!
      * \brief Finds a local or public function
      *
-     * <p>First, it looks for a function according to its unique identifier.<br>
+     * <p>First, it looks for a function according to its unique identifier,
+     * in the tables built when programs are compiled.<br>
      * If the identifier is not found, looks by name and parameters.
      *
-     * \param localFunctionList Linked list of local functions to search in, can be null
+     * \param program Program whose functions are searched first
      * \param nIdent[in, out] Unique identifier of the function
      * \param name Name of the function
      * \param ppVars List of function arguments
@@ -129,7 +128,7 @@ public:
      * \param baseProg Initial program, for context of the object/bot
      * \return Pointer to found CBotFunction instance, or nullptr in case of no match or ambiguity (see TypeOrError for error code)
      */
-    static CBotFunction* FindLocalOrPublic(const std::list<CBotFunction*>& localFunctionList, long &nIdent, const std::string &name,
+    static CBotFunction* FindLocalOrPublic(CBotProgram* program, long &nIdent, const std::string &name,
                                            CBotVar** ppVars, CBotTypResult &TypeOrError, CBotProgram* baseProg);
 
     /*!
@@ -170,7 +169,6 @@ public:
     /*!
      * \brief DoCall Fait un appel à une fonction.
      * \param program
-     * \param localFunctionList
      * \param nIdent
      * \param name
      * \param ppVars
@@ -179,18 +177,18 @@ public:
      * \return
      */
 
-    static int DoCall(CBotProgram* program, const std::list<CBotFunction*>& localFunctionList, long &nIdent, const std::string &name,
+    static int DoCall(CBotProgram* program, long &nIdent, const std::string &name,
                       CBotVar** ppVars, CBotStack* pStack, CBotToken* pToken);
 
     /*!
      * \brief RestoreCall
-     * \param localFunctionList
+     * \param program
      * \param nIdent
      * \param name
      * \param ppVars
      * \param pStack
      */
-    static void RestoreCall(const std::list<CBotFunction*>& localFunctionList,
+    static void RestoreCall(CBotProgram* program,
                             long &nIdent, const std::string &name, CBotVar** ppVars, CBotStack* pStack);
 
     /*!
@@ -259,6 +257,13 @@ public:
      */
     static void AddPublic(CBotFunction* pfunc);
 
+    /*!
+     * \brief Finds a public function by its unique identifier
+     * \param nIdent Unique identifier of the function
+     * \return The function, or nullptr if there's no such public function
+     */
+    static CBotFunction* FindPublic(long nIdent);
+
     /*!
      * \brief GetName
      * \return
@@ -325,6 +330,28 @@ protected:
     virtual std::map<std::string, CBotInstr*> GetDebugLinks() override;
 
 private:
+    /*!
+     * \brief Creates a function running the same compiled code, see CBotProgram::Compile()
+     *
+     * Parameters, block and bytecode stay owned by this function, which must outlive the new one.
+     * \param program Program the new function belongs to.
+     * \return The new function.
+     */
+    CBotFunction* Share(CBotProgram* program);
+
+    /*!
+     * \brief Runs the instruction block, with the bytecode if it was generated
+     * \param pile Stack level of the function
+     * \return false if interrupted, on error or on return
+     */
+    bool ExecuteBlock(CBotStack* pile);
+
+    /*!
+     * \brief Restores the state of the instruction block, see ExecuteBlock()
+     * \param pile Stack level of the function
+     */
+    void RestoreBlock(CBotStack* pile);
+
     friend class CBotDebug;
     long m_nFuncIdent;
     //! Synchronized method.
@@ -334,6 +361,10 @@ private:
     CBotDefParam* m_param;
     //! The instruction block.
     CBotInstr* m_block;
+    //! The instruction block compiled for CBotEngine::BYTECODE, nullptr if not lowered.
+    CBotByteCode* m_byteCode;
+    //! Parameters, block and bytecode belong to the function this one was created from (see Share()).
+    bool m_shared = false;
     //! If returns CBotTypClass.
     CBotToken m_retToken;
     //! Complete type of the result.
@@ -358,8 +389,6 @@ private:
     CBotToken m_openblk;
     CBotToken m_closeblk;
 
-    //! List of public functions
-    static std::set<CBotFunction*> m_publicFunctions;
 
     friend class CBotProgram;
     friend class CBotClass;
@@ -21,6 +21,7 @@
 #include "CBot/CBotInstr/CBotBlock.h"
 #include "CBot/CBotInstr/CBotCondition.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -78,6 +79,18 @@ CBotInstr* CBotIf::Compile(CBotToken* &p, CBotCStack* pStack)
                 }
             }
 
+            // a branch that can't be taken is dropped, unless HasReturn() needs it
+            bool value;
+            if (pStk->IsOptimized() && CBotByteCode::IsConstant(inst->m_condition, value))
+            {
+                CBotInstr*& dead = value ? inst->m_blockElse : inst->m_block;
+                if (dead != nullptr && !dead->HasReturn())
+                {
+                    delete dead;
+                    dead = nullptr;
+                }
+            }
+
             // return the corrent object to the application
             return pStack->Return(inst, pStk);
         }
@@ -172,6 +185,12 @@ bool CBotIf::HasReturn()
     return CBotInstr::HasReturn(); // check next block or instruction
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotIf::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddIf(this, m_condition, m_block, m_blockElse);
+}
+
 std::map<std::string, CBotInstr*> CBotIf::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
@@ -91,7 +91,8 @@ bool CBotIndexExpr::ExecuteVar(CBotVar* &pVar, CBotStack* &pile, CBotToken* prev
         return pj->Return(pile);
     }
 
-    pVar->Update(pile->GetUserPtr());
+    if (pile->StopIsolated(pVar)) return false;     // object of the host
+    if (m_next3 == nullptr || !pVar->IsUpdatedByField()) pVar->Update(pile->GetUserPtr());
 
     if ( m_next3 != nullptr &&
          !m_next3->ExecuteVar(pVar, pile, prevToken, bStep, bExtend) ) return false;
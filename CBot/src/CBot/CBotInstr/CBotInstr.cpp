@@ -40,6 +40,7 @@
 #include "CBot/CBotVar/CBotVar.h"
 
 #include "CBot/CBotClass.h"
+#include "CBot/CBotContextState.h"
 #include "CBot/CBotStack.h"
 
 #include <cassert>
@@ -47,10 +48,6 @@
 namespace CBot
 {
 
-////////////////////////////////////////////////////////////////////////////////
-int CBotInstr::m_LoopLvl = 0;
-std::vector<std::string> CBotInstr::m_labelLvl = std::vector<std::string>();
-
 ////////////////////////////////////////////////////////////////////////////////
 CBotInstr::CBotInstr()
 {
@@ -72,35 +69,39 @@ CBotInstr::~CBotInstr()
 ////////////////////////////////////////////////////////////////////////////////
 void CBotInstr::IncLvl(std::string& label)
 {
-    m_labelLvl.resize(m_LoopLvl+1);
-    m_labelLvl[m_LoopLvl] = label;
-    m_LoopLvl++;
+    CBotContext* context = CBotContext::GetCurrent();
+    GetContextState(context).compilation.labelLvl.resize(GetContextState(context).compilation.loopLvl+1);
+    GetContextState(context).compilation.labelLvl[GetContextState(context).compilation.loopLvl] = label;
+    GetContextState(context).compilation.loopLvl++;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void CBotInstr::IncLvl()
 {
-    m_labelLvl.resize(m_LoopLvl+1);
-    m_labelLvl[m_LoopLvl] = "#SWITCH";
-    m_LoopLvl++;
+    CBotContext* context = CBotContext::GetCurrent();
+    GetContextState(context).compilation.labelLvl.resize(GetContextState(context).compilation.loopLvl+1);
+    GetContextState(context).compilation.labelLvl[GetContextState(context).compilation.loopLvl] = "#SWITCH";
+    GetContextState(context).compilation.loopLvl++;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void CBotInstr::DecLvl()
 {
-    m_LoopLvl--;
-    m_labelLvl[m_LoopLvl].clear();
+    CBotContext* context = CBotContext::GetCurrent();
+    GetContextState(context).compilation.loopLvl--;
+    GetContextState(context).compilation.labelLvl[GetContextState(context).compilation.loopLvl].clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotInstr::ChkLvl(const std::string& label, int type)
 {
-    int    i = m_LoopLvl;
+    CBotContext* context = CBotContext::GetCurrent();
+    int    i = GetContextState(context).compilation.loopLvl;
     while (--i>=0)
     {
-        if ( type == ID_CONTINUE && m_labelLvl[i] == "#SWITCH") continue;
+        if ( type == ID_CONTINUE && GetContextState(context).compilation.labelLvl[i] == "#SWITCH") continue;
         if (label.empty()) return true;
-        if (m_labelLvl[i] == label) return true;
+        if (GetContextState(context).compilation.labelLvl[i] == label) return true;
     }
     return false;
 }
@@ -367,6 +368,11 @@ bool CBotInstr::HasReturn()
     return false; // end of the list
 }
 
+bool CBotInstr::GenerateByteCode(CBotByteCode& code)
+{
+    return false;
+}
+
 std::map<std::string, CBotInstr*> CBotInstr::GetDebugLinks()
 {
     return {
@@ -27,6 +27,7 @@
 namespace CBot
 {
 class CBotDebug;
+class CBotByteCode;
 
 /**
  * \brief Class for one CBot instruction
@@ -276,6 +277,16 @@ public:
      */
     virtual bool HasReturn();
 
+    /**
+     * \brief Appends the operations executing this instruction to the given code
+     *
+     * Statements and side effects can only be lowered in a function body, see CBotByteCode
+     *
+     * \param code Code being generated
+     * \return false if this instruction can't be lowered, it is then executed by the tree walker
+     */
+    virtual bool GenerateByteCode(CBotByteCode& code);
+
 protected:
     friend class CBotDebug;
     /**
@@ -306,15 +317,9 @@ protected:
     //! Necessary for reporting tables.
     CBotInstr* m_next3b;
 
-    //! Counter of nested loops, to determine the break and continue valid.
-    static int m_LoopLvl;
     friend class CBotDefClass;
     friend class CBotDefInt;
     friend class CBotListArray;
-
-private:
-    //! List of labels used.
-    static std::vector<std::string> m_labelLvl;
 };
 
 } // namespace CBot
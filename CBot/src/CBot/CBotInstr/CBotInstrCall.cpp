@@ -21,9 +21,12 @@
 #include "CBot/CBotInstr/CBotExprRetVar.h"
 #include "CBot/CBotInstr/CBotInstrUtils.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 
 #include "CBot/CBotCStack.h"
+#include "CBot/CBotExternalCall.h"
+#include "CBot/CBotProgram.h"
 
 #include "CBot/CBotVar/CBotVar.h"
 
@@ -38,6 +41,8 @@ CBotInstrCall::CBotInstrCall()
     m_parameters = nullptr;
     m_exprRetVar = nullptr;
     m_nFuncIdent = 0;
+    m_externalCall = nullptr;
+    m_externalRevision = -1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -84,6 +89,7 @@ CBotInstr* CBotInstrCall::Compile(CBotToken* &p, CBotCStack* pStack)
         }
 
         pStack->DeleteNext();
+        inst->BindExternalCall();
         if ( inst->m_typRes.GetType() > 0 )
         {
             CBotVar* pRes = CBotVar::Create("", inst->m_typRes);
@@ -153,7 +159,7 @@ bool CBotInstrCall::Execute(CBotStack* &pj)
     CBotStack* pile2 = pile->AddStack();
     if ( pile2->IfStep() ) return false;
 
-    if ( !pile2->ExecuteCall(m_nFuncIdent, GetToken(), ppVars, m_typRes)) return false; // interrupt
+    if ( !Call(pile2, ppVars) ) return false;                  // interrupt
 
     if (m_exprRetVar != nullptr) // func().member
     {
@@ -210,7 +216,58 @@ void CBotInstrCall::RestoreState(CBotStack* &pj, bool bMain)
     CBotStack* pile2 = pile->RestoreStack();
     if ( pile2 == nullptr ) return;
 
-    pile2->RestoreCall(m_nFuncIdent, GetToken(), ppVars);
+    RestoreCall(pile2, ppVars);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotInstrCall::Call(CBotStack* pile, CBotVar** ppVars)
+{
+    CBotExternalCall* external = GetExternalCall(pile->IsIsolated());
+    if ( external != nullptr ) return pile->ExecuteCall(external, GetToken(), ppVars, m_typRes);
+    return pile->ExecuteCall(m_nFuncIdent, GetToken(), ppVars, m_typRes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotInstrCall::RestoreCall(CBotStack* pile, CBotVar** ppVars)
+{
+    CBotExternalCall* external = GetExternalCall(pile->IsIsolated());
+    if ( external != nullptr ) pile->RestoreCall(external);
+    else pile->RestoreCall(m_nFuncIdent, GetToken(), ppVars);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotInstrCall::GenerateByteCode(CBotByteCode& code)
+{
+    if ( m_exprRetVar != nullptr ) return false;    // func().member
+
+    // the parameters are kept on the operand stack until the call
+    int count = 0;
+    for ( CBotInstr* p = m_parameters; p != nullptr; p = p->GetNext() )
+    {
+        if ( !p->GenerateByteCode(code) ) return false;
+        count++;
+    }
+    return code.AddCall(this, count, static_cast<CBotType>(m_typRes.GetType()), GetExternalCall(false) != nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotInstrCall::BindExternalCall()
+{
+    if ( m_nFuncIdent != 0 ) return;                // a function of the program
+
+    m_externalCall = CBotProgram::GetExternalCalls()->Find(m_token.GetString());
+    m_externalRevision = CBotExternalCallList::GetRevision();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotExternalCall* CBotInstrCall::GetExternalCall(bool isolated)
+{
+    if ( m_externalRevision != CBotExternalCallList::GetRevision() )
+    {
+        if ( isolated ) return nullptr;
+        BindExternalCall();
+    }
+    return m_externalCall;
 }
 
 std::string CBotInstrCall::GetDebugData()
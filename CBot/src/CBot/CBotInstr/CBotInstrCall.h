@@ -24,6 +24,8 @@
 namespace CBot
 {
 
+class CBotExternalCall;
+
 /**
  * \brief A call to a function - func()
  *
@@ -57,18 +59,55 @@ public:
      */
     void RestoreState(CBotStack* &pj, bool bMain) override;
 
+    /*!
+     * \brief Call Calls the function once the parameters are evaluated.
+     * \param pile Stack level of the call
+     * \param ppVars Parameters, ending with nullptr
+     * \return false if interrupted or on error
+     */
+    bool Call(CBotStack* pile, CBotVar** ppVars);
+
+    /*!
+     * \brief RestoreCall Restores the state of the function called.
+     * \param pile Stack level of the call
+     * \param ppVars Parameters, ending with nullptr
+     */
+    void RestoreCall(CBotStack* pile, CBotVar** ppVars);
+
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotInstrCall"; }
     virtual std::string GetDebugData() override;
     virtual std::map<std::string, CBotInstr*> GetDebugLinks() override;
 
 private:
+    /*!
+     * \brief Finds the external function called here, when compiling and each time the
+     * registered functions change, see GetExternalCall()
+     */
+    void BindExternalCall();
+
+    /*!
+     * \brief Returns the external function bound to this call, binding it again if the
+     * registered functions changed since
+     * \param isolated Called by CBotProgram::RunIsolated(): the instruction may be shared by
+     * programs running at once, so it isn't changed
+     * \return The function, or nullptr if this calls a function of the program or if it
+     * can't be bound again, the call is then searched by name
+     */
+    CBotExternalCall* GetExternalCall(bool isolated);
+
     //! The parameters to be evaluated.
     CBotInstr* m_parameters;
     //! Complete type of the result.
     CBotTypResult m_typRes;
     //! Id of a function.
     long m_nFuncIdent;
+    //! External function bound to this call when compiling.
+    CBotExternalCall* m_externalCall;
+    //! Revision of the external functions when m_externalCall was found, see CBotExternalCallList::GetRevision().
+    long m_externalRevision;
 
     //! Instruction to return a member of the returned object.
     CBotInstr* m_exprRetVar;
@@ -23,6 +23,7 @@
 #include "CBot/CBotInstr/CBotIndexExpr.h"
 #include "CBot/CBotInstr/CBotExpression.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 #include "CBot/CBotClass.h"
@@ -36,6 +37,8 @@ namespace CBot
 CBotLeftExpr::CBotLeftExpr()
 {
     m_nIdent = 0;
+    m_nSlot = -1;
+    m_varType = CBotTypVoid;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -62,6 +65,8 @@ CBotLeftExpr* CBotLeftExpr::Compile(CBotToken* &p, CBotCStack* pStack)
         if (nullptr != (var = pStk->FindVar(p)))   // seek if known variable
         {
             inst->m_nIdent = var->GetUniqNum();
+            inst->m_varType = var->GetType();
+            if (inst->m_nIdent >= 9000) inst->m_nSlot = pStk->GetVarSlot(var);
             if (inst->m_nIdent > 0 && inst->m_nIdent < 9000)
             {
                 if (CBotFieldExpr::CheckProtectionError(pStk, nullptr, var, true))
@@ -220,7 +225,7 @@ bool CBotLeftExpr::ExecuteVar(CBotVar* &pVar, CBotStack* &pile, CBotToken* prevT
 {
     pile = pile->AddStack(this);
 
-    pVar = pile->FindVar(m_nIdent, false);
+    pVar = pile->FindVar(m_nIdent, m_nSlot, false);
     if (pVar == nullptr)
     {
         assert(false);
@@ -246,6 +251,14 @@ void CBotLeftExpr::RestoreStateVar(CBotStack* &pile, bool bMain)
          m_next3->RestoreStateVar(pile, bMain);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotLeftExpr::GenerateAssignment(CBotByteCode& code, int op, CBotInstr* value, CBotToken* token)
+{
+    // only plain local variables, no fields or array elements
+    if (m_next3 != nullptr || m_nIdent <= 0) return false;
+    return code.AddAssignment(m_nIdent, m_nSlot, m_varType, op, value, token);
+}
+
 std::string CBotLeftExpr::GetDebugData()
 {
     std::stringstream ss;
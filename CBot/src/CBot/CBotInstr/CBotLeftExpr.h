@@ -90,12 +90,27 @@ public:
      */
     void RestoreStateVar(CBotStack* &pile, bool bMain) override;
 
+    /*!
+     * \brief GenerateAssignment Appends the operations of an assignment to a
+     * local variable, see CBotByteCode::AddAssignment().
+     * \param code
+     * \param op Assignment operator
+     * \param value Right operand
+     * \param token Token of the operator
+     * \return false if this is not a plain local variable
+     */
+    bool GenerateAssignment(CBotByteCode& code, int op, CBotInstr* value, CBotToken* token);
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotLeftExpr"; }
     virtual std::string GetDebugData() override;
 
 private:
     long m_nIdent;
+    //! Slot of a local variable, see CBotStack::FindVar(long, int, bool)
+    int m_nSlot;
+    //! Type of the variable, without its fields and indexes
+    CBotType m_varType;
 };
 
 } // namespace CBot
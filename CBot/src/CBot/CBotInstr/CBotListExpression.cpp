@@ -24,6 +24,7 @@
 #include "CBot/CBotInstr/CBotExpression.h"
 #include "CBot/CBotInstr/CBotListExpression.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -127,6 +128,12 @@ void CBotListExpression::RestoreState(CBotStack* &pj, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotListExpression::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddList(this, m_expr);
+}
+
 std::map<std::string, CBotInstr*> CBotListExpression::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
@@ -20,6 +20,7 @@
 #include "CBot/CBotInstr/CBotListInstr.h"
 #include "CBot/CBotInstr/CBotBlock.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -44,6 +45,7 @@ CBotInstr* CBotListInstr::Compile(CBotToken* &p, CBotCStack* pStack, bool bLocal
     CBotCStack* pStk = pStack->TokenStack(p, bLocal);        // variables are local
 
     CBotListInstr* inst = new CBotListInstr();
+    int jump = 0;                                       // return, throw, break or continue met
 
     while (true)
     {
@@ -67,8 +69,31 @@ CBotInstr* CBotListInstr::Compile(CBotToken* &p, CBotCStack* pStack, bool bLocal
             return pStack->Return(nullptr, pStk);
         }
 
+        if (jump != 0 && i != nullptr && pStk->IsOptimized())
+        {
+            // can't be reached, only compiled for the errors
+            // after break or continue, a return is kept for CBotFunction::HasReturn()
+            if (jump == ID_RETURN || jump == ID_THROW || !i->HasReturn())
+            {
+                delete i;
+                continue;
+            }
+        }
+
         if (inst->m_instr == nullptr) inst->m_instr = i;
         else inst->m_instr->AddNext(i);                            // added a result
+
+        if (jump == 0 && i != nullptr)
+        {
+            switch (i->GetTokenType())
+            {
+            case ID_RETURN:
+            case ID_THROW:
+            case ID_BREAK:
+            case ID_CONTINUE:
+                jump = i->GetTokenType();
+            }
+        }
     }
     return pStack->Return(inst, pStk);
 }
@@ -91,7 +116,7 @@ bool CBotListInstr::Execute(CBotStack* &pj)
         if (!p->Execute(pile)) return false;
         p = p->GetNext();
         if (p == nullptr) break;
-        (void)pile->IncState();                                  // ready for next
+        if (!pile->IncState() && !pile->IsOk()) return false;    // ready for next
     }
 
     return pj->Return(pile);
@@ -123,6 +148,12 @@ bool CBotListInstr::HasReturn()
     return CBotInstr::HasReturn(); // check next block or instruction
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotListInstr::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddBlock(this, m_instr);
+}
+
 std::map<std::string, CBotInstr*> CBotListInstr::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
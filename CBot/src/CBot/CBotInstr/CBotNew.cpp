@@ -142,6 +142,7 @@ bool CBotNew::Execute(CBotStack* &pj)
     }
 
     if (pile->IfStep()) return false;
+    if (pile->StopIsolated()) return false;     // the fields and the constructor may run any code
 
     CBotStack*    pile1 = pj->AddStack2();  //secondary stack
 
@@ -20,6 +20,7 @@
 #include "CBot/CBotInstr/CBotPostIncExpr.h"
 #include "CBot/CBotInstr/CBotExprVar.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 
 #include "CBot/CBotVar/CBotVar.h"
@@ -80,6 +81,15 @@ void CBotPostIncExpr::RestoreState(CBotStack* &pj, bool bMain)
     if (pile1 != nullptr) pile1->RestoreStack(this);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotPostIncExpr::GenerateByteCode(CBotByteCode& code)
+{
+    // only plain local variables, no fields or array elements
+    CBotExprVar* var = static_cast<CBotExprVar*>(m_instr);
+    if (var->m_next3 != nullptr || var->m_nIdent <= 0) return false;
+    return code.AddIncrement(var->m_nIdent, var->m_nSlot, var->m_varType, GetTokenType(), true, &m_token);
+}
+
 std::map<std::string, CBotInstr*> CBotPostIncExpr::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
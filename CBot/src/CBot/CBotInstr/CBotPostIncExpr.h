@@ -49,6 +49,8 @@ public:
      */
     void RestoreState(CBotStack* &pj, bool bMain) override;
 
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotPostIncExpr"; }
     virtual std::map<std::string, CBotInstr*> GetDebugLinks() override;
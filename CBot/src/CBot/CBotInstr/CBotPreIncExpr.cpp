@@ -20,6 +20,7 @@
 #include "CBot/CBotInstr/CBotPreIncExpr.h"
 #include "CBot/CBotInstr/CBotExprVar.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 
 #include "CBot/CBotVar/CBotVar.h"
@@ -87,6 +88,15 @@ void CBotPreIncExpr::RestoreState(CBotStack* &pj, bool bMain)
     m_instr->RestoreState(pile, bMain);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotPreIncExpr::GenerateByteCode(CBotByteCode& code)
+{
+    // only plain local variables, no fields or array elements
+    CBotExprVar* var = static_cast<CBotExprVar*>(m_instr);
+    if (var->m_next3 != nullptr || var->m_nIdent <= 0) return false;
+    return code.AddIncrement(var->m_nIdent, var->m_nSlot, var->m_varType, GetTokenType(), false, &m_token);
+}
+
 std::map<std::string, CBotInstr*> CBotPreIncExpr::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
@@ -23,6 +23,7 @@
 
 #include "CBot/CBotInstr/CBotExpression.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -116,6 +117,12 @@ bool CBotReturn::HasReturn()
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotReturn::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddReturn(m_instr);
+}
+
 std::map<std::string, CBotInstr*> CBotReturn::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
@@ -20,6 +20,7 @@
 #include "CBot/CBotInstr/CBotThrow.h"
 #include "CBot/CBotInstr/CBotExpression.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -97,6 +98,12 @@ void CBotThrow::RestoreState(CBotStack* &pj, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotThrow::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddThrow(m_value, &m_token);
+}
+
 std::map<std::string, CBotInstr*> CBotThrow::GetDebugLinks()
 {
     auto links = CBotInstr::GetDebugLinks();
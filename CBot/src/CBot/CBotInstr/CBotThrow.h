@@ -55,6 +55,9 @@ public:
      */
     void RestoreState(CBotStack* &pj, bool bMain) override;
 
+
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotThrow"; }
     virtual std::map<std::string, CBotInstr*> GetDebugLinks() override;
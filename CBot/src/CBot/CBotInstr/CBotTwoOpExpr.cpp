@@ -27,12 +27,15 @@
 
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
+#include "CBot/CBotProgram.h"
 
 #include "CBot/CBotVar/CBotVar.h"
+#include "CBot/CBotVar/CBotVarString.h"
 
 #include <cassert>
 #include <cmath>
 #include <algorithm>
+#include <type_traits>
 
 namespace CBot
 {
@@ -42,6 +45,9 @@ CBotTwoOpExpr::CBotTwoOpExpr()
 {
     m_leftop    = nullptr;
     m_rightop   = nullptr;
+    m_unboxedType = CBotTypVoid;
+    m_leftType  = CBotTypVoid;
+    m_rightType = CBotTypVoid;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -253,6 +259,7 @@ CBotInstr* CBotTwoOpExpr::Compile(CBotToken* &p, CBotCStack* pStack, int* pOpera
             {
                 // ok so, saves the operand in the object
                 inst->m_leftop = left;
+                inst->SelectUnboxed(type1, type2);
 
                 // special for evaluation of the operations of the same level from left to right
                 while ( IsInList(p->GetType(), pOperations, typeMask) ) // same operation(s) follows?
@@ -260,7 +267,7 @@ CBotInstr* CBotTwoOpExpr::Compile(CBotToken* &p, CBotCStack* pStack, int* pOpera
                     typeOp = p->GetType();
                     CBotTwoOpExpr* i = new CBotTwoOpExpr();             // element for operation
                     i->SetToken(p);                                     // stores the operation
-                    i->m_leftop = inst;                                 // left operand
+                    i->m_leftop = pStk->IsOptimized() ? Optimize(inst) : inst;  // left operand
                     type1 = TypeRes;
 
                     p = p->GetNext();                                       // advance after
@@ -273,6 +280,7 @@ CBotInstr* CBotTwoOpExpr::Compile(CBotToken* &p, CBotCStack* pStack, int* pOpera
                         delete i;
                         return pStack->Return(nullptr, pStk);
                     }
+                    i->SelectUnboxed(type1, type2);
 
                     if ( TypeRes != CBotTypString )                     // keep string conversion
                         TypeRes = std::max(type1.GetType(), type2.GetType());
@@ -284,8 +292,11 @@ CBotInstr* CBotTwoOpExpr::Compile(CBotToken* &p, CBotCStack* pStack, int* pOpera
                 // is a variable on the stack for the type of result
                 pStk->SetVar(CBotVar::Create("", t));
 
+                CBotInstr* result = pStk->IsOptimized() ? Optimize(inst) : inst;
+                if (result == inst) inst->CompileByteCode(pStk);
+
                 // and returns the requested object
-                return pStack->Return(inst, pStk);
+                return pStack->Return(result, pStk);
             }
             pStk->SetError(CBotErrBadType2, &inst->m_token);
         }
@@ -330,6 +341,12 @@ bool CBotTwoOpExpr::Execute(CBotStack* &pStack)
 {
     CBotStack* pStk1 = pStack->AddStack(this);  // adds an item to the stack
                                                 // or return in case of recovery
+    if ( m_byteCode != nullptr )                // the whole expression is evaluated at once
+    {
+        if ( pStk1->IfStep() ) return false;
+        m_byteCode->Execute(pStk1);
+        return pStack->Return(pStk1);
+    }
 //  if ( pStk1 == EOX ) return true;
 
     // according to recovery, it may be in one of two states
@@ -341,14 +358,14 @@ bool CBotTwoOpExpr::Execute(CBotStack* &pStack)
         // for OR and AND logic does not evaluate the second expression if not necessary
         if ( (GetTokenType() == ID_LOG_AND || GetTokenType() == ID_TXT_AND ) && pStk1->GetVal() == false )
         {
-            CBotVar*    res = CBotVar::Create("", CBotTypBoolean);
+            CBotVar*    res = pStk1->CreateVar(CBotTypBoolean);
             res->SetValInt(false);
             pStk1->SetVar(res);
             return pStack->Return(pStk1);               // transmits the result
         }
         if ( (GetTokenType() == ID_LOG_OR||GetTokenType() == ID_TXT_OR) && pStk1->GetVal() == true )
         {
-            CBotVar*    res = CBotVar::Create("", CBotTypBoolean);
+            CBotVar*    res = pStk1->CreateVar(CBotTypBoolean);
             res->SetValInt(true);
             pStk1->SetVar(res);
             return pStack->Return(pStk1);               // transmits the result
@@ -380,6 +397,24 @@ bool CBotTwoOpExpr::Execute(CBotStack* &pStack)
     CBotStack* pStk3 = pStk2->AddStack(this);               // adds an item to the stack
     if ( pStk3->IfStep() ) return false;                    // shows the operation if step by step
 
+    // numbers of the types expected when compiling are computed directly
+    if ( m_unboxedType != CBotTypVoid &&
+         type1.GetType() == m_leftType && pStk1->GetVar()->GetInit() == CBotVar::InitType::DEF &&
+         type2.GetType() == m_rightType && pStk2->GetVar()->GetInit() == CBotVar::InitType::DEF )
+    {
+        CBotStack* pResult = nullptr;
+        switch ( m_unboxedType )
+        {
+        case CBotTypInt:    pResult = ExecuteUnboxed<int>(pStack, pStk1, pStk2);    break;
+        case CBotTypLong:   pResult = ExecuteUnboxed<long>(pStack, pStk1, pStk2);   break;
+        case CBotTypFloat:  pResult = ExecuteUnboxed<float>(pStack, pStk1, pStk2);  break;
+        case CBotTypDouble: pResult = ExecuteUnboxed<double>(pStack, pStk1, pStk2); break;
+        default: assert(0);
+        }
+        if ( pResult == pStack ) return pStack->ReturnInPlace();
+        if ( pResult != nullptr ) return pStack->Return(pResult);
+    }
+
     // creates a temporary variable to put the result
     // what kind of result?
     int TypeRes = std::max(type1.GetType(), type2.GetType());
@@ -412,8 +447,24 @@ bool CBotTwoOpExpr::Execute(CBotStack* &pStack)
         }
     }
 
+    // the conversion to string reads the objects
+    if ( TypeRes == CBotTypString &&
+        (pStk3->StopIsolated(pStk1->GetVar()) || pStk3->StopIsolated(pStk2->GetVar())) ) return false;
+
+    // a string built by the left operand grows in place (a + b + c...), nan is an error as below
+    if ( GetTokenType() == ID_ADD && type1.Eq(CBotTypString) &&
+         pStk1->GetVar()->GetInit() == CBotVar::InitType::DEF && !VarIsNAN(pStk2->GetVar()) )
+    {
+        CBotVarString* result = static_cast<CBotVarString*>(pStk1->GetVar());
+        pStk2->GetVar()->Update(nullptr);
+        result->Append(pStk2->GetVar());
+        pStk1->ChargeLength(result->GetString().length());
+        return pStack->Return(pStk1);
+    }
+
     // creates a variable for the result
-    CBotVar*    result = CBotVar::Create("", TypeRes);
+    CBotVar*    result = TypeRes <= CBotTypBoolean ? pStk2->CreateVar(static_cast<CBotType>(TypeRes))
+                                                   : CBotVar::Create("", TypeRes);
 
     // get left and right operands
     CBotVar*    left  = pStk1->GetVar();
@@ -439,6 +490,7 @@ bool CBotTwoOpExpr::Execute(CBotStack* &pStack)
 
     if ( TypeRes == CBotTypPointer ) TypeRes = CBotTypNullPointer;
     if ( TypeRes == CBotTypClass ) temp = CBotVar::Create("", CBotTypResult(CBotTypIntrinsic, type1.GetClass() ) );
+    else if ( TypeRes <= CBotTypBoolean ) temp = pStk2->CreateVar(static_cast<CBotType>(TypeRes));
     else                           temp = CBotVar::Create("", TypeRes );
 
     CBotError err = CBotNoErr;
@@ -517,7 +569,9 @@ bool CBotTwoOpExpr::Execute(CBotStack* &pStack)
     default:
         assert(0);
     }
-    delete temp;
+    pStk2->ReleaseVar(temp);
+
+    if ( result->GetType() == CBotTypString ) pStk2->ChargeLength(static_cast<CBotVarString*>(result)->GetString().length());
 
     pStk2->SetVar(result);                      // puts the result on the stack
     if ( err ) pStk2->SetError(err, &m_token);  // and the possible error (division by zero)
@@ -525,12 +579,147 @@ bool CBotTwoOpExpr::Execute(CBotStack* &pStack)
     return pStack->Return(pStk2);               // transmits the result
 }
 
+////////////////////////////////////////////////////////////////////////////////
+static bool IsUnboxed(CBotType type)
+{
+    return type == CBotTypInt || type == CBotTypLong || type == CBotTypFloat || type == CBotTypDouble;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotTwoOpExpr::SelectUnboxed(const CBotTypResult& type1, const CBotTypResult& type2)
+{
+    CBotType left  = static_cast<CBotType>(type1.GetType());
+    CBotType right = static_cast<CBotType>(type2.GetType());
+    m_unboxedType = CBotTypVoid;
+    if ( !IsUnboxed(left) || !IsUnboxed(right) ) return;
+
+    // same type as the temporary variable created by Execute()
+    CBotType type = std::max(left, right);
+    switch ( GetTokenType() )
+    {
+    case ID_DIV:
+        if ( type == CBotTypFloat && (left == CBotTypLong || right == CBotTypLong) ) type = CBotTypDouble;
+        break;
+    case ID_ADD:
+    case ID_SUB:
+    case ID_MUL:
+    case ID_POWER:
+    case ID_MODULO:
+    case ID_LO:
+    case ID_HI:
+    case ID_LS:
+    case ID_HS:
+    case ID_EQ:
+    case ID_NE:
+        break;
+    case ID_AND:
+    case ID_OR:
+    case ID_XOR:
+        if ( type == CBotTypFloat || type == CBotTypDouble ) return;
+        break;
+    default:
+        return;
+    }
+
+    m_unboxedType = type;
+    m_leftType    = left;
+    m_rightType   = right;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+CBotStack* CBotTwoOpExpr::ExecuteUnboxed(CBotStack* pStack, CBotStack* pStk1, CBotStack* pStk2)
+{
+    // see CBotVarValue.h for the implementation of each operator by the variables
+    T   l = static_cast<T>(*pStk1->GetVar());
+    T   r = static_cast<T>(*pStk2->GetVar());
+    T   value = 0;
+    int test = -1;                                          // result of a comparison
+
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        if ( std::isnan(l) || std::isnan(r) ) return nullptr;   // see IsNan()
+    }
+
+    switch ( GetTokenType() )
+    {
+    case ID_ADD:
+        value = WrappingAdd(l, r);
+        break;
+    case ID_SUB:
+        value = WrappingSub(l, r);
+        break;
+    case ID_MUL:
+        value = WrappingMul(l, r);
+        break;
+    case ID_POWER:
+        value = static_cast<T>(pow(l, r));
+        break;
+    case ID_DIV:
+        if ( r == static_cast<T>(0) ) return nullptr;       // the error is raised by the variables
+        value = WrappingDiv(l, r);
+        break;
+    case ID_MODULO:
+        if ( r == static_cast<T>(0) ) return nullptr;
+        if constexpr (std::is_integral_v<T>) value = WrappingMod(l, r);
+        else                                 value = static_cast<T>(fmod(l, r));
+        break;
+    case ID_LO:
+        test = l < r;
+        break;
+    case ID_HI:
+        test = l > r;
+        break;
+    case ID_LS:
+        test = l <= r;
+        break;
+    case ID_HS:
+        test = l >= r;
+        break;
+    case ID_EQ:
+        test = l == r;
+        break;
+    case ID_NE:
+        test = l != r;
+        break;
+    default:
+        if constexpr (std::is_integral_v<T>)
+        {
+            switch ( GetTokenType() )
+            {
+            case ID_AND: value = l & r; break;
+            case ID_OR:  value = l | r; break;
+            case ID_XOR: value = l ^ r; break;
+            default: assert(0);
+            }
+        }
+        else assert(0);
+    }
+
+    // the result takes the place of an operand, or of the previous result on this stack
+    CBotType typeRes = test < 0 ? m_unboxedType : CBotTypBoolean;
+    CBotStack* pResult;
+    if ( pStk1->GetVar()->GetType() == typeRes ) pResult = pStk1;
+    else if ( pStk2->GetVar()->GetType() == typeRes ) pResult = pStk2;
+    else if ( pStack->GetVar() != nullptr && pStack->GetVar()->GetType() == typeRes ) pResult = pStack;
+    else
+    {
+        pStk2->SetVar(pStk2->CreateVar(typeRes));
+        pResult = pStk2;
+    }
+
+    if ( test < 0 ) *pResult->GetVar() = value;
+    else pResult->GetVar()->SetValInt(test);
+    return pResult;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void CBotTwoOpExpr::RestoreState(CBotStack* &pStack, bool bMain)
 {
     if ( !bMain ) return;
     CBotStack* pStk1 = pStack->RestoreStack(this);  // adds an item to the stack
     if ( pStk1 == nullptr ) return;
+    if ( m_byteCode != nullptr ) return;            // nothing inside to restore
 
     // according to recovery, it may be in one of two states
 
@@ -551,6 +740,63 @@ void CBotTwoOpExpr::RestoreState(CBotStack* &pStack, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotTwoOpExpr::GenerateByteCode(CBotByteCode& code)
+{
+    if ( !m_leftop->GenerateByteCode(code) ) return false;
+    int shortCircuit = code.AddShortCircuit(GetTokenType());
+    if ( !m_rightop->GenerateByteCode(code) ) return false;
+    if ( !code.AddOperation(GetTokenType(), &m_token, shortCircuit) ) return false;
+    code.AddSubsumed(&m_byteCode);      // replaced by the code of the parent
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotInstr* CBotTwoOpExpr::Optimize(CBotTwoOpExpr* inst)
+{
+    CBotInstr* folded = CBotByteCode::Fold(inst);
+    if (folded != inst) return folded;                  // operation on constants
+
+    bool isAnd;
+    switch (inst->GetTokenType())
+    {
+    case ID_LOG_AND:
+    case ID_TXT_AND:
+        isAnd = true;
+        break;
+    case ID_LOG_OR:
+    case ID_TXT_OR:
+        isAnd = false;
+        break;
+    default:
+        return inst;
+    }
+
+    // true && b and false || b are b, false && b and true || b are a (b is not evaluated)
+    // a && true and a || false are a
+    CBotInstr* result = nullptr;
+    bool value;
+    if (CBotByteCode::IsConstant(inst->m_leftop, value))
+        result = (value == isAnd) ? inst->m_rightop : inst->m_leftop;
+    else if (CBotByteCode::IsConstant(inst->m_rightop, value) && value == isAnd)
+        result = inst->m_leftop;
+
+    if (result == nullptr) return inst;
+
+    if (result == inst->m_leftop) inst->m_leftop = nullptr;
+    else inst->m_rightop = nullptr;
+    delete inst;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotTwoOpExpr::CompileByteCode(CBotCStack* pStack)
+{
+    CBotProgram* prog = pStack->GetProgram();
+    if ( prog == nullptr || prog->GetEngine() != CBotEngine::BYTECODE ) return;
+    m_byteCode = CBotByteCode::Generate(this);
+}
+
 std::string CBotTwoOpExpr::GetDebugData()
 {
     return m_token.GetString();
@@ -21,6 +21,10 @@
 
 #include "CBot/CBotInstr/CBotInstr.h"
 
+#include "CBot/CBotByteCode.h"
+
+#include <memory>
+
 namespace CBot
 {
 
@@ -81,6 +85,8 @@ public:
      */
     void RestoreState(CBotStack* &pj, bool bMain) override;
 
+    bool GenerateByteCode(CBotByteCode& code) override;
+
 protected:
     virtual const std::string GetDebugName() override { return "CBotTwoOpExpr"; }
     virtual std::string GetDebugData() override;
@@ -91,6 +97,46 @@ private:
     CBotInstr* m_leftop;
     //! Right element
     CBotInstr* m_rightop;
+    //! Compiled form of the whole expression, if the program uses CBotEngine::BYTECODE
+    std::unique_ptr<CBotByteCode> m_byteCode;
+    //! Type the operation is computed in without boxing the operands, CBotTypVoid if it can't be
+    CBotType m_unboxedType;
+    //! Types of the operands known when compiling, checked before using the unboxed operation
+    CBotType m_leftType;
+    CBotType m_rightType;
+
+    /*!
+     * \brief Lowers the expression to bytecode when the program asks for it
+     * \param pStack
+     */
+    void CompileByteCode(CBotCStack* pStack);
+
+    /*!
+     * \brief Selects the unboxed operation if both operands are numbers (int, long, float, double)
+     * \param type1 Type of the left operand
+     * \param type2 Type of the right operand
+     */
+    void SelectUnboxed(const CBotTypResult& type1, const CBotTypResult& type2);
+
+    /*!
+     * \brief Performs the operation on the values of the operands, stores the result in a variable
+     * already on the stack instead of creating one
+     * \param pStack Stack of this instruction
+     * \param pStk1 Stack of the left operand
+     * \param pStk2 Stack of the right operand
+     * \return Stack holding the result, or nullptr if the operation must be done by the variables
+     * (division by zero)
+     */
+    template <typename T>
+    CBotStack* ExecuteUnboxed(CBotStack* pStack, CBotStack* pStk1, CBotStack* pStk2);
+
+    /*!
+     * \brief Evaluates the operation if its operands are constants, or simplifies it
+     * if it is a logical operation with a constant operand (true && a is a, ...)
+     * \param inst Operation, deleted if it is replaced
+     * \return The replacement, or inst itself
+     */
+    static CBotInstr* Optimize(CBotTwoOpExpr* inst);
 };
 
 } // namespace CBot
@@ -21,6 +21,7 @@
 #include "CBot/CBotInstr/CBotBlock.h"
 #include "CBot/CBotInstr/CBotCondition.h"
 
+#include "CBot/CBotByteCode.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 
@@ -148,6 +149,12 @@ void CBotWhile::RestoreState(CBotStack* &pj, bool bMain)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotWhile::GenerateByteCode(CBotByteCode& code)
+{
+    return code.AddWhile(this, m_condition, m_block, m_label);
+}
+
 std::string CBotWhile::GetDebugData()
 {
     return !m_label.empty() ? "m_label = "+m_label : "";
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#include "CBot/CBotMemoryAccount.h"
+
+namespace CBot
+{
+
+//! Account of the program running in each thread, charged by constructors which have no stack to find it on
+static thread_local CBotMemoryAccount* currentAccount = nullptr;
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotMemoryAccount::Charge(long bytes)
+{
+    long used = m_used.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    long peak = m_peak.load(std::memory_order_relaxed);
+    while (used > peak && !m_peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) ;
+
+    long limit = m_limit.load(std::memory_order_relaxed);
+    if (limit > 0 && used > limit) m_exceeded.store(true, std::memory_order_relaxed);
+}
+
+void CBotMemoryAccount::Release(long bytes)
+{
+    m_used.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+long CBotMemoryAccount::GetUsed() const
+{
+    return m_used.load(std::memory_order_relaxed);
+}
+
+long CBotMemoryAccount::GetPeak() const
+{
+    return m_peak.load(std::memory_order_relaxed);
+}
+
+void CBotMemoryAccount::SetLimit(long bytes)
+{
+    m_limit.store(bytes, std::memory_order_relaxed);
+    m_exceeded.store(false, std::memory_order_relaxed);
+}
+
+long CBotMemoryAccount::GetLimit() const
+{
+    return m_limit.load(std::memory_order_relaxed);
+}
+
+bool CBotMemoryAccount::TakeExceeded()
+{
+    // most of the time it's false, don't write it then
+    return m_exceeded.load(std::memory_order_relaxed) && m_exceeded.exchange(false, std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotMemoryAccount* CBotMemoryAccount::GetCurrent()
+{
+    return currentAccount;
+}
+
+CBotMemoryAccount::Scope::Scope(CBotMemoryAccount* account) : m_previous(currentAccount)
+{
+    currentAccount = account;
+}
+
+CBotMemoryAccount::Scope::~Scope()
+{
+    currentAccount = m_previous;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotMemoryCharge::CBotMemoryCharge()
+{
+    if (currentAccount != nullptr) m_account = currentAccount->shared_from_this();
+}
+
+CBotMemoryCharge::~CBotMemoryCharge()
+{
+    if (m_account != nullptr) m_account->Release(m_bytes);
+}
+
+void CBotMemoryCharge::Add(long bytes)
+{
+    if (m_account == nullptr) return;
+    m_account->Charge(bytes);
+    m_bytes += bytes;
+}
+
+void CBotMemoryCharge::Set(long bytes)
+{
+    if (m_account == nullptr) return;
+    if (bytes > m_bytes) m_account->Charge(bytes - m_bytes);
+    else m_account->Release(m_bytes - bytes);
+    m_bytes = bytes;
+}
+
+} // namespace CBot
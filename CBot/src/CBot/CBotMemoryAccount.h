@@ -0,0 +1,140 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace CBot
+{
+
+/**
+ * \brief Memory used by a program, see CBotProgram::GetMemoryUsed() and CBotProgram::SetMemoryLimit()
+ *
+ * The class instances, arrays and long strings are charged (with CBotMemoryCharge) to the account
+ * current when they are created, which is the one of the program running in the calling thread.
+ * They stay charged to it until they are freed, even if another program holds them by then.
+ *
+ * The sizes are estimates: a variable counts for the size of its object and of a link to it,
+ * a string for the capacity of its buffer.
+ *
+ * Several programs may run at once (see CBotProgram::RunIsolated()), the counters are atomic.
+ */
+class CBotMemoryAccount : public std::enable_shared_from_this<CBotMemoryAccount>
+{
+public:
+    CBotMemoryAccount() = default;
+    CBotMemoryAccount(const CBotMemoryAccount&) = delete;
+    CBotMemoryAccount& operator=(const CBotMemoryAccount&) = delete;
+
+    /**
+     * \brief Adds memory to the account, notes if it goes over the limit
+     * \param bytes Memory allocated, in bytes
+     */
+    void Charge(long bytes);
+
+    /**
+     * \brief Removes memory from the account
+     * \param bytes Memory freed, in bytes
+     */
+    void Release(long bytes);
+
+    /**
+     * \brief Returns the memory charged and not released yet, in bytes
+     */
+    long GetUsed() const;
+
+    /**
+     * \brief Returns the highest memory charged at once, in bytes
+     */
+    long GetPeak() const;
+
+    /**
+     * \brief Changes the limit checked by Charge()
+     * \param bytes Limit in bytes, 0 for none
+     */
+    void SetLimit(long bytes);
+
+    /**
+     * \brief Returns the limit given to SetLimit()
+     */
+    long GetLimit() const;
+
+    /**
+     * \brief Tells if the limit was exceeded since the last call, see CBotStack::SetState()
+     */
+    bool TakeExceeded();
+
+    /**
+     * \brief Returns the account of the calling thread, nullptr if no program runs in it
+     */
+    static CBotMemoryAccount* GetCurrent();
+
+    /**
+     * \brief Makes an account current until the end of the scope
+     */
+    class Scope
+    {
+    public:
+        Scope(CBotMemoryAccount* account);
+        ~Scope();
+
+    private:
+        CBotMemoryAccount* m_previous;
+    };
+
+private:
+    std::atomic<long> m_used{0};
+    std::atomic<long> m_peak{0};
+    std::atomic<long> m_limit{0};
+    std::atomic<bool> m_exceeded{false};
+};
+
+/**
+ * \brief Memory of an object, charged to the account current when it was created
+ *
+ * It is released from the account when the object is destroyed. Without a current account, nothing is charged.
+ */
+class CBotMemoryCharge
+{
+public:
+    CBotMemoryCharge();
+    ~CBotMemoryCharge();
+    CBotMemoryCharge(const CBotMemoryCharge&) = delete;
+    CBotMemoryCharge& operator=(const CBotMemoryCharge&) = delete;
+
+    /**
+     * \brief Charges more memory to the account
+     * \param bytes Memory allocated, in bytes
+     */
+    void Add(long bytes);
+
+    /**
+     * \brief Changes the memory charged to the account
+     * \param bytes Memory used by the object now, in bytes
+     */
+    void Set(long bytes);
+
+private:
+    std::shared_ptr<CBotMemoryAccount> m_account;
+    long m_bytes = 0;
+};
+
+} // namespace CBot
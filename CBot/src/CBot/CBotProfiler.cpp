@@ -0,0 +1,134 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#include "CBot/CBotProfiler.h"
+
+#include "CBot/CBotStack.h"
+#include "CBot/CBotToken.h"
+
+#include "CBot/CBotInstr/CBotFunction.h"
+
+namespace CBot
+{
+
+////////////////////////////////////////////////////////////////////////////////
+CBotProfiler::CBotProfiler(const std::string& name) : m_name(name)
+{
+    m_last = std::chrono::steady_clock::now();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotProfiler::WriteCollapsed(std::ostream& ostr, Measure measure) const
+{
+    for (const Entry& entry : m_entries)
+    {
+        long count = entry.ticks;
+        if (measure == Measure::TIME)
+            count = static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(entry.time).count());
+        if (count > 0) ostr << entry.stack << " " << count << "\n";
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long CBotProfiler::GetTicks() const
+{
+    return m_ticks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotProfiler::Clear()
+{
+    m_entries.clear();
+    m_paths.clear();
+    m_stacks.clear();
+    m_ticks = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotProfiler::Begin()
+{
+    m_last = std::chrono::steady_clock::now();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotProfiler::Tick(CBotStack* level, int ticks)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // the instruction, then the functions it was called from
+    m_path.clear();
+    CBotStack* p = level;
+    while (p != nullptr && p->m_instr == nullptr) p = p->m_prev;
+    m_path.push_back(p != nullptr ? p->m_instr : nullptr);
+    for (p = level->GetFrame(); p != nullptr; p = p->m_prev != nullptr ? p->m_prev->GetFrame() : nullptr)
+    {
+        if (p->m_func == CBotStack::IsFunction::YES && p->m_instr != nullptr) m_path.push_back(p->m_instr);
+    }
+
+    auto it = m_paths.find(m_path);
+    if (it == m_paths.end())
+    {
+        std::string stack = m_name;
+        for (std::size_t i = m_path.size(); i-- > 0; )
+        {
+            if (!stack.empty()) stack += ";";
+            stack += GetLabel(m_path[i], i > 0);
+        }
+
+        auto found = m_stacks.find(stack);
+        if (found == m_stacks.end())
+        {
+            found = m_stacks.emplace(stack, m_entries.size()).first;
+            m_entries.emplace_back();
+            m_entries.back().stack = stack;
+        }
+        it = m_paths.emplace(m_path, found->second).first;
+    }
+
+    Entry& entry = m_entries[it->second];
+    entry.ticks += ticks;
+    entry.time += now - m_last;
+    m_ticks += ticks;
+    m_last = now;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotProfiler::ForgetCode()
+{
+    m_paths.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string CBotProfiler::GetLabel(CBotInstr* instr, bool function)
+{
+    if (instr == nullptr) return "?";
+
+    if (function)
+    {
+        CBotFunction* func = static_cast<CBotFunction*>(instr);
+        if (func->GetClassName().empty()) return func->GetName();
+        return func->GetClassName() + "::" + func->GetName();
+    }
+
+    CBotToken* token = instr->GetToken();
+    if (token->GetString().empty()) return "{}";   // list of instructions
+    return token->GetString() + "@" + std::to_string(token->GetStart()) + "-" + std::to_string(token->GetEnd());
+}
+
+} // namespace CBot
@@ -0,0 +1,125 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace CBot
+{
+
+class CBotInstr;
+class CBotStack;
+
+/**
+ * \brief Measures where a program spends its time, see CBotProgram::SetProfiler()
+ *
+ * Every timer tick (see CBotStack::SetState()) is charged, along with the wall time elapsed
+ * since the previous one, to the instruction making it and to the functions it was called
+ * from. The results are written as collapsed stacks, one line per call path:
+ *
+ * \code
+ * Robot;Main;Work;sin@120-123 42
+ * \endcode
+ *
+ * which is the input format of the usual flame graph tools (flamegraph.pl, speedscope, inferno...).
+ * Instructions are named by their token and its position in the source code.
+ *
+ * A profiler may be used by several programs, but by only one of them at a time.
+ * Profiling slows the execution down, programs without a profiler are not affected.
+ */
+class CBotProfiler
+{
+public:
+    //! What WriteCollapsed() reports
+    enum class Measure
+    {
+        TICKS,      //!< timer ticks
+        TIME,       //!< wall time, in microseconds
+    };
+
+    /**
+     * \brief Constructor
+     * \param name Name of the outermost frame of all the stacks (e.g. the robot running the program), none if empty
+     */
+    CBotProfiler(const std::string& name = "");
+
+    /**
+     * \brief Writes the results as collapsed stacks
+     * \param ostr Output stream
+     * \param measure What the count of each stack is
+     */
+    void WriteCollapsed(std::ostream& ostr, Measure measure = Measure::TICKS) const;
+
+    /**
+     * \brief Returns the total number of ticks measured
+     */
+    long GetTicks() const;
+
+    /**
+     * \brief Forgets all the results
+     */
+    void Clear();
+
+private:
+    friend class CBotProgram;
+    friend class CBotStack;
+
+    /**
+     * \brief Starts measuring the time, called when a program starts running
+     */
+    void Begin();
+
+    /**
+     * \brief Charges ticks to a stack level
+     */
+    void Tick(CBotStack* level, int ticks);
+
+    /**
+     * \brief Forgets the instructions seen so far, called when they may be deleted (the results are kept)
+     */
+    void ForgetCode();
+
+    std::string GetLabel(CBotInstr* instr, bool function);
+
+private:
+    struct Entry
+    {
+        std::string stack;
+        long ticks = 0;
+        std::chrono::nanoseconds time{0};
+    };
+
+    std::string m_name;
+    std::vector<Entry> m_entries;
+    //! Entries by call path, see Tick()
+    std::map<std::vector<CBotInstr*>, std::size_t> m_paths;
+    //! Entries by stack name, to find them again after ForgetCode()
+    std::map<std::string, std::size_t> m_stacks;
+    //! Call path of the current tick, kept to avoid allocations
+    std::vector<CBotInstr*> m_path;
+    std::chrono::steady_clock::time_point m_last;
+    long m_ticks = 0;
+};
+
+} // namespace CBot
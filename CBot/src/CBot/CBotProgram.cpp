@@ -18,11 +18,17 @@
  */
 
 #include "CBot/CBotVar/CBotVar.h"
+#include "CBot/CBotVar/CBotVarClass.h"
 
+#include "CBot/CBotContextState.h"
 #include "CBot/CBotExternalCall.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotCStack.h"
 #include "CBot/CBotClass.h"
+#include "CBot/CBotFileUtils.h"
+#include "CBot/CBotInstanceNumbers.h"
+#include "CBot/CBotMemoryAccount.h"
+#include "CBot/CBotProfiler.h"
 #include "CBot/CBotUtils.h"
 
 #include "CBot/CBotInstr/CBotFunction.h"
@@ -30,23 +36,27 @@
 #include "CBot/stdlib/stdlib.h"
 
 #include <algorithm>
+#include <mutex>
 
 namespace CBot
 {
 
-std::unique_ptr<CBotExternalCallList> CBotProgram::m_externalCalls;
-
 CBotProgram::CBotProgram()
+: m_memory(std::make_shared<CBotMemoryAccount>()), m_instanceNumbers(new CBotInstanceNumbers()),
+  m_context(CBotContext::GetCurrent())
 {
 }
 
 CBotProgram::CBotProgram(CBotVar* thisVar)
-: m_thisVar(thisVar)
+: m_memory(std::make_shared<CBotMemoryAccount>()), m_instanceNumbers(new CBotInstanceNumbers()),
+  m_thisVar(thisVar), m_context(CBotContext::GetCurrent())
 {
 }
 
 CBotProgram::~CBotProgram()
 {
+    CBotContext::Scope scope(m_context);
+
 //  delete  m_classes;
     for (CBotClass* c : m_classes)
         c->Purge();
@@ -58,10 +68,130 @@ CBotProgram::~CBotProgram()
     m_functions.clear();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//! Compiled code shared by the programs compiled from the same source
+struct CBotProgram::SharedCode
+{
+    ~SharedCode();
+
+    //! Tells if a program compiled now would get the same code
+    bool Matches(const std::string& program, CBotEngine engine, bool optimize, CBotClass* thisClass) const;
+
+    //! Context the code was compiled in, the shared codes are indexed there
+    CBotContext* context;
+    std::size_t hash;
+    std::string source;
+    CBotEngine engine;
+    bool optimize;
+    //! Class of "this", the methods defined out of their class (e.g. object::Main) are compiled in it
+    CBotClass* thisClass;
+    //! Revisions of the definitions the code was compiled with
+    long externalCalls;
+    long defineNum;
+    long classes;
+    long publicFunctions;
+    //! Functions owning the instructions, the programs run copies of them (see CBotFunction::Share())
+    std::list<CBotFunction*> functions;
+    std::vector<std::string> externFunctions;
+};
+
+CBotProgram::SharedCode::~SharedCode()
+{
+    for (CBotFunction* f : functions) delete f;
+
+    // forget the programs nobody runs anymore, including this one
+    auto& sharedCodes = GetContextState(context).functions.sharedCodes;
+    auto range = sharedCodes.equal_range(hash);
+    for (auto it = range.first; it != range.second; )
+    {
+        if (it->second.expired()) it = sharedCodes.erase(it);
+        else ++it;
+    }
+}
+
+bool CBotProgram::SharedCode::Matches(const std::string& program, CBotEngine engine, bool optimize, CBotClass* thisClass) const
+{
+    return this->engine == engine &&
+           this->optimize == optimize &&
+           this->thisClass == thisClass &&
+           externalCalls == CBotExternalCallList::GetRevision() &&
+           defineNum == CBotToken::GetDefineNumRevision() &&
+           classes == CBotClass::GetRevision() &&
+           publicFunctions == GetContextState(context).functions.revision &&
+           source == program;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotProgram::UseSharedCode(const std::string& program, std::size_t hash, std::vector<std::string>& externFunctions)
+{
+    auto range = GetContextState(m_context).functions.sharedCodes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        std::shared_ptr<SharedCode> code = it->second.lock();
+        if (code == nullptr || !code->Matches(program, m_engine, m_optimize, GetThisClass())) continue;
+
+        for (CBotFunction* f : code->functions)
+            m_functions.push_back(f->Share(this));
+        externFunctions = code->externFunctions;
+        m_sharedCode = code;
+        return true;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotProgram::ShareCode(const std::string& program, std::size_t hash, const std::vector<std::string>& externFunctions)
+{
+    // classes and public functions are known by their name to all the programs
+    if (!m_classes.empty()) return;
+    for (CBotFunction* f : m_functions)
+    {
+        if (f->IsPublic()) return;
+    }
+
+    auto code = std::shared_ptr<SharedCode>(new SharedCode());
+    code->context = m_context;
+    code->hash = hash;
+    code->source = program;
+    code->engine = m_engine;
+    code->optimize = m_optimize;
+    code->thisClass = GetThisClass();
+    code->externalCalls = CBotExternalCallList::GetRevision();
+    code->defineNum = CBotToken::GetDefineNumRevision();
+    code->classes = CBotClass::GetRevision();
+    code->publicFunctions = GetContextState(m_context).functions.revision;
+    code->externFunctions = externFunctions;
+
+    code->functions.swap(m_functions);
+    for (CBotFunction* f : code->functions)
+    {
+        f->m_pProg = nullptr;
+        m_functions.push_back(f->Share(this));
+    }
+
+    GetContextState(m_context).functions.sharedCodes.emplace(hash, code);
+    m_sharedCode = code;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotClass* CBotProgram::GetThisClass()
+{
+    return m_thisVar != nullptr ? m_thisVar->GetClass() : nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotProgram::IsCodeShared()
+{
+    return m_sharedCode != nullptr && m_sharedCode.use_count() > 1;
+}
+
 bool CBotProgram::Compile(const std::string& program, std::vector<std::string>& externFunctions, void* pUser)
 {
+    CBotContext::Scope scope(m_context);
+
     // Cleanup the previously compiled program
     Stop();
+    if (m_profiler != nullptr) m_profiler->ForgetCode();
 
     for (CBotClass* c : m_classes)
         c->Purge();      // purge the old definitions of classes
@@ -70,10 +200,19 @@ bool CBotProgram::Compile(const std::string& program, std::vector<std::string>&
     m_classes.clear();
     for (CBotFunction* f : m_functions) delete f;
     m_functions.clear();
+    m_sharedCode.reset();
+    IndexFunctions();
 
     externFunctions.clear();
     m_error = CBotNoErr;
 
+    std::size_t hash = std::hash<std::string>()(program);
+    if (UseSharedCode(program, hash, externFunctions))
+    {
+        IndexFunctions();
+        return true;
+    }
+
     // Step 1. Process the code into tokens
     auto tokens = CBotToken::CompileTokens(program);
     if (tokens == nullptr) return false;
@@ -82,7 +221,7 @@ bool CBotProgram::Compile(const std::string& program, std::vector<std::string>&
     CBotToken* p = tokens.get()->GetNext();                 // skips the first token (separator)
 
     pStack->SetProgram(this);                               // defined used routines
-    m_externalCalls->SetUserPtr(pUser);
+    GetContextState(m_context).definitions.externalCalls->SetUserPtr(pUser);
 
     // Step 2. Find all function and class definitions
     while ( pStack->IsOk() && p != nullptr && p->GetType() != 0)
@@ -143,12 +282,38 @@ bool CBotProgram::Compile(const std::string& program, std::vector<std::string>&
         for (CBotFunction* f : m_functions) delete f;
         m_functions.clear();
     }
+    else if (!m_functions.empty())
+    {
+        ShareCode(program, hash, externFunctions);
+    }
 
+    IndexFunctions();
     return !m_functions.empty();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void CBotProgram::IndexFunctions()
+{
+    m_functionsByIdent.clear();
+    m_hasMethods = false;
+    for (CBotFunction* f : m_functions)
+    {
+        m_functionsByIdent.emplace(f->m_nFuncIdent, f);
+        if (!f->GetClassName().empty()) m_hasMethods = true;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotFunction* CBotProgram::FindFunction(long ident)
+{
+    auto it = m_functionsByIdent.find(ident);
+    return it != m_functionsByIdent.end() ? it->second : nullptr;
+}
+
 bool CBotProgram::Start(const std::string& name)
 {
+    CBotContext::Scope scope(m_context);
+    CBotMemoryAccount::Scope memoryScope(m_memory.get());
     Stop();
 
     auto it = std::find_if(m_functions.begin(), m_functions.end(), [&name](CBotFunction* x) { return x->GetName() == name; });
@@ -158,6 +323,9 @@ bool CBotProgram::Start(const std::string& name)
         return false;
     }
     m_entryPoint = *it;
+    m_ticks = 0;
+    m_totalTicks = 0;
+    m_stateChanged = true;
 
     m_stack = CBotStack::AllocateStack();
     m_stack->SetProgram(this);
@@ -176,31 +344,64 @@ bool CBotProgram::GetPosition(const std::string& name, int& start, int& stop, CB
 
 bool CBotProgram::Run(void* pUser, int timer)
 {
+    CBotContext::Scope scope(m_context);
+    CBotMemoryAccount::Scope memoryScope(m_memory.get());
+    m_instanceNumbers->Number();    // in the order of the programs, as if RunIsolated() ran them one by one
+
     if (m_stack == nullptr || m_entryPoint == nullptr)
     {
         m_error = CBotErrNoRun;
+        m_ticks = 0;
         return true;
     }
 
     m_error = CBotNoErr;
 
-    m_stack->SetUserPtr(pUser);
-    if ( timer >= 0 ) m_stack->SetTimer(timer); // TODO: Check if changing order here fixed ipf()
-    m_stack->Reset();                         // reset the possible previous error, and resets the timer
+    m_stack->SetProfiler(m_profiler);
+    m_stack->SetMemoryAccount(m_memory->GetLimit() > 0 ? m_memory.get() : nullptr);
+    if (m_profiler != nullptr) m_profiler->Begin();
 
-    m_stack->SetProgram(this);                     // bases for routines
+    bool ok;
+    if (m_isolatedRun == IsolatedRun::DONE)
+    {
+        ok = m_isolatedResult;
+    }
+    else
+    {
+        CBotClass::InvalidateFields();  // the objects of the host changed since the last run
+        m_stack->SetUserPtr(pUser);
+        if (m_isolatedRun == IsolatedRun::NONE)
+        {
+            if ( timer >= 0 ) m_stack->SetTimer(timer); // TODO: Check if changing order here fixed ipf()
+            m_stack->Reset();                         // reset the possible previous error, and resets the timer
+        }
+
+        m_stack->SetProgram(this);                     // bases for routines
 
-    // resumes execution on the top of the stack
-    bool ok = m_stack->Execute();
-    if (ok)
+        // resumes execution on the top of the stack
+        ok = m_stack->Execute();
+        if (ok)
+        {
+            // returns to normal execution
+            ok = m_entryPoint->Execute(nullptr, m_stack, m_thisVar);
+        }
+    }
+    m_isolatedRun = IsolatedRun::NONE;
+
+    m_ticks = m_stack->GetTicks();
+    m_totalTicks += m_ticks;
+    if (m_ticks != 0) m_stateChanged = true;
+    if (m_stack->IsSharedAccess())
     {
-        // returns to normal execution
-        ok = m_entryPoint->Execute(nullptr, m_stack, m_thisVar);
+        m_stack->SetSharedAccess(false);
+        m_sharedAccess = true;
+        GetContextState(m_context).classes.sharedStateRevision++;
     }
 
     // completed on a mistake?
     if (ok || !m_stack->IsOk())
     {
+        m_stateChanged = true;
         m_error = m_stack->GetError(m_errorStart, m_errorEnd);
         m_stack->Delete();
         m_stack = nullptr;
@@ -212,8 +413,93 @@ bool CBotProgram::Run(void* pUser, int timer)
     return ok;
 }
 
+void CBotProgram::RunIsolated(void* pUser, int timer)
+{
+    CBotContext::Scope scope(m_context);
+    CBotMemoryAccount::Scope memoryScope(m_memory.get());
+
+    m_isolatedRun = IsolatedRun::NONE;
+    if (m_stack == nullptr || m_entryPoint == nullptr || timer <= 0) return;
+    if (GetContextState(m_context).instances.destructible > 0) return;
+
+    m_stack->SetUserPtr(pUser);
+    m_stack->SetTimer(timer);
+    m_stack->Reset();
+    m_stack->SetProgram(this);
+    m_stack->SetIsolated(true);
+    m_stack->SetProfiler(m_profiler);
+    m_stack->SetMemoryAccount(m_memory->GetLimit() > 0 ? m_memory.get() : nullptr);
+    if (m_profiler != nullptr) m_profiler->Begin();
+
+    bool ok;
+    {
+        CBotInstanceNumbers::Scope numbersScope(m_instanceNumbers.get());
+        ok = m_stack->Execute();
+        if (ok) ok = m_entryPoint->Execute(nullptr, m_stack, m_thisVar);
+    }
+
+    m_stack->SetIsolated(false);
+
+    // the end of the execution is left to Run(), as it releases the locks of all the classes
+    if (!ok && m_stack->IsOk() && m_stack->IsStoppedIsolated())
+    {
+        m_isolatedRun = IsolatedRun::STOPPED;
+    }
+    else
+    {
+        m_isolatedRun = IsolatedRun::DONE;
+        m_isolatedResult = ok;
+    }
+}
+
+int CBotProgram::GetTicks()
+{
+    return m_ticks;
+}
+
+long CBotProgram::GetTotalTicks()
+{
+    return m_totalTicks;
+}
+
+void CBotProgram::SetProfiler(CBotProfiler* profiler)
+{
+    m_profiler = profiler;
+    if (m_profiler != nullptr) m_profiler->ForgetCode();
+}
+
+CBotProfiler* CBotProgram::GetProfiler()
+{
+    return m_profiler;
+}
+
+void CBotProgram::SetMemoryLimit(long bytes)
+{
+    m_memory->SetLimit(bytes);
+}
+
+long CBotProgram::GetMemoryLimit()
+{
+    return m_memory->GetLimit();
+}
+
+long CBotProgram::GetMemoryUsed()
+{
+    return m_memory->GetUsed();
+}
+
+long CBotProgram::GetMemoryPeak()
+{
+    return m_memory->GetPeak();
+}
+
 void CBotProgram::Stop()
 {
+    CBotContext::Scope scope(m_context);
+    m_instanceNumbers->Number();
+    m_isolatedRun = IsolatedRun::NONE;
+    m_stateChanged = true;
+    m_sharedAccess = false;
     if (m_stack != nullptr)
     {
         m_stack->Delete();
@@ -273,6 +559,26 @@ const std::list<CBotFunction*>& CBotProgram::GetFunctions()
     return m_functions;
 }
 
+void CBotProgram::SetEngine(CBotEngine engine)
+{
+    m_engine = engine;
+}
+
+CBotEngine CBotProgram::GetEngine()
+{
+    return m_engine;
+}
+
+void CBotProgram::SetOptimize(bool optimize)
+{
+    m_optimize = optimize;
+}
+
+bool CBotProgram::GetOptimize()
+{
+    return m_optimize;
+}
+
 bool CBotProgram::ClassExists(std::string name)
 {
     for (CBotClass* p : m_classes)
@@ -296,25 +602,28 @@ static bool rSizeOf( CBotVar* pVar, CBotVar* pResult, int& ex, void* pUser )
 {
     if ( pVar == nullptr ) { ex = CBotErrLowParam; return true; }
 
-    int i = 0;
-    pVar = pVar->GetItemList();
-
-    while ( pVar != nullptr )
-    {
-        i++;
-        pVar = pVar->GetNext();
-    }
-
-    pResult->SetValInt(i);
+    pResult->SetValInt(pVar->GetItemCount());
     return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotProgram::AddFunction(const std::string& name,
                               bool rExec(CBotVar* pVar, CBotVar* pResult, int& Exception, void* pUser),
-                              CBotTypResult rCompile(CBotVar*& pVar, void* pUser))
+                              CBotTypResult rCompile(CBotVar*& pVar, void* pUser),
+                              bool isolated)
 {
-    return m_externalCalls->AddFunction(name, std::unique_ptr<CBotExternalCall>(new CBotExternalCallDefault(rExec, rCompile)));
+    auto call = std::unique_ptr<CBotExternalCall>(new CBotExternalCallDefault(rExec, rCompile));
+    call->SetIsolated(isolated);
+    return GetExternalCalls()->AddFunction(name, std::move(call));
+}
+
+bool CBotProgram::SetFunctionCost(const std::string& name, int cost)
+{
+    CBotExternalCall* call = GetExternalCalls()->Find(name);
+    if (call == nullptr) return false;
+
+    call->SetCost(cost);
+    return true;
 }
 
 bool CBotProgram::DefineNum(const std::string& name, long val)
@@ -324,48 +633,91 @@ bool CBotProgram::DefineNum(const std::string& name, long val)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotProgram::SaveState(std::ostream &ostr)
+bool CBotProgram::CollectCycles(int budget)
+{
+    return CBotVarClass::CollectCycles(budget);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotProgram::MemoryUsage CBotProgram::GetMemoryUsage()
+{
+    CBotContext* context = CBotContext::GetCurrent();
+    CBotVarClass::MergeCycleCandidates();
+    std::lock_guard<std::mutex> lock(GetContextState(context).instances.mutex);
+    MemoryUsage usage;
+    usage.instances = GetContextState(context).instances.byIdent.size();
+    usage.candidates = GetContextState(context).instances.cycleCandidates.size();
+    usage.collected = GetContextState(context).instances.collected;
+    return usage;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotProgram::SetDestructorLimits(long ticks, std::chrono::steady_clock::time_point deadline)
+{
+    CBotContext* context = CBotContext::GetCurrent();
+    GetContextState(context).instances.destructorTickLimit = ticks;
+    GetContextState(context).instances.destructorDeadline = deadline;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotProgram::DestructorUsage CBotProgram::GetDestructorUsage()
 {
-    if (!WriteLong(ostr, CBOTVERSION)) return false;
+    CBotContext* context = CBotContext::GetCurrent();
+    DestructorUsage usage;
+    usage.ticks = GetContextState(context).instances.destructorTicks;
+    usage.stopped = GetContextState(context).instances.stoppedDestructors;
+    return usage;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotProgram::SaveState(CBotStateWriter &writer)
+{
+    CBotContext::Scope scope(m_context);
+    m_instanceNumbers->Number();
+    if (!WriteLong(writer, CBOTVERSION)) return false;
 
 
     if (m_stack != nullptr )
     {
-        if (!WriteWord(ostr, 1)) return false;
-        if (!WriteString(ostr, m_entryPoint->GetName())) return false;
-        if (!m_stack->SaveState(ostr)) return false;
+        // the stack of a function run by the bytecode has its own layout
+        if (!WriteWord(writer, m_engine == CBotEngine::BYTECODE ? 2 : 1)) return false;
+        if (!WriteString(writer, m_entryPoint->GetName())) return false;
+        if (!m_stack->SaveState(writer)) return false;
     }
     else
     {
-        if (!WriteWord(ostr, 0)) return false;
+        if (!WriteWord(writer, 0)) return false;
     }
     return true;
 }
 
-bool CBotProgram::RestoreState(std::istream &istr)
+bool CBotProgram::RestoreState(CBotStateReader &reader)
 {
+    CBotContext::Scope scope(m_context);
+    CBotMemoryAccount::Scope memoryScope(m_memory.get());
     unsigned short  w;
     std::string      s;
 
     Stop();
 
     long version;
-    if (!ReadLong(istr, version)) return false;
+    if (!ReadLong(reader, version)) return false;
     if ( version != CBOTVERSION ) return false;
 
-    if (!ReadWord(istr, w)) return false;
+    if (!ReadWord(reader, w)) return false;
     if ( w == 0 ) return true;
+    if ( w != (m_engine == CBotEngine::BYTECODE ? 2 : 1) ) return false;    // saved with the other engine
 
     // don't restore if compile error exists
     if (m_error != CBotNoErr) return false;
 
-    if (!ReadString(istr, s)) return false;
+    if (!ReadString(reader, s)) return false;
     if (!Start(s)) return false; // point de reprise
     // Start() already created the new stack
     // and called m_stack->SetProgram(this);
 
     // retrieves the stack from the memory
-    if (!m_stack->RestoreState(istr, m_stack))
+    if (!m_stack->RestoreState(reader, m_stack))
     {
         m_stack->Delete();
         m_stack = nullptr;
@@ -379,6 +731,81 @@ bool CBotProgram::RestoreState(std::istream &istr)
     return true;
 }
 
+bool CBotProgram::SaveState(std::ostream &ostr)
+{
+    std::string state;
+    CBotStateWriter writer(state);
+    if (!SaveState(writer)) return false;
+    return !!ostr.write(state.data(), state.size());
+}
+
+bool CBotProgram::RestoreState(std::istream &istr)
+{
+    CBotStateReader reader(istr);
+    return RestoreState(reader);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Identifies the snapshots made by CBotProgram::SaveSnapshot()
+static const char SNAPSHOT_MAGIC[4] = { 'C', 'B', 'S', 'N' };
+//! Version of the snapshot layout, the data itself has its own version (CBOTVERSION)
+static const uint32_t SNAPSHOT_VERSION = 1;
+//! Magic, version and length of the data, each one on 4 bytes
+static const std::size_t SNAPSHOT_HEADER_SIZE = 12;
+
+static void PutUInt32(char* p, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+static uint32_t GetUInt32(const char* p)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return value;
+}
+
+bool CBotProgram::IsStateChanged()
+{
+    if (m_stateChanged) return true;
+    return m_sharedAccess && m_sharedStateRevision != GetContextState(m_context).classes.sharedStateRevision;
+}
+
+const std::string& CBotProgram::SaveSnapshot()
+{
+    if (!IsStateChanged()) return m_snapshot;
+
+    m_snapshot.assign(SNAPSHOT_HEADER_SIZE, '\0');
+    CBotStateWriter writer(m_snapshot);
+    bool ok = SaveState(writer);
+
+    std::size_t length = m_snapshot.size() - SNAPSHOT_HEADER_SIZE;
+    if (!ok || length > UINT32_MAX)
+    {
+        m_snapshot.clear();
+        return m_snapshot;
+    }
+
+    std::copy(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 4, &m_snapshot[0]);
+    PutUInt32(&m_snapshot[4], SNAPSHOT_VERSION);
+    PutUInt32(&m_snapshot[8], static_cast<uint32_t>(length));
+
+    m_stateChanged = false;
+    m_sharedStateRevision = GetContextState(m_context).classes.sharedStateRevision;
+    return m_snapshot;
+}
+
+bool CBotProgram::RestoreSnapshot(const std::string& snapshot)
+{
+    if (snapshot.size() < SNAPSHOT_HEADER_SIZE) return false;
+    if (!std::equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 4, snapshot.data())) return false;
+    if (GetUInt32(&snapshot[4]) != SNAPSHOT_VERSION) return false;
+    if (GetUInt32(&snapshot[8]) != snapshot.size() - SNAPSHOT_HEADER_SIZE) return false;
+
+    CBotStateReader reader(snapshot.data() + SNAPSHOT_HEADER_SIZE, snapshot.size() - SNAPSHOT_HEADER_SIZE);
+    return RestoreState(reader);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 int CBotProgram::GetVersion()
@@ -388,7 +815,7 @@ int CBotProgram::GetVersion()
 
 void CBotProgram::Init()
 {
-    m_externalCalls.reset(new CBotExternalCallList);
+    GetCurrentState().definitions.externalCalls.reset(new CBotExternalCallList);
 
     CBotProgram::DefineNum("CBotErrZeroDiv",    CBotErrZeroDiv);     // division by zero
     CBotProgram::DefineNum("CBotErrNotInit",    CBotErrNotInit);     // uninitialized variable
@@ -402,25 +829,27 @@ void CBotProgram::Init()
     CBotProgram::DefineNum("CBotErrOutArray",   CBotErrOutArray);    // Attempted access out of bounds of an array
     CBotProgram::DefineNum("CBotErrStackOver",  CBotErrStackOver);   // Stack overflow
     CBotProgram::DefineNum("CBotErrDeletedPtr", CBotErrDeletedPtr);  // Attempted to use deleted object
+    CBotProgram::DefineNum("CBotErrMemory",     CBotErrMemory);      // Memory limit exceeded
 
-    CBotProgram::AddFunction("sizeof", rSizeOf, cSizeOf);
+    CBotProgram::AddFunction("sizeof", rSizeOf, cSizeOf, true);
 
     InitStringFunctions();
     InitMathFunctions();
+    InitArrayFunctions();
     InitFileFunctions();
 }
 
 void CBotProgram::Free()
 {
     CBotToken::ClearDefineNum();
-    m_externalCalls->Clear();
+    GetExternalCalls()->Clear();
     CBotClass::ClearPublic();
-    m_externalCalls.reset();
+    GetCurrentState().definitions.externalCalls.reset();
 }
 
 const std::unique_ptr<CBotExternalCallList>& CBotProgram::GetExternalCalls()
 {
-    return m_externalCalls;
+    return GetCurrentState().definitions.externalCalls;
 }
 
 } // namespace CBot
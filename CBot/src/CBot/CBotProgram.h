@@ -21,9 +21,11 @@
 
 #include "CBot/CBotEnums.h"
 
+#include <chrono>
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace CBot
@@ -35,6 +37,12 @@ class CBotStack;
 class CBotTypResult;
 class CBotVar;
 class CBotExternalCallList;
+class CBotContext;
+class CBotProfiler;
+class CBotMemoryAccount;
+class CBotInstanceNumbers;
+class CBotStateWriter;
+class CBotStateReader;
 
 /**
  * \brief Class that manages a CBot program. This is the main entry point into the CBot engine.
@@ -55,6 +63,8 @@ class CBotExternalCallList;
  *
  * After you are finished, free the memory used by the CBot engine by calling CBotProgram::Free().
  *
+ * All of this happens in the current CBotContext, so that independent engines can run side by side.
+ *
  * \section Example Example usage
  * \code
  * // Initialize the engine
@@ -88,11 +98,15 @@ class CBotProgram
 public:
     /**
      * \brief Constructor
+     *
+     * The program belongs to the current context, see CBotContext
      */
     CBotProgram();
 
     /**
      * \brief Constructor
+     *
+     * The program belongs to the current context, see CBotContext
      * \param thisVar Variable to pass to the program as "this"
      */
     CBotProgram(CBotVar* thisVar);
@@ -104,11 +118,13 @@ public:
 
     /**
      * \brief Initializes the module, should be done once (and only once) at the beginning
+     *
+     * Initializes the current context, see CBotContext
      */
     static void Init();
 
     /**
-     * \brief Frees the static memory areas
+     * \brief Frees the static memory areas of the current context
      */
     static void Free();
 
@@ -126,6 +142,15 @@ public:
      * 2. First pass - getting declarations of all functions an classes for use later
      * 3. Second pass - compiling definitions of all functions and classes
      *
+     * When another program was compiled from the same source with the same settings, and neither the
+     * external functions, the constants, the classes nor the public functions changed since, its
+     * compiled code is reused instead. Only the execution state (stack, "this", errors) is kept per
+     * program, so compiling the same source for many objects costs a single compilation. Programs
+     * defining classes or public functions are always compiled on their own, as these definitions
+     * are registered by name for the whole engine.
+     *
+     * The compile functions of the external calls must then give the same result for any pUser.
+     *
      * \param program Code to compile
      * \param[out] externFunctions Returns the names of functions declared as extern
      * \param pUser Optional pointer to be passed to compile function (see AddFunction())
@@ -180,6 +205,81 @@ public:
      */
     bool Run(void* pUser = nullptr, int timer = -1);
 
+    /**
+     * \brief Executes the part of the next Run() that only works on the program itself
+     *
+     * The program runs as with Run(), but is interrupted before any operation shared with other
+     * programs or with the host: calls to functions not marked with CBotExternalCall::SetIsolated(),
+     * access to the objects of the host (instances with a user pointer) and to static fields,
+     * synchronized methods, creation of objects of a class defined by a program... Programs of the
+     * same context can so run this part at once, on several threads.
+     *
+     * The next Run() then goes on with the same time slice (its arguments are ignored), or just
+     * returns if the program finished or used its whole timer here. Running all the programs this
+     * way, then calling Run() on each of them in the usual order, gives the same results as the
+     * Run() calls alone. This includes the numbers of the instances created, which the next Run()
+     * gives (see CBotInstanceNumbers), so the saved states are the same too.
+     *
+     * Nothing is run when the timer is not positive (step by step mode), or when some instance
+     * has a destructor to call (see CBotVarClass::ConstructorSet()), as it may be released at any time.
+     *
+     * \param pUser Custom pointer to be passed to execute function (see AddFunction())
+     * \param timer Number of timer ticks to execute, as with Run()
+     */
+    void RunIsolated(void* pUser, int timer);
+
+    /**
+     * \brief Returns the number of timer ticks used by the last Run(), with what RunIsolated() ran before it
+     *
+     * It may be a bit more than the timer given to Run(), see CBotStack::SetState()
+     */
+    int GetTicks();
+
+    /**
+     * \brief Returns the number of timer ticks used since the program was started with Start()
+     */
+    long GetTotalTicks();
+
+    /**
+     * \brief Profiles the execution of this program
+     *
+     * The ticks of Run() and RunIsolated() are then charged to the instructions making them, see CBotProfiler
+     *
+     * \param profiler Profiler, not owned by the program, nullptr to stop profiling
+     */
+    void SetProfiler(CBotProfiler* profiler);
+
+    /**
+     * \brief Returns the profiler given to SetProfiler()
+     */
+    CBotProfiler* GetProfiler();
+
+    /**
+     * \brief Limits the memory of the class instances, arrays and strings this program creates
+     *
+     * When the limit is exceeded, the program gets a ::CBotErrMemory error at its next step.
+     * The error can be caught by a try ... catch block, after freeing some memory the program may go on.
+     * See CBotMemoryAccount for what is counted.
+     *
+     * \param bytes Limit in bytes, 0 for none (default)
+     */
+    void SetMemoryLimit(long bytes);
+
+    /**
+     * \brief Returns the limit given to SetMemoryLimit()
+     */
+    long GetMemoryLimit();
+
+    /**
+     * \brief Returns the memory used by what this program created and is not freed yet, in bytes
+     */
+    long GetMemoryUsed();
+
+    /**
+     * \brief Returns the highest memory used by this program at once, in bytes
+     */
+    long GetMemoryPeak();
+
     /**
      * \brief Gives the current position in the executing program
      * \param[out] functionName Name of the currently executed function
@@ -262,11 +362,21 @@ public:
      * \param name Name of the function
      * \param rExec Execution function
      * \param rCompile Compilation function
+     * \param isolated The function only works on its arguments and result, see CBotExternalCall::SetIsolated()
      * \return true
      */
     static bool AddFunction(const std::string& name,
                             bool rExec(CBotVar* pVar, CBotVar* pResult, int& Exception, void* pUser),
-                            CBotTypResult rCompile(CBotVar*& pVar, void* pUser));
+                            CBotTypResult rCompile(CBotVar*& pVar, void* pUser),
+                            bool isolated = false);
+
+    /**
+     * \brief Sets the number of timer ticks a call to a function added with AddFunction() costs
+     * \param name Name of the function
+     * \param cost Number of ticks charged for each call, see CBotExternalCall::SetCost()
+     * \return false if there's no such function
+     */
+    static bool SetFunctionCost(const std::string& name, int cost);
 
     /**
      * \copydoc CBotToken::DefineNum()
@@ -274,6 +384,71 @@ public:
      */
     static bool DefineNum(const std::string& name, long val);
 
+    /**
+     * \brief Memory used by the class instances of the current context, see GetMemoryUsage()
+     */
+    struct MemoryUsage
+    {
+        //! Class instances and arrays alive
+        long instances = 0;
+        //! Instances which lost a reference, to examine by CollectCycles()
+        long candidates = 0;
+        //! Instances freed by CollectCycles()
+        long collected = 0;
+    };
+
+    /**
+     * \brief Frees the class instances only referenced by one another
+     *
+     * An instance is freed as soon as nothing references it, but instances in a cycle (a list linked
+     * in both directions, children keeping their parent...) keep one another alive. The instances
+     * which lost a reference are examined here in groups, until the time is over, the rest is left
+     * for the next call: call it regularly, e.g. once per frame, but not while RunIsolated() runs.
+     * The time is checked while a group is examined too, the next call then goes on with it, unless
+     * the programs changed its instances meanwhile: it is then examined again, without interruption.
+     *
+     * The destructors of the instances of a cycle run before any of them is freed.
+     *
+     * \param budget Time to spend, in microseconds; a few instances are examined at least
+     * \return true if there's nothing left to examine
+     */
+    static bool CollectCycles(int budget);
+
+    /**
+     * \brief Returns the memory used by the class instances of the current context
+     */
+    static MemoryUsage GetMemoryUsage();
+
+    /**
+     * \brief What the destructors of the current context used, see GetDestructorUsage()
+     */
+    struct DestructorUsage
+    {
+        //! Timer ticks used by the destructors
+        long ticks = 0;
+        //! Destructors stopped before their end by the limits
+        long stopped = 0;
+    };
+
+    /**
+     * \brief Limits the time the destructors of the current context may take
+     *
+     * A destructor runs as soon as its instance isn't referenced anymore, which may happen out of Run()
+     * (in Stop(), CollectCycles(), when a program is destroyed...), so the timer of the program doesn't
+     * bound it. The destructors share these limits; once they are reached, the destructors are stopped
+     * where they are and their instances freed anyway.
+     *
+     * \param ticks Timer ticks the destructors may use in all, as counted by GetDestructorUsage(), 0 for no limit
+     * \param deadline Time after which the destructors are stopped
+     */
+    static void SetDestructorLimits(long ticks,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    /**
+     * \brief Returns what the destructors of the current context used since it was created
+     */
+    static DestructorUsage GetDestructorUsage();
+
     /**
      * \brief Save the current execution status into a file
      * \param ostr Output stream
@@ -281,6 +456,13 @@ public:
      */
     bool SaveState(std::ostream &ostr);
 
+    /**
+     * \brief Save the current execution status in memory, in the same format as SaveState(std::ostream&)
+     * \param writer Where the state is written
+     * \return true on success
+     */
+    bool SaveState(CBotStateWriter &writer);
+
     /**
      * \brief Restore the execution state from a file
      *
@@ -291,6 +473,44 @@ public:
      */
     bool RestoreState(std::istream &istr);
 
+    /**
+     * \brief Restore the execution state from memory, see RestoreState(std::istream&)
+     * \param reader Where the state is read from
+     * \return true on success, false on read error
+     */
+    bool RestoreState(CBotStateReader &reader);
+
+    /**
+     * \brief Tells if the execution state changed since the last SaveSnapshot()
+     *
+     * The state changes when the program is started, stopped or restored, and when Run() executes
+     * some instructions. Waiting in an external function (which asks to be called again) doesn't change it.
+     * A program which accessed the static fields of a class may hold instances changed by other programs,
+     * so its state also changes when any program accesses them.
+     */
+    bool IsStateChanged();
+
+    /**
+     * \brief Save the current execution status into a snapshot
+     *
+     * The snapshot is a single buffer: a header with the format version and the length of the data,
+     * followed by the same data as SaveState(). It is made again only if IsStateChanged(), otherwise
+     * the previous one is returned as is.
+     *
+     * \return The snapshot, empty on error. It stays valid until the next call
+     */
+    const std::string& SaveSnapshot();
+
+    /**
+     * \brief Restore the execution state from a snapshot made by SaveSnapshot()
+     *
+     * The data is read straight from memory, as with RestoreState() the program must already have been compiled.
+     *
+     * \param snapshot The snapshot
+     * \return true on success, false if the snapshot is invalid or doesn't match the program
+     */
+    bool RestoreSnapshot(const std::string& snapshot);
+
     /**
      * \brief GetPosition Gives the position of a routine in the original text
      * the user can select the item to find from the beginning to the end
@@ -320,6 +540,41 @@ public:
      */
     const std::list<CBotFunction*>& GetFunctions();
 
+    /**
+     * \brief Select the engine used to execute this program
+     *
+     * The engine is applied by Compile(), so the program has to be recompiled after changing it.
+     * Both engines give the same results, see ::CBotEngine. A state saved with SaveState()
+     * can only be restored by a program using the same engine.
+     *
+     * \param engine Execution engine, CBotEngine::TREE by default
+     */
+    void SetEngine(CBotEngine engine);
+
+    /**
+     * \brief Returns the engine selected with SetEngine()
+     */
+    CBotEngine GetEngine();
+
+    /**
+     * \brief Enable or disable the optimizations made while compiling
+     *
+     * When enabled, Compile() evaluates the operations on constants (e.g. 2 * 3.14 / 180), simplifies
+     * the logical operations with a constant operand, and drops the code that can't be reached
+     * (after return or break, branches of an if with a constant condition). Results and errors
+     * stay the same, only fewer steps are executed.
+     *
+     * The program has to be recompiled after changing it.
+     *
+     * \param optimize true to optimize (default), false to compile the program as written
+     */
+    void SetOptimize(bool optimize);
+
+    /**
+     * \brief Returns the setting given to SetOptimize()
+     */
+    bool GetOptimize();
+
     /**
      * \brief Check if class with that name was created in this program
      * \return True if class was defined in this program, otherwise, false
@@ -327,24 +582,96 @@ public:
     bool ClassExists(std::string name);
 
     /**
-     * \brief Returns static list of all registered external calls
+     * \brief Tells if the compiled code of this program is currently shared with other programs
+     * \see Compile()
+     */
+    bool IsCodeShared();
+
+    /**
+     * \brief Returns the list of all external calls registered in the current context
      */
     static const std::unique_ptr<CBotExternalCallList>& GetExternalCalls();
 
 private:
-    //! All external calls
-    static std::unique_ptr<CBotExternalCallList> m_externalCalls;
+    struct SharedCode;
+
+    /**
+     * \brief Takes the compiled code of an identical program, see Compile()
+     * \return true if such a program was found
+     */
+    bool UseSharedCode(const std::string& program, std::size_t hash, std::vector<std::string>& externFunctions);
+
+    /**
+     * \brief Makes the code just compiled available to the identical programs, if it can be shared
+     */
+    void ShareCode(const std::string& program, std::size_t hash, const std::vector<std::string>& externFunctions);
+
+    /**
+     * \brief Returns the class of "this", nullptr if the program has none
+     */
+    CBotClass* GetThisClass();
+
+    /**
+     * \brief Builds the table of the functions by unique identifier, once the program is compiled
+     */
+    void IndexFunctions();
+
+    /**
+     * \brief Finds a function of this program by its unique identifier
+     * \param ident Unique identifier of the function
+     * \return The function, or nullptr if there's no such function in this program
+     */
+    CBotFunction* FindFunction(long ident);
+
+private:
+    //! Compiled code this program runs, if it's shared
+    std::shared_ptr<SharedCode> m_sharedCode;
     //! All user-defined functions
     std::list<CBotFunction*> m_functions{};
+    //! User-defined functions by their unique identifier, see IndexFunctions()
+    std::unordered_map<long, CBotFunction*> m_functionsByIdent{};
+    //! Some functions are methods defined out of their class, see CBotClass::FindVirtual()
+    bool m_hasMethods = false;
     //! The entry point function
     CBotFunction* m_entryPoint = nullptr;
     //! Classes defined in this program
     std::list<CBotClass*> m_classes{};
     //! Execution stack
     CBotStack* m_stack = nullptr;
+    //! What the last RunIsolated() left for the next Run()
+    enum class IsolatedRun
+    {
+        NONE,       //!< nothing, Run() starts a new time slice
+        STOPPED,    //!< interrupted before a shared operation, Run() goes on with the same time slice
+        DONE,       //!< the time slice is over, Run() returns m_isolatedResult
+    };
+    IsolatedRun m_isolatedRun = IsolatedRun::NONE;
+    bool m_isolatedResult = false;
+    //! See GetTicks() and GetTotalTicks()
+    int m_ticks = 0;
+    long m_totalTicks = 0;
+    //! See IsStateChanged() and SaveSnapshot()
+    bool m_stateChanged = true;
+    bool m_sharedAccess = false;
+    long m_sharedStateRevision = 0;
+    std::string m_snapshot;
+    //! See SetProfiler()
+    CBotProfiler* m_profiler = nullptr;
+    //! See SetMemoryLimit() and GetMemoryUsed()
+    std::shared_ptr<CBotMemoryAccount> m_memory;
+    //! Numbers of the instances created by RunIsolated(), given by the next Run()
+    std::unique_ptr<CBotInstanceNumbers> m_instanceNumbers;
     //! "this" variable
     CBotVar* m_thisVar = nullptr;
+    //! Execution engine
+    CBotEngine m_engine = CBotEngine::TREE;
+    //! Optimizations made while compiling
+    bool m_optimize = true;
+    //! Context the program belongs to
+    CBotContext* m_context;
+    friend struct CBotContextState;
     friend class CBotFunction;
+    friend class CBotClass;
     friend class CBotDebug;
 
     CBotError m_error = CBotNoErr;
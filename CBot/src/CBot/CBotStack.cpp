@@ -20,6 +20,8 @@
 #include "CBot/CBotStack.h"
 
 #include "CBot/CBotClass.h"
+#include "CBot/CBotMemoryAccount.h"
+#include "CBot/CBotProfiler.h"
 
 #include "CBot/CBotInstr/CBotFunction.h"
 
@@ -33,12 +35,35 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <vector>
 
 
 namespace CBot
 {
 
 const int DEFAULT_TIMER = 100;
+//! Number of stack levels allocated at once
+const int STACK_CHUNK = 32;
+//! Maximum number of released chunks kept for the next stacks
+const int MAX_FREE_CHUNKS = 256;
+//! Maximum number of released results kept by a stack for each type, see CBotStack::CreateVar()
+const int MAX_SPARE_VARS = 16;
+
+//! Released chunks, all their levels are cleared, each thread has its own to avoid locking
+struct FreeChunks
+{
+    std::vector<CBotStack*> chunks;
+
+    ~FreeChunks()
+    {
+        for (CBotStack* p : chunks) free(p);
+    }
+};
+
+static thread_local FreeChunks freeChunks;
+
+static thread_local CBotStack::ChunkStats chunkStats;
 
 struct CBotStack::Data
 {
@@ -56,34 +81,107 @@ struct CBotStack::Data
     void*        pUser      = nullptr;
 
     std::unique_ptr<CBotVar> retvar;
+
+    //! Run by CBotProgram::RunIsolated(), see StopIsolated()
+    bool         isolated   = false;
+    bool         stoppedIsolated = false;
+
+    //! See SetSharedAccess()
+    bool         sharedAccess = false;
+
+    //! See CBotProgram::SetProfiler()
+    CBotProfiler* profiler  = nullptr;
+
+    //! See SetMemoryAccount()
+    CBotMemoryAccount* memory = nullptr;
+
+    //! Memory of the levels, allocated as the stack grows
+    std::vector<CBotStack*> chunks;
+
+    //! Numbers and booleans released by the levels, by type, see CreateVar()
+    std::vector<std::unique_ptr<CBotVar>> spareVars[CBotTypBoolean + 1];
 };
 
 CBotStack* CBotStack::AllocateStack()
+{
+    CBotStack*    p = AllocateChunk(0);
+
+    p->m_block = BlockVisibilityType::BLOCK;
+
+    p->m_data = new CBotStack::Data;
+    p->m_data->topStack = p;
+    p->m_data->chunks.push_back(p);
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotStack* CBotStack::AllocateChunk(int first)
 {
     CBotStack*    p;
+    chunkStats.taken++;
+
+    if (!freeChunks.chunks.empty())
+    {
+        // recycled chunks are already empty
+        p = freeChunks.chunks.back();
+        freeChunks.chunks.pop_back();
+    }
+    else
+    {
+        long    size = sizeof(CBotStack);
+        size    *= STACK_CHUNK;
 
-    long    size = sizeof(CBotStack);
-    size    *= (MAXSTACK+10);
+        // request a slice of memory for the stack
+        p = static_cast<CBotStack*>(malloc(size));
+        chunkStats.allocated++;
 
-    // request a slice of memory for the stack
-    p = static_cast<CBotStack*>(malloc(size));
+        // completely empty
+        memset(p, 0, size);
+    }
 
-    // completely empty
-    memset(p, 0, size);
+    for (int i = 0; i < STACK_CHUNK; i++) p[i].m_index = first + i;
+    return p;
+}
 
-    p->m_block = BlockVisibilityType::BLOCK;
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::ReleaseChunk(CBotStack* chunk)
+{
+    if (freeChunks.chunks.size() >= MAX_FREE_CHUNKS)
+    {
+        free(chunk);
+        return;
+    }
 
-    CBotStack* pp = p;
-    pp += MAXSTACK;
-    int i;
-    for ( i = 0 ; i< 10 ; i++ )
+    // levels normally are cleared by Delete(), unless a stack was left behind
+    for (int i = 0; i < STACK_CHUNK; i++)
     {
-        pp->m_bOver = true;
-        pp ++;
+        if (chunk[i].m_prev != nullptr) memset(&chunk[i], 0, sizeof(CBotStack));
     }
+    freeChunks.chunks.push_back(chunk);
+}
 
-    p->m_data = new CBotStack::Data;
-    p->m_data->topStack = p;
+////////////////////////////////////////////////////////////////////////////////
+const CBotStack::ChunkStats& CBotStack::GetChunkStats()
+{
+    return chunkStats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotStack* CBotStack::NextFreeLevel()
+{
+    std::vector<CBotStack*>& chunks = m_data->chunks;
+    int           index = m_index;
+    CBotStack*    p;
+    do
+    {
+        index++;
+        while (index >= static_cast<int>(chunks.size()) * STACK_CHUNK)
+        {
+            chunks.push_back(AllocateChunk(chunks.size() * STACK_CHUNK));
+        }
+        p = chunks[index / STACK_CHUNK] + index % STACK_CHUNK;
+    }
+    while ( p->m_prev != nullptr );
     return p;
 }
 
@@ -102,19 +200,28 @@ void CBotStack::Delete()
             m_prev->m_next2 = nullptr;        // removes chain
     }
 
-    delete m_var;
+    if (m_listVar != nullptr) ReleaseSlots(m_listVar);
+    ReleaseVar(m_var);
     delete m_listVar;
+    delete[] m_slots;
 
     CBotStack*    p = m_prev;
-    bool        bOver = m_bOver;
-    if ( m_prev == nullptr ) delete m_data;
+    int           index = m_index;
+    std::vector<CBotStack*> chunks;
+    if ( m_prev == nullptr )
+    {
+        chunks.swap(m_data->chunks);
+        delete m_data;
+    }
 
     // clears the freed block
     memset(this, 0, sizeof(CBotStack));
-    m_bOver    = bOver;
+    m_index    = index;
 
     if ( p == nullptr )
-        free( this );
+    {
+        for (CBotStack* chunk : chunks) ReleaseChunk(chunk);
+    }
 }
 
 // routine improved
@@ -126,18 +233,14 @@ CBotStack* CBotStack::AddStack(CBotInstr* instr, BlockVisibilityType bBlock)
         return m_next;                // included in an existing stack
     }
 
-    CBotStack*    p = this;
-    do
-    {
-        p ++;
-    }
-    while ( p->m_prev != nullptr );
+    CBotStack*    p = NextFreeLevel();
 
     m_next = p;                                    // chain an element
     p->m_data   = m_data;
     p->m_block  = bBlock;
     p->m_instr  = instr;
     p->m_prog   = m_prog;
+    p->m_frame  = GetFrame();
     p->m_step   = 0;
     p->m_prev   = this;
     p->m_state  = 0;
@@ -170,16 +273,12 @@ CBotStack* CBotStack::AddStack2(BlockVisibilityType bBlock)
         return m_next2;                    // included in an existing stack
     }
 
-    CBotStack*    p = this;
-    do
-    {
-        p ++;
-    }
-    while ( p->m_prev != nullptr );
+    CBotStack*    p = NextFreeLevel();
 
     m_next2 = p;                                // chain an element
     p->m_data = m_data;
     p->m_prev = this;
+    p->m_frame = GetFrame();
     p->m_block = bBlock;
     p->m_prog = m_prog;
     p->m_step = 0;
@@ -197,7 +296,7 @@ bool CBotStack::Return(CBotStack* pfils)
 {
     if ( pfils == this ) return true;    // special
 
-    if (m_var != nullptr) delete m_var;            // value replaced?
+    ReleaseVar(m_var);                          // value replaced?
     m_var = pfils->m_var;                        // result transmitted
     pfils->m_var = nullptr;                        // not to destroy the variable
 
@@ -217,12 +316,31 @@ bool CBotStack::Return(CBotStack* pfils)
     return IsOk();                        // interrupted if error
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotStack::ReturnInPlace()
+{
+    if (m_next != nullptr)
+    {
+        // releases the stack above
+        m_next->Delete();
+        m_next = nullptr;
+    }
+    if (m_next2 != nullptr)
+    {
+        // also the second stack (catch)
+        m_next2->Delete();
+        m_next2 = nullptr;
+    }
+
+    return IsOk();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotStack::ReturnKeep(CBotStack* pfils)
 {
     if ( pfils == this ) return true;    // special
 
-    if (m_var != nullptr) delete m_var;            // value replaced?
+    ReleaseVar(m_var);                          // value replaced?
     m_var = pfils->m_var;                        // result transmitted
     pfils->m_var = nullptr;                        // not to destroy the variable
 
@@ -232,7 +350,7 @@ bool CBotStack::ReturnKeep(CBotStack* pfils)
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotStack::StackOver()
 {
-    if (!m_bOver) return false;
+    if (m_index < MAXSTACK) return false;
     m_data->error = CBotErrStackOver;
     return true;
 }
@@ -336,7 +454,7 @@ bool CBotStack::GetRetVar(bool bRet)
 {
     if (m_data->error == CBotError(-3))
     {
-        if ( m_var ) delete m_var;
+        ReleaseVar(m_var);
         m_var         = m_data->retvar.release();
         m_data->error = CBotNoErr;
         return        true;
@@ -412,6 +530,87 @@ CBotVar* CBotStack::FindVar(long ident, bool bUpdate)
     return nullptr;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+CBotVar* CBotStack::FindVar(long ident, int slot, bool bUpdate)
+{
+    if (slot < 0) return FindVar(ident, bUpdate);
+
+    CBotStack*    frame = GetFrame();
+    if (slot < frame->m_slotCount)
+    {
+        CBotVar*    pp = frame->m_slots[slot];
+        if (pp != nullptr && pp->GetUniqNum() == ident)
+        {
+            if ( bUpdate )
+                pp->Update(m_data->pUser);
+
+            return pp;
+        }
+    }
+
+    // not resolved yet, search it in the levels of the function
+    CBotStack*    p = this;
+    while (p != nullptr)
+    {
+        CBotVar*    pp = p->m_listVar;
+        while ( pp != nullptr)
+        {
+            if (pp->GetUniqNum() == ident)
+            {
+                frame->SetSlot(slot, pp);
+                if ( bUpdate )
+                    pp->Update(m_data->pUser);
+
+                return pp;
+            }
+            pp = pp->m_next;
+        }
+        if (p == frame) break;
+        p = p->m_prev;
+    }
+    return FindVar(ident, bUpdate);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotStack* CBotStack::GetFrame()
+{
+    return m_func == IsFunction::YES || m_frame == nullptr ? this : m_frame;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::SetSlot(int slot, CBotVar* var)
+{
+    if (slot >= m_slotCount)
+    {
+        int         count = slot + 8;
+        CBotVar**   slots = new CBotVar*[count]();
+        for (int i = 0; i < m_slotCount; i++) slots[i] = m_slots[i];
+        delete[] m_slots;
+        m_slots = slots;
+        m_slotCount = count;
+    }
+
+    CBotVar*    old = m_slots[slot];
+    if (old != nullptr) old->m_slot = -1;
+    if (var->m_slot >= 0 && var->m_slot < m_slotCount && m_slots[var->m_slot] == var) m_slots[var->m_slot] = nullptr;
+
+    m_slots[slot] = var;
+    var->m_slot = slot;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::ReleaseSlots(CBotVar* listVar)
+{
+    CBotStack*    frame = GetFrame();
+    for (CBotVar* pp = listVar; pp != nullptr; pp = pp->m_next)
+    {
+        if (pp->m_slot < 0) continue;
+        if (pp->m_slot < frame->m_slotCount && frame->m_slots[pp->m_slot] == pp)
+            frame->m_slots[pp->m_slot] = nullptr;
+        pp->m_slot = -1;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CBotVar* CBotStack::FindVar(CBotToken& pToken, bool bUpdate)
 {
@@ -437,6 +636,8 @@ bool CBotStack::SetState(int n, int limite)
     m_state = n;
 
     m_data->timer--;                              // decrement the timer
+    if (m_data->profiler != nullptr) m_data->profiler->Tick(this, 1);
+    if (m_data->memory != nullptr && m_data->memory->TakeExceeded()) return MemoryExceeded();
     return (m_data->timer > limite);                // interrupted if timer pass
 }
 
@@ -446,9 +647,25 @@ bool CBotStack::IncState(int limite)
     m_state++;
 
     m_data->timer--;                              // decrement the timer
+    if (m_data->profiler != nullptr) m_data->profiler->Tick(this, 1);
+    if (m_data->memory != nullptr && m_data->memory->TakeExceeded()) return MemoryExceeded();
+    return (m_data->timer > limite);                // interrupted if timer pass
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotStack::ChargeTimer(int ticks, int limite)
+{
+    m_data->timer -= ticks;                       // decrement the timer
+    if (m_data->profiler != nullptr && ticks != 0) m_data->profiler->Tick(this, ticks);
     return (m_data->timer > limite);                // interrupted if timer pass
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotStack::ChargeLength(std::size_t length, int limite)
+{
+    return ChargeTimer(static_cast<int>(length / LENGTH_PER_TICK), limite);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void CBotStack::SetError(CBotError n, CBotToken* token)
 {
@@ -487,6 +704,80 @@ int CBotStack::GetTimer()
     return m_data->initimer;
 }
 
+int CBotStack::GetTicks()
+{
+    return m_data->initimer - m_data->timer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::SetIsolated(bool isolated)
+{
+    m_data->isolated = isolated;
+    if (isolated) m_data->stoppedIsolated = false;
+}
+
+bool CBotStack::IsIsolated()
+{
+    return m_data->isolated;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotStack::StopIsolated()
+{
+    if (!m_data->isolated) return false;
+    m_data->stoppedIsolated = true;
+    return true;
+}
+
+bool CBotStack::StopIsolated(CBotVar* var)
+{
+    if (!m_data->isolated || var == nullptr) return false;
+
+    CBotType type = var->GetType();
+    if (type != CBotTypPointer && type != CBotTypClass) return false;
+
+    // the instances of the programs keep the user pointer they were created with
+    CBotVarClass* instance = var->GetPointer();
+    if (instance == nullptr || instance->GetUserPtr() == OBJECTCREATED) return false;
+
+    return StopIsolated();
+}
+
+bool CBotStack::IsStoppedIsolated()
+{
+    return m_data->stoppedIsolated;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::SetSharedAccess(bool shared)
+{
+    m_data->sharedAccess = shared;
+}
+
+bool CBotStack::IsSharedAccess()
+{
+    return m_data->sharedAccess;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::SetProfiler(CBotProfiler* profiler)
+{
+    m_data->profiler = profiler;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::SetMemoryAccount(CBotMemoryAccount* account)
+{
+    m_data->memory = account;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotStack::MemoryExceeded()
+{
+    SetError(CBotErrMemory, m_instr != nullptr ? m_instr->GetToken() : nullptr);
+    return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotStack::Execute()
 {
@@ -507,6 +798,7 @@ bool CBotStack::Execute()
     }
 
     if ( instr == nullptr ) return true;                // normal execution request
+    if ( StopIsolated() ) return false;                 // the call acts on the host
 
     if (!instr->Run(nullptr, pile)) return false;            // resume interrupted execution
 
@@ -520,7 +812,7 @@ bool CBotStack::Execute()
 ////////////////////////////////////////////////////////////////////////////////
 void CBotStack::SetVar( CBotVar* var )
 {
-    if (m_var) delete m_var;    // replacement of a variable
+    ReleaseVar(m_var);          // replacement of a variable
     m_var = var;
 }
 
@@ -528,12 +820,44 @@ void CBotStack::SetVar( CBotVar* var )
 ////////////////////////////////////////////////////////////////////////////////
 void CBotStack::SetCopyVar( CBotVar* var )
 {
-    if (m_var) delete m_var;    // replacement of a variable
+    ReleaseVar(m_var);          // replacement of a variable
 
-    m_var = CBotVar::Create("", var->GetTypResult(CBotVar::GetTypeMode::CLASS_AS_INTRINSIC));
+    CBotTypResult type = var->GetTypResult(CBotVar::GetTypeMode::CLASS_AS_INTRINSIC);
+    m_var = type.GetType() <= CBotTypBoolean ? CreateVar(static_cast<CBotType>(type.GetType()))
+                                             : CBotVar::Create("", type);
     m_var->Copy( var );
 }
 
+////////////////////////////////////////////////////////////////////////////////
+CBotVar* CBotStack::CreateVar(CBotType type)
+{
+    if (type <= CBotTypBoolean)
+    {
+        auto& spares = m_data->spareVars[type];
+        if (!spares.empty())
+        {
+            CBotVar* var = spares.back().release();
+            spares.pop_back();
+            return var;
+        }
+    }
+    return CBotVar::Create("", type);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::ReleaseVar(CBotVar* var)
+{
+    if (var == nullptr) return;
+
+    int type = var->GetType();
+    if (type <= CBotTypBoolean && m_data->spareVars[type].size() < MAX_SPARE_VARS && var->Recycle())
+    {
+        m_data->spareVars[type].emplace_back(var);
+        return;
+    }
+    delete var;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CBotVar* CBotStack::GetVar()
 {
@@ -567,10 +891,25 @@ void CBotStack::AddVar(CBotVar* pVar)
 void CBotStack::SetProgram(CBotProgram* p)
 {
     m_prog = p;
-    m_func = IsFunction::YES;
+    if (m_func != IsFunction::YES)
+    {
+        m_func = IsFunction::YES;
+        // the levels above already exist when restoring a saved state
+        if (m_next != nullptr) m_next->SetFrame(this);
+        if (m_next2 != nullptr) m_next2->SetFrame(this);
+    }
     if (this == m_data->topStack) m_data->baseProg = p;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::SetFrame(CBotStack* frame)
+{
+    m_frame = frame;
+    if (m_func == IsFunction::YES) return;
+    if (m_next != nullptr) m_next->SetFrame(frame);
+    if (m_next2 != nullptr) m_next2->SetFrame(frame);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CBotProgram*  CBotStack::GetProgram(bool bFirst)
 {
@@ -590,7 +929,7 @@ void CBotStack::SetUserPtr(void* user)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotStack::ExecuteCall(long& nIdent, CBotToken* token, CBotVar** ppVar, const CBotTypResult& rettype)
+bool CBotStack::ExecuteCall(long nIdent, CBotToken* token, CBotVar** ppVar, const CBotTypResult& rettype)
 {
     int res;
 
@@ -599,7 +938,7 @@ bool CBotStack::ExecuteCall(long& nIdent, CBotToken* token, CBotVar** ppVar, con
     res = m_prog->GetExternalCalls()->DoCall(nullptr, nullptr, ppVar, this, rettype);
     if (res >= 0) return res;
 
-    res = CBotFunction::DoCall(m_prog, m_prog->GetFunctions(), nIdent, "", ppVar, this, token);
+    res = CBotFunction::DoCall(m_prog, nIdent, "", ppVar, this, token);
     if (res >= 0) return res;
 
     // if not found (recompile?) seeks by name
@@ -608,7 +947,7 @@ bool CBotStack::ExecuteCall(long& nIdent, CBotToken* token, CBotVar** ppVar, con
     res = m_prog->GetExternalCalls()->DoCall(token, nullptr, ppVar, this, rettype);
     if (res >= 0) return res;
 
-    res = CBotFunction::DoCall(m_prog, m_prog->GetFunctions(), nIdent, token->GetString(), ppVar, this, token);
+    res = CBotFunction::DoCall(m_prog, nIdent, token->GetString(), ppVar, this, token);
     if (res >= 0) return res;
 
     SetError(CBotErrUndefFunc, token);
@@ -616,14 +955,28 @@ bool CBotStack::ExecuteCall(long& nIdent, CBotToken* token, CBotVar** ppVar, con
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void CBotStack::RestoreCall(long& nIdent, CBotToken* token, CBotVar** ppVar)
+bool CBotStack::ExecuteCall(CBotExternalCall* call, CBotToken* token, CBotVar** ppVar, const CBotTypResult& rettype)
+{
+    return m_prog->GetExternalCalls()->DoCall(call, token, nullptr, ppVar, this, rettype);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::RestoreCall(long nIdent, CBotToken* token, CBotVar** ppVar)
 {
     if (m_next == nullptr) return;
 
     if (m_prog->GetExternalCalls()->RestoreCall(token, nullptr, ppVar, this))
         return;
 
-    CBotFunction::RestoreCall(m_prog->GetFunctions(), nIdent, token->GetString(), ppVar, this);
+    CBotFunction::RestoreCall(m_prog, nIdent, token->GetString(), ppVar, this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotStack::RestoreCall(CBotExternalCall* call)
+{
+    if (m_next == nullptr) return;
+
+    m_prog->GetExternalCalls()->RestoreCall(call, nullptr, this);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -710,104 +1063,104 @@ CBotVar* CBotStack::GetStackVars(std::string& functionName, int level)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotStack::SaveState(std::ostream &ostr)
+bool CBotStack::SaveState(CBotStateWriter &writer)
 {
     if (m_next2 != nullptr)
     {
-        if (!WriteWord(ostr, 2)) return false; // a marker of type (m_next2)
-        if (!m_next2->SaveState(ostr)) return false; // saves the next element
+        if (!WriteWord(writer, 2)) return false; // a marker of type (m_next2)
+        if (!m_next2->SaveState(writer)) return false; // saves the next element
     }
     else
     {
-        if (!WriteWord(ostr, 1)) return false; // a marker of type (m_next)
+        if (!WriteWord(writer, 1)) return false; // a marker of type (m_next)
     }
-    if (!WriteWord(ostr, static_cast<unsigned short>(m_block))) return false;
-    if (!WriteInt(ostr, m_state)) return false;
-    if (!WriteWord(ostr, 0)) return false; // for backwards combatibility (m_bDontDelete)
-    if (!WriteInt(ostr, m_step)) return false;
+    if (!WriteWord(writer, static_cast<unsigned short>(m_block))) return false;
+    if (!WriteInt(writer, m_state)) return false;
+    if (!WriteWord(writer, 0)) return false; // for backwards combatibility (m_bDontDelete)
+    if (!WriteInt(writer, m_step)) return false;
 
-    if (!SaveVars(ostr, m_var)) return false;          // current result
-    if (!SaveVars(ostr, m_listVar)) return false;      // local variables
+    if (!SaveVars(writer, m_var)) return false;          // current result
+    if (!SaveVars(writer, m_listVar)) return false;      // local variables
 
     if (m_next != nullptr)
     {
-        if (!m_next->SaveState(ostr)) return false; // saves the next element
+        if (!m_next->SaveState(writer)) return false; // saves the next element
     }
     else
     {
-        if (!WriteWord(ostr, 0)) return false; // 0 - CBotStack::SaveState terminator
+        if (!WriteWord(writer, 0)) return false; // 0 - CBotStack::SaveState terminator
     }
     return true;
 }
 
-bool SaveVars(std::ostream &ostr, CBotVar* pVar)
+bool SaveVars(CBotStateWriter &writer, CBotVar* pVar)
 {
     while (pVar != nullptr)
     {
-        if (!pVar->Save0State(ostr)) return false; // common header
-        if (!pVar->Save1State(ostr)) return false; // saves the data
+        if (!pVar->Save0State(writer)) return false; // common header
+        if (!pVar->Save1State(writer)) return false; // saves the data
 
         pVar = pVar->GetNext();
     }
-    return WriteWord(ostr, 0); // 0 - CBot::SaveVars terminator
+    return WriteWord(writer, 0); // 0 - CBot::SaveVars terminator
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotStack::RestoreState(std::istream &istr, CBotStack* &pStack)
+bool CBotStack::RestoreState(CBotStateReader &reader, CBotStack* &pStack)
 {
     unsigned short w;
 
     if (pStack != this) pStack = nullptr;
-    if (!ReadWord(istr, w)) return false;
+    if (!ReadWord(reader, w)) return false;
     if ( w == 0 ) return true; // 0 - CBotStack::SaveState terminator
 
     if (pStack == nullptr) pStack = AddStack();
 
     if ( w == 2 ) // 2 - m_next2
     {
-        if (!pStack->RestoreState(istr, pStack->m_next2)) return false;
+        if (!pStack->RestoreState(reader, pStack->m_next2)) return false;
     }
 
-    if (!ReadWord(istr, w)) return false;
+    if (!ReadWord(reader, w)) return false;
     pStack->m_block = static_cast<BlockVisibilityType>(w);
 
     int state;
-    if (!ReadInt(istr, state)) return false;
+    if (!ReadInt(reader, state)) return false;
     pStack->SetState(state);
 
-    if (!ReadWord(istr, w)) return false; // backwards compatibility (m_bDontDelete)
+    if (!ReadWord(reader, w)) return false; // backwards compatibility (m_bDontDelete)
 
-    if (!ReadInt(istr, state)) return false;
+    if (!ReadInt(reader, state)) return false;
     pStack->m_step = state;
 
-    if (!CBotVar::RestoreState(istr, pStack->m_var)) return false;     // temp variable
-    if (!CBotVar::RestoreState(istr, pStack->m_listVar)) return false; // local variables
+    if (!CBotVar::RestoreState(reader, pStack->m_var)) return false;     // temp variable
+    if (!CBotVar::RestoreState(reader, pStack->m_listVar)) return false; // local variables
 
-    return pStack->RestoreState(istr, pStack->m_next);
+    return pStack->RestoreState(reader, pStack->m_next);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotVar::Save0State(std::ostream &ostr)
+bool CBotVar::Save0State(CBotStateWriter &writer)
 {
-    if (!WriteWord(ostr, 100+static_cast<int>(m_mPrivate)))return false; // private variable?
-    if (!WriteWord(ostr, m_bStatic))return false;            // static variable?
-    if (!WriteWord(ostr, m_type.GetType()))return false;     // saves the type (always non-zero)
+    if (!WriteWord(writer, 100+static_cast<int>(m_mPrivate)))return false; // private variable?
+    if (!WriteWord(writer, m_bStatic))return false;            // static variable?
+    if (!WriteWord(writer, m_type.GetType()))return false;     // saves the type (always non-zero)
 
     if (m_type.Eq(CBotTypPointer) && GetPointer() != nullptr)
     {
         if (GetPointer()->m_bConstructor)                    // constructor was called?
         {
-            if (!WriteWord(ostr, (2000 + static_cast<unsigned short>(m_binit)) )) return false;
-            return WriteString(ostr, m_token->GetString());  // and variable name
+            if (!WriteWord(writer, (2000 + static_cast<unsigned short>(m_binit)) )) return false;
+            return WriteString(writer, GetName());  // and variable name
         }
     }
 
-    if (!WriteWord(ostr, static_cast<unsigned short>(m_binit))) return false;        // variable defined?
-    return WriteString(ostr, m_token->GetString());          // and variable name
+    if (!WriteWord(writer, static_cast<unsigned short>(m_binit))) return false;        // variable defined?
+    return WriteString(writer, GetName());          // and variable name
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
+bool CBotVar::RestoreState(CBotStateReader &reader, CBotVar* &pVar)
 {
     unsigned short        w, wi, prv, st;
 
@@ -819,27 +1172,27 @@ bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
 
     while ( true )            // retrieves a list
     {
-        if (!ReadWord(istr, w)) return false;                      // private or type?
+        if (!ReadWord(reader, w)) return false;                      // private or type?
         if ( w == 0 ) return true; // 0 - CBot::SaveVars terminator
 
         std::string defnum;
         if ( w == 200 )
         {
-            if (!ReadString(istr, defnum)) return false;          // number with identifier
-            if (!ReadWord(istr, w)) return false;                 // type
+            if (!ReadString(reader, defnum)) return false;          // number with identifier
+            if (!ReadWord(reader, w)) return false;                 // type
         }
 
         prv = 100; st = 0;
         if ( w >= 100 )
         {
             prv = w;
-            if (!ReadWord(istr, st)) return false;              // static
-            if (!ReadWord(istr, w)) return false;               // type
+            if (!ReadWord(reader, st)) return false;              // static
+            if (!ReadWord(reader, w)) return false;               // type
         }
 
         if ( w == CBotTypClass ) w = CBotTypIntrinsic;            // necessarily intrinsic
 
-        if (!ReadWord(istr, wi)) return false;                  // init ?
+        if (!ReadWord(reader, wi)) return false;                  // init ?
         bool bConstructor = false;
         if (w == CBotTypPointer && wi >= 2000)
         {
@@ -849,7 +1202,7 @@ bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
 
         CBotVar::InitType initType = static_cast<CBotVar::InitType>(wi);
         std::string varname;
-        if (!ReadString(istr, varname)) return false;           // variable name
+        if (!ReadString(reader, varname)) return false;           // variable name
         CBotToken token(varname, std::string());
 
         bool isClass = false;
@@ -858,56 +1211,56 @@ bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
         {
         case CBotTypBoolean:
             char valBool;
-            if (!ReadByte(istr, valBool)) return false;
+            if (!ReadByte(reader, valBool)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
             pNew->SetValInt(valBool);
             break;
         case CBotTypByte:
             char valByte;
-            if (!ReadByte(istr, valByte)) return false;
+            if (!ReadByte(reader, valByte)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
             pNew->SetValByte(valByte);
             break;
         case CBotTypShort:
             short valShort;
-            if (!ReadShort(istr, valShort)) return false;
+            if (!ReadShort(reader, valShort)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
             pNew->SetValShort(valShort);
             break;
         case CBotTypChar:
             uint32_t valChar;
-            if (!ReadUInt32(istr, valChar)) return false;
+            if (!ReadUInt32(reader, valChar)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
             pNew->SetValChar(valChar);
             break;
         case CBotTypInt:
             int valInt;
-            if (!ReadInt(istr, valInt)) return false;
+            if (!ReadInt(reader, valInt)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
             pNew->SetValInt(valInt, defnum);
             break;
         case CBotTypLong:
             long valLong;
-            if (!ReadLong(istr, valLong)) return false;
+            if (!ReadLong(reader, valLong)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
-            pNew->SetValInt(valLong);
+            pNew->SetValLong(valLong);
             break;
         case CBotTypFloat:
             float valFloat;
-            if (!ReadFloat(istr, valFloat)) return false;
+            if (!ReadFloat(reader, valFloat)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
             pNew->SetValFloat(valFloat);
             break;
         case CBotTypDouble:
             double valDouble;
-            if (!ReadDouble(istr, valDouble)) return false;
+            if (!ReadDouble(reader, valDouble)) return false;
             pNew = CBotVar::Create(token, w);                        // creates a variable
             pNew->SetValDouble(valDouble);
             break;
         case CBotTypString:
             {
                 std::string valString;
-                if (!ReadString(istr, valString)) return false;
+                if (!ReadString(reader, valString)) return false;
                 pNew = CBotVar::Create(token, w);                    // creates a variable
                 pNew->SetValString(valString);
                 break;
@@ -919,8 +1272,8 @@ bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
             {
                 CBotTypResult    r;
                 long            id;
-                if (!ReadType(istr, r)) return false;               // complete type
-                if (!ReadLong(istr, id)) return false;
+                if (!ReadType(reader, r)) return false;               // complete type
+                if (!ReadLong(reader, id)) return false;
 
                 {
                     CBotVar* p = nullptr;
@@ -928,7 +1281,8 @@ bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
 
                     pNew = new CBotVarClass(token, r);                // directly creates an instance
                                                                     // attention cptuse = 0
-                    if (!RestoreState(istr, (static_cast<CBotVarClass*>(pNew))->m_pVar)) return false;
+                    if (!RestoreState(reader, (static_cast<CBotVarClass*>(pNew))->m_pVar)) return false;
+                    static_cast<CBotVarClass*>(pNew)->ChargeMemory();
                     pNew->SetIdent(id);
 
                     if (isClass && p == nullptr) // set id for each item in this instance
@@ -961,18 +1315,18 @@ bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
         case CBotTypNullPointer:
         {
             std::string className;
-            if (!ReadString(istr, className)) return false; // name of the class
+            if (!ReadString(reader, className)) return false; // name of the class
             {
 //                CBotVarClass* p = nullptr;
                 long id;
-                if (!ReadLong(istr, id)) return false;
+                if (!ReadLong(reader, id)) return false;
 //                if ( id ) p = CBotVarClass::Find(id);        // found the instance (made by RestoreInstance)
 
                 CBotTypResult ptrType(w, className);
                 pNew = CBotVar::Create(token, ptrType);        // creates a variable
                 // returns a copy of the original instance
                 CBotVar* pInstance = nullptr;
-                if (!CBotVar::RestoreState(istr, pInstance)) return false;
+                if (!CBotVar::RestoreState(reader, pInstance)) return false;
                 (static_cast<CBotVarPointer*>(pNew))->SetPointer( pInstance );            // and point over
 
                 if (bConstructor) pNew->ConstructorSet(); // constructor was called
@@ -986,13 +1340,13 @@ bool CBotVar::RestoreState(std::istream &istr, CBotVar* &pVar)
         case CBotTypArrayPointer:
             {
                 CBotTypResult    r;
-                if (!ReadType(istr, r)) return false;
+                if (!ReadType(reader, r)) return false;
 
                 pNew = CBotVar::Create(token, r);                        // creates a variable
 
                 // returns a copy of the original instance
                 CBotVar* pInstance = nullptr;
-                if (!CBotVar::RestoreState(istr, pInstance)) return false;
+                if (!CBotVar::RestoreState(reader, pInstance)) return false;
                 (static_cast<CBotVarPointer*>(pNew))->SetPointer( pInstance );            // and point over
             }
             break;
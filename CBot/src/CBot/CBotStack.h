@@ -33,8 +33,12 @@ namespace CBot
 class CBotInstr;
 class CBotExternalCall;
 class CBotVar;
+class CBotProfiler;
+class CBotMemoryAccount;
 class CBotProgram;
 class CBotToken;
+class CBotStateWriter;
+class CBotStateReader;
 
 /**
  * \brief The execution stack
@@ -62,6 +66,10 @@ public:
 
     /**
      * \brief Allocate the stack
+     *
+     * The levels are allocated by chunks as the stack grows, and the chunks of
+     * deleted stacks are reused.
+     *
      * \return pointer to created stack
      */
     static CBotStack* AllocateStack();
@@ -69,6 +77,22 @@ public:
     /** \brief Remove the current stack */
     void Delete();
 
+    /**
+     * \brief Chunk counters, see GetChunkStats()
+     */
+    struct ChunkStats
+    {
+        //! Number of chunks given to the stacks, recycled or not
+        long taken = 0;
+        //! Number of chunks allocated from the system for them
+        long allocated = 0;
+    };
+
+    /**
+     * \brief Returns the chunk counters of the calling thread since its start
+     */
+    static const ChunkStats& GetChunkStats();
+
     CBotStack() = delete;
     ~CBotStack() = delete;
 
@@ -184,6 +208,20 @@ public:
      */
     CBotVar* FindVar(long ident, bool bUpdate);
 
+    /**
+     * \brief Fetch a local variable of the current function by its slot
+     *
+     * The slot is resolved when compiling, see CBotCStack::GetVarSlot(). The first access
+     * (or the first one after RestoreState()) searches the variable by its identifier, the
+     * next ones take it directly from the slot table of the function.
+     *
+     * \param ident Unique identifier of a variable
+     * \param slot Slot of the variable, -1 if it has none (same as FindVar(long, bool) then)
+     * \param bUpdate true to automatically call update function for classes, see CBotClass::SetUpdateFunc()
+     * \return Found variable, nullptr if not found
+     */
+    CBotVar* FindVar(long ident, int slot, bool bUpdate);
+
     /**
      * \brief Find variable by its token and returns a copy of it
      *
@@ -264,6 +302,12 @@ public:
      * \return IsOk()
      */
     bool            ReturnKeep(CBotStack* pFils);
+    /**
+     * \brief Like Return() but keeps the result of this stack, which was updated in place
+     *
+     * \return IsOk()
+     */
+    bool            ReturnInPlace();
 
     /**
      * \todo Document
@@ -295,7 +339,7 @@ public:
      * \brief Set execution state
      * \param n New state
      * \param lim Required amount of "ticks" on the timer required to allow to continue execution. By default allows a little overflow (up to 10 ticks)
-     * \return false if timer requests interruption (timer <= limit)
+     * \return false if timer requests interruption (timer <= limit), or with ::CBotErrMemory if the program went over its memory limit, see SetMemoryAccount()
      */
     bool            SetState(int n, int lim = -10);
     /**
@@ -309,9 +353,29 @@ public:
     /**
      * \brief Increase the execution state by one
      * \param lim Required amount of "ticks" on the timer required to allow to continue execution. By default allows a little overflow (up to 10 ticks)
-     * \return false if timer requests interruption (timer <= limit)
+     * \return Same as SetState()
      */
     bool            IncState(int lim = -10);
+    /**
+     * \brief Charge several "ticks" on the timer at once, without changing the execution state
+     *
+     * Used by instructions that do several steps of work in one go (see CBotByteCode)
+     *
+     * \param ticks Number of ticks to charge
+     * \param lim Same as in SetState()
+     * \return false if timer requests interruption (timer <= limit)
+     */
+    bool            ChargeTimer(int ticks, int lim = -10);
+    /**
+     * \brief Charge the ticks of an operation on a string of the given length
+     *
+     * Strings shorter than #LENGTH_PER_TICK are free, longer ones cost one tick per #LENGTH_PER_TICK characters
+     *
+     * \param length Length of the string
+     * \param lim Same as in SetState()
+     * \return false if timer requests interruption (timer <= limit)
+     */
+    bool            ChargeLength(std::size_t length, int lim = -10);
 
     /**
      * \brief Check if we are in step by step execution mode
@@ -342,6 +406,23 @@ public:
      * \param var Variable to copy as result
      */
     void            SetCopyVar(CBotVar* var);
+    /**
+     * \brief Creates an unnamed variable for a result, of a number or boolean type
+     *
+     * The results released by the levels of this stack are kept to be given back here, so that
+     * the loops don't create and destroy variables at each iteration. The variable is not initialized.
+     *
+     * \param type Type of the variable
+     * \return New variable, to give to SetVar()
+     */
+    CBotVar*        CreateVar(CBotType type);
+    /**
+     * \brief Destroys a variable no longer used, or keeps it for CreateVar()
+     *
+     * The results replaced on the levels are released this way, other variables only need it
+     * if they were created by CreateVar() and not given to SetVar().
+     */
+    void            ReleaseVar(CBotVar* var);
     /**
      * \brief Return result variable
      * \return Variable set with SetVar() or SetCopyVar()
@@ -408,19 +489,32 @@ public:
 
     /**
      * \brief Execute a function call, either external or user-defined
-     * \param[in, out] nIdent Unique function identifier, if not found will be updated
+     * \param nIdent Unique function identifier, if not found the function is searched by name
+     * \param token Function name token
+     * \param ppVar Array of function arguments
+     * \param rettype Expected return type
+     */
+    bool            ExecuteCall(long nIdent, CBotToken* token, CBotVar** ppVar, const CBotTypResult& rettype);
+    /**
+     * \brief Execute a call to an external function already found by the caller
+     * \param call Function to call, see CBotExternalCallList::Find()
      * \param token Function name token
      * \param ppVar Array of function arguments
      * \param rettype Expected return type
      */
-    bool            ExecuteCall(long& nIdent, CBotToken* token, CBotVar** ppVar, const CBotTypResult& rettype);
+    bool            ExecuteCall(CBotExternalCall* call, CBotToken* token, CBotVar** ppVar, const CBotTypResult& rettype);
     /**
      * \brief Restore a function call after the program state has been restored from a file
-     * \param[in, out] nIdent Unique function identifier, if not found will be updated
+     * \param nIdent Unique function identifier, if not found the function is searched by name
      * \param token Function name token
      * \param ppVar Array of function arguments
      */
-    void            RestoreCall(long& nIdent, CBotToken* token, CBotVar** ppVar);
+    void            RestoreCall(long nIdent, CBotToken* token, CBotVar** ppVar);
+    /**
+     * \brief Restore a call to an external function already found by the caller
+     * \param call Called function, see CBotExternalCallList::Find()
+     */
+    void            RestoreCall(CBotExternalCall* call);
 
     //@}
 
@@ -428,8 +522,8 @@ public:
     //! \name Write to file
     //@{
 
-    bool            SaveState(std::ostream &ostr);
-    bool            RestoreState(std::istream &istr, CBotStack* &pStack);
+    bool            SaveState(CBotStateWriter &writer);
+    bool            RestoreState(CBotStateReader &reader, CBotStack* &pStack);
 
     //@}
 
@@ -445,6 +539,59 @@ public:
      * \brief Get the current configured maximum number of "timer ticks" (parts of instructions) to execute
      */
     int             GetTimer();
+    /**
+     * \brief Get the number of "timer ticks" used since the last Reset()
+     */
+    int             GetTicks();
+
+    /**
+     * \brief Enables or disables the isolated mode of the whole stack, see CBotProgram::RunIsolated()
+     */
+    void            SetIsolated(bool isolated);
+    /**
+     * \brief Tells if the stack runs in isolated mode
+     */
+    bool            IsIsolated();
+    /**
+     * \brief Interrupts an isolated execution before an operation shared with other programs or with the host
+     *
+     * The instruction then returns false right away, and must be able to do the operation
+     * again when the execution resumes (as after IfStep())
+     *
+     * \return true if the execution must be interrupted
+     */
+    bool            StopIsolated();
+    /**
+     * \brief Interrupts an isolated execution before an access to an object of the host
+     * \param var Variable accessed, the execution is only interrupted if it points to an instance with a user pointer (see CBotVar::SetUserPtr())
+     * \return true if the execution must be interrupted
+     */
+    bool            StopIsolated(CBotVar* var);
+    /**
+     * \brief Tells if the execution was interrupted by StopIsolated() since the last SetIsolated()
+     */
+    bool            IsStoppedIsolated();
+
+    /**
+     * \brief Notes that the execution accessed the static fields of a class, which all the programs share
+     * \param shared false to clear the note, see CBotProgram::IsStateChanged()
+     */
+    void            SetSharedAccess(bool shared = true);
+    /**
+     * \brief Tells if SetSharedAccess() was called since the note was cleared
+     */
+    bool            IsSharedAccess();
+
+    /**
+     * \brief Sets the profiler charged with the ticks of the whole stack, see CBotProgram::SetProfiler()
+     */
+    void            SetProfiler(CBotProfiler* profiler);
+
+    /**
+     * \brief Sets the account whose limit SetState() and IncState() check, see CBotProgram::SetMemoryLimit()
+     * \param account Account, nullptr not to check any
+     */
+    void            SetMemoryAccount(CBotMemoryAccount* account);
 
     /**
      * \brief Get current position in the program
@@ -464,6 +611,48 @@ public:
     bool            IsCallFinished();
 
 private:
+    /**
+     * \brief Raises ::CBotErrMemory on the current instruction
+     * \return false
+     */
+    bool            MemoryExceeded();
+
+    /**
+     * \brief Stack level of the function this level belongs to, which holds the slot table
+     */
+    CBotStack*      GetFrame();
+
+    /**
+     * \brief Attaches this level and the ones above to the given function level
+     */
+    void            SetFrame(CBotStack* frame);
+
+    /**
+     * \brief Stores a variable in the slot table of this (function) level
+     */
+    void            SetSlot(int slot, CBotVar* var);
+
+    /**
+     * \brief Removes the given variables from the slot table of their function
+     */
+    void            ReleaseSlots(CBotVar* listVar);
+
+    /**
+     * \brief Gives a chunk of empty levels
+     * \param first Position of the first level of the chunk in its stack
+     */
+    static CBotStack* AllocateChunk(int first);
+
+    /**
+     * \brief Keeps a chunk for the next stacks
+     */
+    static void     ReleaseChunk(CBotStack* chunk);
+
+    /**
+     * \brief Finds the first free level above this one, allocating a new chunk if needed
+     */
+    CBotStack*      NextFreeLevel();
+
     CBotStack*        m_next;
     CBotStack*        m_next2;
     CBotStack*        m_prev;
@@ -479,7 +668,7 @@ private:
     CBotVar*        m_listVar;                    // variables declared at this level
 
     BlockVisibilityType m_block;                    // is part of a block (variables are local to this block)
-    bool            m_bOver;                    // stack limits?
+    int             m_index;                    // position in the stack, see StackOver()
     //! CBotProgram instance the execution is in in this stack level
     CBotProgram*    m_prog;
 
@@ -490,7 +679,15 @@ private:
     //! Extern call on this level (only if m_func == IsFunction::EXTERNAL_CALL)
     CBotExternalCall* m_call;
 
+    //! Nearest level above with m_func == IsFunction::YES, see GetFrame()
+    CBotStack*      m_frame;
+    //! Local variables of the function by slot (only if m_func == IsFunction::YES)
+    CBotVar**       m_slots;
+    int             m_slotCount;
+
     bool m_callFinished;
+
+    friend class CBotProfiler;
 };
 
 } // namespace CBot
@@ -19,9 +19,14 @@
 
 #include "CBot/CBotToken.h"
 
+#include "CBot/CBotContextState.h"
+
+#include <algorithm>
+#include <array>
 #include <cstdarg>
 #include <cassert>
-#include <map>
+#include <cstdint>
+#include <iterator>
 
 namespace CBot
 {
@@ -31,9 +36,15 @@ namespace
     static const std::string TX_UNDEF_VALUE = "undefined";
 }
 
-//! \brief Keeps the string corresponding to keyword ID
-//! Map is filled with id-string pars that are needed for CBot language parsing
-static const std::map<std::string, TokenId> KEYWORDS{
+//! A keyword or an operator of the language
+struct Keyword
+{
+    std::string_view text;
+    TokenId id;
+};
+
+//! Keeps the string corresponding to keyword ID, see GetKeyWord()
+static constexpr Keyword KEYWORDS[] = {
     {"if",           ID_IF},
     {"else",         ID_ELSE},
     {"while",        ID_WHILE},
@@ -125,17 +136,70 @@ static const std::map<std::string, TokenId> KEYWORDS{
     {"%",            ID_MODULO},
     {"**",           ID_POWER},
     {"%=",           ID_ASSMODULO},
-    {TX_UNDEF_VALUE, TX_UNDEF},
-    {"not a number", TX_NAN}
+    {"undefined",    TX_UNDEF},
+    {"not a number", TX_NAN},
 };
 
+//! Length of the longest keyword, no longer word has to be looked up
+static constexpr std::size_t KEYWORD_MAX_LENGTH = []
+{
+    std::size_t length = 0;
+    for (const Keyword& keyword : KEYWORDS) length = std::max(length, keyword.text.size());
+    return length;
+}();
+
+//! Number of slots of the keyword table, large enough to find a perfect hash with few seeds
+static constexpr std::size_t KEYWORD_SLOTS = 1024;
+
+//! FNV-1a hash of a word, with a seed to choose for the keyword table
+static constexpr uint32_t HashKeyword(std::string_view text, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : text)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 16);
+}
+
+//! Perfect hash table of the keywords, built at compile time
+struct KeywordTable
+{
+    //! Seed of HashKeyword() giving a different slot to each keyword, 0 if none was found
+    uint32_t seed = 0;
+    //! Index in KEYWORDS + 1 for each slot, 0 for the empty ones
+    uint8_t slots[KEYWORD_SLOTS] = {};
+};
+
+static constexpr KeywordTable MakeKeywordTable()
+{
+    static_assert(std::size(KEYWORDS) < 256, "the slots can't hold the index of each keyword");
+    for (uint32_t seed = 1; seed < 10000; ++seed)
+    {
+        KeywordTable table;
+        table.seed = seed;
+        bool perfect = true;
+        for (std::size_t i = 0; i < std::size(KEYWORDS) && perfect; ++i)
+        {
+            uint8_t& slot = table.slots[HashKeyword(KEYWORDS[i].text, seed) % KEYWORD_SLOTS];
+            perfect = (slot == 0);
+            slot = static_cast<uint8_t>(i + 1);
+        }
+        if (perfect) return table;
+    }
+    return KeywordTable();
+}
+
+static constexpr KeywordTable KEYWORD_TABLE = MakeKeywordTable();
+static_assert(KEYWORD_TABLE.seed != 0, "no perfect hash found for the keywords, increase KEYWORD_SLOTS");
+
 const std::string& UndefinedTokenString()
 {
     return TX_UNDEF_VALUE;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-std::map<std::string, long> CBotToken::m_defineNum;
 ////////////////////////////////////////////////////////////////////////////////
 CBotToken::CBotToken()
 {
@@ -172,7 +236,15 @@ CBotToken::~CBotToken()
 ////////////////////////////////////////////////////////////////////////////////
 void CBotToken::ClearDefineNum()
 {
-    m_defineNum.clear();
+    CBotContext* context = CBotContext::GetCurrent();
+    GetContextState(context).definitions.defineNum.clear();
+    GetContextState(context).definitions.defineNumRevision++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long CBotToken::GetDefineNumRevision()
+{
+    return GetCurrentState().definitions.defineNumRevision;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -211,7 +283,7 @@ long CBotToken::GetKeywordId()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-const std::string& CBotToken::GetString()
+const std::string& CBotToken::GetString() const
 {
     return m_text;
 }
@@ -243,242 +315,206 @@ void CBotToken::SetPos(int start, int end)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// TODO: CharInList could probably be optimized to conditions like (*c >= '0' && *c <= '9') to gain some performance
-static char    sep1[] = " \r\n\t,:()[]{}-+*/=;><!~^|&%.\"\'?";
-static char    sep2[] = " \r\n\t";                           // only separators
-static char    sep3[] = ",:()[]{}-+*/=;<>!~^|&%.?";          // operational separators
-static char    num[]  = "0123456789";                        // point (single) is tested separately
-static char    hexnum[]   = "0123456789ABCDEFabcdef";
-static char    nch[]  = "\r\n\t";                            // forbidden in chains
+//! Classes of the characters for the lexer, see CHAR_CLASSES
+enum CharClass : unsigned char
+{
+    CHAR_SEP      = 1 << 0,     //!< ends a word: " \r\n\t,:()[]{}-+*/=;><!~^|&%.\"\'?"
+    CHAR_BLANK    = 1 << 1,     //!< only separator: " \r\n\t"
+    CHAR_OPERATOR = 1 << 2,     //!< operational separator: ",:()[]{}-+*/=;<>!~^|&%.?"
+    CHAR_DIGIT    = 1 << 3,     //!< "0123456789", the point (single) is tested separately
+    CHAR_HEX      = 1 << 4,     //!< "0123456789ABCDEFabcdef"
+    CHAR_NOSTRING = 1 << 5,     //!< forbidden in strings: "\r\n\t"
+};
 
-////////////////////////////////////////////////////////////////////////////////
-CBotToken*  CBotToken::NextToken(const char*& program, bool first)
+static constexpr std::array<unsigned char, 256> MakeCharClasses()
 {
-    std::string token; // found token
-    std::string sep;   // separators after the token
-    bool stop = first;
+    std::array<unsigned char, 256> classes{};
+    auto add = [&classes](std::string_view chars, CharClass charClass)
+    {
+        for (char c : chars) classes[static_cast<unsigned char>(c)] |= charClass;
+    };
+    add(" \r\n\t,:()[]{}-+*/=;><!~^|&%.\"\'?", CHAR_SEP);
+    add(" \r\n\t", CHAR_BLANK);
+    add(",:()[]{}-+*/=;<>!~^|&%.?", CHAR_OPERATOR);
+    add("0123456789", CHAR_DIGIT);
+    add("0123456789ABCDEFabcdef", CHAR_HEX);
+    add("\r\n\t", CHAR_NOSTRING);
+    return classes;
+}
+
+static constexpr std::array<unsigned char, 256> CHAR_CLASSES = MakeCharClasses();
 
-    if (*program == 0) return nullptr;
+static inline bool IsCharClass(char c, unsigned char charClass)
+{
+    return (CHAR_CLASSES[static_cast<unsigned char>(c)] & charClass) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotToken* CBotToken::NextToken(std::string_view program, std::size_t& pos, bool first)
+{
+    // the program also ends at the first null character
+    auto at = [&program](std::size_t i) { return i < program.size() ? program[i] : '\0'; };
 
-    char c = *(program++);                 // next character
+    const std::size_t start = pos;
+    std::size_t i = start;               // position of the next character
+    if (at(i) == 0) return nullptr;
 
+    bool stop = first;
     if (!first)
     {
-        token = c;                            // built the word
-        c   = *(program++);                 // next character
+        const char lead = program[i++];  // first character of the word
+        char c = at(i);
 
-        // special case for strings
-        if (token[0] == '\"' )
+        if (lead == '\"')               // special case for strings
         {
-            while (c != 0 && c != '\"' && !CharInList(c, nch))
+            while (c != 0 && c != '\"' && !IsCharClass(c, CHAR_NOSTRING))
             {
-                if ( c == '\\' )
+                if (c == '\\')
                 {
-                    token += c;
-                    c = *(program++);
-                    if (c == 0 || CharInList(c, nch)) break;
+                    c = at(++i);
+                    if (c == 0 || IsCharClass(c, CHAR_NOSTRING)) break;
                 }
-                token += c;
-                c = *(program++);
-            }
-            if ( c == '\"' )
-            {
-                token += c;                           // string is complete
-                c   = *(program++);                 // next character
+                c = at(++i);
             }
+            if (c == '\"') ++i;          // string is complete
             stop = true;
         }
-
-        // special case for characters
-        if (token[0] == '\'')
+        else if (lead == '\'')          // special case for characters
         {
-            if (c == '\\')       // escape sequence
+            if (c == '\\')               // escape sequence
             {
-                token += c;
-                c = *(program++);
-
+                c = at(++i);
                 if (c == 'u' || c == 'U') // unicode escape
                 {
                     int maxlen = (c == 'u') ? 4 : 8;
-                    token += c;
-                    c = *(program++);
-                    for (int i = 0; i < maxlen; i++)
-                    {
-                        if (c == 0 || !CharInList(c, hexnum)) break;
-                        token += c;
-                        c = *(program++);
-                    }
+                    c = at(++i);
+                    for (int n = 0; n < maxlen && c != 0 && IsCharClass(c, CHAR_HEX); n++) c = at(++i);
                 }
-                else if (c != 0 && !CharInList(c, nch)) // other escape char
+                else if (c != 0 && !IsCharClass(c, CHAR_NOSTRING)) // other escape char
                 {
-                    token += c;
-                    c = *(program++);
+                    c = at(++i);
                 }
             }
-            else if (c != 0 && c != '\'' && !CharInList(c, nch)) // single character
+            else if (c != 0 && c != '\'' && !IsCharClass(c, CHAR_NOSTRING)) // single character
             {
-                token += c;
-                c = *(program++);
+                c = at(++i);
             }
 
-            if (c == '\'') // close quote
-            {
-                token += c;
-                c = *(program++);
-            }
+            if (c == '\'') ++i;          // close quote
             stop = true;
         }
-
-        // special case for numbers
-        if ( CharInList(token[0], num ))
+        else if (IsCharClass(lead, CHAR_DIGIT)) // special case for numbers
         {
-            bool    bdot = false;   // found a point?
-            bool    bexp = false;   // found an exponent?
+            bool bdot = false;           // found a point?
+            bool bexp = false;           // found an exponent?
 
-            char    bin[] = "01";
-            char*   liste = num;
-            if (token[0] == '0' && c == 'x')          // hexadecimal value?
-            {
-                token += c;
-                c   = *(program++);                 // next character
-                liste = hexnum;
-            }
-            else if (token[0] == '0' && c == 'b')   // binary literal
+            unsigned char digits = CHAR_DIGIT;
+            bool binary = false;
+            if (lead == '0' && c == 'x')            // hexadecimal value?
             {
-                liste = bin;
-                token += c;
-                c = *(program++);
+                digits = CHAR_HEX;
+                c = at(++i);
             }
-cw:
-            while (c != 0 && CharInList(c, liste))
+            else if (lead == '0' && c == 'b')       // binary literal
             {
-cc:             token += c;
-                c   = *(program++);                 // next character
+                binary = true;
+                c = at(++i);
             }
-            if ( liste == num )                     // not for hexadecimal
+            while (true)
             {
-                if ( !bdot && c == '.' ) { bdot = true; goto cc; }
-                if ( !bexp && ( c == 'e' || c == 'E' ) )
+                while (c != 0 && (binary ? (c == '0' || c == '1') : IsCharClass(c, digits))) c = at(++i);
+                if (binary || digits != CHAR_DIGIT) break;  // only for decimal values
+
+                if (!bdot && c == '.')
+                {
+                    bdot = true;
+                    c = at(++i);
+                }
+                else if (!bexp && (c == 'e' || c == 'E'))
                 {
                     bexp = true;
-                    token += c;
-                    c   = *(program++);                 // next character
-                    if ( c == '-' ||
-                         c == '+' ) goto cc;
-                    goto cw;
+                    c = at(++i);
+                    if (c == '-' || c == '+') c = at(++i);
                 }
-
+                else break;
             }
             stop = true;
         }
-
-        if (CharInList(token[0], sep3))               // an operational separator?
+        else if (IsCharClass(lead, CHAR_OPERATOR)) // an operational separator?
         {
-            std::string  motc = token;
-            while (motc += c, c != 0 && GetKeyWord(motc) > 0)    // operand seeks the longest possible
-            {
-                token += c;                           // build the word
-                c = *(program++);                   // next character
-            }
-
+            // operand seeks the longest possible
+            while (c != 0 && GetKeyWord(program.substr(start, i + 1 - start)) > 0) c = at(++i);
             stop = true;
         }
     }
 
+    // the rest of a word
+    if (!stop)
+    {
+        while (at(i) != 0 && !IsCharClass(at(i), CHAR_SEP)) ++i;
+    }
+    const std::size_t end = i;
 
-
+    // separators and comments after the word
     while (true)
     {
-        if (stop || c == 0 || CharInList(c, sep1))
+        char c = at(i);
+        if (IsCharClass(c, CHAR_BLANK))
         {
-            if (!first && token.empty()) return nullptr;   // end of the analysis
-bis:
-            while (CharInList(c, sep2))
-            {
-                sep += c;                           // after all the separators
-                c = *(program++);
-            }
-            if (c == '/' && *program == '/')        // comment on the heap?
-            {
-                while( c != '\n' && c != 0 )
-                {
-                    sep += c;
-                    c = *(program++);               // next character
-                }
-                goto bis;
-            }
-
-            if (c == '/' && *program == '*')        // comment on the heap?
-            {
-                while( c != 0 && (c != '*' || *program != '/'))
-                {
-                    sep += c;
-                    c = *(program++);               // next character
-                }
-                if ( c != 0 )
-                {
-                    sep += c;
-                    c = *(program++);               // next character
-                    sep += c;
-                    c = *(program++);               // next character
-                }
-                goto bis;
-            }
-
-            program--;
-
-            CBotToken* t = new CBotToken(token, sep);
+            ++i;
+        }
+        else if (c == '/' && at(i + 1) == '/')
+        {
+            while (at(i) != '\n' && at(i) != 0) ++i;
+        }
+        else if (c == '/' && at(i + 1) == '*')
+        {
+            while (at(i) != 0 && (at(i) != '*' || at(i + 1) != '/')) ++i;
+            if (at(i) != 0) i += 2;
+        }
+        else break;
+    }
+    pos = i;
 
-            if (CharInList(token[0], num )) t->m_type = TokenTypNum;
-            if (token[0] == '\"') t->m_type = TokenTypString;
-            if (token[0] == '\'') t->m_type = TokenTypChar;
-            if (first) t->m_type = TokenTypNone;
+    std::string_view token = program.substr(start, end - start);
+    CBotToken* t = new CBotToken(std::string(token), std::string(program.substr(end, i - end)),
+                                 static_cast<int>(start), static_cast<int>(end));
 
-            t->m_keywordId = GetKeyWord(token);
-            if (t->m_keywordId > 0) t->m_type = TokenTypKeyWord;
-            else GetDefineNum(token, t) ;         // treats DefineNum
+    if (!token.empty())
+    {
+        if (IsCharClass(token[0], CHAR_DIGIT)) t->m_type = TokenTypNum;
+        if (token[0] == '\"') t->m_type = TokenTypString;
+        if (token[0] == '\'') t->m_type = TokenTypChar;
+    }
+    if (first) t->m_type = TokenTypNone;
 
-            return t;
-        }
+    t->m_keywordId = GetKeyWord(token);
+    if (t->m_keywordId > 0) t->m_type = TokenTypKeyWord;
+    else GetDefineNum(token, t);          // treats DefineNum
 
-        token += c;                       // built the word
-        c = *(program++);               // next character
-    }
+    return t;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-std::unique_ptr<CBotToken> CBotToken::CompileTokens(const std::string& program)
+std::unique_ptr<CBotToken> CBotToken::CompileTokens(std::string_view program)
 {
-    CBotToken       *nxt, *prv, *tokenbase;
-    const char*     p = program.c_str();
-    int             pos = 0;
-
-    prv = tokenbase = NextToken(p, true);
-
+    std::size_t pos = 0;
+    CBotToken* tokenbase = NextToken(program, pos, true);
     if (tokenbase == nullptr) return nullptr;
 
-    tokenbase->m_start  = pos;
-    pos += tokenbase->m_text.length();
-    tokenbase->m_end    = pos;
-    pos += tokenbase->m_sep.length();
-
-    const char* pp = p;
-    while (nullptr != (nxt = NextToken(p, false)))
+    CBotToken* prv = tokenbase;
+    CBotToken* nxt;
+    while (nullptr != (nxt = NextToken(program, pos, false)))
     {
         prv->m_next = nxt;              // added after
         nxt->m_prev = prv;
         prv = nxt;                      // advance
-
-        nxt->m_start    = pos;
-        pos += (p - pp);                // total size
-        nxt->m_end  = pos - nxt->m_sep.length();
-        pp = p;
     }
 
     // terminator token
     nxt = new CBotToken();
     nxt->m_type = TokenTypNone;
-    nxt->m_end = nxt->m_start = pos;
+    nxt->m_end = nxt->m_start = static_cast<int>(pos);
     prv->m_next = nxt;
     nxt->m_prev = prv;
 
@@ -486,39 +522,45 @@ std::unique_ptr<CBotToken> CBotToken::CompileTokens(const std::string& program)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-int CBotToken::GetKeyWord(const std::string& w)
+int CBotToken::GetKeyWord(std::string_view w)
 {
-    auto it = KEYWORDS.find(w);
-    if (it != KEYWORDS.end())
+    if (w.empty() || w.size() > KEYWORD_MAX_LENGTH) return -1;
+
+    uint8_t slot = KEYWORD_TABLE.slots[HashKeyword(w, KEYWORD_TABLE.seed) % KEYWORD_SLOTS];
+    if (slot != 0 && KEYWORDS[slot - 1].text == w)
     {
-        return it->second;
+        return KEYWORDS[slot - 1].id;
     }
 
     return -1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotToken::GetDefineNum(const std::string& name, CBotToken* token)
+bool CBotToken::GetDefineNum(std::string_view name, CBotToken* token)
 {
-    if (m_defineNum.count(name) == 0)
+    const auto& defineNum = GetCurrentState().definitions.defineNum;
+    auto it = defineNum.find(name);
+    if (it == defineNum.end())
         return false;
 
     token->m_type = TokenTypDef;
-    token->m_keywordId = m_defineNum[name];
+    token->m_keywordId = it->second;
     return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 bool CBotToken::DefineNum(const std::string& name, long val)
 {
-    if (m_defineNum.count(name) > 0)
+    CBotContext* context = CBotContext::GetCurrent();
+    if (GetContextState(context).definitions.defineNum.count(name) > 0)
     {
         // TODO: No access to the logger from CBot library :(
         printf("CBOT WARNING: %s redefined\n", name.c_str());
         return false;
     }
 
-    m_defineNum[name] = val;
+    GetContextState(context).definitions.defineNum[name] = val;
+    GetContextState(context).definitions.defineNumRevision++;
     return true;
 }
 
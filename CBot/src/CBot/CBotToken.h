@@ -24,6 +24,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
 #include <memory>
 
@@ -120,7 +121,7 @@ public:
      * \brief Return the token string
      * \return The string associated with this token
      */
-    const std::string& GetString();
+    const std::string& GetString() const;
 
     /**
      * \brief Set the token string
@@ -158,13 +159,13 @@ public:
 
     /**
      * \brief Transforms a CBot program from a string to a list of tokens
-     * \param prog The program string
+     * \param prog The program string, it ends at the first null character
      * \return The first token in the linked list
      */
-    static std::unique_ptr<CBotToken> CompileTokens(const std::string& prog);
+    static std::unique_ptr<CBotToken> CompileTokens(std::string_view prog);
 
     /**
-     * \brief Define a new constant
+     * \brief Define a new constant in the current context
      * \param name Name of the constant
      * \param val Value of the constant
      * \return true on success, false if already defined
@@ -177,17 +178,25 @@ public:
      */
     static void ClearDefineNum();
 
+    /**
+     * \brief Revision of the defined constants
+     *
+     * Changes every time a constant is defined or the list is cleared
+     */
+    static long GetDefineNumRevision();
+
 private:
     /**
      * \brief Find the next token in the string
      *
      * The string must not start with separators. The separator is part of the previous token.
      *
-     * \param [in, out] program The program string, modified to point at the next token
+     * \param program The program string, it ends at the first null character
+     * \param [in, out] pos Position of the token in the program, modified to point at the next token
      * \param first true if this is the first call (beginning of the program string)
      * \return A processed CBotToken
      */
-    static CBotToken* NextToken(const char*& program, bool first);
+    static CBotToken* NextToken(std::string_view program, std::size_t& pos, bool first);
 
 private:
     //! The token type
@@ -205,15 +214,13 @@ private:
     //! The end position of the token in the CBotProgram
     int m_end = 0;
 
-    //! Map of all defined constants (see DefineNum())
-    static std::map<std::string, long> m_defineNum;
 
     /**
      * \brief Check if the word is a keyword
      * \param w The word to check
      * \return the keyword ID (::CBotTokenId), or -1 if this is not a keyword
      */
-    static int GetKeyWord(const std::string& w);
+    static int GetKeyWord(std::string_view w);
 
     /**
      * \brief Resolve a constant defined with DefineNum()
@@ -221,7 +228,7 @@ private:
      * \param token Token that we are working on, will be filled with data about found constant
      * \return true if the constant was found, false otherwise
      */
-    static bool GetDefineNum(const std::string& name, CBotToken* token);
+    static bool GetDefineNum(std::string_view name, CBotToken* token);
 };
 
 /**
@@ -26,7 +26,13 @@
 
 #include "CBot/CBotVar/CBotVar.h"
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <type_traits>
 
 namespace CBot
 {
@@ -276,4 +282,92 @@ std::string CodePointToUTF8(unsigned int val)
     return s;
 }
 
+template<typename T>
+std::string NumberToString(T val)
+{
+#ifdef __cpp_lib_to_chars
+    char buffer[32];
+    std::to_chars_result result;
+    if constexpr (std::is_floating_point_v<T>)
+        result = std::to_chars(buffer, buffer + sizeof(buffer), val, std::chars_format::general, 6);
+    else
+        result = std::to_chars(buffer, buffer + sizeof(buffer), val);
+    assert(result.ec == std::errc());
+    return std::string(buffer, result.ptr);
+#else
+    std::ostringstream s;
+    s.imbue(std::locale::classic());
+    s << val;
+    return s.str();
+#endif
+}
+
+template<typename T>
+T StringToNumber(const std::string& str)
+{
+#ifdef __cpp_lib_to_chars
+    const char* p = str.c_str();
+    const char* end = p + str.size();
+    while (p < end && CharInList(*p, " \t\n\v\f\r")) p++;
+
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '+' || *p == '-')) p++;
+
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        // no "inf" nor "nan", like the streams
+        if (p == end || !CharInList(*p, "0123456789.")) return 0;
+        T val = 0;
+        auto result = std::from_chars(p, end, val, std::chars_format::general);
+        if (result.ec == std::errc::result_out_of_range)
+        {
+            const char* exponent = std::find_if(p, result.ptr, [](char c) { return c == 'e' || c == 'E'; });
+            if (exponent + 1 < result.ptr && exponent[1] == '-') return 0;      // too small
+            val = std::numeric_limits<T>::max();
+        }
+        else if (result.ec != std::errc()) return 0;
+        return negative ? -val : val;
+    }
+    else
+    {
+        using U = std::make_unsigned_t<T>;
+        U magnitude = 0;
+        auto result = std::from_chars(p, end, magnitude);
+        if (result.ec == std::errc::invalid_argument) return 0;
+        if constexpr (std::is_unsigned_v<T>)
+        {
+            if (result.ec == std::errc::result_out_of_range) return std::numeric_limits<T>::max();
+            return negative ? static_cast<T>(-magnitude) : static_cast<T>(magnitude);
+        }
+        else
+        {
+            U limit = static_cast<U>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+            if (result.ec == std::errc::result_out_of_range || magnitude > limit)
+                return negative ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+            return negative ? static_cast<T>(-magnitude) : static_cast<T>(magnitude);
+        }
+    }
+#else
+    std::istringstream s(str);
+    s.imbue(std::locale::classic());
+    T val = 0;
+    s >> val;
+    return val;
+#endif
+}
+
+template std::string NumberToString<short>(short val);
+template std::string NumberToString<uint32_t>(uint32_t val);
+template std::string NumberToString<int>(int val);
+template std::string NumberToString<long>(long val);
+template std::string NumberToString<float>(float val);
+template std::string NumberToString<double>(double val);
+
+template short StringToNumber<short>(const std::string& str);
+template uint32_t StringToNumber<uint32_t>(const std::string& str);
+template int StringToNumber<int>(const std::string& str);
+template long StringToNumber<long>(const std::string& str);
+template float StringToNumber<float>(const std::string& str);
+template double StringToNumber<double>(const std::string& str);
+
 } // namespace CBot
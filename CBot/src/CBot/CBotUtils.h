@@ -23,6 +23,7 @@
 
 #include <string>
 #include <cassert>
+#include <type_traits>
 
 namespace CBot
 {
@@ -88,6 +89,95 @@ bool CharInList(const char c, const char* list);
  */
 std::string CodePointToUTF8(unsigned int val);
 
+/*!
+ * \brief Converts a number to a string, like std::ostream with its default format
+ *
+ * Doesn't depend on the locale, and doesn't create a stream.
+ * Floating point numbers are written with 6 significant digits.
+ * \param val Number (short, uint32_t, int, long, float or double)
+ * \return Decimal representation
+ */
+template<typename T> std::string NumberToString(T val);
+
+/*!
+ * \brief Reads the number at the beginning of a string, like std::istream
+ *
+ * Doesn't depend on the locale, and doesn't create a stream.
+ * Leading spaces are skipped, and the number ends at the first character
+ * which can't be part of it.
+ * \param str String
+ * \return The number, 0 if there's none, the nearest limit if it is out of range
+ */
+template<typename T> T StringToNumber(const std::string& str);
+
+/*!
+ * \brief Arithmetic operators which wrap around on integer overflow, as the CPU does
+ *
+ * The signed integers are computed as unsigned ones, where the overflow is defined.
+ * Floating point numbers are computed as usual.
+ */
+//@{
+template<typename T> T WrappingAdd(T l, T r)
+{
+    if constexpr (std::is_integral_v<T>)
+    {
+        using U = std::make_unsigned_t<decltype(l + r)>;
+        return static_cast<T>(static_cast<U>(l) + static_cast<U>(r));
+    }
+    else return l + r;
+}
+
+template<typename T> T WrappingSub(T l, T r)
+{
+    if constexpr (std::is_integral_v<T>)
+    {
+        using U = std::make_unsigned_t<decltype(l - r)>;
+        return static_cast<T>(static_cast<U>(l) - static_cast<U>(r));
+    }
+    else return l - r;
+}
+
+template<typename T> T WrappingMul(T l, T r)
+{
+    if constexpr (std::is_integral_v<T>)
+    {
+        using U = std::make_unsigned_t<decltype(l * r)>;
+        return static_cast<T>(static_cast<U>(l) * static_cast<U>(r));
+    }
+    else return l * r;
+}
+
+template<typename T> T WrappingNeg(T val)
+{
+    if constexpr (std::is_integral_v<T>)
+    {
+        using U = std::make_unsigned_t<decltype(-val)>;
+        return static_cast<T>(U(0) - static_cast<U>(val));
+    }
+    else return -val;
+}
+
+//! The divisor must not be 0, the minimum divided by -1 gives the minimum instead of a hardware exception
+template<typename T> T WrappingDiv(T l, T r)
+{
+    if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+    {
+        if (r == -1) return WrappingNeg(l);
+    }
+    return l / r;
+}
+
+//! The divisor must not be 0, the remainder of a division by -1 is 0 (even for the minimum)
+template<typename T> T WrappingMod(T l, T r)
+{
+    if constexpr (std::is_signed_v<T>)
+    {
+        if (r == -1) return 0;
+    }
+    return l % r;
+}
+//@}
+
 template<typename T> class CBotLinkedList
 {
 public:
@@ -37,24 +37,223 @@
 #include "CBot/CBotVar/CBotVarString.h"
 
 #include "CBot/CBotClass.h"
+#include "CBot/CBotContextState.h"
 #include "CBot/CBotToken.h"
 
 #include "CBot/CBotEnums.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <mutex>
+#include <new>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 
 namespace CBot
 {
 
+//! Size step of the slabs, also the alignment of the variables
+const std::size_t SLAB_ALIGN = 16;
+//! Larger variables are allocated directly
+const std::size_t SLAB_MAX_SIZE = 512;
+//! Minimum number of variables in a slab
+const std::size_t SLAB_COUNT = 64;
+
+//! A free block of a slab
+struct SlabItem
+{
+    SlabItem* next;
+};
+
+const std::size_t SLAB_STEPS = SLAB_MAX_SIZE / SLAB_ALIGN + 1;
+//! Each type of variable has its own slabs, see CBotVar::Allocate()
+const std::size_t SLAB_KINDS = CBotTypMAX;
+
+/**
+ * \brief Size in bytes of the slabs of a size step
+ *
+ * A power of 2 the slabs are aligned on, so the slab of a block is found from its address.
+ */
+static std::size_t SlabBytes(std::size_t step)
+{
+    std::size_t bytes = SLAB_ALIGN;
+    while (bytes < step * SLAB_ALIGN * SLAB_COUNT) bytes *= 2;
+    return bytes;
+}
+
+//! Free blocks of a slab, left by the threads that ended
+struct OrphanSlab
+{
+    SlabItem* free = nullptr;
+    std::size_t count = 0;
+};
+
+//! Slabs with orphan blocks, by kind and size step; a slab whose blocks are all orphan is given back to the system
+static std::unordered_map<char*, OrphanSlab> orphanSlabs[SLAB_KINDS * SLAB_STEPS];
+static std::mutex orphanSlabMutex;
+
+//! Free blocks, by kind and size step, each thread has its own to avoid locking
+struct SlabFreeLists
+{
+    SlabItem* lists[SLAB_KINDS * SLAB_STEPS] = {};
+
+    //! The other blocks of the slabs may still be used by other threads, so the blocks are given to the next threads
+    ~SlabFreeLists()
+    {
+        std::lock_guard<std::mutex> lock(orphanSlabMutex);
+        for (std::size_t index = 0; index < SLAB_KINDS * SLAB_STEPS; index++)
+        {
+            std::size_t step = index % SLAB_STEPS;
+            std::size_t bytes = step == 0 ? 0 : SlabBytes(step);
+            while (lists[index] != nullptr)
+            {
+                SlabItem* item = lists[index];
+                lists[index] = item->next;
+
+                char* slab = reinterpret_cast<char*>(reinterpret_cast<std::uintptr_t>(item) & ~(bytes - 1));
+                OrphanSlab& orphan = orphanSlabs[index][slab];
+                item->next = orphan.free;
+                orphan.free = item;
+                if (++orphan.count == bytes / (step * SLAB_ALIGN))
+                {
+                    ::operator delete(slab, std::align_val_t(bytes));
+                    orphanSlabs[index].erase(slab);
+                }
+            }
+        }
+    }
+};
+
+static thread_local SlabFreeLists slabFree;
+
+static thread_local CBotVar::AllocationStats allocationStats;
+
+//! Name of most temporary variables, shared by all contexts
+static const std::string emptyName;
+
+//! Names already interned by the thread, found without locking the context
+struct NameCache
+{
+    //! Serial number of the context the names belong to
+    long context = 0;
+    //! The keys are the strings of the context
+    std::unordered_map<std::string_view, const std::string*> names;
+};
+
+static thread_local NameCache nameCache;
+
+////////////////////////////////////////////////////////////////////////////////
+const std::string* CBotVar::InternName(const std::string& name)
+{
+    if (name.empty()) return &emptyName;
+    CBotContext* context = CBotContext::GetCurrent();
+    if (nameCache.context != GetContextState(context).serial)
+    {
+        nameCache.names.clear();
+        nameCache.context = GetContextState(context).serial;
+    }
+
+    auto it = nameCache.names.find(name);
+    if (it != nameCache.names.end()) return it->second;
+
+    const std::string* interned;
+    {
+        std::lock_guard<std::mutex> lock(GetContextState(context).variables.namesMutex);
+        interned = &*GetContextState(context).variables.names.insert(name).first;
+    }
+    nameCache.names.emplace(*interned, interned);
+    return interned;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* CBotVar::operator new(std::size_t size)
+{
+    return Allocate(size, CBotTypVoid);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotVar::operator delete(void* p, std::size_t size)
+{
+    Free(p, size, CBotTypVoid);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* CBotVar::Allocate(std::size_t size, int kind)
+{
+    assert(kind >= 0 && static_cast<std::size_t>(kind) < SLAB_KINDS);
+    allocationStats.created++;
+
+    std::size_t step = (size + SLAB_ALIGN - 1) / SLAB_ALIGN;
+    if (step * SLAB_ALIGN > SLAB_MAX_SIZE)
+    {
+        allocationStats.blocks++;
+        return ::operator new(size);
+    }
+
+    std::size_t index = kind * SLAB_STEPS + step;
+    SlabItem*& list = slabFree.lists[index];
+    if (list == nullptr)
+    {
+        // takes all the orphan blocks of a slab
+        std::lock_guard<std::mutex> lock(orphanSlabMutex);
+        auto orphan = orphanSlabs[index].begin();
+        if (orphan != orphanSlabs[index].end())
+        {
+            list = orphan->second.free;
+            orphanSlabs[index].erase(orphan);
+        }
+    }
+    if (list == nullptr)
+    {
+        // new slab, all its blocks become free
+        std::size_t bytes = SlabBytes(step);
+        char* slab = static_cast<char*>(::operator new(bytes, std::align_val_t(bytes)));
+        allocationStats.blocks++;
+        for (std::size_t i = bytes / (step * SLAB_ALIGN); i-- > 0; )
+        {
+            SlabItem* item = reinterpret_cast<SlabItem*>(slab + i * step * SLAB_ALIGN);
+            item->next = list;
+            list = item;
+        }
+    }
+
+    SlabItem* item = list;
+    list = item->next;
+    return item;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
-long CBotVar::m_identcpt = 0;
+void CBotVar::Free(void* p, std::size_t size, int kind)
+{
+    if (p == nullptr) return;
+    allocationStats.destroyed++;
+
+    std::size_t step = (size + SLAB_ALIGN - 1) / SLAB_ALIGN;
+    if (step * SLAB_ALIGN > SLAB_MAX_SIZE)
+    {
+        ::operator delete(p);
+        return;
+    }
+
+    std::size_t index = kind * SLAB_STEPS + step;
+    SlabItem* item = static_cast<SlabItem*>(p);
+    item->next = slabFree.lists[index];
+    slabFree.lists[index] = item;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const CBotVar::AllocationStats& CBotVar::GetAllocationStats()
+{
+    return allocationStats;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-CBotVar::CBotVar( ) : m_token(nullptr)
+CBotVar::CBotVar( ) : m_name(InternName("")), m_token(nullptr)
 {
     m_pMyThis = nullptr;
     m_pUserPtr = nullptr;
@@ -63,11 +262,12 @@ CBotVar::CBotVar( ) : m_token(nullptr)
     m_type  = -1;
     m_binit = InitType::UNDEF;
     m_ident = 0;
+    m_slot = -1;
     m_bStatic = false;
     m_mPrivate = ProtectionLevel::Public;
 }
 
-CBotVar::CBotVar(const CBotToken &name) : m_token(new CBotToken(name))
+CBotVar::CBotVar(const CBotToken &name) : m_name(InternName(name.GetString())), m_token(nullptr)
 {
     m_pMyThis = nullptr;
     m_pUserPtr = nullptr;
@@ -76,6 +276,7 @@ CBotVar::CBotVar(const CBotToken &name) : m_token(new CBotToken(name))
     m_type  = -1;
     m_binit = InitType::UNDEF;
     m_ident = 0;
+    m_slot = -1;
     m_bStatic = false;
     m_mPrivate = ProtectionLevel::Public;
 }
@@ -122,8 +323,22 @@ void CBotVar::SetUniqNum(long n)
 ////////////////////////////////////////////////////////////////////////////////
 long CBotVar::NextUniqNum()
 {
-    if (++m_identcpt < 10000) m_identcpt = 10000;
-    return m_identcpt;
+    std::atomic<long>& identcpt = GetCurrentState().variables.identcpt;
+    long n;
+    // the first numbers are reserved, the counter is moved past them unless another thread already did
+    while ((n = ++identcpt) < 10000) identcpt.compare_exchange_strong(n, 9999);
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long CBotVar::NextUniqNums(long count)
+{
+    std::atomic<long>& identcpt = GetCurrentState().variables.identcpt;
+    long last = identcpt;
+    long first;
+    do first = std::max(last, 9999L) + 1;
+    while (!identcpt.compare_exchange_weak(last, first + count - 1));
+    return first;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -139,7 +354,7 @@ void* CBotVar::GetUserPtr()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotVar::Save1State(std::ostream &ostr)
+bool CBotVar::Save1State(CBotStateWriter &writer)
 {
     // this routine "virtual" must never be called,
     // there must be a routine for each of the subclasses (CBotVarInt, CBotVarFloat, etc)
@@ -153,6 +368,15 @@ void CBotVar::Update(void* pUser)
 {
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool CBotVar::IsUpdatedByField()
+{
+    int type = m_type.GetType();
+    if (type != CBotTypPointer && type != CBotTypClass && type != CBotTypIntrinsic) return false;
+    CBotClass* pClass = GetClass();
+    return pClass != nullptr && pClass->IsUpdatedByField();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CBotVar* CBotVar::Create(const CBotToken& name, CBotType type)
 {
@@ -226,7 +450,7 @@ CBotVar* CBotVar::Create(const CBotToken& name, CBotTypResult type)
 ////////////////////////////////////////////////////////////////////////////////
 CBotVar* CBotVar::Create( CBotVar* pVar )
 {
-    CBotVar*    p = Create(pVar->m_token->GetString(), pVar->GetTypResult(CBotVar::GetTypeMode::CLASS_AS_INTRINSIC));
+    CBotVar*    p = Create(*pVar->m_name, pVar->GetTypResult(CBotVar::GetTypeMode::CLASS_AS_INTRINSIC));
     return p;
 }
 
@@ -411,18 +635,46 @@ void CBotVar::SetInit(CBotVar::InitType initType)
 ////////////////////////////////////////////////////////////////////////////////
 const std::string& CBotVar::GetName()
 {
-    return    m_token->GetString();
+    return    *m_name;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void CBotVar::SetName(const std::string& name)
 {
-    m_token->SetString(name);
+    m_name = InternName(name);
+    if (m_token != nullptr) m_token->SetString(name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotVar::CopyName(CBotVar* pSrc)
+{
+    m_name = pSrc->m_name;
+    if (m_token != nullptr) m_token->SetString(*m_name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotVar::Recycle()
+{
+    if (m_type.GetType() < CBotTypByte || m_type.GetType() > CBotTypBoolean) return false;
+    if (m_next != nullptr || m_pMyThis != nullptr || m_bStatic || m_mPrivate != ProtectionLevel::Public) return false;
+    if (m_InitExpr != nullptr || m_LimExpr != nullptr || m_slot != -1) return false;
+
+    SetValInt(0);                           // also forgets the name of a defined number
+    if (!m_name->empty()) SetName("");
+    m_binit = InitType::UNDEF;
+    m_pUserPtr = nullptr;
+    m_ident = 0;
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 CBotToken* CBotVar::GetToken()
 {
+    if (m_token == nullptr)
+    {
+        m_token = new CBotToken(*m_name);
+        allocationStats.tokens++;
+    }
     return    m_token;
 }
 
@@ -447,6 +699,13 @@ CBotVar* CBotVar::GetItemList()
     return nullptr;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+int CBotVar::GetItemCount()
+{
+    assert(0);
+    return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CBotVar* CBotVar::GetItem(int index, bool grow)
 {
@@ -484,7 +743,7 @@ CBotVar* CBotVar::GetStaticVar()
     if ( m_bStatic == 0 || m_pMyThis == nullptr ) return this;
 
     CBotClass*    pClass = m_pMyThis->GetClass();
-    return pClass->GetItem( m_token->GetString() );
+    return pClass->GetItem( *m_name );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -517,7 +776,10 @@ void CBotVar::SetVal(CBotVar* var)
         SetValDouble(var->GetValDouble());
         break;
     case CBotTypString:
-        SetValString(var->GetValString());
+        if (GetType() == CBotTypString)
+            static_cast<CBotVarString*>(this)->SetValString(static_cast<CBotVarString*>(var));
+        else
+            SetValString(var->GetValString());
         break;
     case CBotTypPointer:
     case CBotTypNullPointer:
@@ -526,8 +788,7 @@ void CBotVar::SetVal(CBotVar* var)
         break;
     case CBotTypClass:
         {
-            delete (static_cast<CBotVarClass*>(this))->m_pVar;
-            (static_cast<CBotVarClass*>(this))->m_pVar = nullptr;
+            delete (static_cast<CBotVarClass*>(this))->DetachVars();
             Copy(var, false);
         }
         break;
@@ -803,7 +1064,7 @@ void CBotVar::Dec()
 ////////////////////////////////////////////////////////////////////////////////
 void CBotVar::Copy(CBotVar* pSrc, bool bName)
 {
-    if (bName) *m_token = *pSrc->m_token;
+    if (bName) CopyName(pSrc);
     m_type = pSrc->m_type;
     m_binit = pSrc->m_binit;
 //-    m_bStatic    = pSrc->m_bStatic;
@@ -24,6 +24,7 @@
 #include "CBot/CBotEnums.h"
 #include "CBot/CBotUtils.h"
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -34,6 +35,8 @@ class CBotVarClass;
 class CBotInstr;
 class CBotClass;
 class CBotToken;
+class CBotStateWriter;
+class CBotStateReader;
 
 /**
  * \brief A CBot variable
@@ -61,6 +64,39 @@ public:
      */
     virtual ~CBotVar();
 
+    /**
+     * \brief Variables are allocated from slabs, one list of free blocks per type and object size
+     *
+     * Variables are created and destroyed for every intermediate result, so the memory
+     * is kept for the next variables of the same type instead of being given back.
+     * Each thread has its own free blocks; those of a thread that ends go to the next threads,
+     * and the slabs they fill completely are given back to the system.
+     *
+     * The subclasses give their type to Allocate(), this one is for the other ones.
+     */
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
+    /**
+     * \brief Allocation counters, see GetAllocationStats()
+     */
+    struct AllocationStats
+    {
+        //! Number of variables created
+        long created = 0;
+        //! Number of variables destroyed
+        long destroyed = 0;
+        //! Number of memory blocks requested from the system for them
+        long blocks = 0;
+        //! Number of tokens created for their names, see GetToken()
+        long tokens = 0;
+    };
+
+    /**
+     * \brief Returns the allocation counters of the calling thread since its start
+     */
+    static const AllocationStats& GetAllocationStats();
+
     /**
      * \brief Creates a new variable from a type described by CBotTypResult
      * \param name Variable name
@@ -182,7 +218,8 @@ public:
     /**
      * \brief Returns the CBotToken this variable is associated with
      *
-     * This token is either passed in CBotVar::Create() or created from name string
+     * This token is created from the name on the first call, only its string and
+     * the position set with CBotToken::SetPos() are meaningful
      */
     CBotToken* GetToken();
 
@@ -366,6 +403,15 @@ public:
      */
     virtual void Update(void* pUser);
 
+    /**
+     * \brief Tells if this instance is updated one field at a time, when the fields are read
+     *
+     * Its update is then left to the access to the field, see CBotVarClass::UpdateField().
+     *
+     * \see CBotClass::SetFieldUpdateFunc()
+     */
+    bool IsUpdatedByField();
+
     /**
      * \brief Set unique identifier of this variable
      * Note: For classes, this is unique within the class only - see CBotClass:AddItem
@@ -388,6 +434,13 @@ public:
      */
     static long NextUniqNum();
 
+    /**
+     * \brief Generate several consecutive unique identifiers at once
+     * \param count Number of identifiers
+     * \return The first identifier
+     */
+    static long NextUniqNums(long count);
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     //! \name Class / array member access
     //@{
@@ -424,6 +477,12 @@ public:
      */
     virtual CBotVar* GetItemList();
 
+    /**
+     * \brief Returns the number of elements of an array, without walking GetItemList()
+     * \return Number of elements, 0 for a null array
+     */
+    virtual int GetItemCount();
+
     //@}
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -648,34 +707,71 @@ public:
 
     /**
      * \brief Save common variable header (name, type, etc.)
-     * \param ostr Output stream
+     * \param writer Where the state is written
      * \return false on write error
      */
-    virtual bool Save0State(std::ostream &ostr);
+    virtual bool Save0State(CBotStateWriter &writer);
 
     /**
      * \brief Save variable data
      *
      * Overriden in child classes
      *
-     * \param ostr Output stream
+     * \param writer Where the state is written
      * \return false on write error
      */
-    virtual bool Save1State(std::ostream &ostr);
+    virtual bool Save1State(CBotStateWriter &writer);
 
     /**
      * \brief Restore variable
-     * \param istr Input stream
+     * \param reader Where the state is read from
      * \param[out] pVar Pointer to recieve the variable
      * \return false on read error
      */
-    static bool RestoreState(std::istream &istr, CBotVar* &pVar);
+    static bool RestoreState(CBotStateReader &reader, CBotVar* &pVar);
 
     //@}
 
 protected:
-    //! The corresponding token, defines the variable name
-    CBotToken* const m_token;
+    /**
+     * \brief Gives the name of another variable to this one
+     */
+    void CopyName(CBotVar* pSrc);
+
+    /**
+     * \brief Clears a number or a boolean given back by a stack level, to be used again as a result
+     *
+     * See CBotStack::CreateVar(). Only a result variable can be used again: it is not a member,
+     * not linked to other variables and not used by the host.
+     *
+     * \return false if this variable can't be used again, it must be destroyed
+     */
+    bool Recycle();
+
+    /**
+     * \brief Allocates a variable from the slabs of its type
+     * \param size Size of the variable
+     * \param kind Type of the variable (::CBotType), it is never mixed with other types in a slab
+     */
+    static void* Allocate(std::size_t size, int kind);
+    /**
+     * \brief Frees a variable allocated by Allocate() with the same size and type
+     */
+    static void Free(void* p, std::size_t size, int kind);
+
+    //! Name of the variable, shared by all variables of that name
+    const std::string* m_name;
+
+    /**
+     * \brief Shares the strings of the variable names, in the current context
+     *
+     * The strings belong to the context, so a variable must be destroyed before the context
+     * it was created in (see CBotContext). Each thread keeps the names it already asked for,
+     * the context is only locked for new names.
+     */
+    static const std::string* InternName(const std::string& name);
+    //! Token of the variable, only created by GetToken()
+    CBotToken* m_token;
     //! Type of value.
     CBotTypResult m_type;
     //! Initialization status
@@ -702,9 +798,12 @@ protected:
      * \see GetUniqNum()
      */
     long m_ident;
-
-    //! TODO: ?
-    static long m_identcpt;
+    //! Slot of a local variable in its function
+    /**
+     * \see CBotCStack::GetVarSlot()
+     * \see CBotStack::FindVar(long, int, bool)
+     */
+    int m_slot;
 
     friend class CBotStack;
     friend class CBotCStack;
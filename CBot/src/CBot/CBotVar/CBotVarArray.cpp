@@ -60,7 +60,7 @@ void CBotVarArray::Copy(CBotVar* pSrc, bool bName)
 
     CBotVarArray*    p = static_cast<CBotVarArray*>(pSrc);
 
-    if ( bName) *m_token    = *p->m_token;
+    if (bName) CopyName(p);
     m_type        = p->m_type;
     m_pInstance = p->GetPointer();
 
@@ -128,6 +128,13 @@ CBotVar* CBotVarArray::GetItemList()
     return m_pInstance->GetItemList();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+int CBotVarArray::GetItemCount()
+{
+    if ( m_pInstance == nullptr) return 0;
+    return m_pInstance->GetItemCount();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::string CBotVarArray::GetValString() const
 {
@@ -136,10 +143,10 @@ std::string CBotVarArray::GetValString() const
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotVarArray::Save1State(std::ostream &ostr)
+bool CBotVarArray::Save1State(CBotStateWriter &writer)
 {
-    if (!WriteType(ostr, m_type)) return false;
-    return SaveVars(ostr, m_pInstance);                      // saves the instance that manages the table
+    if (!WriteType(writer, m_type)) return false;
+    return SaveVars(writer, m_pInstance);                      // saves the instance that manages the table
 }
 
 } // namespace CBot
@@ -41,6 +41,10 @@ public:
      */
     ~CBotVarArray();
 
+    //! Variables of this type have their own slabs, see CBotVar::operator new()
+    static void* operator new(std::size_t size) { return CBotVar::Allocate(size, CBotTypArrayPointer); }
+    static void operator delete(void* p, std::size_t size) { CBotVar::Free(p, size, CBotTypArrayPointer); }
+
     void SetPointer(CBotVar* p) override;
     CBotVarClass* GetPointer() override;
 
@@ -48,10 +52,11 @@ public:
 
     CBotVar* GetItem(int n, bool grow = false) override;
     CBotVar* GetItemList() override;
+    int GetItemCount() override;
 
     std::string GetValString() const override;
 
-    bool Save1State(std::ostream &ostr) override;
+    bool Save1State(CBotStateWriter &writer) override;
 
 private:
     //! Array data
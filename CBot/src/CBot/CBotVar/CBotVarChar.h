@@ -48,9 +48,9 @@ public:
         SetValChar(left->GetValChar() >> right->GetValInt());
     }
 
-    bool Save1State(std::ostream &ostr) override
+    bool Save1State(CBotStateWriter &writer) override
     {
-        return WriteUInt32(ostr, m_val);
+        return WriteUInt32(writer, m_val);
     }
 };
 
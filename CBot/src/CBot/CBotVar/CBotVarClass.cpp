@@ -20,18 +20,87 @@
 #include "CBot/CBotVar/CBotVarClass.h"
 
 #include "CBot/CBotClass.h"
+#include "CBot/CBotContextState.h"
+#include "CBot/CBotInstanceNumbers.h"
 #include "CBot/CBotStack.h"
 #include "CBot/CBotDefines.h"
 
 #include "CBot/CBotInstr/CBotInstr.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace CBot
 {
 
+//! Releases nested deeper are deferred, see DecrementUse()
+const int MAX_RELEASE_DEPTH = 64;
+//! Number of candidates CollectCycles() examines at once
+const std::size_t CYCLE_BATCH = 256;
+//! Instances CollectCycles() examines between two checks of its deadline
+const int CYCLE_CHECK = 32;
+//! Memory charged for each member or element, see ChargeMemory()
+const long VARIABLE_MEMORY = sizeof(CBotVar) + sizeof(CBotVar*);
+//! Timer ticks a destructor runs before its limits are checked again, see CallDestructor()
+const int DESTRUCTOR_SLICE = 1000;
+
+//! Number of nested releases in progress in the calling thread
+static thread_local int releaseDepth = 0;
+//! Instances to release once the outermost release of the calling thread is done
+static thread_local std::vector<CBotVarClass*> deferredReleases;
+
+/**
+ * \brief Candidates of CBotVarClass::CollectCycles() kept by a thread, see CBotVarClass::DecrementUse()
+ *
+ * Only the thread locks it, except when another one merges it or destroys one of its instances.
+ */
+struct CBotCandidateBuffer
+{
+    std::mutex mutex;
+    //! Context of the instances
+    CBotContext* context = nullptr;
+    std::unordered_set<CBotVarClass*> instances;
+
+    CBotCandidateBuffer();
+    ~CBotCandidateBuffer();
+
+    //! Moves the instances to the candidates of their context, the mutex being locked
+    void Merge();
+};
+
+//! Buffers of all the threads, see CBotVarClass::MergeCycleCandidates()
+static std::mutex candidateBuffersMutex;
+static std::unordered_set<CBotCandidateBuffer*> candidateBuffers;
+
+static thread_local CBotCandidateBuffer candidateBuffer;
+
 ////////////////////////////////////////////////////////////////////////////////
-std::set<CBotVarClass*> CBotVarClass::m_instances{};
+CBotCandidateBuffer::CBotCandidateBuffer()
+{
+    std::lock_guard<std::mutex> lock(candidateBuffersMutex);
+    candidateBuffers.insert(this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotCandidateBuffer::~CBotCandidateBuffer()
+{
+    std::lock_guard<std::mutex> lock(candidateBuffersMutex);
+    {
+        std::lock_guard<std::mutex> bufferLock(mutex);
+        Merge();
+    }
+    candidateBuffers.erase(this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotCandidateBuffer::Merge()
+{
+    if ( !instances.empty() ) CBotVarClass::MergeCycleCandidates(*this);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 CBotVarClass::CBotVarClass(const CBotToken& name, const CBotTypResult& type) : CBotVar(name)
@@ -58,16 +127,27 @@ CBotVarClass::CBotVarClass(const CBotToken& name, const CBotTypResult& type) : C
     m_bStatic    = false;
     m_mPrivate    = ProtectionLevel::Public;
     m_bConstructor = false;
+    m_hasDestructor = false;
     m_CptUse    = 0;
-    m_ItemIdent = type.Eq(CBotTypIntrinsic) ? 0 : CBotVar::NextUniqNum();
+    // programs running at once number their instances later, see CBotInstanceNumbers
+    CBotInstanceNumbers* numbers = CBotInstanceNumbers::GetCurrent();
+    if ( type.Eq(CBotTypIntrinsic) ) m_ItemIdent = 0;
+    else if ( numbers != nullptr )   m_ItemIdent = numbers->Take(this);
+    else                             m_ItemIdent = CBotVar::NextUniqNum();
 
     // add to the list
-    if (m_ItemIdent != 0) m_instances.insert(this);
+    m_indexed = m_ItemIdent != 0;
+    if (m_indexed)
+    {
+        CBotContext* context = CBotContext::GetCurrent();
+        std::lock_guard<std::mutex> lock(GetContextState(context).instances.mutex);
+        GetContextState(context).instances.byIdent.emplace(m_ItemIdent, this);
+    }
 
     CBotClass* pClass = type.GetClass();
 
     SetClass( pClass );
-
+    ChargeMemory();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -77,7 +157,40 @@ CBotVarClass::~CBotVarClass( )
         assert(0);
 
     // removes the class list
-    if (m_ItemIdent != 0) m_instances.erase(this);
+    if (m_indexed) Unindex();
+    if (m_ItemIdent < 0 && CBotInstanceNumbers::GetCurrent() != nullptr)
+        CBotInstanceNumbers::GetCurrent()->Remove(this);
+    if (m_candidateBuffer != nullptr)
+    {
+        // the buffer of another thread may be merged meanwhile, or destroyed with its thread
+        std::unique_lock<std::mutex> buffersLock(candidateBuffersMutex, std::defer_lock);
+        if (m_candidateBuffer != &candidateBuffer) buffersLock.lock();
+        CBotCandidateBuffer* buffer = m_candidateBuffer;
+        if (buffer != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            if (m_candidateBuffer == buffer)
+            {
+                buffer->instances.erase(this);
+                m_candidateBuffer = nullptr;
+            }
+        }
+    }
+    if (m_cycleCandidate)
+    {
+        CBotContextState::Instances& instances = GetCurrentState().instances;
+        std::lock_guard<std::mutex> lock(instances.mutex);
+        instances.cycleCandidates.erase(this);
+    }
+    if (m_collecting)
+    {
+        // the examination in progress is abandoned, without this instance
+        CBotContextState::Instances& instances = GetCurrentState().instances;
+        std::lock_guard<std::mutex> lock(instances.mutex);
+        instances.cycleCollection.outside.erase(this);
+        instances.cycleCollection.invalid = true;
+    }
+    if (m_hasDestructor) GetCurrentState().instances.destructible--;
 
     delete    m_pVar;
 }
@@ -86,6 +199,10 @@ CBotVarClass::~CBotVarClass( )
 void CBotVarClass::ConstructorSet()
 {
     m_bConstructor = true;
+
+    if (m_hasDestructor || m_pClass == nullptr || !m_pClass->HasDestructor()) return;
+    m_hasDestructor = true;
+    GetCurrentState().instances.destructible++;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -93,12 +210,13 @@ void CBotVarClass::Copy(CBotVar* pSrc, bool bName)
 {
     pSrc = pSrc->GetPointer();                    // if source given by a pointer
 
-    if ( pSrc->GetType() != CBotTypClass )
+    // array bodies are copied the same way, their index is rebuilt from the new list
+    if ( pSrc->GetType() != CBotTypClass && pSrc->GetType() != CBotTypArrayBody )
         assert(0);
 
     CBotVarClass*    p = static_cast<CBotVarClass*>(pSrc);
 
-    if (bName)    *m_token    = *p->m_token;
+    if (bName) CopyName(p);
 
     m_type        = p->m_type;
     m_binit        = p->m_binit;
@@ -108,13 +226,12 @@ void CBotVarClass::Copy(CBotVar* pSrc, bool bName)
 //    m_next        = nullptr;
     m_pUserPtr    = p->m_pUserPtr;
     m_pMyThis    = nullptr;//p->m_pMyThis;
-    m_ItemIdent = p->m_ItemIdent;
+    SetIdent(p->m_ItemIdent);
 
     // keeps indentificator the same (by default)
     if (m_ident == 0 ) m_ident     = p->m_ident;
 
-    delete        m_pVar;
-    m_pVar        = nullptr;
+    delete        DetachVars();
 
     CBotVar*    pv = p->m_pVar;
     while( pv != nullptr )
@@ -126,14 +243,55 @@ void CBotVarClass::Copy(CBotVar* pSrc, bool bName)
 
         pv = pv->GetNext();
     }
+    ChargeMemory();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void CBotVarClass::SetIdent(long n)
 {
+    if (m_indexed && n != m_ItemIdent)
+    {
+        Unindex();
+        CBotContext* context = CBotContext::GetCurrent();
+        std::lock_guard<std::mutex> lock(GetContextState(context).instances.mutex);
+        GetContextState(context).instances.byIdent.emplace(n, this);
+    }
+
+    // a copy of an instance not numbered yet is numbered with it
+    CBotInstanceNumbers* numbers = CBotInstanceNumbers::GetCurrent();
+    if (numbers != nullptr && (m_ItemIdent < 0) != (n < 0))
+    {
+        if (n < 0) numbers->Add(this);
+        else numbers->Remove(this);
+    }
     m_ItemIdent = n;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::Unindex()
+{
+    CBotContext* context = CBotContext::GetCurrent();
+    std::lock_guard<std::mutex> lock(GetContextState(context).instances.mutex);
+    auto& instances = GetContextState(context).instances.byIdent;
+    auto range = instances.equal_range(m_ItemIdent);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == this)
+        {
+            instances.erase(it);
+            return;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::ChargeMemory()
+{
+    long count = 0;
+    for ( CBotVar* p = m_pVar; p != nullptr; p = p->m_next ) count++;
+    m_memory.Set(sizeof(CBotVarClass) + count * VARIABLE_MEMORY);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void CBotVarClass::SetClass(CBotClass* pClass)//, int &nIdent)
 {
@@ -144,10 +302,13 @@ void CBotVarClass::SetClass(CBotClass* pClass)//, int &nIdent)
     m_pClass = pClass;
 
     // initializes the variables associated with this class
-    delete m_pVar;
-    m_pVar = nullptr;
+    delete DetachVars();
 
-    if (pClass == nullptr) return;
+    if (pClass == nullptr)
+    {
+        ChargeMemory();
+        return;
+    }
 
     CBotVar* pv = nullptr;
     while (pClass != nullptr)
@@ -205,6 +366,7 @@ void CBotVarClass::SetClass(CBotClass* pClass)//, int &nIdent)
         pv = pv->GetNext();
         if ( pv == nullptr ) pClass = pClass->GetParent();
     }
+    ChargeMemory();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -222,12 +384,47 @@ void CBotVarClass::Update(void* pUser)
     if ( m_pUserPtr != nullptr) pUser = m_pUserPtr;
     if ( pUser == OBJECTDELETED ||
          pUser == OBJECTCREATED ) return;
+
+    if ( m_pClass->IsUpdatedByField() )
+    {
+        for ( CBotVar* p = m_pVar; p != nullptr; p = p->m_next ) UpdateField(p, pUser);
+        return;
+    }
     m_pClass->Update(this, pUser);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::UpdateField(CBotVar* field, void* pUser)
+{
+    if ( m_pClass == nullptr || !m_pClass->IsUpdatedByField() ) return;
+
+    if ( m_pUserPtr != nullptr) pUser = m_pUserPtr;
+    if ( pUser == OBJECTDELETED ||
+         pUser == OBJECTCREATED ) return;
+
+    long slot = field->GetUniqNum() - 1;
+    if ( slot < 0 || field->IsStatic() ) return;
+
+    // each field is updated once per generation
+    long generation = GetCurrentState().classes.fieldsGeneration;
+    if ( slot >= static_cast<long>(m_fieldGenerations.size()) )
+        m_fieldGenerations.resize(std::max<long>(slot + 1, m_pClass->GetFieldCount()), 0);
+    if ( m_fieldGenerations[slot] == generation ) return;
+    m_fieldGenerations[slot] = generation;
+
+    m_pClass->UpdateField(this, field, slot, pUser);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CBotVar* CBotVarClass::GetItem(const std::string& name)
 {
+    int slot = m_pClass != nullptr ? m_pClass->GetFieldSlot(name) : -1;
+    if ( slot >= 0 )
+    {
+        CBotVar* p = GetItemRef(slot + 1);
+        if ( p != nullptr && p->GetName() == name ) return p;
+    }
+
     CBotVar*    p = m_pVar;
 
     while ( p != nullptr )
@@ -242,6 +439,14 @@ CBotVar* CBotVarClass::GetItem(const std::string& name)
 ////////////////////////////////////////////////////////////////////////////////
 CBotVar* CBotVarClass::GetItemRef(int nIdent)
 {
+    IndexFields();
+    if ( nIdent > 0 && nIdent <= static_cast<int>(m_fields.size()) )
+    {
+        CBotVar* p = m_fields[nIdent - 1];
+        if ( p != nullptr && p->GetUniqNum() == nIdent ) return p;
+    }
+
+    // not in the layout, the class may have changed since
     CBotVar*    p = m_pVar;
 
     while ( p != nullptr )
@@ -254,34 +459,60 @@ CBotVar* CBotVarClass::GetItemRef(int nIdent)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-CBotVar* CBotVarClass::GetItem(int n, bool bExtend)
+void CBotVarClass::IndexItems()
 {
-    CBotVar*    p = m_pVar;
+    if ( !m_items.empty() ) return;
+    for ( CBotVar* p = m_pVar; p != nullptr; p = p->m_next ) m_items.push_back(p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotVar* CBotVarClass::DetachVars()
+{
+    CBotVar* vars = m_pVar;
+    m_pVar = nullptr;
+    m_items.clear();
+    m_fields.clear();
+    m_fieldGenerations.clear();
+    return vars;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::IndexFields()
+{
+    if ( !m_fields.empty() || m_pClass == nullptr ) return;
 
+    m_fields.resize(m_pClass->GetFieldCount(), nullptr);
+    for ( CBotVar* p = m_pVar; p != nullptr; p = p->m_next )
+    {
+        long n = p->GetUniqNum();
+        if ( n > 0 && n <= static_cast<long>(m_fields.size()) && m_fields[n - 1] == nullptr ) m_fields[n - 1] = p;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotVar* CBotVarClass::GetItem(int n, bool bExtend)
+{
     if ( n < 0 ) return nullptr;
     if ( n > MAXARRAYSIZE ) return nullptr;
 
     if ( m_type.GetLimite() >= 0 && n >= m_type.GetLimite() ) return nullptr;
 
-    if ( p == nullptr && bExtend )
-    {
-        p = CBotVar::Create("", m_type.GetTypElem());
-        m_pVar = p;
-    }
+    IndexItems();
 
-    if ( n == 0 ) return p;
+    if ( n < static_cast<int>(m_items.size()) ) return m_items[n];
+    if ( !bExtend ) return nullptr;
 
-    while ( n-- > 0 )
+    // the elements stay linked too, for GetItemList()
+    while ( static_cast<int>(m_items.size()) <= n )
     {
-        if ( p->m_next == nullptr )
-        {
-            if ( bExtend ) p->m_next = CBotVar::Create("", m_type.GetTypElem());
-            if ( p->m_next == nullptr ) return nullptr;
-        }
-        p = p->m_next;
+        CBotVar*    p = CBotVar::Create("", m_type.GetTypElem());
+        if ( m_items.empty() ) m_pVar = p;
+        else m_items.back()->m_next = p;
+        m_items.push_back(p);
+        m_memory.Add(VARIABLE_MEMORY);
     }
 
-    return p;
+    return m_items[n];
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -290,6 +521,13 @@ CBotVar* CBotVarClass::GetItemList()
     return m_pVar;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+int CBotVarClass::GetItemCount()
+{
+    IndexItems();
+    return m_items.size();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::string CBotVarClass::GetValString() const
 {
@@ -366,58 +604,366 @@ std::string CBotVarClass::GetValString() const
 void CBotVarClass::IncrementUse()
 {
     m_CptUse++;
+    if ( m_collecting ) GetCurrentState().instances.cycleCollection.invalid = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void CBotVarClass::DecrementUse()
 {
+    if ( m_collecting ) GetCurrentState().instances.cycleCollection.invalid = true;
+    if ( --m_CptUse != 0 )
+    {
+        // the remaining references may all come from a cycle
+        if ( m_candidateBuffer == nullptr && !m_cycleCandidate && m_indexed &&
+             (m_pUserPtr == OBJECTCREATED || m_pUserPtr == OBJECTDELETED) )
+        {
+            CBotContext* context = CBotContext::GetCurrent();
+            std::lock_guard<std::mutex> lock(candidateBuffer.mutex);
+            if ( candidateBuffer.context != context )
+            {
+                candidateBuffer.Merge();
+                candidateBuffer.context = context;
+            }
+            candidateBuffer.instances.insert(this);
+            m_candidateBuffer = &candidateBuffer;
+        }
+        return;
+    }
+
+    if ( releaseDepth >= MAX_RELEASE_DEPTH )
+    {
+        deferredReleases.push_back(this);
+        return;
+    }
+
+    releaseDepth++;
+    Release();
+    releaseDepth--;
+    if ( releaseDepth > 0 ) return;
+
+    // the deferred releases may defer others in turn
+    for ( std::size_t i = 0; i < deferredReleases.size(); i++ )
+    {
+        releaseDepth++;
+        deferredReleases[i]->Release();
+        releaseDepth--;
+    }
+    deferredReleases.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::Release()
+{
+    CallDestructor();
+    delete this; // self-destructs!
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::CallDestructor()
+{
+    // if there is one, call the destructor
+    // but only if a constructor had been called.
+    if ( !m_bConstructor ) return;
+
+    m_CptUse++;    // does not return to the destructor
+
+    CBotStack*  pile = CBotStack::AllocateStack();
+    CBotVar*    ppVars[1];
+    ppVars[0] = nullptr;
+
+    CBotVar*    pThis  = CBotVar::Create("this", CBotTypNullPointer);
+    pThis->SetPointer(this);
+
+    std::string    nom = std::string("~") + m_pClass->GetName();
+    long        ident = 0;
+
+    CBotToken token(nom); // TODO
+
+    // runs to the end, by slices to keep within the limits of the destructors
+    CBotContextState::Instances& instances = GetCurrentState().instances;
+    pile->SetTimer(DESTRUCTOR_SLICE);
+    while ( pile->IsOk() )
+    {
+        if ( (instances.destructorTickLimit > 0 && instances.destructorTicks >= instances.destructorTickLimit) ||
+             std::chrono::steady_clock::now() >= instances.destructorDeadline )
+        {
+            instances.stoppedDestructors++;
+            break;
+        }
+
+        pile->Reset();
+        bool done = m_pClass->ExecuteMethode(ident, pThis, ppVars, CBotTypResult(CBotTypVoid), pile, &token);
+        instances.destructorTicks += pile->GetTicks();
+        if ( done ) break;
+    }
+
+    pile->Delete();
+    delete pThis;
     m_CptUse--;
-    if ( m_CptUse == 0 )
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool CBotVarClass::CollectCycles(int budget)
+{
+    CBotContext* context = CBotContext::GetCurrent();
+    CBotContextState::Instances& instances = GetContextState(context).instances;
+    CBotCycleCollection& collection = instances.cycleCollection;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(budget);
+    MergeCycleCandidates();
+
+    do
     {
-        // if there is one, call the destructor
-        // but only if a constructor had been called.
-        if ( m_bConstructor )
+        if ( collection.active && collection.invalid ) AbandonCollection(context);
+        if ( !collection.active )
         {
-            m_CptUse++;    // does not return to the destructor
+            std::vector<CBotVarClass*> roots;
+            {
+                std::lock_guard<std::mutex> lock(instances.mutex);
+                auto it = instances.cycleCandidates.begin();
+                while ( it != instances.cycleCandidates.end() && roots.size() < CYCLE_BATCH )
+                {
+                    (*it)->m_cycleCandidate = false;
+                    roots.push_back(*it);
+                    it = instances.cycleCandidates.erase(it);
+                }
+            }
+            if ( roots.empty() ) return true;
+            StartCollection(context, roots);
+        }
 
-            CBotStack*  pile = CBotStack::AllocateStack();
-            CBotVar*    ppVars[1];
-            ppVars[0] = nullptr;
+        if ( !ExamineCycles(context, deadline) ) return false;
+        FreeCycles(context);
+    }
+    while ( std::chrono::steady_clock::now() < deadline );
 
-            CBotVar*    pThis  = CBotVar::Create("this", CBotTypNullPointer);
-            pThis->SetPointer(this);
+    std::lock_guard<std::mutex> lock(instances.mutex);
+    return instances.cycleCandidates.empty();
+}
 
-            std::string    nom = std::string("~") + m_pClass->GetName();
-            long        ident = 0;
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::MergeCycleCandidates()
+{
+    CBotContext* context = CBotContext::GetCurrent();
+    std::lock_guard<std::mutex> lock(candidateBuffersMutex);
+    for ( CBotCandidateBuffer* buffer : candidateBuffers )
+    {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        if ( buffer->context == context ) buffer->Merge();
+    }
+}
 
-            CBotToken token(nom); // TODO
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::MergeCycleCandidates(CBotCandidateBuffer& buffer)
+{
+    CBotContextState::Instances& instances = GetContextState(buffer.context).instances;
+    std::lock_guard<std::mutex> lock(instances.mutex);
+    for ( CBotVarClass* p : buffer.instances )
+    {
+        p->m_candidateBuffer = nullptr;
+        p->m_cycleCandidate = true;
+        instances.cycleCandidates.insert(p);
+    }
+    buffer.instances.clear();
+}
 
-            while ( pile->IsOk() && !m_pClass->ExecuteMethode(ident, pThis, ppVars, CBotTypResult(CBotTypVoid), pile, &token)) ;    // waits for the end
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::StartCollection(CBotContext* context, const std::vector<CBotVarClass*>& roots)
+{
+    CBotCycleCollection& collection = GetContextState(context).instances.cycleCollection;
+    collection.active = true;
+    collection.invalid = false;
+    for ( CBotVarClass* root : roots )
+    {
+        if ( collection.outside.emplace(root, CBotCycleCollection::Reached{root->m_CptUse, true}).second )
+        {
+            collection.reached.push_back(root);
+            root->m_collecting = true;
+        }
+    }
+}
 
-            pile->Delete();
-            delete pThis;
-            m_CptUse--;
+////////////////////////////////////////////////////////////////////////////////
+bool CBotVarClass::ExamineCycles(CBotContext* context, std::chrono::steady_clock::time_point deadline)
+{
+    CBotCycleCollection& collection = GetContextState(context).instances.cycleCollection;
+    int examined = 0;
+    auto interrupted = [&]()
+    {
+        return ++examined % CYCLE_CHECK == 0 && !collection.uninterrupted &&
+               std::chrono::steady_clock::now() >= deadline;
+    };
+
+    // trial deletion: removes from the count of each instance reachable from the roots
+    // the references held by the others, what remains comes from outside
+    std::vector<CBotVarClass*> references;
+    while ( collection.counted < collection.reached.size() )
+    {
+        if ( interrupted() ) return false;
+        CBotVarClass* instance = collection.reached[collection.counted++];
+        references.clear();
+        GetReferences(instance->m_pVar, references);
+        for ( CBotVarClass* p : references )
+        {
+            auto it = collection.outside.emplace(p, CBotCycleCollection::Reached{p->m_CptUse, false});
+            if ( it.second )
+            {
+                collection.reached.push_back(p);
+                p->m_collecting = true;
+            }
+            it.first->second.outside--;
         }
+    }
 
-        delete this; // self-destructs!
+    // the instances referenced from outside keep alive those they reference
+    if ( !collection.marking )
+    {
+        collection.marking = true;
+        for ( CBotVarClass* p : collection.reached )
+        {
+            if ( collection.outside.at(p).outside > 0 && collection.alive.insert(p).second ) collection.pending.push_back(p);
+        }
+    }
+    while ( !collection.pending.empty() )
+    {
+        if ( interrupted() ) return false;
+        CBotVarClass* p = collection.pending.back();
+        collection.pending.pop_back();
+        references.clear();
+        GetReferences(p->m_pVar, references);
+        for ( CBotVarClass* r : references )
+        {
+            // the instances referenced since the references were removed weren't reached, nor counted
+            if ( collection.outside.count(r) != 0 && collection.alive.insert(r).second ) collection.pending.push_back(r);
+        }
     }
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-CBotVarClass* CBotVarClass::GetPointer()
+void CBotVarClass::AbandonCollection(CBotContext* context)
 {
-    return this;
+    CBotContextState::Instances& instances = GetContextState(context).instances;
+    CBotCycleCollection& collection = instances.cycleCollection;
+    {
+        // the instances destroyed meanwhile already left the collection
+        std::lock_guard<std::mutex> lock(instances.mutex);
+        for ( auto& reached : collection.outside )
+        {
+            CBotVarClass* p = reached.first;
+            p->m_collecting = false;
+            if ( reached.second.root && p->m_candidateBuffer == nullptr && !p->m_cycleCandidate )
+            {
+                p->m_cycleCandidate = true;
+                instances.cycleCandidates.insert(p);
+            }
+        }
+    }
+
+    collection.Reset();
+    collection.uninterrupted = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-CBotVarClass* CBotVarClass::Find(long id)
+void CBotVarClass::FreeCycles(CBotContext* context)
 {
-    for (CBotVarClass* p : m_instances)
+    CBotCycleCollection& collection = GetContextState(context).instances.cycleCollection;
+    std::vector<CBotVarClass*> garbage;
+    for ( CBotVarClass* p : collection.reached )
     {
-        if (p->m_ItemIdent == id) return p;
+        p->m_collecting = false;
+        if ( collection.alive.count(p) == 0 ) garbage.push_back(p);
     }
 
-    return nullptr;
+    collection.Reset();
+    collection.uninterrupted = false;
+    if ( garbage.empty() ) return;
+
+    std::vector<CBotVarClass*> references;
+    // the destructors run while all the instances of the cycles exist
+    for ( CBotVarClass* p : garbage ) p->m_CptUse++;
+    bool destructors = false;
+    for ( CBotVarClass* p : garbage )
+    {
+        if ( p->m_hasDestructor && p->m_bConstructor )
+        {
+            p->CallDestructor();
+            destructors = true;
+        }
+        p->m_bConstructor = false;
+    }
+
+    // a destructor may have kept a reference to them, they are examined again later
+    bool resurrected = false;
+    if ( destructors )
+    {
+        std::unordered_map<CBotVarClass*, int> counts;
+        for ( CBotVarClass* p : garbage ) counts.emplace(p, p->m_CptUse - 1);
+        for ( CBotVarClass* p : garbage )
+        {
+            references.clear();
+            GetReferences(p->m_pVar, references);
+            for ( CBotVarClass* r : references )
+            {
+                auto it = counts.find(r);
+                if ( it != counts.end() ) it->second--;
+            }
+        }
+        resurrected = std::any_of(counts.begin(), counts.end(), [](const auto& count) { return count.second != 0; });
+    }
+
+    if ( !resurrected )
+    {
+        // breaks the cycles, the instances are then released as usual
+        for ( CBotVarClass* p : garbage )
+        {
+            CBotVar* vars = p->DetachVars();
+            p->ChargeMemory();
+            delete vars;
+        }
+        GetContextState(context).instances.collected += garbage.size();
+    }
+    for ( CBotVarClass* p : garbage ) p->DecrementUse();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CBotVarClass::GetReferences(CBotVar* vars, std::vector<CBotVarClass*>& references)
+{
+    for ( CBotVar* p = vars; p != nullptr; p = p->m_next )
+    {
+        switch ( p->GetType() )
+        {
+            case CBotTypPointer:
+            case CBotTypNullPointer:
+            case CBotTypArrayPointer:
+            {
+                CBotVarClass* instance = p->GetPointer();
+                if ( instance != nullptr ) references.push_back(instance);
+                break;
+            }
+            case CBotTypClass:
+                GetReferences(static_cast<CBotVarClass*>(p)->m_pVar, references);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotVarClass* CBotVarClass::GetPointer()
+{
+    return this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CBotVarClass* CBotVarClass::Find(long id)
+{
+    CBotContext* context = CBotContext::GetCurrent();
+    std::lock_guard<std::mutex> lock(GetContextState(context).instances.mutex);
+    auto& instances = GetContextState(context).instances.byIdent;
+    auto it = instances.find(id);
+    if (it == instances.end()) return nullptr;
+    return it->second;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -455,12 +1001,12 @@ bool CBotVarClass::Ne(CBotVar* left, CBotVar* right)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotVarClass::Save1State(std::ostream &ostr)
+bool CBotVarClass::Save1State(CBotStateWriter &writer)
 {
-    if (!WriteType(ostr, m_type)) return false;
-    if (!WriteLong(ostr, m_ItemIdent)) return false;
+    if (!WriteType(writer, m_type)) return false;
+    if (!WriteLong(writer, m_ItemIdent)) return false;
 
-    return SaveVars(ostr, m_pVar);                              // content of the object
+    return SaveVars(writer, m_pVar);                              // content of the object
 }
 
 } // namespace CBot
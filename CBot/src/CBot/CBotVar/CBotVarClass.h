@@ -21,11 +21,18 @@
 
 #include "CBot/CBotVar/CBotVar.h"
 
-#include <set>
+#include "CBot/CBotMemoryAccount.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
 
 namespace CBot
 {
 
+class CBotContext;
+struct CBotCandidateBuffer;
+
 /**
  * \brief CBotVar subclass for managing classes (::CBotTypClass, ::CBotTypIntrinsic)
  *
@@ -43,6 +50,10 @@ public:
      */
     ~CBotVarClass();
 
+    //! Variables of this type have their own slabs, see CBotVar::operator new()
+    static void* operator new(std::size_t size) { return CBotVar::Allocate(size, CBotTypClass); }
+    static void operator delete(void* p, std::size_t size) { CBotVar::Free(p, size, CBotTypClass); }
+
     void Copy(CBotVar* pSrc, bool bName = true) override;
 
     void SetClass(CBotClass* pClass) override;
@@ -52,12 +63,20 @@ public:
     CBotVar* GetItemRef(int nIdent) override;
     CBotVar* GetItem(int n, bool bExtend) override;
     CBotVar* GetItemList() override;
+    int GetItemCount() override;
     std::string GetValString() const override;
 
-    bool Save1State(std::ostream &ostr) override;
+    bool Save1State(CBotStateWriter &writer) override;
 
     void Update(void* pUser) override;
 
+    /**
+     * \brief Updates a field of this instance if it is out of date, see CBotClass::SetFieldUpdateFunc()
+     * \param field Field of this instance
+     * \param pUser User pointer to pass to the update function, if the instance has none
+     */
+    void UpdateField(CBotVar* field, void* pUser);
+
     //! \name Reference counter
     //@{
 
@@ -68,11 +87,28 @@ public:
 
     /**
      * \brief Decrement reference counter
+     *
+     * The instance is destroyed when it isn't referenced anymore. The instances it referenced are
+     * then released too, those nested too deeply only once the outermost release is done, so that
+     * long chains of instances don't exhaust the native stack.
+     *
+     * An instance still referenced becomes a candidate of CollectCycles(), kept by the calling
+     * thread until the next collection so that the context isn't locked each time.
      */
     void DecrementUse();
 
     //@}
 
+    /**
+     * \brief Frees the instances only referenced by one another, see CBotProgram::CollectCycles()
+     */
+    static bool CollectCycles(int budget);
+
+    /**
+     * \brief Moves the candidates of CollectCycles() kept by all the threads to the current context
+     */
+    static void MergeCycleCandidates();
+
     CBotVarClass* GetPointer() override;
 
     //! \name Unique instance identifier
@@ -81,7 +117,7 @@ public:
     void SetIdent(long n) override;
 
     /*!
-     * \brief Finds a class instance by unique identifier
+     * \brief Finds a class instance by unique identifier, through an index kept by the instances
      * \param id Identifier to find
      * \return Found class instance
      */
@@ -95,21 +131,117 @@ public:
     void ConstructorSet() override;
 
 private:
-    //! List of all class instances - first
-    static std::set<CBotVarClass*> m_instances;
+    /**
+     * \brief Fills m_items from m_pVar if needed
+     */
+    void IndexItems();
+
+    /**
+     * \brief Takes the members or elements out of this instance, clearing the index caches built over them
+     * \return The list m_pVar held, for the caller to delete
+     */
+    CBotVar* DetachVars();
+
+    /**
+     * \brief Fills m_fields from m_pVar if needed
+     */
+    void IndexFields();
+
+    /**
+     * \brief Removes this instance from the index of Find()
+     */
+    void Unindex();
+
+    /**
+     * \brief Charges the memory of this instance and of its variables, once m_pVar is replaced
+     */
+    void ChargeMemory();
+
+    /**
+     * \brief Calls the destructor of the class, if a constructor was called
+     */
+    void CallDestructor();
+
+    /**
+     * \brief Calls the destructor and deletes this instance, once it isn't referenced anymore
+     */
+    void Release();
+
+    /**
+     * \brief Moves the candidates kept by a thread to those of their context, the buffer being locked
+     */
+    static void MergeCycleCandidates(CBotCandidateBuffer& buffer);
+
+    /**
+     * \brief Starts the examination of the instances reachable from some candidates of CollectCycles()
+     */
+    static void StartCollection(CBotContext* context, const std::vector<CBotVarClass*>& roots);
+
+    /**
+     * \brief Goes on with the examination of CollectCycles(), checking the time every few instances
+     * \return false if the deadline interrupted it
+     */
+    static bool ExamineCycles(CBotContext* context, std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * \brief Ends the examination of CollectCycles(), freeing the instances only referenced by one another
+     */
+    static void FreeCycles(CBotContext* context);
+
+    /**
+     * \brief Abandons the examination of CollectCycles() after a change of the instances, its roots become candidates again
+     */
+    static void AbandonCollection(CBotContext* context);
+
+    /**
+     * \brief Appends the instances referenced by a list of variables, through pointers, arrays and intrinsic instances
+     */
+    static void GetReferences(CBotVar* vars, std::vector<CBotVarClass*>& references);
+
     //! Class definition
     CBotClass* m_pClass;
-    //! Class members
+    //! Class members, or elements of an array
     CBotVar* m_pVar;
-    //! Reference counter
-    int m_CptUse;
-    //! Identifier (unique) of an instance
+    /**
+     * \brief Index cache of the elements of an array, pointers into m_pVar which still owns them,
+     * built by IndexItems() and cleared by DetachVars()
+     *
+     * It only makes GetItem() constant time; growing the array appends to it without rebuilding it.
+     * The elements themselves stay boxed variables linked in m_pVar: GetItem() gives the element
+     * itself to CBotIndexExpr and CBotLeftExpr, which assign it in place, and the host reads arrays
+     * by walking GetItemList() (see CScriptFunctions). Unboxed values would need a proxy variable
+     * for each of these uses. Elements created one after the other come from the same slab
+     * (see CBotVar::operator new()), so they are mostly next to each other in memory anyway.
+     */
+    std::vector<CBotVar*> m_items;
+    //! Index cache of the class members by slot (see CBotClass::GetFieldCount()), pointers into m_pVar,
+    //! built by IndexFields() and cleared by DetachVars()
+    std::vector<CBotVar*> m_fields;
+    //! Generation (see CBotClass::InvalidateFields()) each field was updated in, by slot
+    std::vector<long> m_fieldGenerations;
+    //! Reference counter, atomic as objects of the host may be shared by programs running at once
+    std::atomic<int> m_CptUse;
+    //! Identifier (unique) of an instance, negative until numbered if created in CBotProgram::RunIsolated()
     long m_ItemIdent;
+    //! Instance can be found by its identifier, see Find()
+    bool m_indexed;
     //! Set after constructor is called, allows destructor to be called
     bool m_bConstructor;
+    //! Counted in the instances with a destructor to call, see CBotProgram::RunIsolated()
+    bool m_hasDestructor;
+    //! In the candidates of CollectCycles() kept by a thread, see DecrementUse()
+    std::atomic<CBotCandidateBuffer*> m_candidateBuffer{nullptr};
+    //! In the candidates of CollectCycles() of the context
+    std::atomic<bool> m_cycleCandidate{false};
+    //! Reached by the examination of CollectCycles() in progress, see CBotCycleCollection
+    bool m_collecting = false;
+    //! Memory charged to the program which created this instance, see CBotProgram::GetMemoryUsed()
+    CBotMemoryCharge m_memory;
 
     friend class CBotVar;
     friend class CBotVarPointer;
+    friend class CBotInstanceNumbers;
+    friend struct CBotCandidateBuffer;
 };
 
 } // namespace CBot
@@ -32,9 +32,9 @@ class CBotVarDouble : public CBotVarNumber<double, CBotTypDouble>
 public:
     CBotVarDouble(const CBotToken &name) : CBotVarNumber(name) {}
 
-    bool Save1State(std::ostream &ostr) override
+    bool Save1State(CBotStateWriter &writer) override
     {
-        return WriteDouble(ostr, m_val);
+        return WriteDouble(writer, m_val);
     }
 };
 
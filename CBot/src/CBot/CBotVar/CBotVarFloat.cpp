@@ -22,9 +22,9 @@
 namespace CBot
 {
 
-bool CBotVarFloat::Save1State(std::ostream &ostr)
+bool CBotVarFloat::Save1State(CBotStateWriter &writer)
 {
-    return WriteFloat(ostr, m_val); // the value of the variable
+    return WriteFloat(writer, m_val); // the value of the variable
 }
 
 } // namespace CBot
@@ -69,20 +69,20 @@ void CBotVarInt::Not()
     m_defnum.clear();
 }
 
-bool CBotVarInt::Save0State(std::ostream &ostr)
+bool CBotVarInt::Save0State(CBotStateWriter &writer)
 {
     if (!m_defnum.empty())
     {
-        if(!WriteWord(ostr, 200)) return false; // special marker
-        if(!WriteString(ostr, m_defnum)) return false;
+        if(!WriteWord(writer, 200)) return false; // special marker
+        if(!WriteString(writer, m_defnum)) return false;
     }
 
-    return CBotVar::Save0State(ostr);
+    return CBotVar::Save0State(writer);
 }
 
-bool CBotVarInt::Save1State(std::ostream &ostr)
+bool CBotVarInt::Save1State(CBotStateWriter &writer)
 {
-    return WriteInt(ostr, m_val);
+    return WriteInt(writer, m_val);
 }
 
 } // namespace CBot
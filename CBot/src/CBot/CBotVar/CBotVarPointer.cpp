@@ -170,21 +170,21 @@ CBotClass* CBotVarPointer::GetClass()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-bool CBotVarPointer::Save1State(std::ostream &ostr)
+bool CBotVarPointer::Save1State(CBotStateWriter &writer)
 {
     if ( m_type.GetClass() != nullptr )
     {
-        if (!WriteString(ostr, m_type.GetClass()->GetName())) return false;  // name of the class
+        if (!WriteString(writer, m_type.GetClass()->GetName())) return false;  // name of the class
     }
     else
     {
-        if (!WriteString(ostr, "")) return false;
+        if (!WriteString(writer, "")) return false;
     }
 
-    if (!WriteLong(ostr, GetIdent())) return false;      // the unique reference
+    if (!WriteLong(writer, GetIdent())) return false;      // the unique reference
 
     // also saves the proceedings copies
-    return SaveVars(ostr, GetPointer());
+    return SaveVars(writer, GetPointer());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -196,7 +196,7 @@ void CBotVarPointer::Copy(CBotVar* pSrc, bool bName)
 
     CBotVarPointer*    p = static_cast<CBotVarPointer*>(pSrc);
 
-    if ( bName) *m_token    = *p->m_token;
+    if (bName) CopyName(p);
     m_type        = p->m_type;
 //    m_pVarClass = p->m_pVarClass;
     m_pVarClass = p->GetPointer();
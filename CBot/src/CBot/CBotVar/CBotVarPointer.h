@@ -39,6 +39,10 @@ public:
      */
     ~CBotVarPointer();
 
+    //! Variables of this type have their own slabs, see CBotVar::operator new()
+    static void* operator new(std::size_t size) { return CBotVar::Allocate(size, CBotTypPointer); }
+    static void operator delete(void* p, std::size_t size) { CBotVar::Free(p, size, CBotTypPointer); }
+
     void Copy(CBotVar* pSrc, bool bName = true) override;
 
     void SetClass(CBotClass* pClass) override;
@@ -61,7 +65,7 @@ public:
 
     void ConstructorSet() override;
 
-    bool Save1State(std::ostream &ostr) override;
+    bool Save1State(CBotStateWriter &writer) override;
 
     void Update(void* pUser) override;
 
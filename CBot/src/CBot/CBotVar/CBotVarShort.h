@@ -37,9 +37,9 @@ public:
         SetValShort(static_cast<unsigned short>(left->GetValShort()) >> right->GetValInt());
     }
 
-    bool Save1State(std::ostream &ostr) override
+    bool Save1State(CBotStateWriter &writer) override
     {
-        return WriteShort(ostr, m_val);
+        return WriteShort(writer, m_val);
     }
 };
 
@@ -22,24 +22,115 @@
 namespace CBot
 {
 
+CBotSharedString::Text::Text(std::string text) : str(std::move(text))
+{
+    memory.Set(str.capacity());
+}
+
+CBotSharedString::CBotSharedString(std::string str)
+{
+    if (str.length() <= SHORT_LENGTH)
+        m_short = std::move(str);
+    else
+        m_shared = std::make_shared<Text>(std::move(str));
+}
+
+void CBotSharedString::Append(const std::string& str)
+{
+    if (m_shared == nullptr && m_short.length() + str.length() <= SHORT_LENGTH)
+    {
+        m_short += str;
+        return;
+    }
+
+    // use_count() is exact when it is 1, no other string can copy this one meanwhile
+    if (m_shared != nullptr && m_shared.use_count() == 1)
+    {
+        m_shared->str.append(str);
+        m_shared->memory.Set(m_shared->str.capacity());
+        return;
+    }
+
+    std::string text;
+    text.reserve(Get().length() + str.length());
+    text.append(Get()).append(str);
+    m_shared = std::make_shared<Text>(std::move(text));
+    m_short.clear();
+}
+
+bool CBotSharedString::operator==(const CBotSharedString& other) const
+{
+    if (m_shared != nullptr && m_shared == other.m_shared) return true;
+    return Get() == other.Get();
+}
+
+void CBotVarString::Copy(CBotVar* pSrc, bool bName)
+{
+    CBotVar::Copy(pSrc, bName);
+
+    m_val = static_cast<CBotVarString*>(pSrc)->m_val;
+}
+
+void CBotVarString::SetValString(CBotVarString* var)
+{
+    m_val = var->m_val;
+    m_binit = CBotVar::InitType::DEF;
+}
+
 void CBotVarString::Add(CBotVar* left, CBotVar* right)
 {
-    SetValString(left->GetValString() + right->GetValString());
+    if (left->GetType() == CBotTypString && left->GetInit() == CBotVar::InitType::DEF)
+        m_val = static_cast<CBotVarString*>(left)->m_val;
+    else
+        m_val = CBotSharedString(left->GetValString());
+    m_binit = CBotVar::InitType::DEF;
+
+    Append(right);
+}
+
+void CBotVarString::Append(CBotVar* var)
+{
+    if (var->GetType() == CBotTypString && var->GetInit() == CBotVar::InitType::DEF)
+        m_val.Append(static_cast<CBotVarString*>(var)->m_val.Get());
+    else
+        m_val.Append(var->GetValString());
+}
+
+bool CBotVarString::AppendInPlace(CBotVarString* copy, CBotVar* var)
+{
+    if (m_binit != CBotVar::InitType::DEF || copy->m_binit != CBotVar::InitType::DEF) return false;
+    if (!(m_val == copy->m_val)) return false;
+
+    copy->m_val = CBotSharedString();
+    Append(var);
+    copy->m_val = m_val;
+    return true;
+}
+
+static const std::string& GetText(CBotVar* var, std::string& buffer)
+{
+    if (var->GetType() == CBotTypString && var->GetInit() == CBotVar::InitType::DEF)
+        return static_cast<CBotVarString*>(var)->GetString();
+
+    buffer = var->GetValString();
+    return buffer;
 }
 
 bool CBotVarString::Eq(CBotVar* left, CBotVar* right)
 {
-    return left->GetValString() == right->GetValString();
+    std::string buffer1, buffer2;
+    return GetText(left, buffer1) == GetText(right, buffer2);
 }
 
 bool CBotVarString::Ne(CBotVar* left, CBotVar* right)
 {
-    return left->GetValString() != right->GetValString();
+    std::string buffer1, buffer2;
+    return GetText(left, buffer1) != GetText(right, buffer2);
 }
 
-bool CBotVarString::Save1State(std::ostream &ostr)
+bool CBotVarString::Save1State(CBotStateWriter &writer)
 {
-    return WriteString(ostr, m_val);
+    return WriteString(writer, m_val.Get());
 }
 
 } // namespace CBot
@@ -19,69 +19,164 @@
 
 #pragma once
 
-#include "CBot/CBotVar/CBotVarValue.h"
+#include "CBot/CBotVar/CBotVar.h"
+
+#include "CBot/CBotMemoryAccount.h"
+#include "CBot/CBotToken.h"
+
+#include <memory>
+#include <string>
 
 namespace CBot
 {
 
+/**
+ * \brief Text of a string variable
+ *
+ * The copies of a variable share its text, it is only copied when one of them is modified.
+ * Short strings are kept in the variable itself, as std::string doesn't allocate them,
+ * longer ones in a buffer counting its references.
+ */
+class CBotSharedString
+{
+public:
+    CBotSharedString() = default;
+    explicit CBotSharedString(std::string str);
+
+    /**
+     * \brief Returns the text, without copying it
+     */
+    const std::string& Get() const
+    {
+        return m_shared != nullptr ? m_shared->str : m_short;
+    }
+
+    /**
+     * \brief Appends text, in place if the buffer isn't shared with another string
+     *
+     * This keeps the capacity of the buffer, so building a string piece by piece
+     * doesn't copy it each time.
+     */
+    void Append(const std::string& str);
+
+    /**
+     * \brief Tells if both strings have the same text
+     */
+    bool operator==(const CBotSharedString& other) const;
+
+private:
+    //! Longest text kept in m_short
+    static const std::size_t SHORT_LENGTH = 15;
+
+    //! Shared buffer, charged to the program which created it
+    struct Text
+    {
+        explicit Text(std::string text);
+
+        std::string str;
+        CBotMemoryCharge memory;
+    };
+
+    std::string m_short;
+    std::shared_ptr<Text> m_shared;
+};
+
 /**
  * \brief CBotVar subclass for managing string values (::CBotTypString)
  */
-class CBotVarString : public CBotVarValue<std::string, CBotTypString>
+class CBotVarString : public CBotVar
 {
 public:
-    CBotVarString(const CBotToken &name) : CBotVarValue(name) {}
+    /**
+     * \brief Constructor. Do not call directly, use CBotVar::Create()
+     */
+    CBotVarString(const CBotToken &name) : CBotVar(name)
+    {
+        m_type = CBotTypString;
+    }
+
+    //! Variables of this type have their own slabs, see CBotVar::operator new()
+    static void* operator new(std::size_t size) { return CBotVar::Allocate(size, CBotTypString); }
+    static void operator delete(void* p, std::size_t size) { CBotVar::Free(p, size, CBotTypString); }
+
+    void Copy(CBotVar* pSrc, bool bName = true) override;
 
     void SetValString(const std::string& val) override
     {
-        m_val = val;
+        m_val = CBotSharedString(val);
         m_binit = CBotVar::InitType::DEF;
     }
 
+    std::string GetValString() const override
+    {
+        if (m_binit == CBotVar::InitType::UNDEF)
+            return UndefinedTokenString();
+
+        return m_val.Get();
+    }
+
+    /**
+     * \brief Returns the value without copying it
+     */
+    const std::string& GetString() const
+    {
+        return m_val.Get();
+    }
+
+    /**
+     * \brief Sets the value to the one of another string, whose text is shared
+     */
+    void SetValString(CBotVarString* var);
+
     void SetValInt(int val, const std::string& s = "") override
     {
-        SetValString(ToString(val));
+        SetValString(NumberToString(val));
     }
 
     void SetValFloat(float val) override
     {
-        SetValString(ToString(val));
+        SetValString(NumberToString(val));
     }
 
     int GetValInt() const override
     {
-        return FromString<int>(GetValString());
+        return StringToNumber<int>(m_val.Get());
     }
 
     float GetValFloat() const override
     {
-        return FromString<float>(GetValString());
+        return StringToNumber<float>(m_val.Get());
     }
 
     void Add(CBotVar* left, CBotVar* right) override;
 
+    /**
+     * \brief Appends the value of a variable (converted to a string) to this one
+     *
+     * Used to build strings: the text grows in place if it isn't shared.
+     * \param var Variable to append
+     */
+    void Append(CBotVar* var);
+
+    /**
+     * \brief Appends the value of a variable to this one, if it wasn't modified since the given copy
+     *
+     * The copy gives its text up first, so that a string built by a loop (s += ...) grows in place.
+     * It has the new value afterwards.
+     * \param copy Copy of this variable
+     * \param var Variable to append
+     * \return false if the values differ, nothing is done then
+     */
+    bool AppendInPlace(CBotVarString* copy, CBotVar* var);
+
     bool Eq(CBotVar* left, CBotVar* right) override;
     bool Ne(CBotVar* left, CBotVar* right) override;
 
-    bool Save1State(std::ostream &ostr) override;
+    bool Save1State(CBotStateWriter &writer) override;
 
 private:
-    template<typename T>
-    static std::string ToString(T val)
-    {
-        std::ostringstream ss;
-        ss << val;
-        return ss.str();
-    }
-
-    template<typename T>
-    static T FromString(std::string val)
-    {
-        std::istringstream ss(val);
-        T v;
-        ss >> v;
-        return v;
-    }
+    //! The value
+    CBotSharedString m_val;
 };
 
 } // namespace CBot
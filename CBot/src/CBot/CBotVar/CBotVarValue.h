@@ -23,16 +23,17 @@
 
 #include "CBot/CBotEnums.h"
 #include "CBot/CBotToken.h"
+#include "CBot/CBotUtils.h"
 
-#include <sstream>
 #include <cmath>
+#include <type_traits>
 
 
 namespace CBot
 {
 
 /**
- * \brief A variable holding a simple value (bool, int, float, string)
+ * \brief A variable holding a simple value (bool, int, float)
  */
 template <typename T, CBotType type>
 class CBotVarValue : public CBotVar
@@ -46,6 +47,10 @@ public:
         m_type = type;
     }
 
+    //! Variables of this type have their own slabs, see CBotVar::operator new()
+    static void* operator new(std::size_t size) { return CBotVar::Allocate(size, type); }
+    static void operator delete(void* p, std::size_t size) { CBotVar::Free(p, size, type); }
+
     void Copy(CBotVar* pSrc, bool bName = true) override
     {
         CBotVar::Copy(pSrc, bName);
@@ -57,8 +62,20 @@ public:
 
     void SetValString(const std::string& val) override
     {
-        std::istringstream s(val);
-        s >> m_val;
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            m_val = StringToNumber<int>(val) == 1;
+        }
+        else if constexpr (std::is_same_v<T, signed char>)
+        {
+            // a single character, like std::istream does
+            std::size_t i = val.find_first_not_of(" \t\n\v\f\r");
+            m_val = i == std::string::npos ? 0 : val[i];
+        }
+        else
+        {
+            m_val = StringToNumber<T>(val);
+        }
         m_binit = CBotVar::InitType::DEF;
     }
 
@@ -67,9 +84,12 @@ public:
         if (m_binit == CBotVar::InitType::UNDEF)
             return UndefinedTokenString();
 
-        std::ostringstream s;
-        s << std::boolalpha << m_val;
-        return s.str();
+        if constexpr (std::is_same_v<T, bool>)
+            return m_val ? "true" : "false";
+        else if constexpr (std::is_same_v<T, signed char>)
+            return std::string(1, static_cast<char>(m_val));   // written as a character, like std::ostream does
+        else
+            return NumberToString(m_val);
     }
 
 protected:
@@ -187,7 +207,7 @@ public:
 
     void Mul(CBotVar* left, CBotVar* right) override
     {
-        this->SetValue(static_cast<T>(*left) * static_cast<T>(*right));
+        this->SetValue(WrappingMul(static_cast<T>(*left), static_cast<T>(*right)));
     }
     void Power(CBotVar* left, CBotVar* right) override
     {
@@ -197,7 +217,7 @@ public:
     {
         T r = static_cast<T>(*right);
         if ( r == static_cast<T>(0) ) return CBotErrZeroDiv;
-        this->SetValue(static_cast<T>(*left) / r);
+        this->SetValue(WrappingDiv(static_cast<T>(*left), r));
         return CBotNoErr;
     }
     CBotError Modulo(CBotVar* left, CBotVar* right) override
@@ -209,11 +229,11 @@ public:
     }
     void Add(CBotVar* left, CBotVar* right) override
     {
-        this->SetValue(static_cast<T>(*left) + static_cast<T>(*right));
+        this->SetValue(WrappingAdd(static_cast<T>(*left), static_cast<T>(*right)));
     }
     void Sub(CBotVar* left, CBotVar* right) override
     {
-        this->SetValue(static_cast<T>(*left) - static_cast<T>(*right));
+        this->SetValue(WrappingSub(static_cast<T>(*left), static_cast<T>(*right)));
     }
 
     void Neg() override
@@ -260,7 +280,7 @@ public:
     {
         T r = static_cast<T>(*right);
         if ( r == static_cast<T>(0) ) return CBotErrZeroDiv;
-        this->SetValue(static_cast<T>(*left) % r);
+        this->SetValue(WrappingMod(static_cast<T>(*left), r));
         return CBotNoErr;
     }
 
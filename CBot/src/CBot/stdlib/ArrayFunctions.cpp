@@ -0,0 +1,422 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+#include "CBot/stdlib/stdlib.h"
+
+#include "CBot/CBot.h"
+
+#include "CBot/CBotUtils.h"
+
+#include "CBot/CBotInstr/CBotInstrUtils.h"
+#include "CBot/CBotVar/CBotVarString.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// These functions work on the elements of the arrays directly,
+// a whole array is handled in a single step of the program.
+
+namespace CBot
+{
+namespace
+{
+
+// Checks the array parameter and moves to the next one.
+// Gives the type of the elements of the array.
+
+CBotError CompileArray(CBotVar* &var, CBotTypResult& elem)
+{
+    if ( var == nullptr )  return CBotErrLowParam;
+    if ( var->GetType() != CBotTypArrayPointer )  return CBotErrBadParam;
+    elem = var->GetTypResult().GetTypElem();
+    var = var->GetNext();
+    return CBotNoErr;
+}
+
+// Checks the value parameter, which must be assignable to the elements.
+
+CBotError CompileValue(CBotVar* &var, const CBotTypResult& elem)
+{
+    if ( var == nullptr )  return CBotErrLowParam;
+    if ( !TypesCompatibles(elem, var->GetTypResult()) )  return CBotErrBadParam;
+    var = var->GetNext();
+    return CBotNoErr;
+}
+
+// Reading and writing of the elements by their C++ type.
+
+void GetItemValue(CBotVar* item, long& value)
+{
+    value = item->GetValLong();
+}
+
+void GetItemValue(CBotVar* item, double& value)
+{
+    value = item->GetValDouble();
+}
+
+void GetItemValue(CBotVar* item, std::string& value)
+{
+    value = static_cast<CBotVarString*>(item)->GetString();
+}
+
+void SetItemValue(CBotVar* item, long value)
+{
+    item->SetValLong(value);
+}
+
+void SetItemValue(CBotVar* item, double value)
+{
+    item->SetValDouble(value);
+}
+
+void SetItemValue(CBotVar* item, const std::string& value)
+{
+    item->SetValString(value);
+}
+
+// Order of the elements, nan goes after all numbers.
+
+template<typename T>
+bool IsLess(const T& a, const T& b)
+{
+    return a < b;
+}
+
+bool IsLess(double a, double b)
+{
+    return a < b || (!std::isnan(a) && std::isnan(b));
+}
+
+// Gives the elements of the array in values, fails if one isn't initialized.
+
+template<typename T>
+bool GetItemValues(CBotVar* items, std::vector<T>& values, int& exception)
+{
+    for (CBotVar* p = items; p != nullptr; p = p->GetNext())
+    {
+        if (p->GetInit() == CBotVar::InitType::UNDEF)
+        {
+            exception = CBotErrNotInit;
+            return false;
+        }
+        values.emplace_back();
+        GetItemValue(p, values.back());
+    }
+    return true;
+}
+
+template<typename T>
+bool SortItems(CBotVar* items, int& exception)
+{
+    std::vector<T> values;
+    if (!GetItemValues(items, values, exception)) return false;
+
+    std::sort(values.begin(), values.end(), [](const T& a, const T& b) { return IsLess(a, b); });
+
+    auto it = values.begin();
+    for (CBotVar* p = items; p != nullptr; p = p->GetNext())
+    {
+        SetItemValue(p, *it++);
+    }
+    return true;
+}
+
+// Tells if an element has the value looked for.
+
+bool IsSameValue(CBotVar* item, CBotVar* value)
+{
+    int type = item->GetType();
+    if (type <= CBotTypDouble)
+    {
+        if (type >= CBotTypFloat || value->GetType() >= CBotTypFloat)
+            return item->GetValDouble() == value->GetValDouble();
+        return item->GetValLong() == value->GetValLong();
+    }
+    if (type == CBotTypBoolean)
+        return item->GetValInt() == value->GetValInt();
+    if (type == CBotTypString)
+        return static_cast<CBotVarString*>(item)->GetString() == static_cast<CBotVarString*>(value)->GetString();
+    return item->GetPointer() == value->GetPointer();
+}
+
+// Compilation of "arrreverse(array)".
+
+CBotTypResult cArrReverse(CBotVar* &var, void* user)
+{
+    CBotTypResult elem;
+    CBotError err = CompileArray(var, elem);
+    if ( err != CBotNoErr )  return CBotTypResult(err);
+    if ( var != nullptr )  return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+// Instruction "arrreverse(array)".
+
+bool rArrReverse(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    int n = var->GetItemCount();
+    if (n < 2) return true;
+
+    CBotVar* temp = CBotVar::Create("", var->GetItem(0, false)->GetTypResult());
+    for (int i = 0; i < n / 2; i++)
+    {
+        CBotVar* first = var->GetItem(i, false);
+        CBotVar* last = var->GetItem(n - 1 - i, false);
+        temp->SetVal(first);
+        first->SetVal(last);
+        last->SetVal(temp);
+    }
+    delete temp;
+    return true;
+}
+
+// Compilation of "arrsort(array)", for arrays of numbers or strings.
+
+CBotTypResult cArrSort(CBotVar* &var, void* user)
+{
+    CBotTypResult elem;
+    CBotError err = CompileArray(var, elem);
+    if ( err != CBotNoErr )  return CBotTypResult(err);
+    if ( elem.GetType() > CBotTypDouble && elem.GetType() != CBotTypString )  return CBotTypResult(CBotErrBadParam);
+    if ( var != nullptr )  return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+// Instruction "arrsort(array)".
+
+bool rArrSort(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    CBotVar* items = var->GetItemList();
+    if (items == nullptr) return true;
+
+    switch (items->GetType())
+    {
+        case CBotTypString:
+            return SortItems<std::string>(items, exception);
+        case CBotTypFloat:
+        case CBotTypDouble:
+            return SortItems<double>(items, exception);
+        default:
+            return SortItems<long>(items, exception);
+    }
+}
+
+// Compilation of "arrfind(array, value)".
+
+CBotTypResult cArrFind(CBotVar* &var, void* user)
+{
+    CBotTypResult elem;
+    CBotError err = CompileArray(var, elem);
+    if ( err == CBotNoErr )  err = CompileValue(var, elem);
+    if ( err != CBotNoErr )  return CBotTypResult(err);
+    if ( var != nullptr )  return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypInt);
+}
+
+// Instruction "arrfind(array, value)", gives the index of the first element equal to the value or -1.
+
+bool rArrFind(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    CBotVar* value = var->GetNext();
+
+    int index = 0;
+    for (CBotVar* p = var->GetItemList(); p != nullptr; p = p->GetNext(), index++)
+    {
+        if (p->GetInit() != CBotVar::InitType::UNDEF && IsSameValue(p, value))
+        {
+            result->SetValInt(index);
+            return true;
+        }
+    }
+    result->SetValInt(-1);
+    return true;
+}
+
+// Compilation of "arrfill(array, value)".
+
+CBotTypResult cArrFill(CBotVar* &var, void* user)
+{
+    CBotTypResult elem;
+    CBotError err = CompileArray(var, elem);
+    if ( err == CBotNoErr )  err = CompileValue(var, elem);
+    if ( err != CBotNoErr )  return CBotTypResult(err);
+    if ( var != nullptr )  return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+// Instruction "arrfill(array, value)", assigns the value to all the elements.
+
+bool rArrFill(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    CBotVar* value = var->GetNext();
+
+    for (CBotVar* p = var->GetItemList(); p != nullptr; p = p->GetNext())
+    {
+        p->SetVal(value);
+    }
+    return true;
+}
+
+// Compilation of "arrmid(array, start[, length])", which gives an array of the same type.
+
+CBotTypResult cArrMid(CBotVar* &var, void* user)
+{
+    CBotTypResult elem;
+    CBotError err = CompileArray(var, elem);
+    if ( err != CBotNoErr )  return CBotTypResult(err);
+
+    if ( var == nullptr )  return CBotTypResult(CBotErrLowParam);
+    if ( var->GetType() > CBotTypDouble )  return CBotTypResult(CBotErrBadNum);
+    var = var->GetNext();
+
+    if ( var != nullptr )
+    {
+        if ( var->GetType() > CBotTypDouble )  return CBotTypResult(CBotErrBadNum);
+        var = var->GetNext();
+        if ( var != nullptr )  return CBotTypResult(CBotErrOverParam);
+    }
+    return CBotTypResult(CBotTypArrayPointer, elem);
+}
+
+// Instruction "arrmid(array, start[, length])", copies the elements from start,
+// all of them when the length is not given.
+
+bool rArrMid(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    CBotVar* array = var;
+    int count = array->GetItemCount();
+
+    var = var->GetNext();
+    int start = std::clamp(var->GetValInt(), 0, count);
+    int length = count - start;
+
+    var = var->GetNext();
+    if (var != nullptr) length = std::clamp(var->GetValInt(), 0, length);
+
+    result->SetInit(CBotVar::InitType::DEF);
+    for (int i = 0; i < length; i++)
+    {
+        result->GetItem(i, true)->SetVal(array->GetItem(start + i, false));
+    }
+    return true;
+}
+
+// Compilation of "arrsum(array)", "arrmin(array)" and "arrmax(array)",
+// for arrays of numbers. The result has the type of the elements.
+
+CBotTypResult cArrNumber(CBotVar* &var, void* user)
+{
+    CBotTypResult elem;
+    CBotError err = CompileArray(var, elem);
+    if ( err != CBotNoErr )  return CBotTypResult(err);
+    if ( elem.GetType() > CBotTypDouble )  return CBotTypResult(CBotErrBadNum);
+    if ( var != nullptr )  return CBotTypResult(CBotErrOverParam);
+
+    switch (elem.GetType())
+    {
+        case CBotTypLong:
+        case CBotTypFloat:
+        case CBotTypDouble:
+            return CBotTypResult(elem.GetType());
+        default:
+            return CBotTypResult(CBotTypInt);
+    }
+}
+
+enum class Aggregate
+{
+    Sum,
+    Min,
+    Max,
+};
+
+template<typename T>
+bool AggregateItems(CBotVar* var, CBotVar* result, Aggregate op, int& exception)
+{
+    std::vector<T> values;
+    if (!GetItemValues(var->GetItemList(), values, exception)) return false;
+
+    T value = 0;
+    if (op == Aggregate::Sum)
+    {
+        for (T v : values) value = WrappingAdd(value, v);      // overflows as the + operator
+    }
+    else
+    {
+        // no minimum or maximum of an empty array
+        if (values.empty())
+        {
+            exception = CBotErrOutArray;
+            return false;
+        }
+        if (op == Aggregate::Min)
+            value = *std::min_element(values.begin(), values.end(), [](T a, T b) { return IsLess(a, b); });
+        else
+            value = *std::max_element(values.begin(), values.end(), [](T a, T b) { return IsLess(a, b); });
+    }
+    SetItemValue(result, value);
+    return true;
+}
+
+bool AggregateArray(CBotVar* var, CBotVar* result, Aggregate op, int& exception)
+{
+    if (result->GetType() == CBotTypFloat || result->GetType() == CBotTypDouble)
+        return AggregateItems<double>(var, result, op, exception);
+    return AggregateItems<long>(var, result, op, exception);
+}
+
+// Instruction "arrsum(array)", 0 for an empty array.
+
+bool rArrSum(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    return AggregateArray(var, result, Aggregate::Sum, exception);
+}
+
+// Instruction "arrmin(array)".
+
+bool rArrMin(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    return AggregateArray(var, result, Aggregate::Min, exception);
+}
+
+// Instruction "arrmax(array)".
+
+bool rArrMax(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    return AggregateArray(var, result, Aggregate::Max, exception);
+}
+
+} // namespace
+
+void InitArrayFunctions()
+{
+    CBotProgram::AddFunction("arrsort",    rArrSort,    cArrSort, true);
+    CBotProgram::AddFunction("arrreverse", rArrReverse, cArrReverse, true);
+    CBotProgram::AddFunction("arrfind",    rArrFind,    cArrFind, true);
+    CBotProgram::AddFunction("arrfill",    rArrFill,    cArrFill, true);
+    CBotProgram::AddFunction("arrmid",     rArrMid,     cArrMid, true);
+    CBotProgram::AddFunction("arrsum",     rArrSum,     cArrNumber, true);
+    CBotProgram::AddFunction("arrmin",     rArrMin,     cArrNumber, true);
+    CBotProgram::AddFunction("arrmax",     rArrMax,     cArrNumber, true);
+}
+
+} // namespace CBot
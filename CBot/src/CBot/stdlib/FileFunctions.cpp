@@ -20,6 +20,7 @@
 #include "CBot/stdlib/stdlib.h"
 
 #include "CBot/CBot.h"
+#include "CBot/CBotContextState.h"
 
 #include <memory>
 #include <unordered_map>
@@ -28,11 +29,13 @@
 namespace CBot
 {
 
+CBotFileState& GetFileState()
+{
+    return *GetCurrentState().files;
+}
+
 namespace
 {
-std::unique_ptr<CBotFileAccessHandler> g_fileHandler;
-std::unordered_map<int, std::unique_ptr<CBotFile>> g_files;
-int g_nextFileId = 1;
 
 bool FileClassOpenFile(CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exception)
 {
@@ -68,14 +71,15 @@ bool FileClassOpenFile(CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exc
     if ( pVar->IsDefined()) { Exception = CBotErrFileOpen; return false; }
 
     // opens the requested file
-    assert(g_fileHandler != nullptr);
+    CBotFileState& state = GetFileState();
+    assert(state.handler != nullptr);
 
-    std::unique_ptr<CBotFile> file = g_fileHandler->OpenFile(filename, openMode);
+    std::unique_ptr<CBotFile> file = state.handler->OpenFile(filename, openMode);
 
     if (!file->Opened()) { Exception = CBotErrFileOpen; return false; }
 
-    int fileHandle = g_nextFileId++;
-    g_files[fileHandle] = std::move(file);
+    int fileHandle = state.nextFileId++;
+    state.files[fileHandle] = std::move(file);
 
     // save the file handle
     pVar = pThis->GetItem("handle");
@@ -131,7 +135,7 @@ bool rfdestruct (CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exception
     pVar = pThis->GetItem("handle");
 
     if (!pVar->IsDefined()) return true; // file not opened
-    g_files.erase(pVar->GetValInt());
+    GetFileState().files.erase(pVar->GetValInt());
 
     pVar->SetInit(CBotVar::InitType::UNDEF);
     return true;
@@ -194,14 +198,15 @@ bool rfclose (CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exception, v
 
     int fileHandle = pVar->GetValInt();
 
-    const auto handleIter = g_files.find(fileHandle);
-    if (handleIter == g_files.end())
+    std::unordered_map<int, std::unique_ptr<CBotFile>>& files = GetFileState().files;
+    const auto handleIter = files.find(fileHandle);
+    if (handleIter == files.end())
     {
         Exception = CBotErrNotOpen;
         return false;
     }
 
-    g_files.erase(handleIter);
+    files.erase(handleIter);
 
     pVar->SetInit(CBotVar::InitType::UNDEF);
     return true;
@@ -237,8 +242,9 @@ bool rfwrite (CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exception, v
 
     int fileHandle = pVar->GetValInt();
 
-    const auto handleIter = g_files.find(fileHandle);
-    if (handleIter == g_files.end())
+    std::unordered_map<int, std::unique_ptr<CBotFile>>& files = GetFileState().files;
+    const auto handleIter = files.find(fileHandle);
+    if (handleIter == files.end())
     {
         Exception = CBotErrNotOpen;
         return false;
@@ -283,8 +289,9 @@ bool rfread(CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exception, voi
 
     int fileHandle = pVar->GetValInt();
 
-    const auto handleIter = g_files.find(fileHandle);
-    if (handleIter == g_files.end())
+    std::unordered_map<int, std::unique_ptr<CBotFile>>& files = GetFileState().files;
+    const auto handleIter = files.find(fileHandle);
+    if (handleIter == files.end())
     {
         Exception = CBotErrNotOpen;
         return false;
@@ -325,8 +332,9 @@ bool rfeof (CBotVar* pThis, CBotVar* pVar, CBotVar* pResult, int& Exception, voi
 
     int fileHandle = pVar->GetValInt();
 
-    const auto handleIter = g_files.find(fileHandle);
-    if (handleIter == g_files.end())
+    std::unordered_map<int, std::unique_ptr<CBotFile>>& files = GetFileState().files;
+    const auto handleIter = files.find(fileHandle);
+    if (handleIter == files.end())
     {
         Exception = CBotErrNotOpen;
         return false;
@@ -352,8 +360,9 @@ CBotTypResult cfeof (CBotVar* pThis, CBotVar* &pVar)
 bool rDeleteFile(CBotVar* var, CBotVar* result, int& exception, void* user)
 {
     std::string filename = var->GetValString();
-    assert(g_fileHandler != nullptr);
-    return g_fileHandler->DeleteFile(filename);
+    CBotFileState& state = GetFileState();
+    assert(state.handler != nullptr);
+    return state.handler->DeleteFile(filename);
 }
 
 } // namespace
@@ -395,7 +404,7 @@ void InitFileFunctions()
 
 void SetFileAccessHandler(std::unique_ptr<CBotFileAccessHandler> fileHandler)
 {
-    g_fileHandler = std::move(fileHandler);
+    GetFileState().handler = std::move(fileHandler);
 }
 
 } // namespace CBot
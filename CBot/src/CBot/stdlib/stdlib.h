@@ -21,11 +21,26 @@
 
 #include "CBot/stdlib/stdlib_public.h"
 
+#include <memory>
+#include <unordered_map>
+
 namespace CBot
 {
 
+//! Files opened by the programs of a context, see CBotContext
+struct CBotFileState
+{
+    std::unique_ptr<CBotFileAccessHandler> handler;
+    std::unordered_map<int, std::unique_ptr<CBotFile>> files;
+    int nextFileId = 1;
+};
+
+//! Returns the files of the current context
+CBotFileState& GetFileState();
+
 void InitStringFunctions();
 void InitFileFunctions();
 void InitMathFunctions();
+void InitArrayFunctions();
 
 } // namespace CBot
@@ -49,6 +49,7 @@ public:
     virtual bool DeleteFile(const std::string& filename) = 0;
 };
 
+//! Sets the handler of the file functions, for the current context (see CBotContext)
 void SetFileAccessHandler(std::unique_ptr<CBotFileAccessHandler> fileHandler);
 
 // TODO: provide default implementation of CBotFileAccessHandler
@@ -810,6 +810,7 @@ void InitializeRestext()
     stringsCbot[CBot::CBotErrNotOpen]       = TR("File not open");
     stringsCbot[CBot::CBotErrRead]          = TR("Read error");
     stringsCbot[CBot::CBotErrWrite]         = TR("Write error");
+    stringsCbot[CBot::CBotErrMemory]        = TR("Memory limit exceeded");
 }
 
 
@@ -55,6 +55,8 @@
 #include "level/robotmain.h"
 #include "level/player_profile.h"
 
+#include "script/scheduler.h"
+
 #include "math/geometry.h"
 
 #include "sound/sound.h"
@@ -4644,7 +4646,7 @@ void CEngine::DrawStats()
 
     float height = m_text->GetAscent(FONT_COMMON, 13.0f);
     float width = 0.4f;
-    const int TOTAL_LINES = 22;
+    const int TOTAL_LINES = 23;
 
     glm::vec2 pos(0.05f * m_size.x/m_size.y, 0.05f + TOTAL_LINES * height);
 
@@ -4718,6 +4720,9 @@ void CEngine::DrawStats()
     drawStatsCounter("    Particle update",   PCNT_UPDATE_PARTICLE);
     drawStatsValue  ("    Game update",       gameUpdate);
     drawStatsCounter("    CBot programs",     PCNT_UPDATE_CBOT);
+    CScriptScheduler* scheduler = CRobotMain::GetInstance().GetScriptScheduler();
+    drawStatsLine(   "        ticks",         StrUtils::ToString<int>(scheduler->GetFrameTicks()),
+                                              StrUtils::ToString<int>(scheduler->GetFrameBudget()));
     drawStatsValue(  "    Other update",      otherUpdate);
     drawStatsLine(   "", "", "");
     drawStatsCounter("Frame render",      PCNT_RENDER_ALL);
@@ -37,6 +37,8 @@
 #include "common/resources/outputstream.h"
 #include "common/resources/resourcemanager.h"
 
+#include "common/thread/worker_thread.h"
+
 #include "graphics/core/material.h"
 
 #include "graphics/engine/camera.h"
@@ -86,6 +88,7 @@
 #include "physics/physics.h"
 
 #include "script/cbottoken.h"
+#include "script/scheduler.h"
 #include "script/script.h"
 #include "script/scriptfunc.h"
 
@@ -112,8 +115,10 @@
 #include "ui/screen/screen_loading.h"
 
 #include <algorithm>
+#include <condition_variable>
 #include <iomanip>
 #include <stdexcept>
+#include <thread>
 #include <cmath>
 #include <ctime>
 
@@ -127,6 +132,9 @@ float   g_unit;             // conversion factor
 const float MIN_SPEED = 1/8.0f;
 const float MAX_SPEED = 256.0f;
 
+// Time spent each frame freeing the CBot instances left in cycles, in microseconds.
+const int CBOT_COLLECT_BUDGET = 500;
+
 // Reference colors used when recoloring textures, see ChangeColor()
 const Gfx::Color COLOR_REF_BOT   = Gfx::Color( 10.0f/256.0f, 166.0f/256.0f, 254.0f/256.0f);  // blue
 const Gfx::Color COLOR_REF_ALIEN = Gfx::Color(135.0f/256.0f, 170.0f/256.0f,  13.0f/256.0f);  // green
@@ -154,6 +162,7 @@ CRobotMain::CRobotMain()
     m_modelManager = std::make_unique<Gfx::CModelManager>();
     m_settings    = std::make_unique<CSettings>();
     m_pause       = std::make_unique<CPauseManager>();
+    m_scriptScheduler = std::make_unique<CScriptScheduler>();
     m_interface   = std::make_unique<Ui::CInterface>();
     m_terrain     = std::make_unique<Gfx::CTerrain>();
     m_camera      = std::make_unique<Gfx::CCamera>();
@@ -310,6 +319,11 @@ CPauseManager* CRobotMain::GetPauseManager()
     return m_pause.get();
 }
 
+CScriptScheduler* CRobotMain::GetScriptScheduler()
+{
+    return m_scriptScheduler.get();
+}
+
 std::string PhaseToString(Phase phase)
 {
     if (phase == PHASE_WELCOME1) return "PHASE_WELCOME1";
@@ -1340,6 +1354,12 @@ void CRobotMain::ExecuteCmd(const std::string& cmd)
             return;
         }
 
+        if (cmd == "profile")
+        {
+            SetCBotProfiling(!m_cbotProfiling);
+            return;
+        }
+
         if (cmd == "noclip")
         {
             CObject* object = GetSelect();
@@ -2370,6 +2390,67 @@ void CRobotMain::InitEye()
                        glm::vec3(10.0f,  5.0f, 0.0f), 0.0f);
 }
 
+//! Returns the programs that will run in this frame, in the order they will run
+//! Programs in step by step mode are left out, they run at their own pace
+//! Transported objects are left out too, EventFrame() advances them after all the others
+std::vector<CScript*> CRobotMain::GetRunningScripts()
+{
+    std::vector<CScript*> scripts;
+    for (CObject* obj : m_objMan->GetAllObjects())
+    {
+        if (IsObjectBeingTransported(obj)) continue;
+        if (obj->GetType() == OBJECT_TOTO) continue;
+        if (!obj->Implements(ObjectInterfaceType::Programmable)) continue;
+
+        CProgrammableObject& programmable = dynamic_cast<CProgrammableObject&>(*obj);
+        if (!programmable.GetActivity() || !programmable.IsProgram()) continue;
+
+        CScript* script = programmable.GetCurrentProgram()->script.get();
+        if (script->GetStepMode()) continue;
+        scripts.push_back(script);
+    }
+    return scripts;
+}
+
+//! Runs at once, on several threads, the programs of the robots until they act on the world
+//! The rest of each program is run as before, one robot after the other, by CScript::Continue()
+void CRobotMain::RunProgramsIsolated(const std::vector<CScript*>& scripts)
+{
+    if (scripts.size() < 2) return;
+
+    if (m_programThreads.empty())
+    {
+        unsigned int count = std::max(std::thread::hardware_concurrency(), 2u);
+        for (unsigned int i = 0; i < count; i++)
+            m_programThreads.push_back(std::make_unique<CWorkerThread>());
+    }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t next = 0, running = m_programThreads.size();
+
+    // every thread takes the next script until there are none left
+    auto work = [&]()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (next < scripts.size())
+        {
+            CScript* script = scripts[next++];
+            lock.unlock();
+            script->ContinueIsolated();
+            lock.lock();
+        }
+        running--;
+        finished.notify_one();
+    };
+
+    for (auto& thread : m_programThreads)
+        thread->Start(work);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]() { return running == 0; });
+}
+
 //! Advances the entire scene
 bool CRobotMain::EventFrame(const Event &event)
 {
@@ -2397,6 +2478,10 @@ bool CRobotMain::EventFrame(const Event &event)
     CObject* toto = nullptr;
     if (!m_pause->IsPauseType(PAUSE_OBJECT_UPDATES))
     {
+        std::vector<CScript*> scripts = GetRunningScripts();
+        m_scriptScheduler->Schedule(scripts);
+        RunProgramsIsolated(scripts);
+
         // Advances all the robots, but not toto.
         for (CObject* obj : m_objMan->GetAllObjects())
         {
@@ -2436,6 +2521,13 @@ bool CRobotMain::EventFrame(const Event &event)
         }
 
         m_engine->GetPyroManager()->EventProcess(event);
+
+        // Frees, a little every frame, the class instances the programs left in cycles of references
+        long collected = CBot::CBotProgram::GetMemoryUsage().collected;
+        CBot::CBotProgram::CollectCycles(CBOT_COLLECT_BUDGET);
+        CBot::CBotProgram::MemoryUsage usage = CBot::CBotProgram::GetMemoryUsage();
+        if (usage.collected != collected)
+            GetLogger()->Debug("CBot: %% instances freed in cycles, %% alive", usage.collected - collected, usage.instances);
     }
 
     // The camera follows the object, because its position
@@ -5421,6 +5513,50 @@ bool CRobotMain::GetTrainerPilot()
     return m_cheatTrainerPilot;
 }
 
+//! Starts or stops profiling the programs of all the objects
+//! When it stops, the results are written as collapsed stacks, for the flame graph tools
+void CRobotMain::SetCBotProfiling(bool profiling)
+{
+    std::vector<CScript*> scripts;
+    for (CObject* obj : m_objMan->GetAllObjects())
+    {
+        if (!obj->Implements(ObjectInterfaceType::ProgramStorage)) continue;
+
+        for (auto& program : dynamic_cast<CProgramStorageObject&>(*obj).GetPrograms())
+            scripts.push_back(program->script.get());
+    }
+
+    if (m_cbotProfiling && !profiling)
+    {
+        auto writeProfile = [&](const std::string& filename, CBot::CBotProfiler::Measure measure)
+        {
+            COutputStream ostr(filename);
+            if (!ostr.is_open())
+            {
+                GetLogger()->Error("Unable to write %%", filename);
+                return;
+            }
+            for (CScript* script : scripts)
+            {
+                if (script->GetProfiler() != nullptr)
+                    script->GetProfiler()->WriteCollapsed(ostr, measure);
+            }
+            GetLogger()->Info("CBot profile written to %%", filename);
+        };
+        writeProfile("cbot_profile.txt", CBot::CBotProfiler::Measure::TICKS);
+        writeProfile("cbot_profile_time.txt", CBot::CBotProfiler::Measure::TIME);
+    }
+
+    m_cbotProfiling = profiling;
+    for (CScript* script : scripts)
+        script->SetProfiling(profiling);
+}
+
+bool CRobotMain::GetCBotProfiling()
+{
+    return m_cbotProfiling;
+}
+
 bool CRobotMain::GetPlusTrainer()
 {
     return m_ui->GetPlusTrainer();
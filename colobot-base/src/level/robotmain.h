@@ -97,6 +97,9 @@ class CPlayerProfile;
 class CSettings;
 class COldObject;
 class CPauseManager;
+class CScript;
+class CScriptScheduler;
+class CWorkerThread;
 struct ActivePause;
 
 namespace Gfx
@@ -193,6 +196,7 @@ public:
     Ui::CInterface* GetInterface();
     Ui::CDisplayText* GetDisplayText();
     CPauseManager* GetPauseManager();
+    CScriptScheduler* GetScriptScheduler();
 
     /**
      * \name Phase management
@@ -272,6 +276,8 @@ public:
     const std::string& GetScriptName();
     const std::string& GetScriptFile();
     bool        GetTrainerPilot();
+    void        SetCBotProfiling(bool profiling);
+    bool        GetCBotProfiling();
     bool        GetPlusTrainer();
     bool        GetPlusExplorer();
     bool        GetFixScene();
@@ -508,6 +514,8 @@ public:
 
 protected:
     bool        EventFrame(const Event &event);
+    std::vector<CScript*> GetRunningScripts();
+    void        RunProgramsIsolated(const std::vector<CScript*>& scripts);
     bool        EventObject(const Event &event);
     void        InitEye();
 
@@ -584,6 +592,7 @@ protected:
     std::unique_ptr<CObjectManager> m_objMan;
     std::unique_ptr<CMainMovie> m_movie;
     std::unique_ptr<CPauseManager> m_pause;
+    std::unique_ptr<CScriptScheduler> m_scriptScheduler;
     std::unique_ptr<Gfx::CModelManager> m_modelManager;
     std::unique_ptr<Gfx::CTerrain> m_terrain;
     std::unique_ptr<Gfx::CCamera> m_camera;
@@ -598,6 +607,8 @@ protected:
 
     //! Progress of loaded player
     std::unique_ptr<CPlayerProfile> m_playerProfile;
+    //! Threads running the programs of the robots at the beginning of each frame, see RunProgramsIsolated()
+    std::vector<std::unique_ptr<CWorkerThread>> m_programThreads;
 
 
     //! Time since level start, including pause and intro movie
@@ -651,6 +662,7 @@ protected:
     bool            m_editFull = false;        // edition in full screen?
     bool            m_hilite = false;
     bool            m_cheatTrainerPilot = false;    // remote trainer?
+    bool            m_cbotProfiling = false;        // programs measured by a CBotProfiler?
     bool            m_friendAim = false;
     bool            m_resetCreate = false;
     bool            m_mapShow = false;
@@ -395,6 +395,14 @@ std::string GetHelpFilename(const char *token)
     if ( strcmp(token, "strfind"       ) == 0 )  helpfile = "cbot/string";
     if ( strcmp(token, "strlower"      ) == 0 )  helpfile = "cbot/string";
     if ( strcmp(token, "strupper"      ) == 0 )  helpfile = "cbot/string";
+    if ( strcmp(token, "arrsort"       ) == 0 )  helpfile = "cbot/array";
+    if ( strcmp(token, "arrreverse"    ) == 0 )  helpfile = "cbot/array";
+    if ( strcmp(token, "arrfind"       ) == 0 )  helpfile = "cbot/array";
+    if ( strcmp(token, "arrfill"       ) == 0 )  helpfile = "cbot/array";
+    if ( strcmp(token, "arrmid"        ) == 0 )  helpfile = "cbot/array";
+    if ( strcmp(token, "arrsum"        ) == 0 )  helpfile = "cbot/array";
+    if ( strcmp(token, "arrmin"        ) == 0 )  helpfile = "cbot/array";
+    if ( strcmp(token, "arrmax"        ) == 0 )  helpfile = "cbot/array";
     if ( strcmp(token, "open"          ) == 0 )  helpfile = "cbot/open";
     if ( strcmp(token, "close"         ) == 0 )  helpfile = "cbot/close";
     if ( strcmp(token, "writeln"       ) == 0 )  helpfile = "cbot/writeln";
@@ -523,6 +531,14 @@ bool IsFunction(const char *token)
     if ( strcmp(token, "strfind"      ) == 0 )  return true;
     if ( strcmp(token, "strlower"     ) == 0 )  return true;
     if ( strcmp(token, "strupper"     ) == 0 )  return true;
+    if ( strcmp(token, "arrsort"      ) == 0 )  return true;
+    if ( strcmp(token, "arrreverse"   ) == 0 )  return true;
+    if ( strcmp(token, "arrfind"      ) == 0 )  return true;
+    if ( strcmp(token, "arrfill"      ) == 0 )  return true;
+    if ( strcmp(token, "arrmid"       ) == 0 )  return true;
+    if ( strcmp(token, "arrsum"       ) == 0 )  return true;
+    if ( strcmp(token, "arrmin"       ) == 0 )  return true;
+    if ( strcmp(token, "arrmax"       ) == 0 )  return true;
     if ( strcmp(token, "open"         ) == 0 )  return true;
     if ( strcmp(token, "close"        ) == 0 )  return true;
     if ( strcmp(token, "writeln"      ) == 0 )  return true;
@@ -632,6 +648,14 @@ const char* GetHelpText(const char *token)
     if ( strcmp(token, "strfind"   ) == 0 )  return "strfind ( string, substring );";
     if ( strcmp(token, "strlower"  ) == 0 )  return "strlower ( string );";
     if ( strcmp(token, "strupper"  ) == 0 )  return "strupper ( string );";
+    if ( strcmp(token, "arrsort"   ) == 0 )  return "arrsort ( array );";
+    if ( strcmp(token, "arrreverse") == 0 )  return "arrreverse ( array );";
+    if ( strcmp(token, "arrfind"   ) == 0 )  return "arrfind ( array, value );";
+    if ( strcmp(token, "arrfill"   ) == 0 )  return "arrfill ( array, value );";
+    if ( strcmp(token, "arrmid"    ) == 0 )  return "arrmid ( array, pos, len );";
+    if ( strcmp(token, "arrsum"    ) == 0 )  return "arrsum ( array );";
+    if ( strcmp(token, "arrmin"    ) == 0 )  return "arrmin ( array );";
+    if ( strcmp(token, "arrmax"    ) == 0 )  return "arrmax ( array );";
     if ( strcmp(token, "open"      ) == 0 )  return "file.open ( filename, mode );";
     if ( strcmp(token, "close"     ) == 0 )  return "file.close ( );";
     if ( strcmp(token, "writeln"   ) == 0 )  return "file.writeln ( string );";
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+
+#include "script/scheduler.h"
+
+#include "script/script.h"
+
+#include <algorithm>
+
+
+CScriptScheduler::CScriptScheduler()
+{
+}
+
+void CScriptScheduler::SetFrameBudget(int ticks)
+{
+    m_budget = std::max(ticks, 1);
+}
+
+int CScriptScheduler::GetFrameBudget()
+{
+    return m_budget;
+}
+
+// Takes what the programs used in the last frame from their credit,
+// then gives them their time for this frame.
+
+void CScriptScheduler::Schedule(const std::vector<CScript*>& scripts)
+{
+    int requested = 0;
+    m_frameTicks = 0;
+    for (CScript* script : scripts)
+    {
+        m_frameTicks += script->m_frameTicks;
+        script->m_credit -= script->m_frameTicks;
+        script->m_frameTicks = 0;
+        requested += script->m_ipf;
+    }
+
+    if ( requested <= m_budget )  // enough time for everyone?
+    {
+        for (CScript* script : scripts)
+        {
+            script->m_credit = 0;
+            script->m_frameTimer = script->m_ipf;
+        }
+        return;
+    }
+
+    int count = static_cast<int>(scripts.size());
+    int share = m_budget / count;
+    int remainder = m_budget % count;
+    for (int i = 0; i < count; i++)
+    {
+        CScript* script = scripts[(m_next + i) % count];
+        int credit = script->m_credit + share + (i < remainder ? 1 : 0);
+        script->m_credit = std::min(credit, script->m_ipf);
+        script->m_frameTimer = std::max(script->m_credit, 0);
+    }
+    m_next = (m_next + remainder) % count;
+}
+
+int CScriptScheduler::GetFrameTicks()
+{
+    return m_frameTicks;
+}
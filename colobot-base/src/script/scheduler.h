@@ -0,0 +1,65 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+/**
+ * \file script/scheduler.h
+ * \brief Sharing of the CBot time between the running programs
+ */
+
+#pragma once
+
+#include <vector>
+
+class CScript;
+
+
+const int CBOT_FRAME_BUDGET = 20000;    // CBOT: default number of timer ticks / frame for all the programs
+
+
+/**
+ * \class CScriptScheduler
+ * \brief Shares a budget of CBot timer ticks per frame between the running programs
+ *
+ * Each program asks for ipf() ticks per frame (see CScript::Continue()). As long as all
+ * of them fit in the budget, they get them. Otherwise the budget is split evenly: each
+ * program earns its share in credit every frame, up to its ipf(), and runs as long as
+ * its credit allows. What it uses past its credit (expensive instruction or function,
+ * see CBot::CBotStack::ChargeTimer()) is taken from the next frames. The ticks left by
+ * the division go to the next programs in turn.
+ */
+class CScriptScheduler
+{
+public:
+    CScriptScheduler();
+
+    //! Sets the number of ticks all the programs may use in a frame
+    void        SetFrameBudget(int ticks);
+    int         GetFrameBudget();
+
+    //! Gives their time for this frame to the running programs, in the order they will run
+    void        Schedule(const std::vector<CScript*>& scripts);
+
+    //! Returns the number of ticks used by the programs in the last frame
+    int         GetFrameTicks();
+
+protected:
+    int         m_budget = CBOT_FRAME_BUDGET;
+    int         m_next = 0;         // program getting the first remaining tick
+    int         m_frameTicks = 0;
+};
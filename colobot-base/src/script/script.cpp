@@ -45,8 +45,49 @@
 #include "ui/controls/list.h"
 
 #include <libintl.h>
+#include <map>
+#include <string>
 
 const int CBOT_IPF = 100;       // CBOT: default number of instructions / frame
+const int MAX_CHECKED_SCRIPTS = 100;    // scripts whose tokens are kept by CheckToken()
+
+namespace
+{
+
+// Uses of a token in a script, with the position of its last occurrence.
+
+struct TokenUsage
+{
+    int count = 0;
+    int start = 0;
+    int end = 0;
+};
+
+// Gives the uses of the tokens of a script. The robots of a level often run the same
+// program, so the scripts already checked keep theirs and aren't split into tokens again.
+
+const std::map<std::string, TokenUsage>& GetTokenUsage(const char* script)
+{
+    static std::map<std::string, std::map<std::string, TokenUsage>> checked;
+
+    auto it = checked.find(script);
+    if ( it != checked.end() )  return it->second;
+
+    if ( checked.size() >= MAX_CHECKED_SCRIPTS )  checked.clear();
+
+    std::map<std::string, TokenUsage> usage;
+    auto tokens = CBot::CBotToken::CompileTokens(script);
+    for ( CBot::CBotToken* bt = tokens.get(); bt != nullptr; bt = bt->GetNext() )
+    {
+        TokenUsage& token = usage[bt->GetString()];
+        token.count++;
+        token.start = bt->GetStart();
+        token.end = bt->GetEnd();
+    }
+    return checked.emplace(script, std::move(usage)).first->second;
+}
+
+} // namespace
 
 
 // Object's constructor.
@@ -73,6 +114,11 @@ CScript::CScript(COldObject* object)
     m_bCompile = false;
     m_cursor1 = 0;
     m_cursor2 = 0;
+
+    if ( m_main->GetCBotProfiling() )
+    {
+        SetProfiling(true);
+    }
 }
 
 // Object's destructor.
@@ -164,37 +210,24 @@ bool CScript::CheckToken()
     m_token.clear();
     m_bCompile = false;
 
-    std::map<std::string, int> used;
-    std::map<std::string, int> cursor1;
-    std::map<std::string, int> cursor2;
-
-    auto tokens = CBot::CBotToken::CompileTokens(m_script.get());
-    CBot::CBotToken* bt = tokens.get();
-    while ( bt != nullptr )
-    {
-        std::string token = bt->GetString();
-
-        // Store only the last occurrence of the token
-        cursor1[token] = bt->GetStart();
-        cursor2[token] = bt->GetEnd();
-
-        used[token]++;
-
-        bt = bt->GetNext();
-    }
+    // the tokens of the script are counted once, the lists of the levels are checked each time
+    const std::map<std::string, TokenUsage>& usage = GetTokenUsage(m_script.get());
 
     for (const auto& it : m_main->GetObligatoryTokenList())
     {
+        auto found = usage.find(it.first);
+        TokenUsage used = found != usage.end() ? found->second : TokenUsage();
+
         Error error = ERR_OK;
         int allowed = 0;
-        if (it.second.max >= 0 && used[it.first] > it.second.max)
+        if (it.second.max >= 0 && used.count > it.second.max)
         {
             error = ERR_PROHIBITEDTOKEN;
             allowed = it.second.max;
-            m_cursor1 = cursor1[it.first];
-            m_cursor2 = cursor2[it.first];
+            m_cursor1 = used.start;
+            m_cursor2 = used.end;
         }
-        if (it.second.min >= 0 && used[it.first] < it.second.min)
+        if (it.second.min >= 0 && used.count < it.second.min)
         {
             error = ERR_OBLIGATORYTOKEN;
             allowed = it.second.min;
@@ -203,7 +236,7 @@ bool CScript::CheckToken()
         if (error != ERR_OK)
         {
             m_token = it.first;
-            m_tokenUsed = used[it.first];
+            m_tokenUsed = used.count;
             m_tokenAllowed = allowed;
             m_error = static_cast<CBot::CBotError>(error);
             m_title = "<incorrect instructions>";
@@ -238,6 +271,7 @@ bool CScript::Compile()
     if (m_botProg == nullptr)
     {
         m_botProg = std::make_unique<CBot::CBotProgram>(m_object->GetBotVar());
+        m_botProg->SetProfiler(m_profiler.get());
     }
 
     if ( m_botProg->Compile(m_script.get(), functionList, this) )
@@ -313,6 +347,9 @@ bool CScript::Run()
     m_bRun = true;
     m_bContinue = false;
     m_ipf = CBOT_IPF;
+    m_frameTimer = -1;
+    m_frameTicks = 0;
+    m_credit = 0;
     m_errMode = ERM_STOP;
 
     if ( m_bStepMode )  // step by step mode?
@@ -363,7 +400,13 @@ bool CScript::Continue()
         return false;
     }
 
-    if ( m_botProg->Run(this, m_ipf) )
+    int timer = m_frameTimer < 0 ? m_ipf : m_frameTimer;
+    m_frameTimer = -1;
+    if ( timer == 0 )  return false;  // no time left in this frame
+
+    bool finished = m_botProg->Run(this, timer);
+    m_frameTicks += m_botProg->GetTicks();
+    if ( finished )
     {
         m_botProg->GetError(m_error, m_cursor1, m_cursor2);
         if ( m_cursor1 < 0 || m_cursor1 > m_len ||
@@ -390,6 +433,18 @@ bool CScript::Continue()
     return false;
 }
 
+// Runs the part of the next Continue() that doesn't act on the world.
+// May be called for several scripts at once, from any thread.
+
+void CScript::ContinueIsolated()
+{
+    if (m_botProg == nullptr)  return;
+    if ( !m_bRun )  return;
+    if ( m_bStepMode )  return;
+
+    m_botProg->RunIsolated(this, m_frameTimer < 0 ? m_ipf : m_frameTimer);
+}
+
 // Continues the execution of current program.
 // Returns true when execution is finished.
 
@@ -568,6 +623,8 @@ void CScript::UpdateList(Ui::CList* list)
     m_botProg->GetRunPos(progName, cursor1, cursor2);
     if ( progName.empty() )  return;
 
+    CBot::CBotClass::InvalidateFields();  // shows the objects as they are now, not as the program last read them
+
     level = 0;
     rank  = 0;
     std::set<CBot::CBotVar*> previous;
@@ -654,7 +711,7 @@ void CScript::ColorizeScript(Ui::CEdit* edit, int rangeStart, int rangeEnd)
     std::string text = edit->GetText();
     text = text.substr(rangeStart, rangeEnd-rangeStart);
 
-    auto tokens = CBot::CBotToken::CompileTokens(text.c_str());
+    auto tokens = CBot::CBotToken::CompileTokens(text);
     CBot::CBotToken* bt = tokens.get();
     while ( bt != nullptr )
     {
@@ -1042,7 +1099,16 @@ bool CScript::ReadStack(std::istream &istr)
     if (!CBot::ReadInt(istr, m_errMode)) return false;
 
     if (m_botProg == nullptr) return false;
-    if (!m_botProg->RestoreState(istr)) return false;
+    if (nb >= 3)
+    {
+        std::string snapshot;
+        if (!CBot::ReadString(istr, snapshot)) return false;
+        if (!m_botProg->RestoreSnapshot(snapshot)) return false;
+    }
+    else
+    {
+        if (!m_botProg->RestoreState(istr)) return false;
+    }
 
     m_bRun = true;
     m_bContinue = false;
@@ -1055,12 +1121,15 @@ bool CScript::WriteStack(std::ostream &ostr)
 {
     int     nb;
 
-    nb = 2;
+    nb = 3;
     if (!CBot::WriteInt(ostr, nb)) return false;
     if (!CBot::WriteInt(ostr, m_ipf)) return false;
     if (!CBot::WriteInt(ostr, m_errMode)) return false;
 
-    return m_botProg->SaveState(ostr);
+    // the snapshot is only made again if the program ran since the previous save
+    const std::string& snapshot = m_botProg->SaveSnapshot();
+    if (snapshot.empty()) return false;
+    return CBot::WriteString(ostr, snapshot);
 }
 
 
@@ -1085,3 +1154,28 @@ const std::string& CScript::GetFilename()
 {
     return m_filename;
 }
+
+// Starts or stops measuring where the program spends its time.
+
+void CScript::SetProfiling(bool profiling)
+{
+    if ( profiling && m_profiler == nullptr )
+    {
+        std::string name = StrUtils::Format("%s %d", GetObjectName(m_object->GetType()), m_object->GetID());
+        m_profiler = std::make_unique<CBot::CBotProfiler>(name);
+    }
+    if ( !profiling )
+    {
+        m_profiler.reset();
+    }
+
+    if (m_botProg != nullptr)
+    {
+        m_botProg->SetProfiler(m_profiler.get());
+    }
+}
+
+CBot::CBotProfiler* CScript::GetProfiler()
+{
+    return m_profiler.get();
+}
@@ -58,6 +58,7 @@ const int ERM_STOP = 1;     // if error -> stop
 class CScript
 {
 friend class CScriptFunctions;
+friend class CScriptScheduler;
 public:
     CScript(COldObject* object);
     ~CScript();
@@ -72,6 +73,7 @@ public:
     bool        GetStepMode();
     bool        Run();
     bool        Continue();
+    void        ContinueIsolated();
     bool        Step();
     void        Stop();
     bool        IsRunning();
@@ -95,6 +97,9 @@ public:
     void        SetFilename(const std::string &filename);
     const std::string& GetFilename();
 
+    void        SetProfiling(bool profiling);
+    CBot::CBotProfiler* GetProfiler();
+
 protected:
     bool        IsEmpty();
     bool        CheckToken();
@@ -106,12 +111,16 @@ protected:
 
     Gfx::CEngine*       m_engine = nullptr;
     Ui::CInterface*     m_interface = nullptr;
+    std::unique_ptr<CBot::CBotProfiler> m_profiler;  // see CRobotMain::SetCBotProfiling()
     std::unique_ptr<CBot::CBotProgram> m_botProg;
     CRobotMain*         m_main = nullptr;
     Gfx::CTerrain*      m_terrain = nullptr;
     Gfx::CWater*        m_water = nullptr;
 
     int     m_ipf = 0;          // number of instructions/second
+    int     m_frameTimer = -1;  // ticks given by CScriptScheduler for this frame (-1 = m_ipf)
+    int     m_frameTicks = 0;   // ticks used since the last CScriptScheduler::Schedule()
+    int     m_credit = 0;       // ticks left to the program by CScriptScheduler
     int     m_errMode = 0;      // what to do in case of error
     int     m_len = 0;          // length of the script (without <0>)
     std::unique_ptr<char[]> m_script;       // script ends with <0>
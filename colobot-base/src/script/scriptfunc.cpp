@@ -3627,17 +3627,59 @@ void CScriptFunctions::Init()
     CBotProgram::AddFunction("research",  rResearch,  cResearch);
     CBotProgram::AddFunction("destroy",   rDestroy,   cOneObject);
 
+    // functions going through all the objects or a part of the terrain cost more than an instruction
+    CBotProgram::SetFunctionCost("search",     10);
+    CBotProgram::SetFunctionCost("searchall",  10);
+    CBotProgram::SetFunctionCost("radar",      10);
+    CBotProgram::SetFunctionCost("radarall",   10);
+    CBotProgram::SetFunctionCost("detect",     10);
+    CBotProgram::SetFunctionCost("space",      10);
+    CBotProgram::SetFunctionCost("flatspace",  10);
+    CBotProgram::SetFunctionCost("flatground", 10);
+
     SetFileAccessHandler(std::make_unique<CBotFileAccessHandlerColobot>());
 }
 
 
-// Updates the class Object.
+// Fields of the class Object, in the order of their AddItem() in Init().
+
+enum ObjectField
+{
+    FIELD_CATEGORY,
+    FIELD_POSITION,
+    FIELD_ORIENTATION,
+    FIELD_PITCH,
+    FIELD_ROLL,
+    FIELD_ENERGY_LEVEL,
+    FIELD_SHIELD_LEVEL,
+    FIELD_TEMPERATURE,
+    FIELD_ALTITUDE,
+    FIELD_LIFE_TIME,
+    FIELD_ENERGY_CELL,
+    FIELD_LOAD,
+    FIELD_ID,
+    FIELD_TEAM,
+    FIELD_DEAD,
+    FIELD_VELOCITY,
+};
+
+// Sets the fields of a point, or NaN if it isn't known.
+
+static void SetPointFields(CBotVar* point, const glm::vec3* pos)
+{
+    CBotVar* pSub = point->GetItemList();  // "x"
+    pSub->SetValFloat(pos == nullptr ? nanf("") : pos->x/g_unit);
+    pSub = pSub->GetNext();  // "y"
+    pSub->SetValFloat(pos == nullptr ? nanf("") : pos->z/g_unit);
+    pSub = pSub->GetNext();  // "z"
+    pSub->SetValFloat(pos == nullptr ? nanf("") : pos->y/g_unit);
+}
+
+// Updates a field of the class Object, when a program reads it.
 
-void CScriptFunctions::uObject(CBotVar* botThis, void* user)
+void CScriptFunctions::uObjectField(CBotVar* botThis, CBotVar* pVar, int slot, void* user)
 {
     CPhysics*   physics;
-    CBotVar     *pVar, *pSub;
-    ObjectType  type;
     glm::vec3    pos;
     float       value;
 
@@ -3649,140 +3691,129 @@ void CScriptFunctions::uObject(CBotVar* botThis, void* user)
 
     physics = object->GetPhysics();
 
-    // Updates the object's type.
-    pVar = botThis->GetItemList();  // "category"
-    type = object->GetType();
-    pVar->SetValInt(type, object->GetName());
-
-    // Updates the position of the object.
-    pVar = pVar->GetNext();  // "position"
-    if (IsObjectBeingTransported(object))
-    {
-        pSub = pVar->GetItemList();  // "x"
-        pSub->SetValFloat(nanf(""));
-        pSub = pSub->GetNext();  // "y"
-        pSub->SetValFloat(nanf(""));
-        pSub = pSub->GetNext();  // "z"
-        pSub->SetValFloat(nanf(""));
-    }
-    else
+    switch (slot)
     {
-        pos = object->GetPosition();
-        float waterLevel = Gfx::CEngine::GetInstancePointer()->GetWater()->GetLevel();
-        pos.y -= waterLevel;  // relative to sea level!
-        pSub = pVar->GetItemList();  // "x"
-        pSub->SetValFloat(pos.x/g_unit);
-        pSub = pSub->GetNext();  // "y"
-        pSub->SetValFloat(pos.z/g_unit);
-        pSub = pSub->GetNext();  // "z"
-        pSub->SetValFloat(pos.y/g_unit);
-    }
-
-    // Updates the angle.
-    pos = object->GetRotation();
-    pos += object->GetTilt();
-    pVar = pVar->GetNext();  // "orientation"
-    pVar->SetValFloat(Math::NormAngle(2*Math::PI - pos.y)*180.0f/Math::PI);
-    pVar = pVar->GetNext();  // "pitch"
-    pVar->SetValFloat((Math::NormAngle(pos.z + Math::PI) - Math::PI)*180.0f/Math::PI);
-    pVar = pVar->GetNext();  // "roll"
-    pVar->SetValFloat((Math::NormAngle(pos.x + Math::PI) - Math::PI)*180.0f/Math::PI);
-
-    // Updates the energy level of the object.
-    pVar = pVar->GetNext();  // "energyLevel"
-    value = object->GetEnergyLevel();
-    pVar->SetValFloat(value);
-
-    // Updates the shield level of the object.
-    pVar = pVar->GetNext();  // "shieldLevel"
-    if ( !obj->Implements(ObjectInterfaceType::Shielded) ) value = 1.0f;
-    else value = dynamic_cast<CShieldedObject*>(object)->GetShield();
-    pVar->SetValFloat(value);
-
-    // Updates the temperature of the reactor.
-    pVar = pVar->GetNext();  // "temperature"
-    if ( !obj->Implements(ObjectInterfaceType::JetFlying) )  value = 0.0f;
-    else value = 1.0f-dynamic_cast<CJetFlyingObject*>(object)->GetReactorRange();
-    pVar->SetValFloat(value);
-
-    // Updates the height above the ground.
-    pVar = pVar->GetNext();  // "altitude"
-    if ( physics == nullptr )  value = 0.0f;
-    else                 value = physics->GetFloorHeight();
-    pVar->SetValFloat(value/g_unit);
-
-    // Updates the lifetime of the object.
-    pVar = pVar->GetNext();  // "lifeTime"
-    value = object->GetAbsTime();
-    pVar->SetValFloat(value);
-
-    // Updates the type of battery.
-    pVar = pVar->GetNext();  // "energyCell"
-    CSlottedObject *asSlotted = object->Implements(ObjectInterfaceType::Slotted) ? dynamic_cast<CSlottedObject*>(object) : nullptr;
-    if (asSlotted != nullptr && asSlotted->MapPseudoSlot(CSlottedObject::Pseudoslot::POWER) >= 0)
-    {
-        CObject *power = asSlotted->GetSlotContainedObjectReq(CSlottedObject::Pseudoslot::POWER);
-        if (power == nullptr)
-        {
-            pVar->SetPointer(nullptr);
-        }
-        else if (power->Implements(ObjectInterfaceType::Old))
-        {
-            pVar->SetPointer(power->GetBotVar());
-        }
-    }
+        // Updates the object's type.
+        case FIELD_CATEGORY:
+            pVar->SetValInt(object->GetType(), object->GetName());
+            break;
 
-    // Updates the transported object's type.
-    pVar = pVar->GetNext();  // "load"
-    if (asSlotted != nullptr && asSlotted->MapPseudoSlot(CSlottedObject::Pseudoslot::CARRYING) >= 0)
-    {
-        CObject* cargo = asSlotted->GetSlotContainedObjectReq(CSlottedObject::Pseudoslot::CARRYING);
-        if (cargo == nullptr)
-        {
-            pVar->SetPointer(nullptr);
-        }
-        else if (cargo->Implements(ObjectInterfaceType::Old))
-        {
-            pVar->SetPointer(cargo->GetBotVar());
+        // Updates the position of the object.
+        case FIELD_POSITION:
+            if (IsObjectBeingTransported(object))
+            {
+                SetPointFields(pVar, nullptr);
+            }
+            else
+            {
+                pos = object->GetPosition();
+                float waterLevel = Gfx::CEngine::GetInstancePointer()->GetWater()->GetLevel();
+                pos.y -= waterLevel;  // relative to sea level!
+                SetPointFields(pVar, &pos);
+            }
+            break;
+
+        // Updates the angle.
+        case FIELD_ORIENTATION:
+            pos = object->GetRotation() + object->GetTilt();
+            pVar->SetValFloat(Math::NormAngle(2*Math::PI - pos.y)*180.0f/Math::PI);
+            break;
+
+        case FIELD_PITCH:
+            pos = object->GetRotation() + object->GetTilt();
+            pVar->SetValFloat((Math::NormAngle(pos.z + Math::PI) - Math::PI)*180.0f/Math::PI);
+            break;
+
+        case FIELD_ROLL:
+            pos = object->GetRotation() + object->GetTilt();
+            pVar->SetValFloat((Math::NormAngle(pos.x + Math::PI) - Math::PI)*180.0f/Math::PI);
+            break;
+
+        // Updates the energy level of the object.
+        case FIELD_ENERGY_LEVEL:
+            value = object->GetEnergyLevel();
+            pVar->SetValFloat(value);
+            break;
+
+        // Updates the shield level of the object.
+        case FIELD_SHIELD_LEVEL:
+            if ( !obj->Implements(ObjectInterfaceType::Shielded) ) value = 1.0f;
+            else value = dynamic_cast<CShieldedObject*>(object)->GetShield();
+            pVar->SetValFloat(value);
+            break;
+
+        // Updates the temperature of the reactor.
+        case FIELD_TEMPERATURE:
+            if ( !obj->Implements(ObjectInterfaceType::JetFlying) )  value = 0.0f;
+            else value = 1.0f-dynamic_cast<CJetFlyingObject*>(object)->GetReactorRange();
+            pVar->SetValFloat(value);
+            break;
+
+        // Updates the height above the ground.
+        case FIELD_ALTITUDE:
+            if ( physics == nullptr )  value = 0.0f;
+            else                 value = physics->GetFloorHeight();
+            pVar->SetValFloat(value/g_unit);
+            break;
+
+        // Updates the lifetime of the object.
+        case FIELD_LIFE_TIME:
+            value = object->GetAbsTime();
+            pVar->SetValFloat(value);
+            break;
+
+        // Updates the type of battery, and the transported object's type.
+        case FIELD_ENERGY_CELL:
+        case FIELD_LOAD:
+        {
+            CSlottedObject *asSlotted = object->Implements(ObjectInterfaceType::Slotted) ? dynamic_cast<CSlottedObject*>(object) : nullptr;
+            CSlottedObject::Pseudoslot pseudoslot = slot == FIELD_ENERGY_CELL ? CSlottedObject::Pseudoslot::POWER
+                                                                              : CSlottedObject::Pseudoslot::CARRYING;
+            if (asSlotted != nullptr && asSlotted->MapPseudoSlot(pseudoslot) >= 0)
+            {
+                CObject *contained = asSlotted->GetSlotContainedObjectReq(pseudoslot);
+                if (contained == nullptr)
+                {
+                    pVar->SetPointer(nullptr);
+                }
+                else if (contained->Implements(ObjectInterfaceType::Old))
+                {
+                    pVar->SetPointer(contained->GetBotVar());
+                }
+            }
+            break;
         }
-    }
 
-    pVar = pVar->GetNext();  // "id"
-    value = object->GetID();
-    pVar->SetValInt(value);
+        case FIELD_ID:
+            value = object->GetID();
+            pVar->SetValInt(value);
+            break;
 
-    pVar = pVar->GetNext();  // "team"
-    value = object->GetTeam();
-    pVar->SetValInt(value);
+        case FIELD_TEAM:
+            value = object->GetTeam();
+            pVar->SetValInt(value);
+            break;
 
-    pVar = pVar->GetNext();  // "dead"
-    value = object->IsDying();
-    pVar->SetValInt(value);
+        case FIELD_DEAD:
+            value = object->IsDying();
+            pVar->SetValInt(value);
+            break;
 
-    // Updates the velocity of the object.
-    pVar = pVar->GetNext();  // "velocity"
-    if (IsObjectBeingTransported(object) || physics == nullptr)
-    {
-        pSub = pVar->GetItemList();  // "x"
-        pSub->SetValFloat(nanf(""));
-        pSub = pSub->GetNext();  // "y"
-        pSub->SetValFloat(nanf(""));
-        pSub = pSub->GetNext();  // "z"
-        pSub->SetValFloat(nanf(""));
-    }
-    else
-    {
-        glm::mat4 matRotate;
-        Math::LoadRotationZXYMatrix(matRotate, object->GetRotation());
-        pos = physics->GetLinMotion(MO_CURSPEED);
-        pos = Math::Transform(matRotate, pos);
-
-        pSub = pVar->GetItemList();  // "x"
-        pSub->SetValFloat(pos.x/g_unit);
-        pSub = pSub->GetNext();  // "y"
-        pSub->SetValFloat(pos.z/g_unit);
-        pSub = pSub->GetNext();  // "z"
-        pSub->SetValFloat(pos.y/g_unit);
+        // Updates the velocity of the object.
+        case FIELD_VELOCITY:
+            if (IsObjectBeingTransported(object) || physics == nullptr)
+            {
+                SetPointFields(pVar, nullptr);
+            }
+            else
+            {
+                glm::mat4 matRotate;
+                Math::LoadRotationZXYMatrix(matRotate, object->GetRotation());
+                pos = physics->GetLinMotion(MO_CURSPEED);
+                pos = Math::Transform(matRotate, pos);
+                SetPointFields(pVar, &pos);
+            }
+            break;
     }
 }
 
@@ -3791,7 +3822,7 @@ CBotVar* CScriptFunctions::CreateObjectVar(CObject* obj)
     CBotClass* bc = CBotClass::Find("object");
     if ( bc != nullptr )
     {
-        bc->SetUpdateFunc(CScriptFunctions::uObject);
+        bc->SetFieldUpdateFunc(CScriptFunctions::uObjectField);
     }
 
     CBotVar* botVar = CBotVar::Create("", CBotTypResult(CBotTypClass, "object"));
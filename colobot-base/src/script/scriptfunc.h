@@ -160,7 +160,7 @@ private:
     static CBot::CBotTypResult cPointConstructor(CBot::CBotVar* pThis, CBot::CBotVar* &var);
     static bool rPointConstructor(CBot::CBotVar* pThis, CBot::CBotVar* var, CBot::CBotVar* pResult, int& Exception, void* user);
 
-    static void uObject(CBot::CBotVar* botThis, void* user);
+    static void uObjectField(CBot::CBotVar* botThis, CBot::CBotVar* field, int slot, void* user);
 
 private:
     static bool     WaitForForegroundTask(CScript* script, CBot::CBotVar* result, int &exception);
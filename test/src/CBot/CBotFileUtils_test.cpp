@@ -300,4 +300,68 @@ TEST_F(CBotFileUtilsTest, ReadStreamShouldMatchWrittenStream)
     ASSERT_EQ(expectedValue, newStream.str());
 }
 
+TEST_F(CBotFileUtilsTest, StateInMemoryShouldMatchStream)
+{
+    std::string state;
+    CBotStateWriter writer{state};
+    ASSERT_TRUE(WriteWord(writer, 300));
+    ASSERT_TRUE(WriteLong(writer, -123456789L, 5));
+    ASSERT_TRUE(WriteFloat(writer, 3.14f));
+    ASSERT_TRUE(WriteString(writer, createTestStringWithAllPossibleCharacters()));
+
+    ASSERT_TRUE(WriteWord(stream, 300));
+    ASSERT_TRUE(WriteLong(stream, -123456789L, 5));
+    ASSERT_TRUE(WriteFloat(stream, 3.14f));
+    ASSERT_TRUE(WriteString(stream, createTestStringWithAllPossibleCharacters()));
+    ASSERT_EQ(stream.str(), state);
+
+    CBotStateReader reader{state.data(), state.size()};
+    unsigned short w{0};
+    long l{0};
+    float f{0.0f};
+    std::string s;
+    ASSERT_TRUE(ReadWord(reader, w));
+    ASSERT_TRUE(ReadLong(reader, l));
+    ASSERT_TRUE(ReadFloat(reader, f));
+    ASSERT_TRUE(ReadString(reader, s));
+    ASSERT_EQ(300, w);
+    ASSERT_EQ(-123456789L, l);
+    ASSERT_EQ(3.14f, f);
+    ASSERT_EQ(createTestStringWithAllPossibleCharacters(), s);
+
+    char c;
+    ASSERT_FALSE(ReadByte(reader, c));
+    ASSERT_TRUE(reader.Failed());
+}
+
+TEST_F(CBotFileUtilsTest, StateReaderShouldStopAtTheEndOfTheData)
+{
+    std::string state;
+    CBotStateWriter writer{state};
+    ASSERT_TRUE(WriteString(writer, "abc"));
+
+    CBotStateReader reader{state.data(), state.size() - 1};
+    std::string s;
+    ASSERT_FALSE(ReadString(reader, s));
+    ASSERT_TRUE(reader.Failed());
+}
+
+TEST_F(CBotFileUtilsTest, StateReaderShouldNotReadPastTheStateInStream)
+{
+    ASSERT_TRUE(WriteWord(stream, 300));
+    ASSERT_TRUE(WriteString(stream, "after"));
+
+    CBotStateReader reader{stream};
+    unsigned short w{0};
+    ASSERT_TRUE(ReadWord(reader, w));
+    ASSERT_EQ(300, w);
+
+    std::string s;
+    ASSERT_TRUE(ReadString(stream, s));
+    ASSERT_EQ("after", s);
+
+    ASSERT_FALSE(ReadWord(reader, w));
+    ASSERT_TRUE(stream.fail());
+}
+
 }
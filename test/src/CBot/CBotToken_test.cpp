@@ -22,6 +22,8 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
+
 using namespace CBot;
 
 class CBotTokenUT : public testing::Test
@@ -122,3 +124,106 @@ TEST_F(CBotTokenUT, BasicProgram)
         {"}",           ID_CLBLK},
     });
 }
+
+TEST_F(CBotTokenUT, Operators)
+{
+    // the longest operator is taken
+    ExecuteTest("a>>>=b>>>c>>=d>>e>=f>g<<=h<<i**j*k::l:m&&n&=o&p", {
+        {"a",    TokenTypVar},
+        {">>>=", ID_ASSSR},
+        {"b",    TokenTypVar},
+        {">>>",  ID_SR},
+        {"c",    TokenTypVar},
+        {">>=",  ID_ASSASR},
+        {"d",    TokenTypVar},
+        {">>",   ID_ASR},
+        {"e",    TokenTypVar},
+        {">=",   ID_HS},
+        {"f",    TokenTypVar},
+        {">",    ID_HI},
+        {"g",    TokenTypVar},
+        {"<<=",  ID_ASSSL},
+        {"h",    TokenTypVar},
+        {"<<",   ID_SL},
+        {"i",    TokenTypVar},
+        {"**",   ID_POWER},
+        {"j",    TokenTypVar},
+        {"*",    ID_MUL},
+        {"k",    TokenTypVar},
+        {"::",   ID_DBLDOTS},
+        {"l",    TokenTypVar},
+        {":",    ID_DOTS},
+        {"m",    TokenTypVar},
+        {"&&",   ID_LOG_AND},
+        {"n",    TokenTypVar},
+        {"&=",   ID_ASSAND},
+        {"o",    TokenTypVar},
+        {"&",    ID_AND},
+        {"p",    TokenTypVar},
+    });
+    ExecuteTest("x=-1;y!=!z", {
+        {"x",  TokenTypVar},
+        {"=",  ID_ASS},
+        {"-",  ID_SUB},
+        {"1",  TokenTypNum},
+        {";",  ID_SEP},
+        {"y",  TokenTypVar},
+        {"!=", ID_NE},
+        {"!",  ID_LOG_NOT},
+        {"z",  TokenTypVar},
+    });
+}
+
+TEST_F(CBotTokenUT, Literals)
+{
+    ExecuteTest("12 3.5e-2 1E5x 0x1Fg 0b102 .5 \"a\\\"b\" 'c' '\\n' '\\u00e9' undefined nan true", {
+        {"12",        TokenTypNum},
+        {"3.5e-2",    TokenTypNum},
+        {"1E5",       TokenTypNum},
+        {"x",         TokenTypVar},
+        {"0x1F",      TokenTypNum},
+        {"g",         TokenTypVar},
+        {"0b10",      TokenTypNum},
+        {"2",         TokenTypNum},
+        {".",         ID_DOT},
+        {"5",         TokenTypNum},
+        {"\"a\\\"b\"", TokenTypString},
+        {"'c'",       TokenTypChar},
+        {"'\\n'",     TokenTypChar},
+        {"'\\u00e9'", TokenTypChar},
+        {"undefined", TX_UNDEF},
+        {"nan",       ID_NAN},
+        {"true",      ID_TRUE},
+    });
+}
+
+TEST_F(CBotTokenUT, PositionsAndConstants)
+{
+    CBotToken::DefineNum("TokenTestConstant", 42);
+    const char code[] = "// start\nint  x /* a */ = TokenTestConstant;\0ignored";
+    auto tokens = CBotToken::CompileTokens(std::string_view(code, sizeof(code) - 1));
+    ASSERT_TRUE(tokens != nullptr);
+
+    // the first token holds the separators before the program
+    EXPECT_EQ(tokens->GetString(), "");
+    EXPECT_EQ(tokens->GetEnd(), 0);
+
+    CBotToken* token = tokens->GetNext();
+    EXPECT_EQ(token->GetStart(), 9);
+    EXPECT_EQ(token->GetEnd(), 12);
+    token = token->GetNext();
+    EXPECT_EQ(token->GetString(), "x");
+    EXPECT_EQ(token->GetStart(), 14);
+    token = token->GetNext()->GetNext();
+    EXPECT_EQ(token->GetString(), "TokenTestConstant");
+    EXPECT_EQ(token->GetType(), TokenTypDef);
+    EXPECT_EQ(token->GetKeywordId(), 42);
+    token = token->GetNext();
+    EXPECT_EQ(token->GetType(), ID_SEP);
+
+    // the program ends at the null character
+    token = token->GetNext();
+    EXPECT_EQ(token->GetType(), TokenTypNone);
+    EXPECT_EQ(token->GetStart(), static_cast<int>(std::strlen(code)));
+    EXPECT_EQ(token->GetNext(), nullptr);
+}
@@ -18,13 +18,22 @@
  */
 
 #include "CBot/CBot.h"
+#include "CBot/CBotVar/CBotVarClass.h"
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
 #include <limits>
 #include <stdexcept>
+#include <thread>
 
 extern bool g_cbotTestSaveState;
 bool g_cbotTestSaveState = false;
+extern bool g_cbotTestByteCode;
+bool g_cbotTestByteCode = false;
+extern bool g_cbotTestNoOptimize;
+bool g_cbotTestNoOptimize = false;
 
 using namespace CBot;
 
@@ -208,10 +217,24 @@ private:
         if (!program->SaveState(sstr))
             throw CBotTestFail("CBotProgram::SaveState Failed");
 
+        // the snapshot ends with the same data
+        std::string state = sstr.str();
+        std::string snapshot = program->SaveSnapshot();
+        if (snapshot.size() <= state.size() || snapshot.compare(snapshot.size() - state.size(), std::string::npos, state) != 0)
+            throw CBotTestFail("CBotProgram::SaveSnapshot doesn't match CBotProgram::SaveState");
+
         if (!CBotClass::SaveStaticState(sstr))
             throw CBotTestFail("CBotClass::SaveStaticState Failed");
-        // restore
-        if (!program->RestoreState(sstr))
+        // restore, every other time from the snapshot
+        static bool fromSnapshot = false;
+        fromSnapshot = !fromSnapshot;
+        if (fromSnapshot)
+        {
+            if (!program->RestoreSnapshot(snapshot))
+                throw CBotTestFail("CBotProgram::RestoreSnapshot Failed");
+            sstr.seekg(state.size());
+        }
+        else if (!program->RestoreState(sstr))
             throw CBotTestFail("CBotProgram::RestoreState Failed");
 
         if (!CBotClass::RestoreStaticState(sstr))
@@ -219,12 +242,19 @@ private:
     }
 
 protected:
+    //! Engine used by ExecuteTest(), change it with --CBotUT_ByteCode or in the test itself
+    CBotEngine m_engine = g_cbotTestByteCode ? CBotEngine::BYTECODE : CBotEngine::TREE;
+    //! Optimization used by ExecuteTest(), disable it with --CBotUT_NoOptimize or in the test itself
+    bool m_optimize = !g_cbotTestNoOptimize;
+
     std::unique_ptr<CBotProgram> ExecuteTest(const std::string& code, CBotError expectedError = CBotNoErr)
     {
         CBotError expectedCompileError = expectedError < 6000 ? expectedError : CBotNoErr;
         CBotError expectedRuntimeError = expectedError >= 6000 ? expectedError : CBotNoErr;
 
         auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+        program->SetEngine(m_engine);
+        program->SetOptimize(m_optimize);
         std::vector<std::string> tests;
         program->Compile(code, tests);
 
@@ -1536,6 +1566,109 @@ TEST_F(CBotUT, ClassInheritanceVars)
     );
 }
 
+TEST_F(CBotUT, ClassFieldLayout)
+{
+    CBotClass* base = CBotClass::Create("LayoutBase", nullptr);
+    base->AddItem("a", CBotTypResult(CBotTypInt));
+    base->AddItem("b", CBotTypResult(CBotTypInt));
+    CBotClass* sub = CBotClass::Create("LayoutSub", base);
+    sub->AddItem("b", CBotTypResult(CBotTypFloat));
+    sub->AddItem("c", CBotTypResult(CBotTypInt));
+
+    EXPECT_EQ(base->GetFieldCount(), 2);
+    EXPECT_EQ(sub->GetFieldCount(), 4);
+    EXPECT_EQ(sub->GetFieldSlot("a"), 0);
+    EXPECT_EQ(base->GetFieldSlot("b"), 1);
+    EXPECT_EQ(sub->GetFieldSlot("b"), 2);
+    EXPECT_EQ(sub->GetFieldSlot("c"), 3);
+    EXPECT_EQ(sub->GetFieldSlot("d"), -1);
+
+    CBotVar* var = CBotVar::Create("x", CBotTypResult(CBotTypClass, sub));
+    for (int slot = 0; slot < 4; slot++)
+    {
+        ASSERT_NE(var->GetItemRef(slot + 1), nullptr);
+        EXPECT_EQ(var->GetItemRef(slot + 1)->GetUniqNum(), slot + 1);
+    }
+    EXPECT_EQ(var->GetItemRef(5), nullptr);
+    EXPECT_EQ(var->GetItem("a"), var->GetItemRef(1));
+    EXPECT_EQ(var->GetItem("b"), var->GetItemRef(3));
+    EXPECT_EQ(var->GetItem("b")->GetType(), CBotTypFloat);
+    EXPECT_EQ(var->GetItem("c"), var->GetItemRef(4));
+    EXPECT_EQ(var->GetItem("d"), nullptr);
+    delete var;
+
+    delete sub;
+    delete base;
+}
+
+static int g_sensorValue = 0;
+static int g_sensorUpdates[2] = {0, 0};
+
+static void uSensorField(CBotVar* thisVar, CBotVar* field, int slot, void* user)
+{
+    g_sensorUpdates[slot]++;
+    field->SetValInt(g_sensorValue * 10 + slot);
+}
+
+static CBotTypResult cSensorTick(CBotVar* &var, void* user)
+{
+    if (var != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+static bool rSensorTick(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    g_sensorValue++;
+    return true;
+}
+
+TEST_F(CBotUT, ClassFieldUpdates)
+{
+    CBotProgram::AddFunction("tick", rSensorTick, cSensorTick);
+    CBotClass* sensor = CBotClass::Create("Sensor", nullptr);
+    sensor->AddItem("a", CBotTypResult(CBotTypInt), CBotVar::ProtectionLevel::ReadOnly);
+    sensor->AddItem("b", CBotTypResult(CBotTypInt), CBotVar::ProtectionLevel::ReadOnly);
+    sensor->SetFieldUpdateFunc(uSensorField);
+    g_sensorValue = 1;
+    g_sensorUpdates[0] = g_sensorUpdates[1] = 0;
+
+    int host = 0;
+    CBotVar* thisVar = CBotVar::Create("", CBotTypResult(CBotTypClass, "Sensor"));
+    thisVar->SetUserPtr(&host);
+    {
+        auto program = std::unique_ptr<CBotProgram>(new CBotProgram(thisVar));
+        std::vector<std::string> externFunctions;
+        ASSERT_TRUE(program->Compile(
+            "extern void Sensor::Read()\n"
+            "{\n"
+            "    ASSERT(a == 10);\n"
+            "    ASSERT(this.a + a == 20);\n"
+            "    tick();\n"
+            "    ASSERT(a == 20);\n"
+            "}\n"
+            "extern void Sensor::Show()\n"
+            "{\n"
+            "    string s = this;\n"
+            "    ASSERT(a == 20 && b == 21);\n"
+            "}\n", externFunctions)) << program->GetError();
+
+        // only the fields read are updated, again after each call to an external function
+        program->Start("Read");
+        while (!program->Run(nullptr, 100));
+        EXPECT_EQ(program->GetError(), CBotNoErr);
+        EXPECT_EQ(g_sensorUpdates[0], 3);
+        EXPECT_EQ(g_sensorUpdates[1], 0);
+
+        // the conversion to a string updates all the fields
+        program->Start("Show");
+        while (!program->Run(nullptr, 100));
+        EXPECT_EQ(program->GetError(), CBotNoErr);
+        EXPECT_EQ(g_sensorUpdates[0], 4);
+        EXPECT_EQ(g_sensorUpdates[1], 1);
+    }
+    delete thisVar;
+}
+
 TEST_F(CBotUT, ClassInheritanceMethods)
 {
     ExecuteTest(
@@ -1651,6 +1784,51 @@ TEST_F(CBotUT, ClassInheritanceMethods)
     );
 }
 
+TEST_F(CBotUT, ClassVirtualMethods)
+{
+    ExecuteTest(
+        "public class Shape {\n"
+        "    float area() { return 0; }\n"
+        "    string kind() { return \"shape\"; }\n"
+        "    int scale(int n) { return n; }\n"
+        "    float scale(float x) { return x; }\n"
+        "    int sides() { return 0; }\n"
+        "}\n"
+        "public class Square extends Shape {\n"
+        "    float size = 2;\n"
+        "    float area() { return size * size; }\n"
+        "    int scale(int n) { return 2 * n; }\n"
+        "    int sides() { return 4; }\n"
+        "}\n"
+        "public class Cube extends Square {\n"
+        "    string kind() { return \"cube\"; }\n"
+        "    int sides(float x) { return 12; }\n"
+        "}\n"
+        "extern void ClassVirtualMethods()\n"
+        "{\n"
+        "    Shape shapes[] = { new Shape(), new Square(), new Cube(), new Square() };\n"
+        "    float areas[] = { 0, 4, 4, 4 };\n"
+        "    string kinds[] = { \"shape\", \"shape\", \"cube\", \"shape\" };\n"
+        // the same call sites run methods of different classes in turn
+        "    for (int j = 0; j < 2; j++)\n"
+        "    {\n"
+        "        for (int i = 0; i < sizeof(shapes); i++)\n"
+        "        {\n"
+        "            ASSERT(shapes[i].area() == areas[i]);\n"
+        "            ASSERT(shapes[i].kind() == kinds[i]);\n"
+        "            ASSERT(shapes[i].scale(3) == (i == 0 ? 3 : 6));\n"
+        "            ASSERT(shapes[i].scale(1.5) == (i == 0 ? 1.5 : 2));\n"
+        "        }\n"
+        "    }\n"
+        // a method overloaded in a subclass is chosen by the arguments
+        "    Shape cube = new Cube();\n"
+        "    ASSERT(cube.sides() == 4);\n"
+        "    Square square = new Square();\n"
+        "    ASSERT(square.sides() == 4);\n"
+        "}\n"
+    );
+}
+
 TEST_F(CBotUT, ClassInheritanceTestThis)
 {
     ExecuteTest(
@@ -1967,6 +2145,91 @@ TEST_F(CBotUT, StringFunctions)
     );
 }
 
+TEST_F(CBotUT, StringSharingAndConversions)
+{
+    ExecuteTest(
+        "public class Holder\n"
+        "{\n"
+        "    string text = \"\";\n"
+        "}\n"
+        "extern void StringCopies()\n"
+        "{\n"
+        "    string a = \"a string longer than sixteen characters\";\n"
+        "    string b = a;\n"
+        "    b += \"!\";\n"
+        "    ASSERT(a == \"a string longer than sixteen characters\");\n"
+        "    ASSERT(b == a + \"!\");\n"
+        "    string c = a + b + a;\n"
+        "    ASSERT(strlen(c) == 3 * strlen(a) + 1);\n"
+        "    ASSERT(a == \"a string longer than sixteen characters\");\n"
+        "    a += a;\n"
+        "    ASSERT(strlen(a) == 78 && strleft(a, 39) == strright(a, 39));\n"
+        "}\n"
+        "extern void StringBuilding()\n"
+        "{\n"
+        "    string s = \"\";\n"
+        "    string[] parts = {\"\", \"\"};\n"
+        "    Holder h = new Holder();\n"
+        "    for (int i = 0; i < 100; i++)\n"
+        "    {\n"
+        "        string before = s;\n"
+        "        s += i % 10;\n"
+        "        parts[i % 2] += \"x\";\n"
+        "        h.text += \"y\";\n"
+        "        ASSERT(strlen(before) == i && strlen(s) == i + 1);\n"
+        "    }\n"
+        "    ASSERT(strleft(s, 12) == \"012345678901\");\n"
+        "    ASSERT(strlen(parts[0]) == 50 && strlen(parts[1]) == 50);\n"
+        "    ASSERT(strlen(h.text) == 100);\n"
+        "}\n"
+        "extern void NumbersToStrings()\n"
+        "{\n"
+        "    long l = 3000000000; float f = 2.5; double d = 1.0 / 3; bool t = true;\n"
+        "    ASSERT(\"\" + -7 + \" \" + l == \"-7 3000000000\");\n"
+        "    ASSERT(\"\" + f + \" \" + d + \" \" + t == \"2.5 0.333333 true\");\n"
+        "    ASSERT(\"\" + 1e20 + \" \" + 0.0001 + \" \" + 123456789.0 == \"1e+20 0.0001 1.23457e+08\");\n"
+        "}\n"
+    );
+
+    CBotVar* var = CBotVar::Create("", CBotTypString);
+    var->SetValString(" 42abc");
+    EXPECT_EQ(var->GetValInt(), 42);
+    var->SetValString("-3.5e2");
+    EXPECT_EQ(var->GetValFloat(), -350.0f);
+    var->SetValString("nan");
+    EXPECT_EQ(var->GetValFloat(), 0.0f);
+    var->SetValFloat(0.1f);
+    EXPECT_EQ(var->GetValString(), "0.1");
+    delete var;
+
+    CBotVar* number = CBotVar::Create("", CBotTypInt);
+    number->SetValString("+12");
+    EXPECT_EQ(number->GetValInt(), 12);
+    number->SetValString("99999999999");
+    EXPECT_EQ(number->GetValInt(), std::numeric_limits<int>::max());
+    delete number;
+}
+
+TEST_F(CBotUT, StringPlusNan)
+{
+    ExecuteTest(
+        "extern void StringPlusNan()\n"
+        "{\n"
+        "    string s = \"a\" + nan;\n"
+        "}\n",
+        CBotErrNan
+    );
+
+    ExecuteTest(
+        "extern void StringPlusNanVariable()\n"
+        "{\n"
+        "    float f = nan;\n"
+        "    string s = \"a\" + \"b\" + f;\n"
+        "}\n",
+        CBotErrNan
+    );
+}
+
 TEST_F(CBotUT, LiteralCharacters)
 {
     ExecuteTest(
@@ -3327,3 +3590,1861 @@ TEST_F(CBotUT, ClassTestSaveInheritedMembers)
         "}\n"
     );
 }
+
+TEST_F(CBotUT, TestSaveLongVariables)
+{
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "extern void TestSaveLongVariables()\n"
+        "{\n"
+        "    long l = 3000000000;\n"
+        "    long m = -9223372036854775807;\n"
+        "    ASSERT(l / 1000 == 3000000);\n"
+        "    ASSERT(m / 1000000000000 == -9223372);\n"
+        "}\n", tests)) << program->GetError();
+
+    // saves and restores at each step, even without --CBotUT_TestSaveState
+    // (the results of the literals are restored too, so the asserts divide down to int)
+    program->Start(tests[0]);
+    while (!program->Run(nullptr, 0))
+    {
+        std::stringstream state;
+        ASSERT_TRUE(program->SaveState(state));
+        ASSERT_TRUE(program->RestoreState(state));
+    }
+    EXPECT_EQ(program->GetError(), CBotNoErr);
+}
+
+TEST_F(CBotUT, ByteCodeSameResults)
+{
+    // id() is a function call, so the expressions using it are always run by the tree walker
+    const std::string code =
+        "int id(int a) { return a; }\n"
+        "long idl(long a) { return a; }\n"
+        "float idf(float a) { return a; }\n"
+        "double idd(double a) { return a; }\n"
+        "bool idb(bool a) { return a; }\n"
+        "extern void ByteCodeArithmetic()\n"
+        "{\n"
+        "    int i = 7; long l = 3000000000; float f = 2.5; double d = 0.1;\n"
+        "    ASSERT(i * 3 + 4 - i / 2 == id(i) * 3 + 4 - id(i) / 2);\n"
+        "    ASSERT(i % 4 + -i == id(i) % 4 + -id(i));\n"
+        "    ASSERT(l * i + 1 == idl(l) * i + 1);\n"
+        "    ASSERT(i + f * 2 == id(i) + idf(f) * 2);\n"
+        "    ASSERT(l / f == idl(l) / idf(f));\n"
+        "    ASSERT(f + d == idf(f) + idd(d));\n"
+        "    ASSERT(f % 1.5 == idf(f) % 1.5);\n"
+        "    ASSERT(f ** 3 == idf(f) ** 3);\n"
+        "    ASSERT(i ** 3 == id(i) ** 3);\n"
+        "    ASSERT(2147483647 + i == 2147483647 + id(i));\n"
+        "    ASSERT(-2147483647 - i == -2147483647 - id(i));\n"
+        "    ASSERT(i * 1000000000 == id(i) * 1000000000);\n"
+        "    ASSERT(l * 4000000000 * 4000000000 == idl(l) * 4000000000 * 4000000000);\n"
+        "}\n"
+        "extern void ByteCodeDivideMinimum()\n"
+        "{\n"
+        "    int m = -2147483647 - 1; int n = -1;\n"
+        "    ASSERT(m / n == m && m % n == 0);\n"
+        "    ASSERT(m / -1 == id(m) / id(n) && m % -1 == id(m) % id(n));\n"
+        "    int q = m; q /= n; ASSERT(q == m);\n"
+        "    q = m; q %= n; ASSERT(q == 0);\n"
+        "    long lm = -9223372036854775807 - 1; long ln = -1;\n"
+        "    ASSERT(lm / ln == lm && lm % ln == 0);\n"
+        "    ASSERT(lm / -1 == idl(lm) / idl(ln) && lm % -1 == idl(lm) % idl(ln));\n"
+        "    long lq = lm; lq /= ln; ASSERT(lq == lm);\n"
+        "}\n"
+        "extern void ByteCodeBits()\n"
+        "{\n"
+        "    int i = -9; long l = 1;\n"
+        "    ASSERT((i << 3 | 5) == (id(i) << 3 | 5));\n"
+        "    ASSERT(i >> 1 == id(i) >> 1);\n"
+        "    ASSERT(i >>> 1 == id(i) >>> 1);\n"
+        "    ASSERT(l << 40 == idl(l) << 40);\n"
+        "    ASSERT((i & 12 ^ ~i) == (id(i) & 12 ^ ~id(i)));\n"
+        "}\n"
+        "extern void ByteCodeLogic()\n"
+        "{\n"
+        "    int i = 5; float n = nan; bool t = true; bool f = false;\n"
+        "    ASSERT((i > 3 && i <= 5) == (id(i) > 3 && id(i) <= 5));\n"
+        "    ASSERT((f || !t) == (idb(f) || !idb(t)));\n"
+        "    ASSERT((t ^ f) == (idb(t) ^ idb(f)));\n"
+        "    ASSERT(n == nan);\n"
+        "    ASSERT((n != 1.0) == (idf(n) != 1.0));\n"
+        "    ASSERT(f && i / 0 == 1 || t);\n"
+        "}\n";
+
+    m_engine = CBotEngine::TREE;
+    ExecuteTest(code);
+    m_engine = CBotEngine::BYTECODE;
+    ExecuteTest(code);
+}
+
+TEST_F(CBotUT, UnboxedOperations)
+{
+    CBotVar::AllocationStats before = CBotVar::GetAllocationStats();
+    ExecuteTest(
+        "extern void UnboxedResults()\n"
+        "{\n"
+        "    int i = 7; long l = 3000000000; float f = 2.5; double d = 0.25;\n"
+        "    ASSERT(i * 3 - i / 2 == 18);\n"
+        "    ASSERT(-i % 4 == -3);\n"
+        "    ASSERT(i ** 2 == 49);\n"
+        "    ASSERT(l * i == 21000000000);\n"
+        "    ASSERT(i + f == 9.5);\n"
+        "    ASSERT(f % 1 == 0.5);\n"
+        "    ASSERT(d + f == 2.75);\n"
+        "    ASSERT(l / f == 1200000000.0);\n"
+        "    ASSERT((i & 3 | 8 ^ 1) == 11);\n"
+        "    ASSERT(i < l && f <= i && d != f && !(i >= l) && i == 7.0);\n"
+        "    float n = nan;\n"
+        "    ASSERT(n == nan && f != n);\n"
+        "}\n"
+        "extern void UnboxedLoop()\n"
+        "{\n"
+        "    int s = 0; float x = 0;\n"
+        "    for (int i = 0; i < 1000; i = i + 1)\n"
+        "    {\n"
+        "        s = s + i * 3 % 7;\n"
+        "        x = x + i / 2.0;\n"
+        "    }\n"
+        "    ASSERT(s == 2999);\n"
+        "    ASSERT(x == 249750);\n"
+        "}\n"
+    );
+    CBotVar::AllocationStats after = CBotVar::GetAllocationStats();
+    // the results of the operations reuse the variables of their operands
+    if (!g_cbotTestSaveState)
+    {
+        EXPECT_LT(after.created - before.created, 25000);
+    }
+
+    // the results released by the stack are used again, the loops don't create any variable
+    for (CBotEngine engine : {CBotEngine::TREE, CBotEngine::BYTECODE})
+    {
+        if (g_cbotTestSaveState) break;
+        m_engine = engine;
+        long created[2];
+        for (int n : {500, 1000})
+        {
+            CBotVar::AllocationStats before = CBotVar::GetAllocationStats();
+            ExecuteTest(
+                "extern void NoAllocationInLoop()\n"
+                "{\n"
+                "    int s = 0; float x = 0; bool b = false;\n"
+                "    for (int i = 0; i < " + std::to_string(n) + "; i++)\n"
+                "    {\n"
+                "        s = s + i * 3 % 7; s += 2; s = -s;\n"
+                "        x = x + i / 2.0;\n"
+                "        b = i < 5 && s > 3 || !b;\n"
+                "        if (s > 100000) s = 0;\n"
+                "    }\n"
+                "}\n"
+            );
+            created[n / 1000] = CBotVar::GetAllocationStats().created - before.created;
+        }
+        EXPECT_EQ(created[0], created[1]);
+    }
+    m_engine = g_cbotTestByteCode ? CBotEngine::BYTECODE : CBotEngine::TREE;
+
+    ExecuteTest(
+        "extern void UnboxedZeroDiv()\n"
+        "{\n"
+        "    int a = 1; int b = 0;\n"
+        "    int c = a % b;\n"
+        "}\n",
+        CBotErrZeroDiv
+    );
+}
+
+TEST_F(CBotUT, ByteCodeSameErrors)
+{
+    const std::vector<std::pair<std::string, CBotError>> codes = {
+        {
+            "extern void ByteCodeZeroDiv()\n"
+            "{\n"
+            "    int a = 1; int b = 0;\n"
+            "    int c = 2 + a / b;\n"
+            "}\n",
+            CBotErrZeroDiv
+        },
+        {
+            "extern void ByteCodeNan()\n"
+            "{\n"
+            "    float a = nan;\n"
+            "    float b = 1 + a * 2;\n"
+            "}\n",
+            CBotErrNan
+        },
+        {
+            "extern void ByteCodeNotInit()\n"
+            "{\n"
+            "    int a = 1; int b;\n"
+            "    int c = a + b * 2;\n"
+            "}\n",
+            CBotErrNotInit
+        },
+        {
+            "extern void ByteCodeIncrementNotInit()\n"
+            "{\n"
+            "    int a;\n"
+            "    for (int i = 0; i < 2; i++) a++;\n"
+            "}\n",
+            CBotErrNotInit
+        },
+        {
+            "extern void ByteCodeAssignZeroDiv()\n"
+            "{\n"
+            "    int a = 1; int b = 0;\n"
+            "    while (true) a /= b;\n"
+            "}\n",
+            CBotErrZeroDiv
+        },
+        {
+            "extern void ByteCodeBadThrow()\n"
+            "{\n"
+            "    int a = -5;\n"
+            "    if (a < 0) throw a;\n"
+            "}\n",
+            CBotErrBadThrow
+        },
+    };
+
+    for (const auto& code : codes)
+    {
+        m_engine = CBotEngine::TREE;
+        auto tree = ExecuteTest(code.first, code.second);
+        m_engine = CBotEngine::BYTECODE;
+        auto byteCode = ExecuteTest(code.first, code.second);
+
+        CBotError error1, error2;
+        int start1, end1, start2, end2;
+        tree->GetError(error1, start1, end1);
+        byteCode->GetError(error2, start2, end2);
+        EXPECT_EQ(error1, error2);
+        EXPECT_EQ(start1, start2);
+        EXPECT_EQ(end1, end2);
+    }
+}
+
+//! Ticks used by each call to Run() until the program ends
+static std::vector<int> TimeSlices(const std::string& code, const std::string& name, CBotEngine engine, bool optimize, int timer)
+{
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    program->SetEngine(engine);
+    program->SetOptimize(optimize);
+    std::vector<std::string> tests;
+    EXPECT_TRUE(program->Compile(code, tests)) << program->GetError();
+
+    std::vector<int> slices;
+    program->Start(name);
+    bool done = false;
+    while (!done)
+    {
+        done = program->Run(nullptr, timer);
+        slices.push_back(program->GetTicks());
+    }
+    EXPECT_EQ(program->GetError(), CBotNoErr) << name;
+    return slices;
+}
+
+TEST_F(CBotUT, ByteCodeTimeSlice)
+{
+    // both engines charge the same ticks and are interrupted at the same points
+    const std::string code =
+        "int twice(int a) { return a * 2; }\n"
+        "extern void Loop()\n"
+        "{\n"
+        "    int i = 0;\n"
+        "    while (i < 1000) i++;\n"
+        "    do { i -= 3; } while (i > 0);\n"
+        "}\n"
+        "extern void Branches()\n"
+        "{\n"
+        "    int s = 0; long b = 2;\n"
+        "    for (int i = 0, j = 10; i < 200; i++, j--)\n"
+        "    {\n"
+        "        int a = (s * 3 + b * 7 - i) % 1000;\n"
+        "        if (a > 500 && i % 2 == 0) s -= a; else s += -a;\n"
+        "        if (i % 7 == 0) continue;\n"
+        "        if (i > 150 || j == 3) { s = s % 100; }\n"
+        "        s += ++j - j--;\n"
+        "        if (i == 190) break;\n"
+        "    }\n"
+        "    ASSERT(s != 0);\n"
+        "}\n"
+        "extern void StraightLine()\n"
+        "{\n"
+        "    int a = 1; int b = 2;\n"
+        "    a = a + b * 3;\n"
+        "    float c = a * 2.5, d;\n"
+        "    bool e = c > 3 && !(a < 10);\n"
+        "    d = -c / 2;\n"
+        "    a = twice(a) + twice(b);\n"
+        "    b <<= 2;\n"
+        "    ASSERT(a == 18 && b == 8 && !e && d == -8.75);\n"
+        "}\n"
+        "extern void TreeStatements()\n"
+        "{\n"
+        "    int a = 1; long b = 2; string t = \"\";\n"
+        "    for (int i = 0; i < 100; i++)\n"
+        "    {\n"
+        "        try { a = (a * 3 + b * 7 - i) % 1000; } catch (1) {}\n"
+        "        switch (i % 3) { case 0: t += i; break; default: a++; }\n"
+        "    }\n"
+        "    ASSERT(a != 0);\n"
+        "}\n";
+
+    for (const std::string name : {"Loop", "Branches", "StraightLine", "TreeStatements"})
+    {
+        for (int timer : {1, 7, 100})
+        {
+            std::vector<int> tree = TimeSlices(code, name, CBotEngine::TREE, m_optimize, timer);
+            std::vector<int> byteCode = TimeSlices(code, name, CBotEngine::BYTECODE, m_optimize, timer);
+            // as many calls to Run(), each one with the same ticks
+            EXPECT_EQ(tree.size(), byteCode.size()) << name << " with timer " << timer;
+            EXPECT_EQ(tree, byteCode) << name << " with timer " << timer;
+        }
+    }
+}
+
+TEST_F(CBotUT, ByteCodeFunctionBodies)
+{
+    // the same bodies run as bytecode, with the statements it can't lower run by the tree walker
+    CBotProgram::DefineNum("ByteCodeNamed", 7);
+    const std::string code =
+        "int twice(int a) { return a * 2; }\n"
+        "long widen(int a) { return a; }\n"
+        "int root(int n) { for (int i = 0; i < n; i++) { if (i * i >= n) return i; } return n; }\n"
+        "extern void ByteCodeLoops()\n"
+        "{\n"
+        "    int s = 0;\n"
+        "    for (int i = 0; i < 10; i++) { if (i % 3 == 0) continue; s += i; if (s > 10) break; }\n"
+        "    ASSERT(s == 12);\n"
+        "    int n = 0;\n"
+        "    outer: while (true)\n"
+        "    {\n"
+        "        int j = 0;\n"
+        "        do { j++; n += j; if (n > 40) break outer; if (j == 3) continue outer; } while (j < 5);\n"
+        "    }\n"
+        "    ASSERT(n == 42);\n"
+        "    int k = 0;\n"
+        "    loop: for (int i = 0; i < 10; i++)\n"
+        "    {\n"
+        "        switch (i) { case 2: continue; case 6: break loop; default: k += i; }\n"
+        "        k += 100;\n"
+        "    }\n"
+        "    ASSERT(k == 613);\n"
+        "    string t = \"\";\n"
+        "    for (int i = 0; i < 3; i++) t += i;\n"
+        "    ASSERT(t == \"012\");\n"
+        "    ASSERT(root(50) == 8 && twice(root(9)) == 6);\n"
+        "}\n"
+        "extern void ByteCodeAssignments()\n"
+        "{\n"
+        "    int i = 5;\n"
+        "    int a = i++ + ++i;\n"
+        "    ASSERT(a == 12 && i == 7);\n"
+        "    i--; --i;\n"
+        "    ASSERT(i == 5);\n"
+        "    int x = 7; x += 2.9; ASSERT(x == 9);\n"
+        "    x *= 1.5; ASSERT(x == 9);\n"
+        "    x >>>= 1; x <<= 2; x ^= 3; ASSERT(x == 19);\n"
+        "    float y = 1; y /= 4; ASSERT(y == 0.25);\n"
+        "    bool b = true; b &= false; ASSERT(!b); b |= true; ASSERT(b);\n"
+        "    long l = 1; l <<= 40; ASSERT(l == 1099511627776);\n"
+        "    int c, d = 3, e;\n"
+        "    c = e = d + 1;\n"
+        "    ASSERT(c == 4 && e == 4);\n"
+        "    { int q = 1; ASSERT(q == 1); }\n"
+        "    { float q = 2.5; ASSERT(q == 2.5); }\n"
+        "    ASSERT(widen(2) * 2000000000 == -294967296);     // the result keeps the type of the expression\n"
+        "}\n"
+        "extern void ByteCodeNamedNumbers()\n"
+        "{\n"
+        "    int c = ByteCodeNamed;\n"
+        "    int d = c;\n"
+        "    string s = \"\"; s += d;\n"
+        "    ASSERT(s == \"ByteCodeNamed\");\n"
+        "    int e = c + 0;\n"
+        "    s = \"\"; s += e;\n"
+        "    ASSERT(s == \"7\");\n"
+        "}\n"
+        "extern void ByteCodeExceptions()\n"
+        "{\n"
+        "    int a = 0; int b = 0; int c = 0;\n"
+        "    try { throw 1234; } catch (1234) { a++; }\n"
+        "    try { int z = 0; z = 1 / z; } catch (CBotErrZeroDiv) { b++; }\n"
+        "    ASSERT(a == 1 && b == 1);\n"
+        "    throw c;\n"
+        "    c = 5;\n"
+        "    ASSERT(c == 5);\n"
+        "}\n";
+
+    m_engine = CBotEngine::TREE;
+    ExecuteTest(code);
+    m_engine = CBotEngine::BYTECODE;
+    ExecuteTest(code);
+}
+
+TEST_F(CBotUT, LocalVariableSlots)
+{
+    ExecuteTest(
+        "int fact(int n)\n"
+        "{\n"
+        "    int r = 1;\n"
+        "    if (n > 1) { int m = n - 1; r = n * fact(m); ASSERT(m == n - 1); }\n"
+        "    return r;\n"
+        "}\n"
+        "extern void RecursiveLocals()\n"
+        "{\n"
+        "    ASSERT(fact(6) == 720);\n"
+        "}\n"
+        "extern void SiblingBlocks()\n"
+        "{\n"
+        "    int a = 1;\n"
+        "    { int b = 2; a += b; }\n"
+        "    { float c = 0.5; a += 2 * c; }\n"
+        "    { string d = \"x\"; int e = 4; a += e; ASSERT(d == \"x\"); }\n"
+        "    ASSERT(a == 8);\n"
+        "}\n"
+        "extern void LoopLocals()\n"
+        "{\n"
+        "    int sum = 0;\n"
+        "    for (int i = 0; i < 5; i++)\n"
+        "    {\n"
+        "        int sq = i * i;\n"
+        "        for (int j = 0; j < 2; j++) { int k = sq + j; sum += k; }\n"
+        "    }\n"
+        "    ASSERT(sum == 65);\n"
+        "}\n"
+    );
+}
+
+TEST_F(CBotUT, StackGrowsOnDemand)
+{
+    ExecuteTest(
+        "int depth(int n)\n"
+        "{\n"
+        "    if (n == 0) return 0;\n"
+        "    int d = depth(n - 1);\n"
+        "    return d + 1;\n"
+        "}\n"
+        "public class Initialized\n"
+        "{\n"
+        "    int a = 1 + 2;\n"
+        "    float b = 3 * 2;\n"
+        "    int c[1 + 2];\n"
+        "    void ~Initialized() { a = 0; }\n"
+        "}\n"
+        "extern void DeepRecursion()\n"
+        "{\n"
+        "    ASSERT(depth(50) == 50);\n"
+        "    ASSERT(depth(10) == 10);\n"
+        "}\n"
+        "extern void InitializedFields()\n"
+        "{\n"
+        "    for (int i = 0; i < 100; i++)\n"
+        "    {\n"
+        "        Initialized x = new Initialized();\n"
+        "        x.c[2] = i;\n"
+        "        ASSERT(x.a == 3 && x.b == 6 && sizeof(x.c) == 3);\n"
+        "    }\n"
+        "}\n"
+    );
+}
+
+TEST_F(CBotUT, VariablesFromSlabs)
+{
+    CBotVar::AllocationStats before = CBotVar::GetAllocationStats();
+    ExecuteTest(
+        "public class Point\n"
+        "{\n"
+        "    float x; float y;\n"
+        "}\n"
+        "extern void ManyTemporaries()\n"
+        "{\n"
+        "    string s = \"\";\n"
+        "    for (int i = 0; i < 1000; i++)\n"
+        "    {\n"
+        "        Point p = new Point();\n"
+        "        p.x = i * 2.5;\n"
+        "        s = \"\" + i;\n"
+        "    }\n"
+        "    ASSERT(s == \"999\");\n"
+        "}\n"
+    );
+    CBotVar::AllocationStats after = CBotVar::GetAllocationStats();
+
+    EXPECT_GT(after.created - before.created, 5000);    // the numbers are used again, see UnboxedOperations
+    EXPECT_EQ(after.created - after.destroyed, before.created - before.destroyed);
+    EXPECT_LT(after.blocks - before.blocks, 100);
+    EXPECT_LT(after.tokens - before.tokens, 10);     // only for the position of the ASSERT() parameter
+
+    CBotVar* var = CBotVar::Create("first", CBotTypInt);
+    EXPECT_EQ(var->GetName(), "first");
+    var->SetName("second");
+    EXPECT_EQ(var->GetName(), "second");
+    EXPECT_EQ(var->GetToken()->GetString(), "second");
+    var->SetName("third");
+    EXPECT_EQ(var->GetToken()->GetString(), "third");
+    CBotVar* copy = CBotVar::Create("", CBotTypInt);
+    copy->Copy(var);
+    EXPECT_EQ(copy->GetName(), "third");
+    delete copy;
+    delete var;
+}
+
+TEST_F(CBotUT, ArrayIndexedAccess)
+{
+    ExecuteTest(
+        "extern void LargeArray()\n"
+        "{\n"
+        "    int a[];\n"
+        "    for (int i = 499; i >= 0; i--) a[i] = i;\n"
+        "    ASSERT(sizeof(a) == 500);\n"
+        "    int sum = 0;\n"
+        "    for (int i = 0; i < sizeof(a); i++) sum += a[i];\n"
+        "    ASSERT(sum == 124750);\n"
+        "}\n"
+        "extern void GrowOnWrite()\n"
+        "{\n"
+        "    float a[];\n"
+        "    ASSERT(sizeof(a) == 0);\n"
+        "    a[2] = 2.5;\n"
+        "    ASSERT(sizeof(a) == 3);\n"
+        "    a[5] = 5;\n"
+        "    ASSERT(sizeof(a) == 6 && a[2] == 2.5 && a[5] == 5);\n"
+        "    float b[] = a;\n"
+        "    b[6] = 6;\n"
+        "    ASSERT(sizeof(a) == 7 && a[6] == 6);\n"
+        "}\n"
+        "extern void CopiedArray()\n"
+        "{\n"
+        "    string a[4];\n"
+        "    a[0] = \"x\"; a[3] = \"y\";\n"
+        "    string b[4];\n"
+        "    b = a;\n"
+        "    a[3] = \"z\";\n"
+        "    ASSERT(b[0] == \"x\" && b[3] == \"z\");\n"
+        "    int c[][] = {{1, 2}, {3, 4, 5}};\n"
+        "    c[1][4] = 7;\n"
+        "    ASSERT(sizeof(c[1]) == 5 && c[1][2] + c[1][4] == 12);\n"
+        "}\n"
+    );
+}
+
+TEST_F(CBotUT, ArrayIndexCache)
+{
+    // the elements stay in their list, the index over them is rebuilt once the list is replaced
+    CBotVar* a = CBotVar::Create("a", CBotTypResult(CBotTypArrayBody, CBotTypResult(CBotTypInt)));
+    CBotVar* b = CBotVar::Create("b", CBotTypResult(CBotTypArrayBody, CBotTypResult(CBotTypInt)));
+    for (int i = 0; i < 5; i++) a->GetItem(i, true)->SetValInt(i);
+    b->GetItem(1, true)->SetValInt(-1);
+    ASSERT_EQ(b->GetItemCount(), 2);
+
+    b->GetPointer()->Copy(a->GetPointer(), false);
+    ASSERT_EQ(b->GetItemCount(), 5);
+    EXPECT_EQ(b->GetItem(1)->GetValInt(), 1);
+    b->GetItem(6, true)->SetValInt(6);
+    EXPECT_EQ(b->GetItemCount(), 7);
+    EXPECT_EQ(a->GetItemCount(), 5);
+    int index = 0;
+    for (CBotVar* item = b->GetItemList(); item != nullptr; item = item->GetNext())
+    {
+        EXPECT_EQ(b->GetItem(index++), item);
+    }
+    EXPECT_EQ(index, 7);
+    delete b;
+    delete a;
+
+    // the members of an instance copied by value
+    CBotClass* point = CBotClass::Create("IndexCachePoint", nullptr, true);
+    point->AddItem("x", CBotTypFloat);
+    point->AddItem("y", CBotTypFloat);
+    CBotVar* p = CBotVar::Create("p", CBotTypResult(CBotTypIntrinsic, point));
+    CBotVar* q = CBotVar::Create("q", CBotTypResult(CBotTypIntrinsic, point));
+    p->GetItem("y")->SetValFloat(1.5f);
+    q->GetItem("y")->SetValFloat(2.5f);
+    q->SetVal(p);
+    EXPECT_EQ(q->GetItem("y")->GetValFloat(), 1.5f);
+    EXPECT_EQ(q->GetItem("y"), q->GetItemList()->GetNext());
+    delete q;
+    delete p;
+
+    // after a restore, saving at each step even without --CBotUT_TestSaveState
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "extern void RestoredArray()\n"
+        "{\n"
+        "    int a[];\n"
+        "    for (int i = 0; i < 20; i++)\n"
+        "    {\n"
+        "        a[i] = i;\n"
+        "        ASSERT(sizeof(a) == i + 1 && a[i / 2] == i / 2);\n"
+        "    }\n"
+        "}\n", tests)) << program->GetError();
+    program->Start(tests[0]);
+    while (!program->Run(nullptr, 0))
+    {
+        std::stringstream state;
+        ASSERT_TRUE(program->SaveState(state));
+        ASSERT_TRUE(program->RestoreState(state));
+    }
+    EXPECT_EQ(program->GetError(), CBotNoErr);
+
+    // through the collection of a cycle made by an array
+    ASSERT_TRUE(program->Compile(
+        "public class Holder\n"
+        "{\n"
+        "    Holder items[];\n"
+        "}\n"
+        "extern void ArrayCycle()\n"
+        "{\n"
+        "    Holder h = new Holder();\n"
+        "    h.items[3] = h;\n"
+        "    ASSERT(sizeof(h.items) == 4);\n"
+        "}\n", tests)) << program->GetError();
+    long collected = CBotProgram::GetMemoryUsage().collected;
+    program->Start(tests[0]);
+    while (!program->Run(nullptr, 0));
+    EXPECT_EQ(program->GetError(), CBotNoErr);
+    while (!CBotProgram::CollectCycles(1000));
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().collected, collected + 2);     // the holder and its array
+}
+
+TEST_F(CBotUT, ArrayFunctions)
+{
+    ExecuteTest(
+        "extern void SortAndSearch()\n"
+        "{\n"
+        "    int a[] = {5, -2, 9, 0, 7};\n"
+        "    arrsort(a);\n"
+        "    ASSERT(a[0] == -2 && a[1] == 0 && a[2] == 5 && a[3] == 7 && a[4] == 9);\n"
+        "    ASSERT(arrfind(a, 7) == 3);\n"
+        "    ASSERT(arrfind(a, 7.5) == -1);\n"
+        "    arrreverse(a);\n"
+        "    ASSERT(a[0] == 9 && a[4] == -2);\n"
+        "    string s[] = {\"b\", \"c\", \"a\"};\n"
+        "    arrsort(s);\n"
+        "    ASSERT(s[0] == \"a\" && s[1] == \"b\" && s[2] == \"c\");\n"
+        "    ASSERT(arrfind(s, \"c\") == 2);\n"
+        "    float f[] = {2.5, nan, -1};\n"
+        "    arrsort(f);\n"
+        "    ASSERT(f[0] == -1 && f[1] == 2.5 && isnan(f[2]));\n"
+        "}\n"
+        "extern void SumMinMax()\n"
+        "{\n"
+        "    int a[] = {3, 1, 4, 1, 5};\n"
+        "    ASSERT(arrsum(a) == 14 && arrmin(a) == 1 && arrmax(a) == 5);\n"
+        "    float f[] = {0.5, 1.25};\n"
+        "    ASSERT(arrsum(f) == 1.75 && arrmax(f) == 1.25);\n"
+        "    int e[];\n"
+        "    ASSERT(arrsum(e) == 0);\n"
+        "    int big[] = {2147483647, 2147483647, 3};\n"
+        "    ASSERT(arrsum(big) == 2147483647 + 2147483647 + 3);\n"
+        "    long lbig[] = {9223372036854775807, 1};\n"
+        "    ASSERT(arrsum(lbig) == -9223372036854775807 - 1);\n"
+        "}\n"
+        "extern void FillAndMid()\n"
+        "{\n"
+        "    int a[];\n"
+        "    a[3] = 0;\n"
+        "    arrfill(a, 8);\n"
+        "    ASSERT(sizeof(a) == 4 && a[0] == 8 && a[3] == 8);\n"
+        "    int b[] = {1, 2, 3, 4, 5};\n"
+        "    int c[] = arrmid(b, 1, 3);\n"
+        "    ASSERT(sizeof(c) == 3 && c[0] == 2 && c[2] == 4);\n"
+        "    c[0] = 0;\n"
+        "    ASSERT(b[1] == 2);\n"
+        "    ASSERT(sizeof(arrmid(b, 3)) == 2 && sizeof(arrmid(b, 9)) == 0);\n"
+        "}\n"
+        "public class Item { int n; }\n"
+        "extern void ObjectArrays()\n"
+        "{\n"
+        "    Item x = new Item(), y = new Item();\n"
+        "    Item[] items = {x, y, null};\n"
+        "    arrreverse(items);\n"
+        "    ASSERT(items[0] == null && items[2] == x);\n"
+        "    ASSERT(arrfind(items, y) == 1 && arrfind(items, null) == 0);\n"
+        "    Item[] copy = arrmid(items, 1);\n"
+        "    ASSERT(copy[1] == x);\n"
+        "    arrfill(items, y);\n"
+        "    ASSERT(arrfind(items, x) == -1);\n"
+        "}\n"
+    );
+
+    ExecuteTest(
+        "extern void MinOfEmptyArray()\n"
+        "{\n"
+        "    int a[];\n"
+        "    int m = arrmin(a);\n"
+        "}\n",
+        CBotErrOutArray
+    );
+
+    ExecuteTest(
+        "extern void SortUninitialized()\n"
+        "{\n"
+        "    int a[];\n"
+        "    a[2] = 1;\n"
+        "    arrsort(a);\n"
+        "}\n",
+        CBotErrNotInit
+    );
+
+    ExecuteTest(
+        "extern void SortBooleans()\n"
+        "{\n"
+        "    bool a[] = {true, false};\n"
+        "    arrsort(a);\n"
+        "}\n",
+        CBotErrBadParam
+    );
+}
+
+static int g_externalCallCount = 0;
+
+static CBotTypResult cCount(CBotVar* &var, void* user)
+{
+    if (var != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypInt);
+}
+
+static bool rCount(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    result->SetValInt(++g_externalCallCount);
+    return true;
+}
+
+static bool rCountTwice(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    g_externalCallCount += 2;
+    result->SetValInt(g_externalCallCount);
+    return true;
+}
+
+TEST_F(CBotUT, ExternalCallBinding)
+{
+    CBotProgram::AddFunction("count", rCount, cCount);
+    g_externalCallCount = 0;
+    ExecuteTest(
+        "extern void CallsBoundFunction()\n"
+        "{\n"
+        "    int last = 0;\n"
+        "    for (int i = 0; i < 10; i++) last = count();\n"
+        "    ASSERT(last == 10);\n"
+        "}\n"
+    );
+    EXPECT_EQ(g_externalCallCount, 10);
+
+    // a function registered again after compilation is found again
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile("extern void CallCount() { count(); }", tests));
+    CBotProgram::AddFunction("count", rCountTwice, cCount);
+    g_externalCallCount = 0;
+    program->Start("CallCount");
+    while (!program->Run(nullptr, 0));
+    EXPECT_EQ(g_externalCallCount, 2);
+
+    // and bound again at each change
+    for (auto function : {rCount, rCountTwice, rCount})
+    {
+        CBotProgram::AddFunction("count", function, cCount);
+        g_externalCallCount = 0;
+        program->Start("CallCount");
+        while (!program->Run(nullptr, 0));
+        EXPECT_EQ(g_externalCallCount, function == rCount ? 1 : 2);
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests
+TEST_F(CBotUT, DISABLED_BenchmarkExternalCalls)
+{
+    for (int i = 0; i < 70; i++)                    // as many functions as Colobot registers
+    {
+        CBotProgram::AddFunction("robotFunction" + std::to_string(i), rCount, cCount);
+    }
+    CBotProgram::AddFunction("count", rCount, cCount);
+
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    program->SetEngine(m_engine);
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "extern void BenchmarkExternalCalls()\n"
+        "{\n"
+        "    for (int i = 0; i < 100000; i++) count();\n"
+        "}\n", tests)) << program->GetError();
+
+    // the calls are bound again after a function is registered, as the game does for each level
+    CBotProgram::AddFunction("count", rCount, cCount);
+    g_externalCallCount = 0;
+    auto start = std::chrono::steady_clock::now();
+    program->Start(tests[0]);
+    while (!program->Run(nullptr, 0));
+    auto time = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(g_externalCallCount, 100000);
+    std::cout << "100000 external calls: " << std::chrono::duration_cast<std::chrono::milliseconds>(time).count() << " ms" << std::endl;
+}
+
+static long CountTicks(const std::string& code)
+{
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    EXPECT_TRUE(program->Compile(code, tests)) << program->GetError();
+    program->Start(tests[0]);
+    while (!program->Run(nullptr, 100));
+    return program->GetTotalTicks();
+}
+
+TEST_F(CBotUT, InstructionCosts)
+{
+    // long strings cost one tick per LENGTH_PER_TICK characters
+    long empty = CountTicks("extern void AppendEmpty() { string s = \"\"; for (int i = 0; i < 100; i++) s += \"\"; }");
+    long text = CountTicks("extern void AppendText() { string s = \"\"; for (int i = 0; i < 100; i++) s += \"0123456789\"; }");
+    EXPECT_EQ(text - empty, 460);
+
+    long concat = CountTicks("extern void Concat() { string s = \"\"; for (int i = 0; i < 100; i++) s = s + \"0123456789\"; }");
+    long concatEmpty = CountTicks("extern void ConcatEmpty() { string s = \"\"; for (int i = 0; i < 100; i++) s = s + \"\"; }");
+    EXPECT_EQ(concat - concatEmpty, 460);
+
+    // and external calls what they were given
+    CBotProgram::AddFunction("count", rCount, cCount);
+    const std::string code = "extern void CallCount() { for (int i = 0; i < 10; i++) count(); }";
+    long free = CountTicks(code);
+    EXPECT_TRUE(CBotProgram::SetFunctionCost("count", 50));
+    EXPECT_EQ(CountTicks(code) - free, 500);
+    EXPECT_FALSE(CBotProgram::SetFunctionCost("noSuchFunction", 50));
+}
+
+TEST_F(CBotUT, ProfilerCollapsedStacks)
+{
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "int Inner(int n)\n"
+        "{\n"
+        "    int sum = 0;\n"
+        "    for (int i = 0; i < n; i++) sum += i;\n"
+        "    return sum;\n"
+        "}\n"
+        "extern void Outer()\n"
+        "{\n"
+        "    int total = 0;\n"
+        "    for (int i = 0; i < 10; i++) total += Inner(20);\n"
+        "}\n", tests));
+
+    CBotProfiler profiler("Robot");
+    program->SetProfiler(&profiler);
+    program->Start("Outer");
+    while (!program->Run(nullptr, 100));
+    EXPECT_EQ(profiler.GetTicks(), program->GetTotalTicks());
+
+    // every tick is in one of the stacks, most of them in Inner
+    std::stringstream collapsed;
+    profiler.WriteCollapsed(collapsed);
+    long total = 0, inner = 0;
+    std::string line;
+    while (std::getline(collapsed, line))
+    {
+        std::size_t space = line.rfind(' ');
+        ASSERT_NE(space, std::string::npos);
+        long count = std::stol(line.substr(space + 1));
+        EXPECT_EQ(line.compare(0, 12, "Robot;Outer;"), 0) << line;
+        if (line.compare(0, 18, "Robot;Outer;Inner;") == 0) inner += count;
+        total += count;
+    }
+    EXPECT_EQ(total, profiler.GetTicks());
+    EXPECT_GT(inner, total / 2);
+}
+
+TEST_F(CBotUT, OptimizeSameResults)
+{
+    const std::string code =
+        "float degrees(float a)\n"
+        "{\n"
+        "    return a * 180 / 3.14159;\n"
+        "    a = 0;\n"
+        "}\n"
+        "extern void ConstantExpressions()\n"
+        "{\n"
+        "    float rad = 2 * 3.14159 / 180;\n"
+        "    ASSERT(rad > 0.0349 && rad < 0.035);\n"
+        "    int mask = ~(1 << 4) & 0xFF;\n"
+        "    ASSERT(mask == 239);\n"
+        "    long big = 3000000000 + -1;\n"
+        "    ASSERT(big == 2999999999);\n"
+        "    ASSERT(CBotErrZeroDiv + 1 == 6001 && -CBotErrZeroDiv == -6000);\n"
+        "    ASSERT((\"\" + (+CBotErrZeroDiv)) == \"CBotErrZeroDiv\");\n"
+        "    ASSERT((\"\" + (CBotErrZeroDiv * 1)) == \"6000\");\n"
+        "    ASSERT(7 / 2 == 3 && 7 % 2 == 1 && 2 ** 10 == 1024);\n"
+        "    ASSERT(!(1 > 2) && 1 < 2 == true);\n"
+        "    ASSERT(degrees(3.14159) == 180);\n"
+        "}\n"
+        "extern void LogicalSimplifications()\n"
+        "{\n"
+        "    int calls = 0;\n"
+        "    bool a = true;\n"
+        "    ASSERT((true && a) == a && (a || false) == a);\n"
+        "    ASSERT((false && (calls++ == 0)) == false && calls == 0);\n"
+        "    ASSERT((true || (calls++ == 0)) == true && calls == 0);\n"
+        "    ASSERT((false || (calls++ == 0)) == true && calls == 1);\n"
+        "    ASSERT(((calls++ == 1) && true) == true && calls == 2);\n"
+        "    ASSERT(((calls++ == 0) && false) == false && calls == 3);\n"
+        "}\n"
+        "extern void DeadCode()\n"
+        "{\n"
+        "    int x = 0;\n"
+        "    if (true) x = 1; else x = 2;\n"
+        "    if (false) x = 3;\n"
+        "    if (1 > 2) x = 4; else { x += 10; }\n"
+        "    ASSERT(x == 11);\n"
+        "    for (int i = 0; i < 3; i++)\n"
+        "    {\n"
+        "        x++;\n"
+        "        continue;\n"
+        "        x = 0;\n"
+        "    }\n"
+        "    while (true)\n"
+        "    {\n"
+        "        break;\n"
+        "        x = 0;\n"
+        "    }\n"
+        "    ASSERT(x == 14);\n"
+        "}\n";
+
+    std::map<std::string, int> steps[2];
+    for (bool optimize : {false, true})
+    {
+        m_optimize = optimize;
+        ExecuteTest(code);
+
+        // the bytecode engine already evaluates a whole expression in one step
+        auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+        program->SetEngine(CBotEngine::TREE);
+        program->SetOptimize(optimize);
+        std::vector<std::string> tests;
+        ASSERT_TRUE(program->Compile(code, tests));
+        for (const std::string& test : tests)
+        {
+            program->Start(test);
+            int count = 0;
+            while (!program->Run(nullptr, 0)) count++;
+            steps[optimize][test] = count;
+        }
+    }
+    for (const auto& test : steps[0])
+    {
+        EXPECT_LT(steps[1][test.first], test.second) << test.first;
+    }
+}
+
+TEST_F(CBotUT, OptimizeSameErrors)
+{
+    const std::vector<std::pair<std::string, CBotError>> codes = {
+        {
+            "extern void ConstantZeroDiv()\n"
+            "{\n"
+            "    int a = 1 + 2 * (3 / 0);\n"
+            "}\n",
+            CBotErrZeroDiv
+        },
+        {
+            "extern void ConstantNan()\n"
+            "{\n"
+            "    float a = 1 + nan * 2;\n"
+            "}\n",
+            CBotErrNan
+        },
+        {
+            "extern void ErrorAfterFolding()\n"
+            "{\n"
+            "    int a = 0;\n"
+            "    int b = (2 * 3) / a;\n"
+            "}\n",
+            CBotErrZeroDiv
+        },
+        {
+            "extern void ErrorInDeadCode()\n"
+            "{\n"
+            "    return;\n"
+            "    int a = \"text\";\n"
+            "}\n",
+            CBotErrBadType1
+        },
+        {
+            "int NoReturn(bool b)\n"
+            "{\n"
+            "    while (b) { break; return 1; }\n"
+            "    if (false) return 2; else return 3;\n"
+            "}\n"
+            "extern void ReturnKept()\n"
+            "{\n"
+            "    ASSERT(NoReturn(true) == 3);\n"
+            "}\n",
+            CBotNoErr
+        },
+    };
+
+    for (const auto& code : codes)
+    {
+        m_optimize = false;
+        auto plain = ExecuteTest(code.first, code.second);
+        m_optimize = true;
+        auto optimized = ExecuteTest(code.first, code.second);
+
+        CBotError error1, error2;
+        int start1, end1, start2, end2;
+        plain->GetError(error1, start1, end1);
+        optimized->GetError(error2, start2, end2);
+        EXPECT_EQ(error1, error2);
+        EXPECT_EQ(start1, start2);
+        EXPECT_EQ(end1, end2);
+    }
+}
+
+TEST_F(CBotUT, SharedProgramCode)
+{
+    const std::string code =
+        "int Add(int a, int b)\n"
+        "{\n"
+        "    return a + b;\n"
+        "}\n"
+        "extern void Sum()\n"
+        "{\n"
+        "    int sum = 0;\n"
+        "    for (int i = 1; i <= 10; i++) sum = Add(sum, i);\n"
+        "    ASSERT(sum == 55);\n"
+        "}\n";
+
+    std::vector<std::string> tests;
+    auto first = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(first->Compile(code, tests));
+    EXPECT_FALSE(first->IsCodeShared());
+
+    auto second = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(second->Compile(code, tests));
+    ASSERT_EQ(tests, std::vector<std::string>{"Sum"});
+    EXPECT_TRUE(first->IsCodeShared());
+    EXPECT_TRUE(second->IsCodeShared());
+
+    // each program keeps its own execution state
+    first->Start("Sum");
+    second->Start("Sum");
+    bool firstDone = false, secondDone = false;
+    while (!firstDone || !secondDone)
+    {
+        if (!firstDone) firstDone = first->Run(nullptr, 0);
+        if (!secondDone) secondDone = second->Run(nullptr, 0);
+    }
+    EXPECT_EQ(first->GetError(), CBotNoErr);
+    EXPECT_EQ(second->GetError(), CBotNoErr);
+
+    second.reset();
+    EXPECT_FALSE(first->IsCodeShared());
+
+    // the code is compiled again once the definitions it may depend on changed
+    CBotProgram::DefineNum("SharedProgramCodeConstant", 1);
+    auto third = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(third->Compile(code, tests));
+    EXPECT_FALSE(third->IsCodeShared());
+    EXPECT_FALSE(first->IsCodeShared());
+}
+
+TEST_F(CBotUT, SharedProgramCodeRebinding)
+{
+    CBotProgram::AddFunction("isolatedCount", rCount, cCount, true);
+    const std::string code = "extern void CallIsolated() { for (int i = 0; i < 10; i++) isolatedCount(); }";
+    std::vector<std::string> tests;
+    auto first = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(first->Compile(code, tests));
+    auto second = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(second->Compile(code, tests));
+    ASSERT_TRUE(second->IsCodeShared());
+
+    // the call bound when compiling is out of date, the shared code is left as it is
+    // and the function found by name, without stopping the isolated runs
+    CBotProgram::AddFunction("isolatedCount", rCountTwice, cCount, true);
+    g_externalCallCount = 0;
+    first->Start("CallIsolated");
+    second->Start("CallIsolated");
+    first->RunIsolated(nullptr, 1000);
+    second->RunIsolated(nullptr, 1000);
+    EXPECT_EQ(g_externalCallCount, 40);
+    EXPECT_TRUE(first->Run(nullptr, 1000));
+    EXPECT_TRUE(second->Run(nullptr, 1000));
+    EXPECT_EQ(first->GetError(), CBotNoErr);
+    EXPECT_EQ(second->GetError(), CBotNoErr);
+    EXPECT_EQ(g_externalCallCount, 40);
+}
+
+static CBotTypResult cReport(CBotVar* &var, void* user)
+{
+    if (var == nullptr) return CBotTypResult(CBotErrLowParam);
+    if (var->GetNext() != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+static bool rReport(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    *static_cast<long*>(user) = var->GetValLong();
+    return true;
+}
+
+static void uSharedRobotField(CBotVar* thisVar, CBotVar* field, int slot, void* user)
+{
+    field->SetValInt(*static_cast<int*>(user));
+}
+
+TEST_F(CBotUT, SharedProgramCodeRobots)
+{
+    // as CScript::Compile() does for the robots of a level running the same program
+    CBotProgram::AddFunction("report", rReport, cReport);
+    CBotClass* robot = CBotClass::Create("SharedRobot", nullptr);
+    robot->AddItem("energy", CBotTypResult(CBotTypInt), CBotVar::ProtectionLevel::ReadOnly);
+    robot->SetFieldUpdateFunc(uSharedRobotField);
+    const std::string code =
+        "extern void SharedRobot::Main()\n"
+        "{\n"
+        "    report(Scaled());\n"
+        "}\n"
+        "int Scaled()\n"
+        "{\n"
+        "    return Energy() * 10;\n"
+        "}\n"
+        "int SharedRobot::Energy()\n"
+        "{\n"
+        "    return energy;\n"
+        "}\n";
+
+    const int count = 3;
+    int energies[count];
+    CBotVar* robotVars[count];
+    std::unique_ptr<CBotProgram> programs[count];
+    long reports[count] = {};
+    for (int i = 0; i < count; i++)
+    {
+        energies[i] = i + 1;
+        robotVars[i] = CBotVar::Create("", CBotTypResult(CBotTypClass, "SharedRobot"));
+        robotVars[i]->SetUserPtr(&energies[i]);
+        programs[i].reset(new CBotProgram(robotVars[i]));
+        std::vector<std::string> externFunctions;
+        ASSERT_TRUE(programs[i]->Compile(code, externFunctions, &reports[i])) << programs[i]->GetError();
+        EXPECT_EQ(externFunctions, std::vector<std::string>{"Main"});
+    }
+    for (int i = 0; i < count; i++)
+    {
+        EXPECT_TRUE(programs[i]->IsCodeShared());
+        programs[i]->Start("Main");
+        while (!programs[i]->Run(&reports[i], 100));
+        EXPECT_EQ(programs[i]->GetError(), CBotNoErr);
+        EXPECT_EQ(reports[i], (i + 1) * 10);
+    }
+
+    // the functions find the methods out of their class (Energy()) in the class of "this"
+    auto noRobot = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> externFunctions;
+    EXPECT_FALSE(noRobot->Compile(code, externFunctions));
+    EXPECT_FALSE(noRobot->IsCodeShared());
+
+    for (int i = 0; i < count; i++)
+    {
+        programs[i].reset();
+        delete robotVars[i];
+    }
+}
+
+TEST_F(CBotUT, IsolatedContexts)
+{
+    const std::string code =
+        "public class Counter\n"
+        "{\n"
+        "    long total = 0;\n"
+        "    void Add(long n) { total += n; }\n"
+        "}\n"
+        "extern void CountInContext()\n"
+        "{\n"
+        "    Counter counter = new Counter();\n"
+        "    for (int i = 0; i < 1000; i++) counter.Add(CONTEXT_VALUE);\n"
+        "    report(counter.total);\n"
+        "}\n";
+
+    // the same public class and constant are defined in every context
+    const int count = 4;
+    std::unique_ptr<CBotContext> contexts[count];
+    std::unique_ptr<CBotProgram> programs[count];
+    for (int i = 0; i < count; i++)
+    {
+        contexts[i].reset(new CBotContext());
+        CBotContext::SetCurrent(contexts[i].get());
+        CBotProgram::Init();
+        CBotProgram::AddFunction("report", rReport, cReport);
+        CBotProgram::DefineNum("CONTEXT_VALUE", i + 1);
+        programs[i].reset(new CBotProgram());
+        std::vector<std::string> externFunctions;
+        EXPECT_TRUE(programs[i]->Compile(code, externFunctions)) << programs[i]->GetError();
+        CBotContext::SetCurrent(nullptr);
+    }
+    EXPECT_EQ(CBotClass::Find("Counter"), nullptr);
+
+    // each program runs in its own thread
+    long results[count] = {};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; i++)
+    {
+        threads.emplace_back([&programs, &results, i]()
+        {
+            programs[i]->Start("CountInContext");
+            while (!programs[i]->Run(&results[i], 10));
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    for (int i = 0; i < count; i++)
+    {
+        EXPECT_EQ(programs[i]->GetError(), CBotNoErr);
+        EXPECT_EQ(results[i], 1000 * (i + 1));
+        programs[i].reset();
+        contexts[i].reset();
+    }
+}
+
+TEST_F(CBotUT, ContextStatistics)
+{
+    std::unique_ptr<CBotContext> context(new CBotContext());
+    CBotContext::Scope scope(context.get());
+    CBotProgram::Init();
+    CBotContext::Statistics before = context->GetStatistics();
+
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> externFunctions;
+    ASSERT_TRUE(program->Compile(
+        "public class Counted { int n; }\n"
+        "public int Twice(int n) { return 2 * n; }\n"
+        "extern void KeepsNames() { Counted c = new Counted(); c.n = Twice(2); }\n", externFunctions));
+    CBotContext::Statistics compiled = context->GetStatistics();
+    EXPECT_EQ(compiled.classes, before.classes + 1);
+    EXPECT_EQ(compiled.publicFunctions, before.publicFunctions + 1);
+
+    program->Start("KeepsNames");
+    while (!program->Run(nullptr, 100));
+    EXPECT_GT(context->GetStatistics().variableNames, before.variableNames);
+
+    program.reset();
+    EXPECT_EQ(context->GetStatistics().publicFunctions, before.publicFunctions);
+    CBotProgram::Free();
+}
+
+TEST_F(CBotUT, InternedNamesOfContexts)
+{
+    // the names cached by the thread belong to the context they were interned in
+    for (int i = 0; i < 3; i++)
+    {
+        std::unique_ptr<CBotContext> context(new CBotContext());
+        CBotContext::SetCurrent(context.get());
+        std::string name = i % 2 == 0 ? "name0" : "name1";
+        CBotVar* var = CBotVar::Create(name, CBotTypResult(CBotTypInt));
+        CBotVar* other = CBotVar::Create(name, CBotTypResult(CBotTypString));
+        EXPECT_EQ(var->GetName(), name);
+        EXPECT_EQ(other->GetName(), var->GetName());
+        delete var;
+        delete other;
+        CBotContext::SetCurrent(nullptr);
+    }
+
+    CBotVar* var = CBotVar::Create("name0", CBotTypInt);
+    EXPECT_EQ(var->GetName(), "name0");
+    delete var;
+}
+
+struct IsolatedRobot
+{
+    int id;
+    std::vector<std::pair<int, float>>* events;
+};
+
+static std::thread::id g_mainThread;
+static std::atomic<int> g_isolatedCalls{0};
+
+static CBotTypResult cRobotId(CBotVar* &var, void* user)
+{
+    if (var != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypInt);
+}
+
+static bool rRobotId(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    result->SetValInt(static_cast<IsolatedRobot*>(user)->id);
+    return true;
+}
+
+static CBotTypResult cRobotEvent(CBotVar* &var, void* user)
+{
+    if (var == nullptr) return CBotTypResult(CBotErrLowParam);
+    if (var->GetNext() != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+static bool rRobotEvent(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    IsolatedRobot* robot = static_cast<IsolatedRobot*>(user);
+    robot->events->emplace_back(robot->id, var->GetValFloat());
+    return true;
+}
+
+static CBotTypResult cHalf(CBotVar* &var, void* user)
+{
+    if (var == nullptr) return CBotTypResult(CBotErrLowParam);
+    if (var->GetNext() != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypFloat);
+}
+
+static bool rHalf(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    if (std::this_thread::get_id() != g_mainThread) g_isolatedCalls++;
+    result->SetValFloat(var->GetValFloat() / 2);
+    return true;
+}
+
+TEST_F(CBotUT, IsolatedRunMatchesSerial)
+{
+    const std::string library =
+        "public class Ticket\n"
+        "{\n"
+        "    static int last = 0;\n"
+        "    int Take() { last++; return last; }\n"
+        "}\n"
+        "public class Shape\n"
+        "{\n"
+        "    float Area() { return 0; }\n"
+        "}\n"
+        "public class Square extends Shape\n"
+        "{\n"
+        "    float side = 0;\n"
+        "    float Area() { return side * side; }\n"
+        "}\n"
+        "extern void Classes() {}\n";
+    const std::string code =
+        "float Work(int n)\n"
+        "{\n"
+        "    float sum = 0;\n"
+        "    for (int i = 0; i < n; i++) sum += half(sqrt(i) * sin(i));\n"
+        "    return sum;\n"
+        "}\n"
+        "extern void Robot()\n"
+        "{\n"
+        "    int me = robotId();\n"
+        "    Ticket ticket = new Ticket();\n"
+        "    Square square = new Square();\n"
+        "    Shape shape = square;\n"
+        "    string name = \"robot\" + me;\n"
+        "    int[] values;\n"
+        "    for (int step = 0; step < 15; step++)\n"
+        "    {\n"
+        "        int[] scratch;\n"
+        "        scratch[me] = step;\n"
+        "        square.side = step;\n"
+        "        values[step] = step * me;\n"
+        "        event(Work(20 + 7 * me + step) + shape.Area() + strlen(name) + sizeof(values));\n"
+        "        event(ticket.Take());\n"
+        "    }\n"
+        "}\n";
+
+    // the same robots, once run serially and once with the isolated parts of each frame on several threads
+    const int count = 8;
+    const int threadCount = 4;
+    std::vector<std::pair<int, float>> events[2];
+    std::vector<std::string> states[2];
+    for (int parallel = 0; parallel < 2; parallel++)
+    {
+        CBotContext context;
+        CBotContext::Scope scope(&context);
+        CBotProgram::Init();
+        CBotProgram::AddFunction("robotId", rRobotId, cRobotId);
+        CBotProgram::AddFunction("event", rRobotEvent, cRobotEvent);
+        CBotProgram::AddFunction("half", rHalf, cHalf, true);
+        auto classes = std::unique_ptr<CBotProgram>(new CBotProgram());
+        std::vector<std::string> externFunctions;
+        ASSERT_TRUE(classes->Compile(library, externFunctions)) << classes->GetError();
+
+        IsolatedRobot robots[count];
+        std::unique_ptr<CBotProgram> programs[count];
+        bool done[count] = {};
+        for (int i = 0; i < count; i++)
+        {
+            robots[i] = IsolatedRobot{i, &events[parallel]};
+            programs[i].reset(new CBotProgram());
+            ASSERT_TRUE(programs[i]->Compile(code, externFunctions)) << programs[i]->GetError();
+            programs[i]->Start("Robot");
+        }
+
+        g_mainThread = std::this_thread::get_id();
+        g_isolatedCalls = 0;
+        int remaining = count;
+        for (int frame = 0; remaining > 0; frame++)
+        {
+            ASSERT_LT(frame, 10000);
+            int timer = 20 + frame % 7;
+
+            if (parallel)
+            {
+                std::vector<std::thread> threads;
+                for (int t = 0; t < threadCount; t++)
+                {
+                    threads.emplace_back([&, t]()
+                    {
+                        for (int i = t; i < count; i += threadCount)
+                        {
+                            if (!done[i]) programs[i]->RunIsolated(&robots[i], timer);
+                        }
+                    });
+                }
+                for (std::thread& thread : threads) thread.join();
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                if (done[i]) continue;
+                done[i] = programs[i]->Run(&robots[i], timer);
+                if (done[i])
+                {
+                    EXPECT_EQ(programs[i]->GetError(), CBotNoErr);
+                    remaining--;
+                }
+            }
+
+            // the arrays created on the threads are numbered as in a serial run
+            for (int i = 0; i < count; i++)
+            {
+                std::stringstream state;
+                ASSERT_TRUE(programs[i]->SaveState(state));
+                states[parallel].push_back(state.str());
+            }
+        }
+
+        if (parallel)
+        {
+            EXPECT_GT(g_isolatedCalls, 0);
+        }
+        for (int i = 0; i < count; i++) programs[i].reset();
+        classes.reset();
+        CBotProgram::Free();
+    }
+
+    ASSERT_EQ(events[0].size(), 2u * 15 * count);
+    EXPECT_EQ(events[0], events[1]);
+    EXPECT_TRUE(states[0] == states[1]);
+}
+
+static int g_pauseCalls = 0;
+static bool g_pauseDone = false;
+
+static CBotTypResult cPause(CBotVar* &var, void* user)
+{
+    if (var != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+static bool rPause(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    g_pauseCalls++;
+    return g_pauseDone;
+}
+
+TEST_F(CBotUT, ProgramSnapshots)
+{
+    CBotProgram::AddFunction("pause", rPause, cPause);
+    g_pauseCalls = 0;
+    g_pauseDone = false;
+    std::vector<std::string> tests;
+
+    auto writer = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(writer->Compile(
+        "public class Counter\n"
+        "{\n"
+        "    static int total = 0;\n"
+        "}\n"
+        "extern void Writer()\n"
+        "{\n"
+        "    Counter c = new Counter();\n"
+        "    c.total++;\n"
+        "}\n", tests)) << writer->GetError();
+
+    const std::string code =
+        "extern void Paused()\n"
+        "{\n"
+        "    string s = \"abc\";\n"
+        "    float f[] = {1.5, 2.5};\n"
+        "    pause();\n"
+        "    s += f[1];\n"
+        "    ASSERT(s == \"abc2.5\");\n"
+        "}\n"
+        "extern void Reader()\n"
+        "{\n"
+        "    Counter c = new Counter();\n"
+        "    int total = c.total;\n"
+        "    pause();\n"
+        "}\n";
+    auto paused = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(paused->Compile(code, tests)) << paused->GetError();
+    auto reader = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(reader->Compile(code, tests)) << reader->GetError();
+
+    paused->Start("Paused");
+    while (g_pauseCalls == 0) ASSERT_FALSE(paused->Run(nullptr, 10)) << paused->GetError();
+    EXPECT_TRUE(paused->IsStateChanged());
+
+    // the snapshot holds the data of SaveState() after its header
+    std::string snapshot = paused->SaveSnapshot();
+    std::stringstream sstr;
+    ASSERT_TRUE(paused->SaveState(sstr));
+    std::string state = sstr.str();
+    ASSERT_GT(snapshot.size(), state.size());
+    EXPECT_EQ(snapshot.substr(snapshot.size() - state.size()), state);
+
+    // waiting in an external function doesn't change the state
+    EXPECT_FALSE(paused->IsStateChanged());
+    ASSERT_FALSE(paused->Run(nullptr, 10));
+    EXPECT_EQ(g_pauseCalls, 2);
+    EXPECT_FALSE(paused->IsStateChanged());
+    EXPECT_EQ(paused->SaveSnapshot(), snapshot);
+
+    // a program reading static fields changes with the programs accessing them
+    reader->Start("Reader");
+    while (g_pauseCalls == 2) ASSERT_FALSE(reader->Run(nullptr, 10)) << reader->GetError();
+    reader->SaveSnapshot();
+    EXPECT_FALSE(reader->IsStateChanged());
+    writer->Start("Writer");
+    while (!writer->Run(nullptr, 10));
+    ASSERT_EQ(writer->GetError(), CBotNoErr);
+    EXPECT_TRUE(reader->IsStateChanged());
+    EXPECT_FALSE(paused->IsStateChanged());
+
+    // the snapshot restores the state, and is checked before
+    auto restored = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(restored->Compile(code, tests));
+    EXPECT_FALSE(restored->RestoreSnapshot(snapshot.substr(0, snapshot.size() - 1)));
+    EXPECT_FALSE(restored->RestoreSnapshot(state));
+    std::string other = snapshot;
+    other[4]++;
+    EXPECT_FALSE(restored->RestoreSnapshot(other));
+    ASSERT_TRUE(restored->RestoreSnapshot(snapshot));
+    EXPECT_TRUE(restored->IsStateChanged());
+    EXPECT_EQ(restored->SaveSnapshot(), snapshot);
+
+    g_pauseDone = true;
+    for (CBotProgram* program : { paused.get(), restored.get(), reader.get() })
+    {
+        while (!program->Run(nullptr, 10));
+        EXPECT_EQ(program->GetError(), CBotNoErr);
+    }
+}
+
+TEST_F(CBotUT, ByteCodeSuspendedCall)
+{
+    CBotProgram::AddFunction("pause", rPause, cPause);
+    g_pauseCalls = 0;
+    g_pauseDone = false;
+    const std::string code =
+        "int twice(int a) { return a * 2; }\n"
+        "extern void Paused()\n"
+        "{\n"
+        "    int total = 0;\n"
+        "    for (int i = 0; i < 3; i++)\n"
+        "    {\n"
+        "        int square = i * i;\n"
+        "        if (i == 1) pause();\n"
+        "        total += square + twice(i);\n"
+        "    }\n"
+        "    ASSERT(total == 11);\n"
+        "}\n";
+    std::vector<std::string> tests;
+
+    auto paused = std::unique_ptr<CBotProgram>(new CBotProgram());
+    paused->SetEngine(CBotEngine::BYTECODE);
+    ASSERT_TRUE(paused->Compile(code, tests)) << paused->GetError();
+    paused->Start("Paused");
+    while (g_pauseCalls == 0) ASSERT_FALSE(paused->Run(nullptr, 10)) << paused->GetError();
+
+    // waiting in the external function keeps the position in the code
+    ASSERT_FALSE(paused->Run(nullptr, 10));
+    EXPECT_EQ(g_pauseCalls, 2);
+    std::stringstream sstr;
+    ASSERT_TRUE(paused->SaveState(sstr));
+    std::string state = sstr.str();
+
+    // the layout of the stack depends on the engine
+    auto tree = std::unique_ptr<CBotProgram>(new CBotProgram());
+    ASSERT_TRUE(tree->Compile(code, tests)) << tree->GetError();
+    std::stringstream treeState(state);
+    EXPECT_FALSE(tree->RestoreState(treeState));
+
+    auto restored = std::unique_ptr<CBotProgram>(new CBotProgram());
+    restored->SetEngine(CBotEngine::BYTECODE);
+    ASSERT_TRUE(restored->Compile(code, tests)) << restored->GetError();
+    std::stringstream restoredState(state);
+    ASSERT_TRUE(restored->RestoreState(restoredState));
+
+    g_pauseDone = true;
+    int slices = 0;
+    while (!restored->Run(nullptr, 10)) slices++;
+    EXPECT_EQ(restored->GetError(), CBotNoErr);
+    EXPECT_EQ(g_pauseCalls, 3);
+    EXPECT_GT(slices, 0);
+}
+
+static int g_destroyed = 0;
+
+static CBotTypResult cDestroyed(CBotVar* &var, void* user)
+{
+    if (var != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypVoid);
+}
+
+static bool rDestroyed(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    g_destroyed++;
+    return true;
+}
+
+TEST_F(CBotUT, ClassCycleCollection)
+{
+    CBotProgram::AddFunction("destroyed", rDestroyed, cDestroyed);
+    g_destroyed = 0;
+
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "public class Node\n"
+        "{\n"
+        "    static Node kept = null;\n"
+        "    Node next;\n"
+        "    Node parent;\n"
+        "    Node[] children;\n"
+        "    void ~Node() { destroyed(); }\n"
+        "}\n"
+        "extern void Cycles()\n"
+        "{\n"
+        "    for (int i = 0; i < 100; i++)\n"
+        "    {\n"
+        "        Node a = new Node();\n"
+        "        a.next = new Node();\n"
+        "        a.next.next = a;\n"
+        "        a.children[0] = new Node();\n"
+        "        a.children[0].parent = a;\n"
+        "    }\n"
+        "    Node k = new Node();\n"
+        "    k.next = new Node();\n"
+        "    k.next.next = k;\n"
+        "    k.kept = k.next;\n"
+        "}\n"
+        "extern void Release()\n"
+        "{\n"
+        "    Node n = new Node();\n"
+        "    n.kept = null;\n"
+        "}\n"
+        "extern void Chain()\n"
+        "{\n"
+        "    Node head = null;\n"
+        "    for (int i = 0; i < 100000; i++)\n"
+        "    {\n"
+        "        Node n = new Node();\n"
+        "        n.next = head;\n"
+        "        head = n;\n"
+        "    }\n"
+        "}\n", tests)) << program->GetError();
+
+    long instances = CBotProgram::GetMemoryUsage().instances;
+    long collected = CBotProgram::GetMemoryUsage().collected;
+    program->Start("Cycles");
+    while (!program->Run(nullptr, 100000));
+    ASSERT_EQ(program->GetError(), CBotNoErr);
+    EXPECT_EQ(g_destroyed, 0);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().instances, instances + 100 * 4 + 2);
+    EXPECT_GT(CBotProgram::GetMemoryUsage().candidates, 0);
+
+    // the cycles are freed after their destructors, except the one a static field keeps
+    while (!CBotProgram::CollectCycles(1000));
+    EXPECT_EQ(g_destroyed, 100 * 3);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().instances, instances + 2);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().collected, collected + 100 * 4);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().candidates, 0);
+
+    // a long chain is released without exhausting the native stack
+    g_destroyed = 0;
+    program->Start("Chain");
+    while (!program->Run(nullptr, 1000000));
+    ASSERT_EQ(program->GetError(), CBotNoErr);
+    EXPECT_EQ(g_destroyed, 100000);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().instances, instances + 2);
+
+    // the cycle the static field kept is freed once released, before its class
+    program->Start("Release");
+    while (!program->Run(nullptr, 1000));
+    ASSERT_EQ(program->GetError(), CBotNoErr);
+    while (!CBotProgram::CollectCycles(1000));
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().instances, instances);
+}
+
+TEST_F(CBotUT, CycleCollectionResumes)
+{
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "public class Ring\n"
+        "{\n"
+        "    static Ring kept = null;\n"
+        "    Ring next;\n"
+        "    void Keep() { kept = this; }\n"
+        "    void Drop() { kept = null; }\n"
+        "    int Count()\n"
+        "    {\n"
+        "        int n = 1;\n"
+        "        Ring r = kept.next;\n"
+        "        while (r != kept)\n"
+        "        {\n"
+        "            n++;\n"
+        "            r = r.next;\n"
+        "        }\n"
+        "        return n;\n"
+        "    }\n"
+        "}\n"
+        "Ring MakeRing(int n)\n"
+        "{\n"
+        "    Ring first = new Ring();\n"
+        "    Ring last = first;\n"
+        "    for (int i = 1; i < n; i++)\n"
+        "    {\n"
+        "        last.next = new Ring();\n"
+        "        last = last.next;\n"
+        "    }\n"
+        "    last.next = first;\n"
+        "    return first;\n"
+        "}\n"
+        "extern void DroppedRing() { MakeRing(2000); }\n"
+        "extern void KeptRing() { Ring r = MakeRing(2000); r.Keep(); }\n"
+        "extern void CheckRing() { Ring r = new Ring(); ASSERT(r.Count() == 2000); }\n"
+        "extern void DropRing() { Ring r = new Ring(); r.Drop(); }\n", tests)) << program->GetError();
+    auto run = [&program](const std::string& name)
+    {
+        program->Start(name);
+        while (!program->Run(nullptr, 100000));
+        EXPECT_EQ(program->GetError(), CBotNoErr) << name;
+    };
+
+    // the examination of a large cycle goes on over several calls
+    long instances = CBotProgram::GetMemoryUsage().instances;
+    long collected = CBotProgram::GetMemoryUsage().collected;
+    run("DroppedRing");
+    int calls = 1;
+    while (!CBotProgram::CollectCycles(0)) calls++;
+    EXPECT_GT(calls, 1);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().collected, collected + 2000);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().instances, instances);
+
+    // a ring used between two calls is examined again, and kept
+    run("KeptRing");
+    EXPECT_FALSE(CBotProgram::CollectCycles(0));
+    run("CheckRing");
+    while (!CBotProgram::CollectCycles(0));
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().collected, collected + 2000);
+    run("CheckRing");
+
+    // a ring dropped between two calls is freed
+    EXPECT_FALSE(CBotProgram::CollectCycles(0));
+    run("DropRing");
+    while (!CBotProgram::CollectCycles(0));
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().collected, collected + 4000);
+    EXPECT_EQ(CBotProgram::GetMemoryUsage().instances, instances);
+}
+
+TEST_F(CBotUT, MemoryLimit)
+{
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "extern void Grow()\n"
+        "{\n"
+        "    int[] a;\n"
+        "    for (int i = 0; i < 10000; i++) a[i] = i;\n"
+        "}\n"
+        "extern void Recover()\n"
+        "{\n"
+        "    int[] a;\n"
+        "    string s = \"0123456789abcdef\";\n"
+        "    int caught = 0;\n"
+        "    try { for (int i = 0; i < 10000; i++) a[i] = i; }\n"
+        "    catch (CBotErrMemory) { a = null; caught++; }\n"
+        "    try { while (true) s += s; }\n"
+        "    catch (CBotErrMemory) { s = \"\"; caught++; }\n"
+        "    int[] b;\n"
+        "    for (int i = 0; i < 100; i++) b[i] = i;\n"
+        "    if (caught != 2) throw(1);\n"
+        "}\n", tests)) << program->GetError();
+
+    // without a limit, the memory is only counted
+    program->Start("Grow");
+    while (!program->Run(nullptr, 100000));
+    ASSERT_EQ(program->GetError(), CBotNoErr);
+    EXPECT_GT(program->GetMemoryPeak(), 10000 * static_cast<long>(sizeof(CBotVar)));
+    EXPECT_LT(program->GetMemoryUsed(), program->GetMemoryPeak());
+
+    program->SetMemoryLimit(100000);
+    EXPECT_EQ(program->GetMemoryLimit(), 100000);
+    program->Start("Grow");
+    while (!program->Run(nullptr, 100000));
+    EXPECT_EQ(program->GetError(), CBotErrMemory);
+
+    // the error can be caught, the program goes on once the memory is freed
+    program->Start("Recover");
+    while (!program->Run(nullptr, 100000));
+    EXPECT_EQ(program->GetError(), CBotNoErr);
+    EXPECT_LT(program->GetMemoryUsed(), 100000);
+}
+
+TEST_F(CBotUT, DestructorLimits)
+{
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    std::vector<std::string> tests;
+    ASSERT_TRUE(program->Compile(
+        "public class Runaway\n"
+        "{\n"
+        "    void ~Runaway() { while (true) {} }\n"
+        "}\n"
+        "extern void Local()\n"
+        "{\n"
+        "    Runaway r = new Runaway();\n"
+        "}\n"
+        "extern void Kept()\n"
+        "{\n"
+        "    Runaway r = new Runaway();\n"
+        "    while (true) {}\n"
+        "}\n", tests)) << program->GetError();
+
+    // a destructor running at the end of a function is stopped by the ticks
+    CBotProgram::SetDestructorLimits(100000);
+    program->Start("Local");
+    while (!program->Run(nullptr, 1000));
+    EXPECT_EQ(program->GetError(), CBotNoErr);
+    EXPECT_EQ(CBotProgram::GetDestructorUsage().stopped, 1);
+    EXPECT_GE(CBotProgram::GetDestructorUsage().ticks, 100000);
+
+    // so is one running when the program stops, once the limits are spent
+    program->Start("Kept");
+    EXPECT_FALSE(program->Run(nullptr, 1000));
+    program->Stop();
+    EXPECT_EQ(CBotProgram::GetDestructorUsage().stopped, 2);
+
+    // and by the deadline
+    long ticks = CBotProgram::GetDestructorUsage().ticks;
+    CBotProgram::SetDestructorLimits(0, std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+    program->Start("Kept");
+    EXPECT_FALSE(program->Run(nullptr, 1000));
+    program->Stop();
+    EXPECT_EQ(CBotProgram::GetDestructorUsage().stopped, 3);
+    EXPECT_GT(CBotProgram::GetDestructorUsage().ticks, ticks);
+
+    CBotProgram::SetDestructorLimits(0);
+}
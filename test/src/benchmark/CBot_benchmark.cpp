@@ -0,0 +1,737 @@
+/*
+ * This file is part of the Colobot: Gold Edition source code
+ * Copyright (C) 2001-2023, Daniel Roux, EPSITEC SA & TerranovaTeam
+ * http://epsitec.ch; http://colobot.info; http://github.com/colobot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://gnu.org/licenses
+ */
+
+/**
+ * \file benchmark/CBot_benchmark.cpp
+ * \brief Benchmark of the CBot interpreter
+ *
+ * Runs a corpus of CBot programs and prints, for each of them, a line of JSON with
+ * the executed instructions (timer ticks) per second and the memory allocations per run:
+ * "heap_allocations" counts the calls to operator new (the slabs of the variables included),
+ * "variables" the variables, most of them taken from the slabs, "stack_chunks" the chunks of stack levels,
+ * most of them taken from the recycled ones, and "system_stack_chunks" those allocated from the system.
+ * The lines "properties" and "properties_eager" measure the reading of the fields of an object of the host,
+ * updated one field at a time or all at once, the line "restore_instances" measures the restore of a program
+ * holding many class instances, and the last line ("tokens") measures the conversion of a large source into tokens.
+ * Compare the output of two builds to evaluate a change of the interpreter.
+ *
+ * Usage: CBot-Benchmark [--bytecode] [--no-optimize] [--runs N] [--filter TEXT]
+ */
+
+#include "CBot/CBot.h"
+#include "CBot/CBotStack.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace CBot;
+
+namespace
+{
+
+//! Number of memory allocations since the start
+std::atomic<long> g_allocations{0};
+
+//! Allocation counters of the interpreter, see Allocations::Now()
+struct Allocations
+{
+    long heap = 0;
+    long variables = 0;
+    long stackChunks = 0;
+    long systemStackChunks = 0;
+
+    //! Counters of the calling thread since its start
+    static Allocations Now()
+    {
+        Allocations allocations;
+        allocations.heap = g_allocations;
+        allocations.variables = CBotVar::GetAllocationStats().created;
+        allocations.stackChunks = CBotStack::GetChunkStats().taken;
+        allocations.systemStackChunks = CBotStack::GetChunkStats().allocated;
+        return allocations;
+    }
+
+    Allocations operator-(const Allocations& start) const
+    {
+        Allocations allocations;
+        allocations.heap = heap - start.heap;
+        allocations.variables = variables - start.variables;
+        allocations.stackChunks = stackChunks - start.stackChunks;
+        allocations.systemStackChunks = systemStackChunks - start.systemStackChunks;
+        return allocations;
+    }
+
+    Allocations& operator+=(const Allocations& other)
+    {
+        heap += other.heap;
+        variables += other.variables;
+        stackChunks += other.stackChunks;
+        systemStackChunks += other.systemStackChunks;
+        return *this;
+    }
+};
+
+//! Fields of the allocations per run, to append to a line of JSON
+std::string AllocationFields(const Allocations& allocations, int runs)
+{
+    return ", \"heap_allocations_per_run\": " + std::to_string(allocations.heap / runs) +
+           ", \"variables_per_run\": " + std::to_string(allocations.variables / runs) +
+           ", \"stack_chunks_per_run\": " + std::to_string(allocations.stackChunks / runs) +
+           ", \"system_stack_chunks_per_run\": " + std::to_string(allocations.systemStackChunks / runs);
+}
+
+//! Prints the line of JSON of a benchmark running a program
+void PrintResult(const std::string& name, CBotEngine engine, bool optimize, int runs,
+                 long ticks, double seconds, const Allocations& allocations)
+{
+    std::cout << "{\"name\": \"" << name << "\""
+              << ", \"engine\": \"" << (engine == CBotEngine::BYTECODE ? "bytecode" : "tree") << "\""
+              << ", \"optimize\": " << (optimize ? "true" : "false")
+              << ", \"runs\": " << runs
+              << ", \"ticks_per_run\": " << ticks / runs
+              << ", \"microseconds_per_run\": " << static_cast<long>(seconds * 1e6 / runs)
+              << ", \"ticks_per_second\": " << static_cast<long>(ticks / seconds)
+              << AllocationFields(allocations, runs)
+              << "}" << std::endl;
+}
+
+struct Benchmark
+{
+    std::string name;
+    std::string code;
+    //! Saves and restores the state of the program at each interruption
+    bool saveState = false;
+};
+
+const std::vector<Benchmark> BENCHMARKS = {
+    {
+        "arithmetic",
+        "extern void Arithmetic()\n"
+        "{\n"
+        "    int a = 0;\n"
+        "    float f = 0;\n"
+        "    for (int i = 0; i < 20000; i++)\n"
+        "    {\n"
+        "        a = (a * 31 + i) % 65536;\n"
+        "        f = f * 0.5 + i / 3.0;\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "strings",
+        "extern void Strings()\n"
+        "{\n"
+        "    string s = \"\";\n"
+        "    for (int i = 0; i < 2000; i++)\n"
+        "    {\n"
+        "        s += \"x\" + i;\n"
+        "        if (strlen(s) > 1000) s = strmid(s, 500, 500);\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "messages",
+        "extern void Messages()\n"
+        "{\n"
+        "    string log = \"\";\n"
+        "    for (int i = 0; i < 500; i++)\n"
+        "    {\n"
+        "        float x = i * 1.5;\n"
+        "        string m = \"Robot \" + i + \" at (\" + x + \", \" + (x * 2) + \") energy \" + i / 500.0;\n"
+        "        if (m != \"\") log += m + \"\\n\";\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "arrays",
+        "extern void Arrays()\n"
+        "{\n"
+        "    int a[];\n"
+        "    for (int i = 0; i < 300; i++) a[i] = (i * 7919) % 1000;\n"
+        "    for (int i = 1; i < 300; i++)\n"
+        "    {\n"
+        "        int v = a[i];\n"
+        "        int j = i - 1;\n"
+        "        while (j >= 0 && a[j] > v)\n"
+        "        {\n"
+        "            a[j + 1] = a[j];\n"
+        "            j--;\n"
+        "        }\n"
+        "        a[j + 1] = v;\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "array_functions",
+        "extern void ArrayFunctions()\n"
+        "{\n"
+        "    int a[];\n"
+        "    for (int i = 0; i < 300; i++) a[i] = (i * 7919) % 1000;\n"
+        "    arrsort(a);\n"
+        "    int total = arrsum(a) + arrfind(a, arrmax(a));\n"
+        "}\n"
+    },
+    {
+        "classes",
+        "public class Node\n"
+        "{\n"
+        "    int value;\n"
+        "    Node next;\n"
+        "}\n"
+        "extern void Classes()\n"
+        "{\n"
+        "    Node list = null;\n"
+        "    for (int i = 0; i < 2000; i++)\n"
+        "    {\n"
+        "        Node node = new Node();\n"
+        "        node.value = i;\n"
+        "        node.next = list;\n"
+        "        list = node;\n"
+        "        if (i % 100 == 99) list = null;\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "field_access",
+        "public class Wide\n"
+        "{\n" +
+        []()
+        {
+            std::string fields;
+            for (int i = 0; i < 30; i++) fields += "    int f" + std::to_string(i) + " = 0;\n";
+            return fields;
+        }() +
+        "}\n"
+        "public class Wider extends Wide\n"
+        "{\n"
+        "    float x = 0; float y = 1; float z = 2;\n"
+        "}\n"
+        "extern void FieldAccess()\n"
+        "{\n"
+        "    Wider w();\n"
+        "    for (int i = 0; i < 10000; i++)\n"
+        "    {\n"
+        "        w.f29 = w.f29 + 1;\n"
+        "        w.x = w.y + w.z;\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "new_with_initializers",
+        "public class Initialized\n"
+        "{\n"
+        "    int a = 1; int b = 2; float c = 3.5; string d = \"d\";\n"
+        "    int e[4];\n"
+        "}\n"
+        "extern void NewWithInitializers()\n"
+        "{\n"
+        "    for (int i = 0; i < 2000; i++)\n"
+        "    {\n"
+        "        Initialized x = new Initialized();\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "recursion",
+        "int Fib(int n)\n"
+        "{\n"
+        "    if (n < 2) return n;\n"
+        "    return Fib(n - 1) + Fib(n - 2);\n"
+        "}\n"
+        "extern void Recursion()\n"
+        "{\n"
+        "    Fib(16);\n"
+        "}\n"
+    },
+    {
+        "function_calls",
+        []()
+        {
+            std::string functions;
+            for (int i = 0; i < 50; i++) functions += "int f" + std::to_string(i) + "() { return " + std::to_string(i) + "; }\n";
+            return functions;
+        }() +
+        "int fib(int n)\n"
+        "{\n"
+        "    if (n < 2) return n;\n"
+        "    return fib(n - 1) + fib(n - 2);\n"
+        "}\n"
+        "extern void FunctionCalls()\n"
+        "{\n"
+        "    fib(18);\n"
+        "}\n"
+    },
+    {
+        "method_calls",
+        "public class Animal\n"
+        "{\n" +
+        []()
+        {
+            std::string methods;
+            for (int i = 0; i < 20; i++) methods += "    int m" + std::to_string(i) + "() { return " + std::to_string(i) + "; }\n";
+            return methods;
+        }() +
+        "    int legs() { return 0; }\n"
+        "    int total(int n) { return n * legs(); }\n"
+        "}\n"
+        "public class Dog extends Animal\n"
+        "{\n"
+        "    int legs() { return 4; }\n"
+        "}\n"
+        "public class Bird extends Animal\n"
+        "{\n"
+        "    int legs() { return 2; }\n"
+        "}\n"
+        "public class Puppy extends Dog\n"
+        "{\n"
+        "}\n"
+        "extern void MethodCalls()\n"
+        "{\n"
+        "    Animal animals[] = { new Dog(), new Bird(), new Puppy(), new Animal() };\n"
+        "    int sum = 0;\n"
+        "    for (int i = 0; i < 10000; i++)\n"
+        "    {\n"
+        "        Animal a = animals[i % 4];\n"
+        "        sum += a.legs() + a.total(1) + a.m19();\n"
+        "    }\n"
+        "}\n"
+    },
+    {
+        "external_calls",
+        "extern void ExternalCalls()\n"
+        "{\n"
+        "    float sum = 0;\n"
+        "    for (int i = 0; i < 5000; i++) sum += count() + abs(sin(i));\n"
+        "}\n"
+    },
+    {
+        "save_restore",
+        "int Deep(int n)\n"
+        "{\n"
+        "    if (n == 0)\n"
+        "    {\n"
+        "        int sum = 0;\n"
+        "        for (int i = 0; i < 200; i++) sum += i;\n"
+        "        return sum;\n"
+        "    }\n"
+        "    return Deep(n - 1) + 1;\n"
+        "}\n"
+        "extern void SaveRestore()\n"
+        "{\n"
+        "    Deep(40);\n"
+        "}\n",
+        true
+    },
+};
+
+CBotTypResult cCount(CBotVar* &var, void* user)
+{
+    if (var != nullptr) return CBotTypResult(CBotErrOverParam);
+    return CBotTypResult(CBotTypInt);
+}
+
+//! Number of calls to count()
+int g_count = 0;
+
+bool rCount(CBotVar* var, CBotVar* result, int& exception, void* user)
+{
+    result->SetValInt(++g_count);
+    return true;
+}
+
+//! Runs the program once, returns false on error
+bool Run(CBotProgram* program, const std::string& entry, bool saveState, long& ticks)
+{
+    if (!program->Start(entry)) return false;
+
+    if (saveState)
+    {
+        while (!program->Run(nullptr, 10))
+        {
+            ticks += program->GetTicks();
+            std::stringstream state;
+            if (!program->SaveState(state)) return false;
+            if (!program->RestoreState(state)) return false;
+        }
+    }
+    else
+    {
+        while (!program->Run(nullptr, 100000)) ticks += program->GetTicks();
+    }
+    ticks += program->GetTicks();
+
+    return program->GetError() == CBotNoErr;
+}
+
+//! Fields of the class "object" of Colobot
+const char* const OBJECT_FIELDS[] = {
+    "category", "position", "orientation", "pitch", "roll", "energyLevel", "shieldLevel", "temperature",
+    "altitude", "lifeTime", "energyCell", "load", "id", "team", "dead", "velocity",
+};
+
+//! Sets a field of the host object as the update function of Colobot does
+void UpdateObjectField(CBotVar* field, int slot)
+{
+    static float time = 0.0f;
+    time += 0.001f;
+    if (field->GetType() == CBotTypClass)
+    {
+        float value = time;
+        for (CBotVar* coordinate = field->GetItemList(); coordinate != nullptr; coordinate = coordinate->GetNext())
+        {
+            coordinate->SetValFloat(value);
+            value *= 0.5f;
+        }
+    }
+    else if (field->GetType() == CBotTypPointer)
+    {
+        field->SetPointer(nullptr);
+    }
+    else
+    {
+        field->SetValFloat(slot + time);
+    }
+}
+
+void uObject(CBotVar* thisVar, void* user)
+{
+    int slot = 0;
+    for (CBotVar* field = thisVar->GetItemList(); field != nullptr; field = field->GetNext())
+    {
+        UpdateObjectField(field, slot++);
+    }
+}
+
+void uObjectField(CBotVar* thisVar, CBotVar* field, int slot, void* user)
+{
+    UpdateObjectField(field, slot);
+}
+
+//! Reads a few fields of a host object per call to an external function, as robot programs do
+bool BenchmarkProperties(int runs, CBotEngine engine, bool optimize, bool byField)
+{
+    CBotClass* point = CBotClass::Find("point");
+    if (point == nullptr)
+    {
+        point = CBotClass::Create("point", nullptr, true);
+        point->AddItem("x", CBotTypFloat);
+        point->AddItem("y", CBotTypFloat);
+        point->AddItem("z", CBotTypFloat);
+
+        CBotClass* object = CBotClass::Create("object", nullptr);
+        for (const char* name : OBJECT_FIELDS)
+        {
+            std::string field = name;
+            CBotTypResult type = CBotTypResult(CBotTypFloat);
+            if (field == "position" || field == "velocity") type = CBotTypResult(CBotTypClass, "point");
+            if (field == "energyCell" || field == "load") type = CBotTypResult(CBotTypPointer, "object");
+            object->AddItem(field, type, CBotVar::ProtectionLevel::ReadOnly);
+        }
+        object->SetUpdateFunc(uObject);
+    }
+    CBotClass::Find("object")->SetFieldUpdateFunc(byField ? uObjectField : nullptr);
+
+    int host = 0;
+    CBotVar* thisVar = CBotVar::Create("", CBotTypResult(CBotTypClass, "object"));
+    thisVar->SetUserPtr(&host);
+
+    bool ok = true;
+    {
+        auto program = std::unique_ptr<CBotProgram>(new CBotProgram(thisVar));
+        program->SetEngine(engine);
+        program->SetOptimize(optimize);
+        std::vector<std::string> entries;
+        ok = program->Compile(
+            "extern void object::Patrol()\n"
+            "{\n"
+            "    float distance = 0;\n"
+            "    for (int i = 0; i < 2000; i++)\n"
+            "    {\n"
+            "        if (energyLevel < 0.5) break;\n"
+            "        distance += position.x - this.position.y;\n"
+            "        count();\n"
+            "    }\n"
+            "}\n", entries) && !entries.empty();
+
+        long ticks = 0;
+        if (ok) Run(program.get(), entries[0], false, ticks);    // warm up
+
+        ticks = 0;
+        Allocations allocations = Allocations::Now();
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; ok && run < runs; run++)
+        {
+            ok = Run(program.get(), entries[0], false, ticks);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (ok)
+        {
+            PrintResult(byField ? "properties" : "properties_eager", engine, optimize, runs,
+                        ticks, seconds, Allocations::Now() - allocations);
+        }
+    }
+    delete thisVar;
+    return ok;
+}
+
+//! Restores a program holding many instances, each one found by its identifier for the pointers to it
+bool BenchmarkRestoreInstances(int runs, CBotEngine engine, bool optimize)
+{
+    const int INSTANCES = 20000;
+    auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+    program->SetEngine(engine);
+    program->SetOptimize(optimize);
+    std::vector<std::string> entries;
+    if (!program->Compile(
+        "public class Item\n"
+        "{\n"
+        "    int value;\n"
+        "}\n"
+        "extern void ManyInstances()\n"
+        "{\n"
+        "    Item items[][], others[][];\n"
+        "    for (int i = 0; i < " + std::to_string(INSTANCES) + "; i++)\n"
+        "    {\n"
+        "        items[i / 1000][i % 1000] = new Item();\n"
+        "        items[i / 1000][i % 1000].value = i;\n"
+        "        others[i / 1000][i % 1000] = items[i / 1000][i % 1000];\n"
+        "    }\n"
+        "    count();\n"
+        "    while (true) {}\n"
+        "}\n", entries) || entries.empty()) return false;
+
+    // runs until all the instances are created
+    int count = g_count;
+    if (!program->Start(entries[0])) return false;
+    while (g_count == count)
+    {
+        if (program->Run(nullptr, 10000)) return false;
+    }
+    std::string state;
+    {
+        std::stringstream stream;
+        if (!program->SaveState(stream)) return false;
+        state = stream.str();
+    }
+
+    double seconds = 0;
+    Allocations allocations;
+    for (int run = 0; run < runs; run++)
+    {
+        program->Stop();                            // the instances of the last run aren't freed in the time
+        std::stringstream stream(state);
+        Allocations start = Allocations::Now();
+        auto time = std::chrono::steady_clock::now();
+        if (!program->RestoreState(stream)) return false;
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - time).count();
+        allocations += Allocations::Now() - start;
+    }
+
+    std::cout << "{\"name\": \"restore_instances\""
+              << ", \"engine\": \"" << (engine == CBotEngine::BYTECODE ? "bytecode" : "tree") << "\""
+              << ", \"optimize\": " << (optimize ? "true" : "false")
+              << ", \"runs\": " << runs
+              << ", \"instances\": " << INSTANCES
+              << ", \"bytes_per_run\": " << state.size()
+              << ", \"microseconds_per_run\": " << static_cast<long>(seconds * 1e6 / runs)
+              << AllocationFields(allocations, runs)
+              << "}" << std::endl;
+    return true;
+}
+
+//! Converts a large source into tokens, as Compile() and the colorization of the editor do
+bool BenchmarkTokens(int runs)
+{
+    for (int i = 0; i < 300; i++)                   // as many constants as Colobot defines
+    {
+        CBotProgram::DefineNum("BenchmarkConstant" + std::to_string(i), i);
+    }
+
+    std::string source;
+    for (int i = 0; source.size() < 256 * 1024; i++)
+    {
+        for (const Benchmark& benchmark : BENCHMARKS) source += benchmark.code;
+        source += "// constants\nint c" + std::to_string(i) + " = BenchmarkConstant" + std::to_string(i % 300) +
+                  " * 0x1F + 2.5e-3; /* " + std::to_string(i) + " */\n";
+    }
+
+    long tokens = 0;
+    Allocations allocations = Allocations::Now();
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; run++)
+    {
+        auto first = CBotToken::CompileTokens(source);
+        if (first == nullptr) return false;
+        for (CBotToken* token = first.get(); token != nullptr; token = token->GetNext()) tokens++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    allocations = Allocations::Now() - allocations;
+
+    std::cout << "{\"name\": \"tokens\""
+              << ", \"runs\": " << runs
+              << ", \"bytes_per_run\": " << source.size()
+              << ", \"tokens_per_run\": " << tokens / runs
+              << ", \"microseconds_per_run\": " << static_cast<long>(seconds * 1e6 / runs)
+              << ", \"megabytes_per_second\": " << static_cast<long>(source.size() * runs / seconds / 1e6)
+              << AllocationFields(allocations, runs)
+              << "}" << std::endl;
+    return true;
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    g_allocations++;
+    void* p = std::malloc(size > 0 ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    g_allocations++;
+    std::size_t alignment = static_cast<std::size_t>(align);
+    void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    CBotEngine engine = CBotEngine::TREE;
+    bool optimize = true;
+    int runs = 20;
+    std::string filter = "";
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--bytecode")
+            engine = CBotEngine::BYTECODE;
+        else if (arg == "--no-optimize")
+            optimize = false;
+        else if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--bytecode] [--no-optimize] [--runs N] [--filter TEXT]" << std::endl;
+            return 1;
+        }
+    }
+
+    CBotProgram::Init();
+    CBotProgram::AddFunction("count", rCount, cCount);
+    for (int i = 0; i < 70; i++)                    // as many functions as Colobot registers
+    {
+        CBotProgram::AddFunction("robotFunction" + std::to_string(i), rCount, cCount);
+    }
+
+    bool errors = false;
+    for (const Benchmark& benchmark : BENCHMARKS)
+    {
+        if (benchmark.name.find(filter) == std::string::npos) continue;
+
+        auto program = std::unique_ptr<CBotProgram>(new CBotProgram());
+        program->SetEngine(engine);
+        program->SetOptimize(optimize);
+        std::vector<std::string> entries;
+        if (!program->Compile(benchmark.code, entries) || entries.empty())
+        {
+            std::cerr << benchmark.name << ": compile error " << program->GetError() << std::endl;
+            errors = true;
+            continue;
+        }
+
+        long ticks = 0;
+        Run(program.get(), entries[0], benchmark.saveState, ticks);    // warm up
+
+        ticks = 0;
+        Allocations allocations = Allocations::Now();
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; run++)
+        {
+            if (!Run(program.get(), entries[0], benchmark.saveState, ticks))
+            {
+                std::cerr << benchmark.name << ": runtime error " << program->GetError() << std::endl;
+                errors = true;
+                break;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        PrintResult(benchmark.name, engine, optimize, runs, ticks, seconds, Allocations::Now() - allocations);
+    }
+
+    for (bool byField : { true, false })
+    {
+        std::string name = byField ? "properties" : "properties_eager";
+        if (name.find(filter) != std::string::npos && !BenchmarkProperties(runs, engine, optimize, byField))
+        {
+            std::cerr << name << ": error" << std::endl;
+            errors = true;
+        }
+    }
+
+    if (std::string("restore_instances").find(filter) != std::string::npos &&
+        !BenchmarkRestoreInstances(runs, engine, optimize))
+    {
+        std::cerr << "restore_instances: error" << std::endl;
+        errors = true;
+    }
+
+    if (std::string("tokens").find(filter) != std::string::npos && !BenchmarkTokens(runs))
+    {
+        std::cerr << "tokens: no token" << std::endl;
+        errors = true;
+    }
+
+    CBotProgram::Free();
+    return errors ? 2 : 0;
+}
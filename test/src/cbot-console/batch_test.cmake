@@ -0,0 +1,41 @@
+# Runs the batch mode of CBot-Console on the programs of test/data/cbot-console and checks their records
+# Variables: CONSOLE (CBot-Console executable), DATA_DIR (test/data/cbot-console), OUTPUT (file of the records)
+
+execute_process(
+    COMMAND ${CONSOLE} --batch ${DATA_DIR}/manifest.txt --jobs 1 --max-ticks 1000000 --max-memory 1 --output ${OUTPUT}
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "CBot-Console exited with ${result}")
+endif()
+
+file(STRINGS ${OUTPUT} records ENCODING UTF-8)
+list(LENGTH records count)
+if(NOT count EQUAL 2)
+    message(FATAL_ERROR "Expected 2 records, got ${count}:\n${records}")
+endif()
+
+# Checks that the record of a program matches all the given patterns
+function(check_record file)
+    foreach(record IN LISTS records)
+        if(record MATCHES "\"file\": \"[^\"]*${file}\"")
+            foreach(pattern IN LISTS ARGN)
+                if(NOT record MATCHES "${pattern}")
+                    message(FATAL_ERROR "Record of ${file} doesn't match ${pattern}:\n${record}")
+                endif()
+            endforeach()
+            return()
+        endif()
+    endforeach()
+    message(FATAL_ERROR "No record of ${file}")
+endfunction()
+
+check_record(runaway.txt
+    "\"status\": \"instruction_limit\""
+    "\"functions\": \\[{\"name\": \"Runaway\", \"status\": \"instruction_limit\", \"ticks\": [0-9]+}\\]"
+    "\"output\": \"café \\\\ufffd\\\\ufffd end\\\\n\""
+)
+check_record(memory.txt
+    "\"status\": \"memory_limit\""
+    "\"functions\": \\[{\"name\": \"OverMemory\", \"status\": \"memory_limit\", \"ticks\": [0-9]+}\\]"
+)
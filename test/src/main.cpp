@@ -24,6 +24,8 @@
 #include <clocale>
 
 extern bool g_cbotTestSaveState;
+extern bool g_cbotTestByteCode;
+extern bool g_cbotTestNoOptimize;
 
 int main(int argc, char* argv[])
 {
@@ -39,6 +41,10 @@ int main(int argc, char* argv[])
         std::string arg(argv[i]);
         if (arg == "--CBotUT_TestSaveState")
             g_cbotTestSaveState = true;
+        if (arg == "--CBotUT_ByteCode")
+            g_cbotTestByteCode = true;
+        if (arg == "--CBotUT_NoOptimize")
+            g_cbotTestNoOptimize = true;
     }
 
     return RUN_ALL_TESTS();
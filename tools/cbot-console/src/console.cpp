@@ -17,18 +17,64 @@
  * along with this program. If not, see http://gnu.org/licenses
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
 
 #include "common/restext.h"
+#include "common/stringutils.h"
 
 #include "CBot/CBot.h"
+#include "CBot/CBotMemoryAccount.h"
 
 using namespace CBot;
 
 namespace
 {
 
+//! Number of timer ticks run between two checks of the limits in batch mode, at most
+const int BATCH_SLICE = 10000;
+//! Number of timer ticks of the first slice, and at least of the next ones, see RunBatchProgram()
+const int BATCH_MIN_SLICE = 100;
+
+//! Text of message() kept for each program of the batch mode, in bytes
+const std::size_t BATCH_MAX_OUTPUT = 1024 * 1024;
+
+//! Microseconds spent looking for cycles of class instances between two slices, see CBotProgram::CollectCycles()
+const int BATCH_COLLECT_BUDGET = 100;
+
+//! Limits of each program of the batch mode, 0 for no limit
+struct BatchLimits
+{
+    //! Timer ticks of all the extern functions of the program
+    long maxTicks = 0;
+    //! Wall-clock time, in milliseconds
+    long timeout = 0;
+    //! Memory used by the variables of the program, in bytes (see CBotProgram::SetMemoryLimit())
+    long maxMemory = 0;
+};
+
+//! Program of the batch mode, given to message() as the user pointer
+struct BatchJob
+{
+    //! Text written by message(), up to BATCH_MAX_OUTPUT
+    std::string output;
+    //! Some text was left out of output
+    bool truncated = false;
+};
+
 CBotTypResult cMessage(CBotVar* &var, void* user)
 {
     if ( var == nullptr )  return CBotTypResult(CBotErrLowParam);
@@ -44,15 +90,429 @@ bool rMessage(CBotVar* var, CBotVar* result, int& exception, void* user)
 {
     std::string message = var->GetValString();
 
-    std::cout << message << std::endl;
+    if (user != nullptr)
+    {
+        // the text is kept until the program ends, it is charged to its memory like its variables
+        BatchJob* job = static_cast<BatchJob*>(user);
+        if (job->output.size() + message.size() + 1 > BATCH_MAX_OUTPUT)
+        {
+            job->truncated = true;
+            return true;
+        }
+        job->output += message + "\n";
+        CBotMemoryAccount* account = CBotMemoryAccount::GetCurrent();
+        if (account != nullptr) account->Charge(message.size() + 1);
+    }
+    else
+    {
+        std::cout << message << std::endl;
+    }
+
+    return true;
+}
+
+void PrintUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [--profile FILE] [--profile-time FILE] < program.txt" << std::endl;
+    std::cerr << "       " << name << " --batch PATH [--jobs N] [--max-ticks N] [--timeout MS] [--max-memory MB] [--output FILE]" << std::endl;
+    std::cerr << "  --profile FILE       write the instructions executed by each call path to FILE" << std::endl;
+    std::cerr << "  --profile-time FILE  write the time spent in each call path (in microseconds) to FILE" << std::endl;
+    std::cerr << "Both files are collapsed stacks, as read by the flame graph tools" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  --batch PATH         run every program of the directory PATH, or listed in the file PATH (one per line)" << std::endl;
+    std::cerr << "  --jobs N             number of programs run at once, the number of cores by default" << std::endl;
+    std::cerr << "  --max-ticks N        stop a program after N instructions" << std::endl;
+    std::cerr << "  --timeout MS         stop a program after MS milliseconds" << std::endl;
+    std::cerr << "  --max-memory MB      stop a program whose variables and messages use more than MB megabytes" << std::endl;
+    std::cerr << "  --output FILE        write the results to FILE instead of the standard output" << std::endl;
+    std::cerr << "The batch mode writes a line of JSON with the result of each program, in the order they finish," << std::endl;
+    std::cerr << "with the first " << BATCH_MAX_OUTPUT / 1024 << " KB of its messages" << std::endl;
+}
+
+bool ParseNumber(const char* text, long& value)
+{
+    char* end = nullptr;
+    value = std::strtol(text, &end, 10);
+    return end != text && *end == '\0' && value >= 0;
+}
+
+std::string GetErrorString(CBotError error)
+{
+    std::string errorStr;
+    GetResource(RES_CBOT, error, errorStr);
+    return errorStr;
+}
+
+//! Writes a string as a JSON string literal, each byte not part of valid UTF-8 is replaced by U+FFFD
+std::string ToJson(const std::string& str)
+{
+    std::string result = "\"";
+    for (std::size_t i = 0; i < str.size(); )
+    {
+        char c = str[i];
+        int length = StrUtils::UTF8CharLength(std::string_view(str).substr(i));
+        if (length == 0)
+        {
+            result += "\\ufffd";
+            i++;
+            continue;
+        }
+        if (length > 1)
+        {
+            result.append(str, i, length);
+            i += length;
+            continue;
+        }
+        i++;
+
+        switch (c)
+        {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    result += escaped;
+                }
+                else
+                {
+                    result += c;
+                }
+        }
+    }
+    return result + "\"";
+}
+
+//! Writes the error of a program as JSON fields
+std::string ErrorToJson(CBotProgram* program)
+{
+    CBotError error;
+    int cursor1, cursor2;
+    program->GetError(error, cursor1, cursor2);
+
+    std::stringstream json;
+    json << "\"error\": " << error << ", \"message\": " << ToJson(GetErrorString(error))
+         << ", \"start\": " << cursor1 << ", \"end\": " << cursor2;
+    return json.str();
+}
+
+/**
+ * Compiles and runs a program of the batch in a context of its own
+ * \param file File of the program
+ * \param limits Limits of the program
+ * \param[out] status Result of the program: ok, read_error, compile_error, no_extern, runtime_error, instruction_limit, timeout or memory_limit
+ * \return Result of the program as a line of JSON
+ */
+std::string RunBatchProgram(const std::string& file, const BatchLimits& limits, std::string& status)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    auto elapsed = [&]()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    };
+
+    std::stringstream json;
+    json << "{\"file\": " << ToJson(file);
+
+    std::ifstream input(file, std::ios::binary);
+    if (!input.is_open())
+    {
+        status = "read_error";
+        json << ", \"status\": \"" << status << "\"}";
+        return json.str();
+    }
+    std::stringstream code;
+    code << input.rdbuf();
+
+    CBotContext context;
+    CBotContext::Scope scope(&context);
+    CBotProgram::Init();
+    CBotProgram::AddFunction("message", rMessage, cMessage);
+
+    // destructors may run out of Run() (in Stop(), when the program is destroyed...), they get what's left
+    // of the limits of the program, and nothing once the program reached them
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (limits.timeout > 0) deadline = startTime + std::chrono::milliseconds(limits.timeout);
+    auto limitDestructors = [&](long ticks)
+    {
+        if (limits.maxTicks > 0 && ticks >= limits.maxTicks)
+            CBotProgram::SetDestructorLimits(0, std::chrono::steady_clock::now());
+        else
+            CBotProgram::SetDestructorLimits(limits.maxTicks > 0 ? limits.maxTicks - ticks : 0, deadline);
+    };
+    limitDestructors(0);
+
+    // the ticks are checked before the time, they don't depend on the load of the machine
+    auto limitStatus = [&](long ticks) -> std::string
+    {
+        ticks += CBotProgram::GetDestructorUsage().ticks;
+        if (limits.maxTicks > 0 && ticks >= limits.maxTicks) return "instruction_limit";
+        if (limits.timeout > 0 && elapsed() >= limits.timeout * 1000) return "timeout";
+        return "";
+    };
+
+    status = "ok";
+    long ticks = 0;
+    BatchJob job;
+    std::stringstream details;
+    std::unique_ptr<CBotProgram> program{new CBotProgram(nullptr)};
+    program->SetMemoryLimit(limits.maxMemory);
+    std::vector<std::string> externFunctions;
+    if (!program->Compile(code.str(), externFunctions, nullptr))
+    {
+        status = "compile_error";
+        details << ", " << ErrorToJson(program.get());
+    }
+    else if (externFunctions.empty())
+    {
+        status = "no_extern";
+    }
+    else
+    {
+        // the limits are for the whole program, the functions after the one reaching them aren't run
+        details << ", \"functions\": [";
+        bool limitReached = false;
+        for (std::size_t i = 0; i < externFunctions.size() && !limitReached; i++)
+        {
+            std::string functionStatus = "ok";
+            long functionTicks = 0;
+            long stoppedDestructors = CBotProgram::GetDestructorUsage().stopped;
+            program->Start(externFunctions[i]);
+            int slice = BATCH_MIN_SLICE;
+            auto sliceStart = std::chrono::steady_clock::now();
+            while (!program->Run(&job, slice))
+            {
+                functionTicks += program->GetTicks();
+
+                // the next slice is sized from the speed of this one, to end before the timeout
+                slice = BATCH_SLICE;
+                if (limits.timeout > 0)
+                {
+                    long sliceTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sliceStart).count();
+                    double ticksPerMicrosecond = static_cast<double>(program->GetTicks()) / std::max(1L, sliceTime);
+                    double remaining = static_cast<double>(limits.timeout) * 1000 - elapsed();
+                    slice = static_cast<int>(std::clamp(remaining * ticksPerMicrosecond, static_cast<double>(BATCH_MIN_SLICE), static_cast<double>(BATCH_SLICE)));
+                }
+
+                CBotProgram::CollectCycles(BATCH_COLLECT_BUDGET);
+
+                std::string limit = limitStatus(ticks + functionTicks);
+                if (limit.empty())
+                {
+                    limitDestructors(ticks + functionTicks);
+                    sliceStart = std::chrono::steady_clock::now();
+                    continue;
+                }
 
+                functionStatus = limit;
+                CBotProgram::SetDestructorLimits(0, std::chrono::steady_clock::now());
+                program->Stop();
+                limitReached = true;
+                break;
+            }
+            if (!limitReached) functionTicks += program->GetTicks();
+            ticks += functionTicks;
+            if (!limitReached) limitDestructors(ticks);
+
+            // the memory limit is a runtime error, the destructors stopped by the limits are not
+            std::string error;
+            if (!limitReached && program->GetError() == CBotErrMemory)
+            {
+                functionStatus = "memory_limit";
+                limitReached = true;
+            }
+            else if (!limitReached && CBotProgram::GetDestructorUsage().stopped > stoppedDestructors)
+            {
+                functionStatus = limitStatus(ticks);
+                limitReached = true;
+            }
+            else if (!limitReached && program->GetError() != CBotNoErr)
+            {
+                functionStatus = "runtime_error";
+                error = ", " + ErrorToJson(program.get());
+            }
+            details << (i > 0 ? ", " : "") << "{\"name\": " << ToJson(externFunctions[i])
+                    << ", \"status\": \"" << functionStatus << "\", \"ticks\": " << functionTicks << error << "}";
+
+            if (status == "ok") status = functionStatus;
+        }
+        details << "]";
+    }
+    long peakMemory = program->GetMemoryPeak();
+    long stoppedDestructors = CBotProgram::GetDestructorUsage().stopped;
+    program.reset();
+    CBotProgram::Free();
+
+    // the destructors of the static fields run last
+    if (status == "ok" && CBotProgram::GetDestructorUsage().stopped > stoppedDestructors)
+        status = limitStatus(ticks);
+    ticks += CBotProgram::GetDestructorUsage().ticks;
+
+    json << ", \"status\": \"" << status << "\", \"ticks\": " << ticks
+         << ", \"microseconds\": " << elapsed() << ", \"memory\": " << peakMemory
+         << details.str() << ", \"output\": " << ToJson(job.output)
+         << ", \"output_truncated\": " << (job.truncated ? "true" : "false") << "}";
+    return json.str();
+}
+
+//! Lists the programs of a directory, or the ones listed in a file relatively to it
+bool GetBatchFiles(const std::string& path, std::vector<std::string>& files)
+{
+    std::error_code error;
+    if (std::filesystem::is_directory(path, error))
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(path, error))
+        {
+            if (entry.is_regular_file()) files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        return !error;
+    }
+
+    std::ifstream manifest(path);
+    if (!manifest.is_open()) return false;
+
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        files.push_back((directory / line).string());
+    }
     return true;
 }
 
+//! Runs the programs of the batch mode on several threads
+int RunBatch(const std::string& path, const std::string& outputFile, long jobs, const BatchLimits& limits)
+{
+    std::vector<std::string> files;
+    if (!GetBatchFiles(path, files))
+    {
+        std::cerr << "FAILED TO READ: " << path << std::endl;
+        return 5;
+    }
+
+    std::ofstream outputStream;
+    if (!outputFile.empty())
+    {
+        outputStream.open(outputFile);
+        if (!outputStream.is_open())
+        {
+            std::cerr << "FAILED TO WRITE: " << outputFile << std::endl;
+            return 5;
+        }
+    }
+    std::ostream& output = outputFile.empty() ? std::cout : outputStream;
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::atomic<std::size_t> next{0};
+    std::mutex outputMutex;
+    std::map<std::string, int> statuses;
+    auto worker = [&]()
+    {
+        for (std::size_t i = next++; i < files.size(); i = next++)
+        {
+            std::string status;
+            std::string record = RunBatchProgram(files[i], limits, status);
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            output << record << std::endl;
+            statuses[status]++;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < jobs; i++) threads.emplace_back(worker);
+    for (std::thread& thread : threads) thread.join();
+
+    long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    std::cerr << "Ran " << files.size() << " programs in " << milliseconds << " ms:";
+    for (const auto& [status, count] : statuses) std::cerr << " " << status << " " << count;
+    std::cerr << std::endl;
+    return 0;
+}
+
 } // namespace
 
 int main(int argc, char* argv[])
 {
+    // Parse the command line
+    std::string profileFile = "";
+    std::string profileTimeFile = "";
+    std::string batchPath = "";
+    std::string outputFile = "";
+    long jobs = std::max(1u, std::thread::hardware_concurrency());
+    long maxMemory = 0;
+    BatchLimits limits;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool valid = true;
+        if (arg == "--profile" && i + 1 < argc)
+        {
+            profileFile = argv[++i];
+        }
+        else if (arg == "--profile-time" && i + 1 < argc)
+        {
+            profileTimeFile = argv[++i];
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batchPath = argv[++i];
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            outputFile = argv[++i];
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            valid = ParseNumber(argv[++i], jobs) && jobs > 0;
+        }
+        else if (arg == "--max-ticks" && i + 1 < argc)
+        {
+            valid = ParseNumber(argv[++i], limits.maxTicks);
+        }
+        else if (arg == "--timeout" && i + 1 < argc)
+        {
+            // converted to nanoseconds by the clock
+            valid = ParseNumber(argv[++i], limits.timeout) && limits.timeout <= std::numeric_limits<long>::max() / 1000000;
+        }
+        else if (arg == "--max-memory" && i + 1 < argc)
+        {
+            valid = ParseNumber(argv[++i], maxMemory) && maxMemory <= std::numeric_limits<long>::max() / (1024 * 1024);
+            if (valid) limits.maxMemory = maxMemory * 1024 * 1024;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            PrintUsage(argv[0]);
+            return 4;
+        }
+    }
+
+    if (!batchPath.empty())
+    {
+        if (!profileFile.empty() || !profileTimeFile.empty())
+        {
+            std::cerr << "The profiles aren't available in batch mode" << std::endl;
+            return 4;
+        }
+
+        // Error message strings are stored on Colobot side, each program has a CBot context of its own
+        InitializeRestext();
+        return RunBatch(batchPath, outputFile, jobs, limits);
+    }
+
     // Read program code from stdin
     std::string code = "";
     std::string line;
@@ -90,6 +550,10 @@ int main(int argc, char* argv[])
         std::cerr << "NO EXTERN FUNCTIONS FOUND";
         return 2;
     }
+    CBotProfiler profiler;
+    if (!profileFile.empty() || !profileTimeFile.empty())
+        program->SetProfiler(&profiler);
+
     bool runErrors = false;
     for (const std::string& func : externFunctions)
     {
@@ -119,5 +583,20 @@ int main(int argc, char* argv[])
         }
     }
 
+    // Write the profiles
+    auto writeProfile = [&](const std::string& filename, CBotProfiler::Measure measure)
+    {
+        if (filename.empty()) return;
+        std::ofstream file(filename);
+        if (!file.is_open())
+        {
+            std::cerr << "FAILED TO WRITE: " << filename << std::endl;
+            return;
+        }
+        profiler.WriteCollapsed(file, measure);
+    };
+    writeProfile(profileFile, CBotProfiler::Measure::TICKS);
+    writeProfile(profileTimeFile, CBotProfiler::Measure::TIME);
+
     return runErrors ? 3 : 0;
 }